@@ -0,0 +1,420 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "refgen.h"
+#include "threadpool.h"
+
+
+namespace rg {
+
+	/** Bounded multi producer multi consumer queue without locks (D. Vyukov's array queue).
+	* Each cell carries a sequence number telling producers and consumers whose turn it is, so push and pop
+	* are a single compare and swap on the shared position plus the copy of the element.
+	*/
+	template<class T>
+	class MPMCQueue {
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> _cells;
+		size_t _mask;
+		char _pad0[64];
+		std::atomic<size_t> _tail;
+		char _pad1[64];
+		std::atomic<size_t> _head;
+		char _pad2[64];
+
+	public:
+
+		/** Queue constructor.
+		* @param capacity maximum number of queued elements (rounded up to a power of two, at least 2).
+		*/
+		explicit MPMCQueue(size_t capacity) : _tail(0), _head(0) {
+			size_t size = 2;
+			while (size < capacity) {
+				size *= 2;
+			}
+			_cells.reset(new Cell[size]);
+			_mask = size - 1;
+			for (size_t i = 0; i < size; i++) {
+				_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		/** Number of cells of the queue.
+		*/
+		size_t capacity() const {
+			return _mask + 1;
+		}
+
+		/** Appends an element: returns false if the queue is full.
+		*/
+		bool push(const T &value) {
+			size_t pos = _tail.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell &cell = _cells[pos & _mask];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+				if (diff == 0) {
+					if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						cell.value = value;
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = _tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/** Removes the oldest element: returns false if the queue is empty.
+		*/
+		bool pop(T &value) {
+			size_t pos = _head.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell &cell = _cells[pos & _mask];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+				if (diff == 0) {
+					if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						value = cell.value;
+						cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (diff < 0) {
+					return false;
+				}
+				else {
+					pos = _head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+	};
+
+	/** State of an asynchronous reference computation.
+	*/
+	enum AsyncStatus {
+		ASYNC_PENDING = 0,	/**< queued or running. */
+		ASYNC_DONE = 1,		/**< completed (its cost may be no longer available if more than capacity jobs followed it). */
+		ASYNC_FAILED = -1,	/**< the computation threw an exception. */
+		ASYNC_UNKNOWN = -2	/**< the ticket was never issued. */
+	};
+
+	/** Ticket of an asynchronous computation (0 is never issued).
+	*/
+	typedef unsigned long long AsyncTicket;
+
+	/** Runs reference computations in the background: submit queues a job and returns a ticket at once, worker threads
+	* take the jobs from a lock free queue, and the caller polls or waits the tickets (or gets a completion callback).
+	* At most capacity jobs are in flight; the result of a ticket stays available until capacity newer jobs are submitted.
+	* A reference generator is not thread safe, so it must not have more than one job in flight, and the data and
+	* reference memory of a job must stay valid until it completes.
+	*/
+	class AsyncEngine {
+
+	private:
+		struct Job {
+			AsyncTicket ticket;
+			void (*run)(const Job &, double &);
+			void *refgen;
+			void *data;
+			size_t spaceSize;
+			size_t length;
+			void *ref;
+			void (*callback)();
+			void *user;
+		};
+
+		// result of a ticket, kept in the slot ticket % capacity: the ticket owning the slot and its state are packed
+		// in one word (ticket * 4 + state code), so a submit reserves the slot and its ticket with a single compare exchange
+		struct Completion {
+			std::atomic<AsyncTicket> owner;
+			std::atomic<double> cost;
+		};
+
+		enum { SLOT_FREE = 2 };
+
+		static AsyncTicket pack(AsyncTicket ticket, int state) {
+			return (ticket << 2) | (AsyncTicket)(state & 3);
+		}
+
+		static AsyncTicket ownerTicket(AsyncTicket owner) {
+			return owner >> 2;
+		}
+
+		static int ownerState(AsyncTicket owner) {
+			int code = (int)(owner & 3);
+			return code == (ASYNC_FAILED & 3) ? ASYNC_FAILED : code;
+		}
+
+		MPMCQueue<Job> _queue;
+		size_t _capacity;
+		std::unique_ptr<Completion[]> _completions;
+		std::atomic<AsyncTicket> _next;
+		std::atomic<size_t> _queued;
+
+		std::vector<std::thread> _workers;
+		std::mutex _mutex;
+		std::condition_variable _work;
+		std::condition_variable _done;
+		std::atomic<size_t> _sleepers;
+		std::atomic<size_t> _waiters;
+		std::atomic<bool> _stop;
+
+		template<typename R>
+		static void runJob(const Job &job, double &cost) {
+			Refgen<R> *refgen = (Refgen<R> *)job.refgen;
+			R result = refgen->computeRef((R *)job.data, job.spaceSize, job.length, (R *)job.ref);
+			cost = (double)result;
+			if (job.callback != nullptr) {
+				((void (*)(AsyncTicket, R, void *))job.callback)(job.ticket, result, job.user);
+			}
+		}
+
+		void complete(const Job &job, int state, double cost) {
+			Completion &slot = _completions[job.ticket % _capacity];
+			slot.cost.store(cost, std::memory_order_relaxed);
+			slot.owner.store(pack(job.ticket, state), std::memory_order_seq_cst);
+
+			// a waiter counted before the state was stored is either notified or sees the state
+			if (_waiters.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_done.notify_all();
+			}
+		}
+
+		void workerLoop() {
+			Job job;
+			for (;;) {
+				if (_queue.pop(job)) {
+					_queued--;
+					double cost = 0;
+					try {
+						job.run(job, cost);
+					}
+					catch (...) {
+						complete(job, ASYNC_FAILED, 0);
+						continue;
+					}
+					complete(job, ASYNC_DONE, cost);
+					continue;
+				}
+
+				// nothing to do: sleep until a submit (the lock is taken only by idle workers and waiters)
+				std::unique_lock<std::mutex> lock(_mutex);
+				_sleepers++;
+				_work.wait(lock, [&]() { return _stop.load() || _queued.load() > 0; });
+				_sleepers--;
+				if (_stop.load() && _queued.load() == 0) {
+					return;
+				}
+			}
+		}
+
+	public:
+
+		/** Starts the worker threads.
+		* @param numThreads number of worker threads (0: all hardware threads).
+		* @param capacity maximum number of jobs in flight.
+		*/
+		explicit AsyncEngine(size_t numThreads = 0, size_t capacity = 1024) :
+			_queue(capacity), _capacity(std::max<size_t>(capacity, 1)), _completions(new Completion[std::max<size_t>(capacity, 1)]),
+			_next(1), _queued(0), _sleepers(0), _waiters(0), _stop(false) {
+
+			for (size_t i = 0; i < _capacity; i++) {
+				_completions[i].owner.store(pack(0, SLOT_FREE), std::memory_order_relaxed);
+				_completions[i].cost.store(0, std::memory_order_relaxed);
+			}
+
+			if (numThreads == 0) {
+				numThreads = hardwareThreads();
+			}
+			_workers.reserve(numThreads);
+			for (size_t t = 0; t < numThreads; t++) {
+				_workers.emplace_back(&AsyncEngine::workerLoop, this);
+			}
+		}
+
+		AsyncEngine(const AsyncEngine &) = delete;
+		AsyncEngine & operator=(const AsyncEngine &) = delete;
+
+		/** Runs the jobs still queued and joins the workers.
+		*/
+		~AsyncEngine() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop.store(true);
+			}
+			_work.notify_all();
+			for (auto &th : _workers) {
+				th.join();
+			}
+		}
+
+		/** Number of worker threads.
+		*/
+		size_t size() const {
+			return _workers.size();
+		}
+
+		/** Maximum number of jobs in flight.
+		*/
+		size_t capacity() const {
+			return _capacity;
+		}
+
+		/** Queues the computation of the next reference of a generator and returns without waiting for it.
+		* @param refgen reference generator (no other job of it may be in flight).
+		* @param data data memory (@see Refgen::computeRef), valid until the job completes.
+		* @param spaceSize space dimension (e.g planar -> 2)
+		* @param length number of columns of data.
+		* @param ref memory of size spaceSize in which store the new reference, valid until the job completes.
+		* @param ticket ticket of the job.
+		* @param callback nullptr or function called as callback(ticket, cost, user) on the worker thread once the reference is written.
+		* @param user pointer passed to the callback.
+		* @return false if capacity jobs are already in flight or the job could not be queued (nothing is queued).
+		*/
+		template<typename R>
+		bool submit(Refgen<R> &refgen, R RG_IN *data, size_t spaceSize, size_t length, R RG_OUT *ref, AsyncTicket RG_OUT &ticket,
+			void (*callback)(AsyncTicket, R, void *) = nullptr, void *user = nullptr) {
+
+			// reserve the result slot of the next ticket first: only the submit holding it may publish the ticket, so two
+			// submits never share a slot and the next ticket is not issued before its slot is pending
+			AsyncTicket t, previous;
+			for (;;) {
+				t = _next.load(std::memory_order_acquire);
+				previous = _completions[t % _capacity].owner.load(std::memory_order_acquire);
+				if (ownerTicket(previous) >= t) {
+					// another submit is reserving ticket t, or t is already stale
+					continue;
+				}
+				if (ownerState(previous) == ASYNC_PENDING) {
+					// the job capacity tickets older is still in flight
+					if (_next.load(std::memory_order_acquire) == t) {
+						return false;
+					}
+					continue;
+				}
+				if (_completions[t % _capacity].owner.compare_exchange_weak(previous, pack(t, ASYNC_PENDING), std::memory_order_acq_rel)) {
+					break;
+				}
+			}
+
+			Job job;
+			job.ticket = t;
+			job.run = &AsyncEngine::runJob<R>;
+			job.refgen = &refgen;
+			job.data = data;
+			job.spaceSize = spaceSize;
+			job.length = length;
+			job.ref = ref;
+			job.callback = (void (*)())callback;
+			job.user = user;
+
+			// no more than capacity jobs are in flight, so the queue has room; should the push fail anyway, the slot is
+			// released and the ticket is not issued
+			if (!_queue.push(job)) {
+				_completions[t % _capacity].owner.store(previous, std::memory_order_release);
+				return false;
+			}
+			_next.store(t + 1, std::memory_order_release);
+			_queued++;
+
+			if (_sleepers.load(std::memory_order_seq_cst) > 0) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_work.notify_one();
+			}
+
+			ticket = t;
+			return true;
+		}
+
+		/** State of a job.
+		* @param ticket ticket of the job.
+		* @param cost nullptr or pointer in which store the cost of the new reference (if ASYNC_DONE and still available).
+		* @return ASYNC_PENDING, ASYNC_DONE, ASYNC_FAILED or ASYNC_UNKNOWN.
+		*/
+		int poll(AsyncTicket ticket, double RG_OUT *cost = nullptr) const {
+
+			if (ticket == 0 || ticket >= _next.load(std::memory_order_acquire)) {
+				return ASYNC_UNKNOWN;
+			}
+
+			const Completion &slot = _completions[ticket % _capacity];
+			AsyncTicket owner = slot.owner.load(std::memory_order_acquire);
+			if (ownerTicket(owner) != ticket) {
+				// a newer job took the slot (the slot of an issued ticket is reserved before the ticket is published)
+				return ASYNC_DONE;
+			}
+
+			int state = ownerState(owner);
+			double value = slot.cost.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (ownerTicket(slot.owner.load(std::memory_order_relaxed)) != ticket) {
+				return ASYNC_DONE;
+			}
+
+			if (state == ASYNC_DONE && cost != nullptr) {
+				*cost = value;
+			}
+			return state;
+		}
+
+		/** Waits for a job to complete.
+		* @param ticket ticket of the job.
+		* @param deadline time after which to give up waiting.
+		* @param cost nullptr or pointer in which store the cost of the new reference (@see poll).
+		* @return the state of the job (ASYNC_PENDING if the deadline expired first).
+		*/
+		int wait(AsyncTicket ticket, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(),
+			double RG_OUT *cost = nullptr) {
+
+			int state = poll(ticket, cost);
+			if (state != ASYNC_PENDING) {
+				return state;
+			}
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			_waiters++;
+			while ((state = poll(ticket, cost)) == ASYNC_PENDING) {
+				if (deadline == std::chrono::steady_clock::time_point::max()) {
+					_done.wait(lock);
+				}
+				else if (_done.wait_until(lock, deadline) == std::cv_status::timeout) {
+					state = poll(ticket, cost);
+					break;
+				}
+			}
+			_waiters--;
+
+			return state;
+		}
+	};
+}
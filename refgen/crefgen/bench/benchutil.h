@@ -0,0 +1,25 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+// Helpers shared by the benchmarks and the replay driver.
+
+#include <algorithm>
+#include <vector>
+
+
+namespace rgbench {
+
+	/** Nearest rank p-quantile of the samples (p in [0, 1]), which are reordered. The samples must not be empty.
+	*/
+	inline double percentile(std::vector<double> &samples, double p) {
+		size_t k = (size_t)(p * (samples.size() - 1) + 0.5);
+		std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+		return samples[k];
+	}
+}
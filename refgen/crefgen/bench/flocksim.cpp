@@ -0,0 +1,355 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/fleet.h"
+#include "crefgen/spatialgrid.h"
+#include "benchutil.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Closed loop flock simulator, the scaling benchmark of the library: N agents start on a lattice and move towards their
+// targets, each one computing its reference from the actual positions of the others (rg::Fleet::computeRefRadius) and
+// then tracking it (position += tracking * (reference - position)). For each flock size it reports the agent updates
+// per second, the tick latency (percentiles), the minimum pairwise separation, the mean number of neighbors and the
+// memory footprint. The sizes run one after another in the same process, so the memory figures are cumulative: the
+// peak RSS of the process so far and the growth of the RSS since the start of the first size.
+//
+// targets:
+//	swap	each agent goes to the opposite side of the flock (target: -start), all the paths cross at the center
+//	shift	the whole flock translates by 10 lattice spacings
+//	shuffle	each agent goes to the start position of another agent (random permutation)
+//
+// usage: flocksim [--agents n[,n...]] [--ticks n] [--dim 2|3] [--targets swap|shift|shuffle] [--radius r | --eps e]
+//			[--spacing s] [--tracking g] [--max-iter n] [--threads n] [--double] [--seed n] [--out file.json]
+
+
+struct SimOptions {
+	std::vector<size_t> agents = { 100, 1000, 10000 };
+	size_t ticks = 50;
+	size_t dim = 2;
+	std::string targets = "swap";
+	double radius = 0;			// neighbor radius, 0: gaussCutoff(d_gauss, min_alpha_gauss, eps) + max_var
+	double eps = 1e-3;
+	double spacing = 3;			// lattice spacing of the start positions (2 x d_gauss)
+	double tracking = 1;		// 1: the agents reach their reference within a tick
+	size_t maxIter = 120;
+	size_t threads = 0;
+	bool useDouble = false;
+	unsigned int seed = 1;
+	std::string out;
+};
+
+struct SimResult {
+	std::string type;
+	size_t agents;
+	size_t ticks;
+	double radius;
+	double updatesPerSecond;
+	double p50, p90, p99, max, mean;	// ms per tick
+	double minSeparation;				// over the whole run
+	double finalSeparation;
+	double meanNeighbors;
+	double targetDistance;				// mean distance from the target at the end
+	double rssBytes, peakRssBytes;
+	double rssGrowthBytes;				// since the start of the first size (cumulative over the sizes run so far)
+};
+
+
+// resident set size and its peak (bytes), 0 where /proc is not available
+void memoryUsage(double &rss, double &peak) {
+	rss = 0;
+	peak = 0;
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 6, "VmRSS:") == 0) {
+			rss = std::atof(line.c_str() + 6) * 1024;
+		}
+		else if (line.compare(0, 6, "VmHWM:") == 0) {
+			peak = std::atof(line.c_str() + 6) * 1024;
+		}
+	}
+#endif
+}
+
+// minimum distance between two agents, searched within radius (radius if no pair is closer)
+template<typename R>
+double minSeparation(rg::SpatialGrid<R> &grid, const std::vector<R> &positions, size_t dim, size_t n, R radius) {
+
+	grid.build(positions.data(), dim, n, radius);
+
+	double best = radius;
+	for (size_t k = 0; k < n; k++) {
+		grid.forEachNeighborOf(k, radius, [&](size_t j) {
+			double dist_sq = 0;
+			for (size_t i = 0; i < dim; i++) {
+				double rel = (double)positions[i * n + k] - (double)positions[i * n + j];
+				dist_sq += rel * rel;
+			}
+			best = std::min(best, std::sqrt(dist_sq));
+		});
+	}
+	return best;
+}
+
+// start positions on a square (cubic) lattice centered in the origin, targets as selected
+template<typename R>
+void makeFlock(const SimOptions &opt, size_t n, std::vector<R> &positions, std::vector<R> &targets) {
+
+	size_t dim = opt.dim;
+	size_t side = (size_t)std::ceil(std::pow((double)n, 1.0 / dim) - 1e-9);
+	double center = (side - 1) * opt.spacing / 2;
+
+	positions.resize(dim * n);
+	targets.resize(dim * n);
+	for (size_t k = 0; k < n; k++) {
+		size_t code = k;
+		for (size_t i = 0; i < dim; i++) {
+			positions[i * n + k] = (R)((code % side) * opt.spacing - center);
+			code /= side;
+		}
+	}
+
+	std::vector<size_t> perm(n);
+	for (size_t k = 0; k < n; k++) {
+		perm[k] = k;
+	}
+	std::mt19937 rng(opt.seed);
+	std::shuffle(perm.begin(), perm.end(), rng);
+
+	for (size_t k = 0; k < n; k++) {
+		for (size_t i = 0; i < dim; i++) {
+			R x = positions[i * n + k];
+			if (opt.targets == "swap") {
+				targets[i * n + k] = -x;
+			}
+			else if (opt.targets == "shift") {
+				targets[i * n + k] = x + (R)(10 * opt.spacing);
+			}
+			else {
+				targets[i * n + k] = positions[i * n + perm[k]];
+			}
+		}
+	}
+}
+
+template<typename R>
+SimResult simulate(const SimOptions &opt, const char *type, size_t n, double rssStart) {
+
+	size_t dim = opt.dim;
+	const R d_gauss = (R)1.5, min_alpha_gauss = (R)30.0, max_var = (R)0.3;
+
+	std::vector<R> positions, targets;
+	makeFlock(opt, n, positions, targets);
+	std::vector<R> refs(dim * n);
+
+	rg::Fleet<R> fleet(n, opt.threads, (R)0.01, (R)1.414, (R)1000.0, (R)0.0001, (R)500.0, (R)6.0, d_gauss, min_alpha_gauss, max_var,
+					   opt.maxIter, (R)0.3, (R)0.4, (R)1, (R)0.602, (R)0.1, (R)0.1, opt.seed);
+	R radius = opt.radius > 0 ? (R)opt.radius : rg::gaussCutoff(d_gauss, min_alpha_gauss, (R)opt.eps) + max_var;
+
+	rg::SpatialGrid<R> sepGrid;
+	R sepRadius = (R)opt.spacing;
+	double minSep = minSeparation(sepGrid, positions, dim, n, sepRadius);
+	double sep = minSep;
+	double neighbors = 0;
+
+	std::vector<double> ms;
+	ms.reserve(opt.ticks);
+	double elapsed = 0;
+
+	for (size_t t = 0; t < opt.ticks; t++) {
+		auto t1 = std::chrono::steady_clock::now();
+		fleet.computeRefRadius(positions.data(), targets.data(), dim, n, radius, refs.data());
+		auto t2 = std::chrono::steady_clock::now();
+
+		double tick = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(t2 - t1).count();
+		ms.push_back(tick);
+		elapsed += tick * 1e-3;
+
+		// closed loop: refs are stored agent by agent, positions axis by axis
+		for (size_t k = 0; k < n; k++) {
+			neighbors += (double)fleet.neighborCount(k);
+			for (size_t i = 0; i < dim; i++) {
+				R &x = positions[i * n + k];
+				x += (R)opt.tracking * (refs[k * dim + i] - x);
+			}
+		}
+
+		sep = minSeparation(sepGrid, positions, dim, n, sepRadius);
+		minSep = std::min(minSep, sep);
+	}
+
+	double targetDistance = 0;
+	for (size_t k = 0; k < n; k++) {
+		double dist_sq = 0;
+		for (size_t i = 0; i < dim; i++) {
+			double rel = (double)positions[i * n + k] - (double)targets[i * n + k];
+			dist_sq += rel * rel;
+		}
+		targetDistance += std::sqrt(dist_sq);
+	}
+
+	SimResult res;
+	res.type = type;
+	res.agents = n;
+	res.ticks = ms.size();
+	res.radius = (double)radius;
+	res.updatesPerSecond = (double)(n * ms.size()) / elapsed;
+	res.mean = elapsed * 1e3 / ms.size();
+	res.max = *std::max_element(ms.begin(), ms.end());
+	res.p50 = rgbench::percentile(ms, 0.5);
+	res.p90 = rgbench::percentile(ms, 0.9);
+	res.p99 = rgbench::percentile(ms, 0.99);
+	res.minSeparation = minSep;
+	res.finalSeparation = sep;
+	res.meanNeighbors = neighbors / (double)(n * ms.size());
+	res.targetDistance = targetDistance / n;
+	memoryUsage(res.rssBytes, res.peakRssBytes);
+	res.rssGrowthBytes = res.rssBytes - rssStart;
+	return res;
+}
+
+void printResult(const SimResult &r) {
+	std::cout << std::setw(7) << r.type << std::setw(8) << r.agents << std::setw(7) << r.ticks
+		<< std::fixed << std::setprecision(0) << std::setw(13) << r.updatesPerSecond
+		<< std::setprecision(3) << std::setw(10) << r.p50 << std::setw(10) << r.p99 << std::setw(10) << r.max
+		<< std::setw(9) << r.minSeparation << std::setw(9) << r.meanNeighbors << std::setw(10) << r.targetDistance
+		<< std::setprecision(1) << std::setw(10) << r.peakRssBytes / (1024 * 1024) << std::setw(10) << r.rssGrowthBytes / (1024 * 1024)
+		<< std::defaultfloat << std::endl;
+}
+
+bool writeJson(const std::string &path, const SimOptions &opt, const std::vector<SimResult> &results) {
+
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	out << std::setprecision(10);
+	out << "{\n  \"benchmark\": \"flocksim\",\n  \"dim\": " << opt.dim << ",\n  \"targets\": \"" << opt.targets << "\",\n  \"results\": [\n";
+	for (size_t k = 0; k < results.size(); k++) {
+		const SimResult &r = results[k];
+		out << "    {\"type\": \"" << r.type << "\", \"agents\": " << r.agents << ", \"ticks\": " << r.ticks << ", \"radius\": " << r.radius
+			<< ", \"updates_per_s\": " << r.updatesPerSecond << ", \"tick_ms\": {\"p50\": " << r.p50 << ", \"p90\": " << r.p90
+			<< ", \"p99\": " << r.p99 << ", \"max\": " << r.max << ", \"mean\": " << r.mean << "}, \"min_separation\": " << r.minSeparation
+			<< ", \"final_separation\": " << r.finalSeparation << ", \"mean_neighbors\": " << r.meanNeighbors
+			<< ", \"target_distance\": " << r.targetDistance << ", \"rss_bytes\": " << r.rssBytes << ", \"peak_rss_bytes\": " << r.peakRssBytes
+			<< ", \"cumulative_rss_growth_bytes\": " << r.rssGrowthBytes << "}" << (k + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+
+	return (bool)out;
+}
+
+std::vector<size_t> parseList(const char *arg) {
+	std::vector<size_t> values;
+	std::stringstream ss(arg);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		values.push_back((size_t)std::atoll(item.c_str()));
+	}
+	return values;
+}
+
+
+int main(int argc, char **argv) {
+
+	SimOptions opt;
+	for (int k = 1; k < argc; k++) {
+		bool value = k + 1 < argc;
+		if (std::strcmp(argv[k], "--agents") == 0 && value) {
+			opt.agents = parseList(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--ticks") == 0 && value) {
+			opt.ticks = (size_t)std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--dim") == 0 && value) {
+			opt.dim = (size_t)std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--targets") == 0 && value) {
+			opt.targets = argv[++k];
+		}
+		else if (std::strcmp(argv[k], "--radius") == 0 && value) {
+			opt.radius = std::atof(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--eps") == 0 && value) {
+			opt.eps = std::atof(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--spacing") == 0 && value) {
+			opt.spacing = std::atof(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--tracking") == 0 && value) {
+			opt.tracking = std::atof(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--max-iter") == 0 && value) {
+			opt.maxIter = (size_t)std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--threads") == 0 && value) {
+			opt.threads = (size_t)std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--seed") == 0 && value) {
+			opt.seed = (unsigned int)std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--out") == 0 && value) {
+			opt.out = argv[++k];
+		}
+		else if (std::strcmp(argv[k], "--double") == 0) {
+			opt.useDouble = true;
+		}
+		else {
+			std::cerr << "usage: " << argv[0] << " [--agents n[,n...]] [--ticks n] [--dim 2|3] [--targets swap|shift|shuffle]"
+				" [--radius r | --eps e] [--spacing s] [--tracking g] [--max-iter n] [--threads n] [--double] [--seed n] [--out file.json]" << std::endl;
+			return 2;
+		}
+	}
+
+	if ((opt.dim != 2 && opt.dim != 3) || opt.ticks == 0 || opt.agents.empty() || opt.spacing <= 0 || !(opt.eps > 0 && opt.eps < 1) ||
+		(opt.targets != "swap" && opt.targets != "shift" && opt.targets != "shuffle")) {
+		std::cerr << "invalid options" << std::endl;
+		return 2;
+	}
+
+	std::cout << "   type  agents  ticks  updates/s   p50 ms    p99 ms    max ms  min sep  neighb.  to target  peak MB  grown MB" << std::endl;
+
+	double rssStart, peakStart;
+	memoryUsage(rssStart, peakStart);
+
+	std::vector<SimResult> results;
+	for (size_t n : opt.agents) {
+		if (n < 2) {
+			continue;
+		}
+		results.push_back(opt.useDouble ? simulate<double>(opt, "double", n, rssStart) : simulate<float>(opt, "float", n, rssStart));
+		printResult(results.back());
+	}
+
+	if (!opt.out.empty()) {
+		if (!writeJson(opt.out, opt, results)) {
+			std::cerr << "cannot write " << opt.out << std::endl;
+			return 1;
+		}
+		std::cout << "results written to " << opt.out << std::endl;
+	}
+
+	return 0;
+}
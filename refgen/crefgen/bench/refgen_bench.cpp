@@ -0,0 +1,313 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/costfnc.h"
+#include "../tests/alloccount.h"
+#include "benchutil.h"
+
+#include <xtensor/xarray.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// Benchmark of the reference generator: it sweeps the number of neighbors, the space dimension, the precision,
+// max_iter and the cost version, and reports the time per call (percentiles), the loss evaluations per second and
+// the heap allocations per call. The results are printed as a table and written as JSON, to be compared between releases.
+//
+// usage: refgen_bench [--quick] [--calls n] [--max-neighbors n] [--out file.json]
+
+
+struct BenchOptions {
+	bool quick = false;
+	size_t calls = 200;			// timed calls of each case (fewer when a case is slow, @see budget)
+	size_t maxNeighbors = 10000;
+	double budget = 1.0;		// seconds of timed calls of each case
+	std::string out = "refgen_bench.json";
+};
+
+struct BenchResult {
+	std::string kind;			// "computeref" or "cost"
+	std::string type;
+	size_t dim;
+	size_t neighbors;
+	size_t maxIter;				// 0 for the cost cases
+	int cost;					// cost version
+	size_t calls;
+	double p50, p90, p99, max, mean;	// ns per call
+	double evalsPerSecond;
+	double allocsPerCall;
+};
+
+
+void summarize(std::vector<double> &ns, BenchResult &res) {
+	double total = 0;
+	for (double t : ns) {
+		total += t;
+	}
+	res.calls = ns.size();
+	res.mean = total / ns.size();
+	res.p50 = rgbench::percentile(ns, 0.5);
+	res.p90 = rgbench::percentile(ns, 0.9);
+	res.p99 = rgbench::percentile(ns, 0.99);
+	res.max = *std::max_element(ns.begin(), ns.end());
+}
+
+// agents spread on a disk whose area grows with their number, the target far from the agent
+template<typename R>
+std::vector<R> makeData(size_t dim, size_t neighbors, unsigned int seed) {
+	size_t length = neighbors + 2;
+	std::vector<R> data(dim * length);
+	R radius = (R)(2 * std::sqrt((double)neighbors + 1));
+	srand(seed);
+	for (size_t i = 0; i < dim; i++) {
+		data[i * length] = 3 * radius;
+		for (size_t k = 1; k < length; k++) {
+			data[i * length + k] = radius * 2 * (static_cast <R> (rand()) / static_cast <R> (RAND_MAX) - (R)0.5);
+		}
+	}
+	return data;
+}
+
+template<typename R>
+BenchResult benchComputeRef(const BenchOptions &opt, const char *type, size_t dim, size_t neighbors, size_t maxIter) {
+
+	size_t length = neighbors + 2;
+	std::vector<R> data = makeData<R>(dim, neighbors, 1);
+	std::vector<R> ref(dim);
+
+	rg::Refgen<R> gen((R)0.01, (R)1.414, (R)1000.0, (R)0.0001, (R)500.0, (R)6.0, (R)1.5, (R)30.0, (R)0.3, maxIter);
+
+	// warm up: first call allocations and multipliers growth
+	for (size_t k = 0; k < 5; k++) {
+		gen.computeRef(data.data(), dim, length, ref.data());
+	}
+
+	std::vector<double> ns;
+	ns.reserve(opt.calls);
+	size_t evaluations = 0;
+	double elapsed = 0;
+
+	size_t allocs = rgtest::allocations();
+	while (ns.size() < opt.calls && (ns.size() < 10 || elapsed < opt.budget)) {
+		rg::SPSAInfo info;
+		auto t1 = std::chrono::steady_clock::now();
+		gen.computeRef(data.data(), dim, length, ref.data(), &info);
+		auto t2 = std::chrono::steady_clock::now();
+
+		double t = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(t2 - t1).count();
+		ns.push_back(t);
+		elapsed += t * 1e-9;
+		evaluations += info.evaluations;
+
+		// closed loop
+		for (size_t i = 0; i < dim; i++) {
+			data[i * length + 1] = ref[i];
+		}
+	}
+	allocs = rgtest::allocations() - allocs;
+
+	BenchResult res;
+	res.kind = "computeref";
+	res.type = type;
+	res.dim = dim;
+	res.neighbors = neighbors;
+	res.maxIter = maxIter;
+	res.cost = 2;
+	res.evalsPerSecond = evaluations / elapsed;
+	res.allocsPerCall = (double)allocs / ns.size();
+	summarize(ns, res);
+	return res;
+}
+
+template<typename R>
+BenchResult benchCost(const BenchOptions &opt, const char *type, size_t dim, size_t neighbors, int version) {
+
+	size_t length = neighbors + 2;
+	std::vector<R> data = makeData<R>(dim, neighbors, 2);
+	size_t shape[2] = { dim, length };
+
+	rg::costParamV2<R> params;
+	params.ni1 = (R)0.01;
+	params.ni2 = (R)0.0001;
+	params.r1 = (R)1.414;
+	params.r2 = (R)1.0;
+	params.alpha_slow = (R)6.0;
+	params.D_gauss = (R)1.5;
+	params.min_alpha_gauss = (R)30.0;
+	params.data_raw.data = (char *)data.data();
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2u;
+
+	// costParam is the leading part of costParamV2
+	rg::costParam<R> paramsV1;
+	paramsV1.ni1 = params.ni1;
+	paramsV1.ni2 = params.ni2;
+	paramsV1.r1 = params.r1;
+	paramsV1.r2 = params.r2;
+	paramsV1.alpha_slow = params.alpha_slow;
+	paramsV1.data_raw = params.data_raw;
+
+	xt::xarray<R> theta(std::vector<size_t>{ dim, 1 });
+	for (size_t i = 0; i < dim; i++) {
+		theta(i, 0) = data[i * length + 1] + (R)0.1;
+	}
+
+	// evaluations timed together, so that the clock resolution does not matter with few neighbors
+	size_t batch = std::max<size_t>(1, 10000 / length);
+	std::vector<double> ns;
+	ns.reserve(opt.calls);
+	double elapsed = 0;
+	volatile R sink = 0;
+
+	size_t allocs = rgtest::allocations();
+	while (ns.size() < opt.calls && (ns.size() < 10 || elapsed < opt.budget)) {
+		auto t1 = std::chrono::steady_clock::now();
+		for (size_t b = 0; b < batch; b++) {
+			theta(0, 0) += (R)1e-6;
+			sink = sink + (version == 1 ? rg::costfnc<R>(theta, &paramsV1) : rg::costfncV2<R>(theta, &params));
+		}
+		auto t2 = std::chrono::steady_clock::now();
+
+		double t = std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(t2 - t1).count();
+		ns.push_back(t / batch);
+		elapsed += t * 1e-9;
+	}
+	allocs = rgtest::allocations() - allocs;
+
+	BenchResult res;
+	res.kind = "cost";
+	res.type = type;
+	res.dim = dim;
+	res.neighbors = neighbors;
+	res.maxIter = 0;
+	res.cost = version;
+	res.evalsPerSecond = ns.size() * batch / elapsed;
+	res.allocsPerCall = (double)allocs / (ns.size() * batch);
+	summarize(ns, res);
+	return res;
+}
+
+void print(const BenchResult &r) {
+	std::cout << std::left << std::setw(11) << r.kind << std::setw(7) << r.type << std::right
+		<< std::setw(4) << r.dim << std::setw(7) << r.neighbors << std::setw(5) << r.maxIter << std::setw(3) << r.cost
+		<< std::setw(7) << r.calls << std::fixed << std::setprecision(0)
+		<< std::setw(12) << r.p50 << std::setw(12) << r.p90 << std::setw(12) << r.p99 << std::setw(12) << r.max
+		<< std::setw(14) << r.evalsPerSecond << std::setprecision(2) << std::setw(9) << r.allocsPerCall
+		<< std::defaultfloat << std::endl;
+}
+
+bool writeJson(const std::string &path, const std::vector<BenchResult> &results) {
+
+	std::ofstream out(path);
+	if (!out) {
+		return false;
+	}
+
+	out << std::setprecision(10);
+	out << "{\n";
+	out << "  \"benchmark\": \"refgen_bench\",\n";
+	out << "  \"format\": 1,\n";
+#if defined(__VERSION__)
+	out << "  \"compiler\": \"" << __VERSION__ << "\",\n";
+#else
+	out << "  \"compiler\": \"unknown\",\n";
+#endif
+	out << "  \"results\": [\n";
+	for (size_t k = 0; k < results.size(); k++) {
+		const BenchResult &r = results[k];
+		out << "    { \"kind\": \"" << r.kind << "\", \"type\": \"" << r.type << "\", \"dim\": " << r.dim
+			<< ", \"neighbors\": " << r.neighbors << ", \"max_iter\": " << r.maxIter << ", \"cost\": " << r.cost
+			<< ", \"calls\": " << r.calls << ", \"ns_p50\": " << r.p50 << ", \"ns_p90\": " << r.p90 << ", \"ns_p99\": " << r.p99
+			<< ", \"ns_max\": " << r.max << ", \"ns_mean\": " << r.mean << ", \"evals_per_s\": " << r.evalsPerSecond
+			<< ", \"allocs_per_call\": " << r.allocsPerCall << " }" << (k + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+
+	return (bool)out;
+}
+
+
+int main(int argc, char **argv) {
+
+	BenchOptions opt;
+	for (int k = 1; k < argc; k++) {
+		if (std::strcmp(argv[k], "--quick") == 0) {
+			opt.quick = true;
+		}
+		else if (std::strcmp(argv[k], "--calls") == 0 && k + 1 < argc) {
+			opt.calls = std::max(1, std::atoi(argv[++k]));
+		}
+		else if (std::strcmp(argv[k], "--max-neighbors") == 0 && k + 1 < argc) {
+			opt.maxNeighbors = std::max(1, std::atoi(argv[++k]));
+		}
+		else if (std::strcmp(argv[k], "--out") == 0 && k + 1 < argc) {
+			opt.out = argv[++k];
+		}
+		else {
+			std::cerr << "usage: " << argv[0] << " [--quick] [--calls n] [--max-neighbors n] [--out file.json]" << std::endl;
+			return 2;
+		}
+	}
+	if (opt.quick) {
+		opt.calls = std::min<size_t>(opt.calls, 50);
+		opt.maxNeighbors = std::min<size_t>(opt.maxNeighbors, 100);
+		opt.budget = 0.2;
+	}
+
+	std::vector<size_t> neighbors;
+	for (size_t n : { 1, 10, 100, 1000, 10000 }) {
+		if (n <= opt.maxNeighbors) {
+			neighbors.push_back(n);
+		}
+	}
+	std::vector<size_t> dims = { 2, 3 };
+	std::vector<size_t> maxIters = opt.quick ? std::vector<size_t>{ 120 } : std::vector<size_t>{ 30, 120, 480 };
+
+	std::cout << std::left << std::setw(11) << "kind" << std::setw(7) << "type" << std::right
+		<< std::setw(4) << "dim" << std::setw(7) << "neigh" << std::setw(5) << "iter" << std::setw(3) << "v"
+		<< std::setw(7) << "calls" << std::setw(12) << "p50 ns" << std::setw(12) << "p90 ns" << std::setw(12) << "p99 ns"
+		<< std::setw(12) << "max ns" << std::setw(14) << "evals/s" << std::setw(9) << "allocs" << std::endl;
+
+	std::vector<BenchResult> results;
+	for (size_t dim : dims) {
+		for (size_t n : neighbors) {
+			for (int version : { 1, 2 }) {
+				results.push_back(benchCost<float>(opt, "float", dim, n, version));
+				print(results.back());
+				results.push_back(benchCost<double>(opt, "double", dim, n, version));
+				print(results.back());
+			}
+			for (size_t maxIter : maxIters) {
+				results.push_back(benchComputeRef<float>(opt, "float", dim, n, maxIter));
+				print(results.back());
+				results.push_back(benchComputeRef<double>(opt, "double", dim, n, maxIter));
+				print(results.back());
+			}
+		}
+	}
+
+	if (!writeJson(opt.out, results)) {
+		std::cerr << "cannot write " << opt.out << std::endl;
+		return 1;
+	}
+	std::cout << "results written to " << opt.out << std::endl;
+
+	return 0;
+}
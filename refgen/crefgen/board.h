@@ -0,0 +1,442 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "refgen.h"
+
+
+namespace rg {
+
+	static_assert(ATOMIC_INT_LOCK_FREE == 2, "PositionBoard: the slot stamps must be lock free to be shared among processes");
+
+	/** Positions of a group of agents in a named shared memory segment, written and read by any number of processes
+	* on the same host without locks. Each agent owns a slot: it publishes its position there, and the reference
+	* generators of the other agents read all the slots in place (@see BoardReader), instead of each process copying
+	* the positions of its neighbors in its own data block.
+	* The positions are stored row major (spaceSize x capacity: all the x, then all the y, ...), the layout read by
+	* Refgen::computeRefView. Each slot has a seqlock stamp: 0 until the first publish, odd while it is written, even
+	* otherwise and increased by each write, so a reader can tell whether a position changed (or was torn) while it was used.
+	* Slots never published or retired hold far away coordinates (@see far), which give no repulsion.
+	*/
+	template<typename R>
+	class PositionBoard {
+
+	private:
+
+		struct Header {
+			char magic[8];						// "RGBOARD" and a terminating 0, written last by create
+			uint32_t version;					// 1
+			uint32_t real_size;					// sizeof(R)
+			uint32_t space_size;
+			uint32_t capacity;
+			std::atomic<uint32_t> count;		// 1 + highest slot ever published
+			uint32_t reserved;
+			uint64_t positions_offset;			// bytes from the start of the segment
+		};
+
+		std::string _name;
+		char *_base;
+		size_t _bytes;
+		Header *_header;
+		std::atomic<uint32_t> *_stamps;
+		R *_positions;
+#ifdef _WIN32
+		HANDLE _mapping;
+#endif
+
+		static size_t align64(size_t bytes) {
+			return (bytes + 63) / 64 * 64;
+		}
+
+		static size_t segmentBytes(size_t capacity, size_t spaceSize, size_t &positionsOffset) {
+			positionsOffset = align64(sizeof(Header)) + align64(capacity * sizeof(std::atomic<uint32_t>));
+			return positionsOffset + align64(spaceSize * capacity * sizeof(R));
+		}
+
+		// shared memory object name (POSIX names start with a slash)
+		static std::string systemName(const char *name) {
+#ifdef _WIN32
+			return std::string("Local\\") + name;
+#else
+			return name[0] == '/' ? std::string(name) : std::string("/") + name;
+#endif
+		}
+
+		bool map(const char *name, size_t bytes, bool create) {
+			std::string sysName = systemName(name);
+#ifdef _WIN32
+			_mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)bytes >> 32),
+												   (DWORD)bytes, sysName.c_str()) :
+				OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, sysName.c_str());
+			if (_mapping == nullptr) {
+				return false;
+			}
+			_base = (char *)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+			if (_base == nullptr) {
+				return false;
+			}
+			if (!create) {
+				MEMORY_BASIC_INFORMATION info;
+				bytes = VirtualQuery(_base, &info, sizeof(info)) != 0 ? (size_t)info.RegionSize : 0;
+			}
+#else
+			int fd = shm_open(sysName.c_str(), create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0666);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat st;
+			bool sized = create ? ftruncate(fd, (off_t)bytes) == 0 : (fstat(fd, &st) == 0 && (bytes = (size_t)st.st_size) > 0);
+			void *base = sized ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+			::close(fd);
+			if (base == MAP_FAILED) {
+				return false;
+			}
+			_base = (char *)base;
+#endif
+			_bytes = bytes;
+			_header = (Header *)_base;
+			return _bytes >= sizeof(Header);
+		}
+
+	public:
+
+		/** Empty board constructor (@see create and open).
+		*/
+		PositionBoard() : _base(nullptr), _bytes(0), _header(nullptr), _stamps(nullptr), _positions(nullptr) {
+#ifdef _WIN32
+			_mapping = nullptr;
+#endif
+		}
+
+		PositionBoard(const PositionBoard &) = delete;
+		PositionBoard & operator=(const PositionBoard &) = delete;
+
+		/** Unmaps the board (the shared memory stays until remove, @see remove).
+		*/
+		~PositionBoard() {
+			close();
+		}
+
+		/** Coordinate of the slots without a position: far enough to give no repulsion, small enough to be squared.
+		*/
+		static R far() {
+			return (R)1e15;
+		}
+
+		/** Creates (or recreates, losing its positions) a named board and maps it.
+		* @param name name of the shared memory segment.
+		* @param capacity number of slots.
+		* @param spaceSize space dimension (e.g planar -> 2).
+		* @return false if the segment cannot be created.
+		*/
+		bool create(const char *name, size_t capacity, size_t spaceSize) {
+			close();
+
+			size_t positionsOffset;
+			size_t bytes = segmentBytes(capacity, spaceSize, positionsOffset);
+			if (capacity == 0 || spaceSize == 0 || capacity > UINT32_MAX || !map(name, bytes, true)) {
+				close();
+				return false;
+			}
+
+			std::memset(_header->magic, 0, sizeof(_header->magic));
+			_header->version = 1;
+			_header->real_size = (uint32_t)sizeof(R);
+			_header->space_size = (uint32_t)spaceSize;
+			_header->capacity = (uint32_t)capacity;
+			new (&_header->count) std::atomic<uint32_t>(0);
+			_header->reserved = 0;
+			_header->positions_offset = positionsOffset;
+
+			_stamps = (std::atomic<uint32_t> *)(_base + align64(sizeof(Header)));
+			_positions = (R *)(_base + positionsOffset);
+			for (size_t k = 0; k < capacity; k++) {
+				new (&_stamps[k]) std::atomic<uint32_t>(0);
+			}
+			for (size_t k = 0; k < spaceSize * capacity; k++) {
+				_positions[k] = far();
+			}
+
+			// the magic tells the other processes that the board is ready
+			std::atomic_thread_fence(std::memory_order_release);
+			std::memcpy(_header->magic, "RGBOARD", 8);
+			_name = name;
+			return true;
+		}
+
+		/** Maps an existing board created by another process (or by this one).
+		* @param name name of the shared memory segment.
+		* @return false if the segment does not exist, it is not ready yet or its precision is not R.
+		*/
+		bool open(const char *name) {
+			close();
+
+			if (!map(name, 0, false) || std::memcmp(_header->magic, "RGBOARD", 8) != 0 || _header->version != 1 ||
+				_header->real_size != sizeof(R)) {
+				close();
+				return false;
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			size_t positionsOffset;
+			if (segmentBytes(_header->capacity, _header->space_size, positionsOffset) > _bytes || positionsOffset != _header->positions_offset) {
+				close();
+				return false;
+			}
+
+			_stamps = (std::atomic<uint32_t> *)(_base + align64(sizeof(Header)));
+			_positions = (R *)(_base + positionsOffset);
+			_name = name;
+			return true;
+		}
+
+		/** Unmaps the board.
+		*/
+		void close() {
+#ifdef _WIN32
+			if (_base != nullptr) {
+				UnmapViewOfFile(_base);
+			}
+			if (_mapping != nullptr) {
+				CloseHandle(_mapping);
+			}
+			_mapping = nullptr;
+#else
+			if (_base != nullptr) {
+				munmap(_base, _bytes);
+			}
+#endif
+			_base = nullptr;
+			_bytes = 0;
+			_header = nullptr;
+			_stamps = nullptr;
+			_positions = nullptr;
+			_name.clear();
+		}
+
+		/** Removes a named board: the processes that mapped it keep using it, new ones cannot open it any more
+		* (on Windows the segment goes away with its last mapping, and this does nothing).
+		*/
+		static bool remove(const char *name) {
+#ifdef _WIN32
+			(void)name;
+			return true;
+#else
+			return shm_unlink(systemName(name).c_str()) == 0;
+#endif
+		}
+
+		/** True if a board is mapped.
+		*/
+		bool isOpen() const {
+			return _base != nullptr;
+		}
+
+		/** Name of the mapped board (empty if none).
+		*/
+		const std::string & name() const {
+			return _name;
+		}
+
+		/** Number of slots.
+		*/
+		size_t capacity() const {
+			return _header != nullptr ? _header->capacity : 0;
+		}
+
+		/** Space dimension.
+		*/
+		size_t spaceSize() const {
+			return _header != nullptr ? _header->space_size : 0;
+		}
+
+		/** 1 + highest slot ever published: the slots read as neighbors.
+		*/
+		size_t count() const {
+			return _header != nullptr ? _header->count.load(std::memory_order_acquire) : 0;
+		}
+
+		/** Positions of all the slots in place (row major, spaceSize x capacity): the component i of the slot k is positions()[i * stride() + k].
+		*/
+		const R * positions() const {
+			return _positions;
+		}
+
+		/** Distance between the rows (axes) of positions().
+		*/
+		size_t stride() const {
+			return capacity();
+		}
+
+		/** Seqlock stamp of a slot: 0 never published, odd while written, even otherwise.
+		*/
+		uint32_t stamp(size_t slot) const {
+			return _stamps[slot].load(std::memory_order_acquire);
+		}
+
+		/** Writes the position of a slot. Each slot must have a single writer.
+		* @param slot slot of the agent (less than capacity).
+		* @param position spaceSize coordinates.
+		*/
+		void publish(size_t slot, const R *position) {
+
+			if (slot >= capacity()) {
+				THROW_EXCPT("PositionBoard: slot out of range");
+			}
+
+			std::atomic<uint32_t> &stamp = _stamps[slot];
+			uint32_t odd = stamp.load(std::memory_order_relaxed) | 1;	// an odd stamp left by a dead writer is reused
+			stamp.store(odd, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+
+			size_t cap = capacity();
+			for (size_t i = 0; i < spaceSize(); i++) {
+				_positions[i * cap + slot] = position[i];
+			}
+
+			stamp.store(odd + 1, std::memory_order_release);
+
+			uint32_t count = _header->count.load(std::memory_order_relaxed);
+			while (count < slot + 1 && !_header->count.compare_exchange_weak(count, (uint32_t)(slot + 1), std::memory_order_acq_rel)) {
+			}
+		}
+
+		/** Removes the position of a slot (e.g. an agent leaving the group): it gives no repulsion any more.
+		*/
+		void retire(size_t slot) {
+			std::vector<R> far_position(spaceSize(), far());
+			publish(slot, far_position.data());
+		}
+
+		/** Consistent copy of the position of a slot.
+		* @param slot slot to read.
+		* @param position spaceSize elements where to store the coordinates.
+		* @return false if the slot has no position (never published or retired).
+		*/
+		bool read(size_t slot, R RG_OUT *position) const {
+
+			size_t cap = capacity();
+			uint32_t before, after;
+			do {
+				before = stamp(slot);
+				while (before & 1) {
+					std::this_thread::yield();
+					before = stamp(slot);
+				}
+				for (size_t i = 0; i < spaceSize(); i++) {
+					position[i] = _positions[i * cap + slot];
+				}
+				std::atomic_thread_fence(std::memory_order_acquire);
+				after = _stamps[slot].load(std::memory_order_relaxed);
+			} while (before != after);
+
+			return before != 0 && position[0] != far();
+		}
+	};
+
+	/** Reference computation of an agent on a shared position board: the neighbors are read in place
+	* (@see Refgen::computeRefView), their stamps are checked after the computation to detect the positions updated
+	* (or torn) meanwhile and the computation may be repeated. One reader for each agent: it keeps the stamps buffer.
+	*/
+	template<typename R>
+	class BoardReader {
+
+	private:
+		std::vector<uint32_t> _stamps;
+		std::vector<R> _self;
+		size_t _spins;
+
+	public:
+
+		/** Reader constructor.
+		* @param spins maximum number of yields waiting for a slot being written before reading it anyway (it is then reported as changed).
+		*/
+		explicit BoardReader(size_t spins = 1000) : _spins(spins) {
+		}
+
+		/** Computes the next reference of the agent of a slot, all the other slots of the board being its neighbors.
+		* @param gen reference generator of the agent.
+		* @param board board holding the positions (its space dimension is the one of the problem).
+		* @param slot slot of the agent (not a neighbor of itself).
+		* @param target spaceSize coordinates of the target.
+		* @param position spaceSize coordinates of the actual position.
+		* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+		* @param changed optional pointer where to store the number of neighbors updated while the last attempt read them.
+		* @param max_retries times the computation is repeated while some neighbor changed (0: never).
+		* @param info optional pointer where to store the number of iterations and cost evaluations of the last attempt.
+		* @return the cost of the reference.
+		*/
+		template<size_t Dim, class Cost>
+		R computeRef(Refgen<R, Dim, Cost> &gen, const PositionBoard<R> &board, size_t slot, const R RG_IN *target, const R RG_IN *position,
+			R RG_OUT *ref, size_t RG_OUT *changed = nullptr, size_t max_retries = 0, SPSAInfo RG_OUT *info = nullptr) {
+
+			size_t spaceSize = board.spaceSize();
+			_self.resize(2 * spaceSize);
+			for (size_t i = 0; i < spaceSize; i++) {
+				_self[2 * i] = target[i];
+				_self[2 * i + 1] = position[i];
+			}
+
+			R cost = 0;
+			size_t torn = 0;
+			for (size_t attempt = 0; attempt <= max_retries; attempt++) {
+
+				size_t count = board.count();
+				_stamps.resize(board.capacity());
+				for (size_t j = 0; j < count; j++) {
+					uint32_t s = board.stamp(j);
+					for (size_t spin = 0; (s & 1) && spin < _spins; spin++) {
+						std::this_thread::yield();
+						s = board.stamp(j);
+					}
+					_stamps[j] = s;
+				}
+
+				cost = gen.computeRefView(_self.data(), board.positions(), board.stride(), count, slot, spaceSize, ref, info);
+
+				// a neighbor changed if it was being written or it has been written since
+				std::atomic_thread_fence(std::memory_order_acquire);
+				torn = 0;
+				for (size_t j = 0; j < count; j++) {
+					if (j != slot && ((_stamps[j] & 1) || board.stamp(j) != _stamps[j])) {
+						torn++;
+					}
+				}
+				if (torn == 0) {
+					break;
+				}
+			}
+
+			if (changed != nullptr) {
+				*changed = torn;
+			}
+			return cost;
+		}
+	};
+}
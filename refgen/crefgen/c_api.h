@@ -9,6 +9,51 @@
 
 #include "../rgcommon.h"
 
+#include <stdint.h>
+
+/** First order SPSA solver, the default one (@see refgen_float_set_solver). */
+#define RG_SOLVER_SPSA 0u
+
+/** Adaptive second order SPSA solver (@see refgen_float_set_solver). */
+#define RG_SOLVER_2SPSA 1u
+
+/** Deterministic solver using the analytic gradient of the cost (@see refgen_float_set_solver). */
+#define RG_SOLVER_GRADIENT 2u
+
+/** Cross-entropy population solver, max_iter being the number of rounds (@see refgen_float_set_population). */
+#define RG_SOLVER_CEM 3u
+
+/** Row major data block: all the x, then all the y, ... (@see refgen_float_computeref_layout). */
+#define RG_LAYOUT_ROW_MAJOR 0u
+
+/** Interleaved (column major) data block: one {x, y, ...} record for each column (@see refgen_float_computeref_layout). */
+#define RG_LAYOUT_INTERLEAVED 1u
+
+/** A separate array for each axis (@see refgen_float_computeref_layout). */
+#define RG_LAYOUT_AXES 2u
+
+/** One in Q16.16, the fixed point format of the refgen_q16 functions (value = raw / RG_Q16_ONE). */
+#define RG_Q16_ONE 65536
+
+/** Q16.16 raw value of a constant, rounded to nearest (e.g. RG_Q16(1.414)): folded by the compiler for literals. */
+#define RG_Q16(x) ((int32_t)((x) * 65536.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+/** Performance counters of a reference generator (@see refgen_float_get_stats), counted only when the library is built with RG_ENABLE_STATS.
+*/
+typedef struct refgen_stats {
+	unsigned long long calls;			/**< references computed. */
+	unsigned long long iterations;		/**< solver iterations. */
+	unsigned long long evaluations;		/**< loss evaluations. */
+	unsigned long long delta_clips;		/**< iterations whose step was scaled down to max_delta. */
+	unsigned long long var_clamps;		/**< references pulled back to max_var from the actual position. */
+	unsigned long long ni1_saturated;	/**< calls run with the external constrain multiplier at max_ni. */
+	unsigned long long ns_prepare;		/**< nanoseconds spent mapping the data and updating the multipliers. */
+	unsigned long long ns_solve;		/**< nanoseconds spent in the solver. */
+	unsigned long long ns_finalize;		/**< nanoseconds spent clamping and writing the references. */
+	double ni1;							/**< external constrain multiplier of the last call (always available, 0 for the global counters). */
+	double ni2;							/**< internal constrain multiplier of the last call (always available, 0 for the global counters). */
+} refgen_stats;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,12 +92,14 @@ extern "C" {
 	* @param alpha SPSA step size decay rate (use: 0.602).
 	* @param c SPSA initial perturbation coefficient (use: 0.1).
 	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param seed seed of the SPSA perturbation generator (instances with the same seed and inputs give the same references).
 	* @see SPSA
 	* @see Refgen
 	*/
 	RG_API void * __stdcall new_refgen_float_ext(float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
 									float d_gauss, float min_alpha_gauss, float max_var,
-									unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma);
+									unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma,
+									unsigned long long seed);
 
 	/** Allocates a double precision reference generator.
 	* @param alpha_rate1 growth rate of the external constrain multiplier.
@@ -87,12 +134,14 @@ extern "C" {
 	* @param alpha SPSA step size decay rate (use: 0.602).
 	* @param c SPSA initial perturbation coefficient (use: 0.1).
 	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param seed seed of the SPSA perturbation generator (instances with the same seed and inputs give the same references).
 	* @see SPSA
 	* @see Refgen
 	*/
 	RG_API void * __stdcall new_refgen_double_ext(double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
 												  double d_gauss, double min_alpha_gauss, double max_var,
-												  unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma);
+												  unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma,
+												  unsigned long long seed);
 
 	/** Destroy a single precision reference generator.
 	* @param refgen pointer to a single precision reference generator to destroy.
@@ -132,6 +181,852 @@ extern "C" {
 	*/
 	RG_API double __stdcall refgen_double_computeref(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref);
 
+	/** Computes the next reference using a single precision reference generator and reports the work done.
+	* @param refgen pointer to a single precision reference generator.
+	* @param data float pointer to data memory (@see refgen_float_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param iterations NULL or pointer where to store the number of SPSA iterations actually run.
+	* @param evaluations NULL or pointer where to store the number of cost function evaluations.
+	* @see refgen_float_set_stop
+	*/
+	RG_API float __stdcall refgen_float_computeref_ext(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length, float RG_OUT *ref,
+												 unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations);
+
+	/** Sets the SPSA stopping rules of a single precision reference generator (all zeros: exactly max_iter iterations).
+	* @param refgen pointer to a single precision reference generator.
+	* @param step_tol stop when the length of the last SPSA step is below step_tol (0: disabled).
+	* @param window number of iterations averaged by the plateau rule (0: disabled).
+	* @param plateau_tol stop when the mean cost of a window changes less than plateau_tol (relative) from the previous window.
+	* @param min_iter no rule is checked before min_iter iterations.
+	*/
+	RG_API void __stdcall refgen_float_set_stop(void *refgen, float step_tol, unsigned int window, float plateau_tol, unsigned int min_iter);
+
+	/** Enables or disables the warm start mode of a single precision reference generator: each call starts from the previous
+	* reference and runs a shorter SPSA with resumed gains, a full run is done when the target jumps.
+	* @param refgen pointer to a single precision reference generator.
+	* @param enable non zero to enable the warm start mode.
+	* @param iterations SPSA iterations of a warm started call (e.g. 20).
+	* @param gain_offset gain sequence offset of a warm started call (max_iter: the gains go on from where a full run ends).
+	* @param reset_dist target jump that triggers a full run from the actual position.
+	*/
+	RG_API void __stdcall refgen_float_set_warm_start(void *refgen, int enable, unsigned int iterations, unsigned int gain_offset, float reset_dist);
+
+	/** Sets the multi-start mode of a single precision reference generator: each call runs chains independent SPSA chains
+	* from different starting points and keeps the best solution.
+	* @param refgen pointer to a single precision reference generator.
+	* @param chains number of chains (1: multi-start disabled).
+	* @param iterations SPSA iterations of each chain (0: the usual budget).
+	* @param spread maximum distance of the starting points of the chains from the usual one along each axis.
+	* @param n_threads maximum number of threads running the chains (0: all hardware threads).
+	*/
+	RG_API void __stdcall refgen_float_set_multi_start(void *refgen, unsigned int chains, unsigned int iterations, float spread, unsigned int n_threads);
+
+	/** Selects the optimization algorithm of the next computations of a single precision reference generator (RG_SOLVER_SPSA
+	* unless set).
+	* @param refgen pointer to a single precision reference generator.
+	* @param solver RG_SOLVER_SPSA, RG_SOLVER_2SPSA, RG_SOLVER_GRADIENT or RG_SOLVER_CEM.
+	* @return 1 on success, 0 if the solver is not known (the previous one is kept).
+	*/
+	RG_API int __stdcall refgen_float_set_solver(void *refgen, unsigned int solver);
+
+	/** Sets the population of the cross-entropy solver (RG_SOLVER_CEM) of a single precision reference generator.
+	* @param refgen pointer to a single precision reference generator.
+	* @param population candidates of each round, scored by one batched cost call (at least 2, e.g. 32).
+	* @param elites best candidates fitting the sampling distribution of the next round (1..population, e.g. 8).
+	* @param sigma initial standard deviation of the candidates along each axis (e.g. 0.1).
+	* @param sigma_min lower bound of the standard deviations (e.g. 0.001).
+	* @param smoothing weight of the elites in each update of the distribution (in (0, 1], e.g. 0.7).
+	* @return 1 on success, 0 if the settings are not valid (the previous ones are kept).
+	*/
+	RG_API int __stdcall refgen_float_set_population(void *refgen, unsigned int population, unsigned int elites, float sigma, float sigma_min, float smoothing);
+
+	/** Starts a resumable reference computation with a single precision reference generator: the solver iterations are run
+	* by refgen_float_step (e.g. in the time left in each control frame) and the reference is taken by refgen_float_finish.
+	* @param refgen pointer to a single precision reference generator.
+	* @param data float pointer to data memory (@see refgen_float_computeref): it has to stay valid until refgen_float_finish.
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+	* @return the cost of the starting point, NaN if the computation could not be started.
+	*/
+	RG_API float __stdcall refgen_float_begin(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length);
+
+	/** Runs more iterations of the computation started by refgen_float_begin.
+	* @param refgen pointer to a single precision reference generator.
+	* @param iterations maximum number of iterations (0: no limit, budget_ns required).
+	* @param budget_ns time budget in nanoseconds from the call: the step ends after the first iteration ending past it (0: no limit).
+	* @return the cost of the best solution found so far, NaN if no computation was started by refgen_float_begin.
+	*/
+	RG_API float __stdcall refgen_float_step(void *refgen, unsigned int iterations, unsigned long long budget_ns);
+
+	/** Ends the computation started by refgen_float_begin, storing the best solution found as the new reference.
+	* @param refgen pointer to a single precision reference generator.
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param iterations NULL or pointer where to store the number of iterations run by all the steps.
+	* @param evaluations NULL or pointer where to store the number of cost function evaluations.
+	* @return the cost of the reference, NaN (ref, iterations and evaluations untouched) if no computation was started by
+	*	refgen_float_begin.
+	*/
+	RG_API float __stdcall refgen_float_finish(void *refgen, float RG_OUT *ref, unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations);
+
+	/** Computes the next reference using a double precision reference generator and reports the work done.
+	* @param refgen pointer to a double precision reference generator.
+	* @param data double pointer to data memory (@see refgen_double_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param iterations NULL or pointer where to store the number of SPSA iterations actually run.
+	* @param evaluations NULL or pointer where to store the number of cost function evaluations.
+	* @see refgen_double_set_stop
+	*/
+	RG_API double __stdcall refgen_double_computeref_ext(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref,
+												 unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations);
+
+	/** Sets the SPSA stopping rules of a double precision reference generator (all zeros: exactly max_iter iterations).
+	* @param refgen pointer to a double precision reference generator.
+	* @param step_tol stop when the length of the last SPSA step is below step_tol (0: disabled).
+	* @param window number of iterations averaged by the plateau rule (0: disabled).
+	* @param plateau_tol stop when the mean cost of a window changes less than plateau_tol (relative) from the previous window.
+	* @param min_iter no rule is checked before min_iter iterations.
+	*/
+	RG_API void __stdcall refgen_double_set_stop(void *refgen, double step_tol, unsigned int window, double plateau_tol, unsigned int min_iter);
+
+	/** Enables or disables the warm start mode of a double precision reference generator: each call starts from the previous
+	* reference and runs a shorter SPSA with resumed gains, a full run is done when the target jumps.
+	* @param refgen pointer to a double precision reference generator.
+	* @param enable non zero to enable the warm start mode.
+	* @param iterations SPSA iterations of a warm started call (e.g. 20).
+	* @param gain_offset gain sequence offset of a warm started call (max_iter: the gains go on from where a full run ends).
+	* @param reset_dist target jump that triggers a full run from the actual position.
+	*/
+	RG_API void __stdcall refgen_double_set_warm_start(void *refgen, int enable, unsigned int iterations, unsigned int gain_offset, double reset_dist);
+
+	/** Sets the multi-start mode of a double precision reference generator: each call runs chains independent SPSA chains
+	* from different starting points and keeps the best solution.
+	* @param refgen pointer to a double precision reference generator.
+	* @param chains number of chains (1: multi-start disabled).
+	* @param iterations SPSA iterations of each chain (0: the usual budget).
+	* @param spread maximum distance of the starting points of the chains from the usual one along each axis.
+	* @param n_threads maximum number of threads running the chains (0: all hardware threads).
+	*/
+	RG_API void __stdcall refgen_double_set_multi_start(void *refgen, unsigned int chains, unsigned int iterations, double spread, unsigned int n_threads);
+
+	/** Selects the optimization algorithm of the next computations of a double precision reference generator (RG_SOLVER_SPSA
+	* unless set).
+	* @param refgen pointer to a double precision reference generator.
+	* @param solver RG_SOLVER_SPSA, RG_SOLVER_2SPSA, RG_SOLVER_GRADIENT or RG_SOLVER_CEM.
+	* @return 1 on success, 0 if the solver is not known (the previous one is kept).
+	*/
+	RG_API int __stdcall refgen_double_set_solver(void *refgen, unsigned int solver);
+
+	/** Sets the population of the cross-entropy solver (RG_SOLVER_CEM) of a double precision reference generator.
+	* @param refgen pointer to a double precision reference generator.
+	* @param population candidates of each round, scored by one batched cost call (at least 2, e.g. 32).
+	* @param elites best candidates fitting the sampling distribution of the next round (1..population, e.g. 8).
+	* @param sigma initial standard deviation of the candidates along each axis (e.g. 0.1).
+	* @param sigma_min lower bound of the standard deviations (e.g. 0.001).
+	* @param smoothing weight of the elites in each update of the distribution (in (0, 1], e.g. 0.7).
+	* @return 1 on success, 0 if the settings are not valid (the previous ones are kept).
+	*/
+	RG_API int __stdcall refgen_double_set_population(void *refgen, unsigned int population, unsigned int elites, double sigma, double sigma_min, double smoothing);
+
+	/** Starts a resumable reference computation with a double precision reference generator: the solver iterations are run
+	* by refgen_double_step (e.g. in the time left in each control frame) and the reference is taken by refgen_double_finish.
+	* @param refgen pointer to a double precision reference generator.
+	* @param data double pointer to data memory (@see refgen_double_computeref): it has to stay valid until refgen_double_finish.
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+	* @return the cost of the starting point, NaN if the computation could not be started.
+	*/
+	RG_API double __stdcall refgen_double_begin(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length);
+
+	/** Runs more iterations of the computation started by refgen_double_begin.
+	* @param refgen pointer to a double precision reference generator.
+	* @param iterations maximum number of iterations (0: no limit, budget_ns required).
+	* @param budget_ns time budget in nanoseconds from the call: the step ends after the first iteration ending past it (0: no limit).
+	* @return the cost of the best solution found so far, NaN if no computation was started by refgen_double_begin.
+	*/
+	RG_API double __stdcall refgen_double_step(void *refgen, unsigned int iterations, unsigned long long budget_ns);
+
+	/** Ends the computation started by refgen_double_begin, storing the best solution found as the new reference.
+	* @param refgen pointer to a double precision reference generator.
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param iterations NULL or pointer where to store the number of iterations run by all the steps.
+	* @param evaluations NULL or pointer where to store the number of cost function evaluations.
+	* @return the cost of the reference, NaN (ref, iterations and evaluations untouched) if no computation was started by
+	*	refgen_double_begin.
+	*/
+	RG_API double __stdcall refgen_double_finish(void *refgen, double RG_OUT *ref, unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations);
+
+	/** Allocates a single precision fleet, e.g. a group of reference generators (one for each agent) updated together.
+	* @param n_agents number of agents.
+	* @param n_threads maximum number of threads used to update the fleet (0: all hardware threads).
+	* @param alpha_rate1 growth rate of the external constrain multiplier.
+	* @param r1 external attractive constrain radius.
+	* @param alpha_rate2 growth rate of the internal constrain multiplier.
+	* @param r2 internal repulsive constrain radius.
+	* @param max_ni multipliers saturation.
+	* @param alpha_slow dynamic friction coefficient.
+	* @param d_gauss safe distance among agents.
+	* @param min_alpha_gauss minimum value for the gauss repulsive distribution of the agent respect others.
+	* @param max_var maximum distance of the new reference with respect to the actual position.
+	* @see Fleet
+	*/
+	RG_API void * __stdcall new_refgen_float_fleet(unsigned int n_agents, unsigned int n_threads,
+												float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
+												float d_gauss, float min_alpha_gauss, float max_var);
+
+	/** Allocates a single precision fleet specifying the SPSA algorithm parameters.
+	* @param n_agents number of agents.
+	* @param n_threads maximum number of threads used to update the fleet (0: all hardware threads).
+	* @param alpha_rate1 growth rate of the external constrain multiplier.
+	* @param r1 external attractive constrain radius.
+	* @param alpha_rate2 growth rate of the internal constrain multiplier.
+	* @param r2 internal repulsive constrain radius.
+	* @param max_ni multipliers saturation.
+	* @param alpha_slow dynamic friction coefficient.
+	* @param d_gauss safe distance among agents.
+	* @param min_alpha_gauss minimum value for the gauss repulsive distribution of the agent respect others.
+	* @param max_var maximum distance of the new reference with respect to the actual position.
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param seed fleet seed (each agent gets its own perturbation stream, results do not depend on n_threads).
+	* @see Fleet
+	*/
+	RG_API void * __stdcall new_refgen_float_fleet_ext(unsigned int n_agents, unsigned int n_threads,
+													float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
+													float d_gauss, float min_alpha_gauss, float max_var,
+													unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma,
+													unsigned long long seed);
+
+	/** Destroy a single precision fleet.
+	* @param fleet pointer to a single precision fleet to destroy.
+	* @see Fleet
+	*/
+	RG_API void __stdcall delete_refgen_float_fleet(void *fleet);
+
+	/** Selects the optimization algorithm of all the agents of a single precision fleet (@see refgen_float_set_solver).
+	* @param fleet pointer to a single precision fleet.
+	* @param solver RG_SOLVER_SPSA, RG_SOLVER_2SPSA, RG_SOLVER_GRADIENT or RG_SOLVER_CEM.
+	* @return 1 on success, 0 if the solver is not known (the previous one is kept).
+	*/
+	RG_API int __stdcall refgen_float_fleet_set_solver(void *fleet, unsigned int solver);
+
+	/** Sets the SPSA stopping rules of all the agents of a single precision fleet.
+	* @param fleet pointer to a single precision fleet.
+	* @see refgen_float_set_stop
+	*/
+	RG_API void __stdcall refgen_float_fleet_set_stop(void *fleet, float step_tol, unsigned int window, float plateau_tol, unsigned int min_iter);
+
+	/** Sets the warm start mode of all the agents of a single precision fleet.
+	* @param fleet pointer to a single precision fleet.
+	* @see refgen_float_set_warm_start
+	*/
+	RG_API void __stdcall refgen_float_fleet_set_warm_start(void *fleet, int enable, unsigned int iterations, unsigned int gain_offset, float reset_dist);
+
+	/** Sets the multi-start mode of all the agents of a single precision fleet (the chains of an agent run on its thread).
+	* @param fleet pointer to a single precision fleet.
+	* @see refgen_float_set_multi_start
+	*/
+	RG_API void __stdcall refgen_float_fleet_set_multi_start(void *fleet, unsigned int chains, unsigned int iterations, float spread);
+
+	/** Computes the next reference of many agents at once using a single precision fleet.
+	* @param fleet pointer to a single precision fleet.
+	* @param data float pointer to the packed data of all the agents. The block of agent k starts at data + offsets[k] and it has the
+	*	same properties required by refgen_float_computeref:
+	*	- rank: 2
+	*	- shape: spaceSize x length_k, where length_k = (offsets[k + 1] - offsets[k]) / spaceSize
+	*	- memory layout: row major (e.g. x1, x2, ..., xk, y1, y2, ..., yk, ...)
+	*	- data meaning: [target agentActualPosition othersPosition...].
+	* @param offsets n_agents + 1 element offsets of the agent blocks (offsets[n_agents] is the total data size).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param n_agents number of agents to update (at most the number of agents of the fleet).
+	* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+	*	references (the reference of agent k starts at refs + k * spaceSize).
+	* @return the sum of the final costs of the agents, NaN (no reference computed) if n_agents is greater than the number of
+	*	agents of the fleet.
+	*/
+	RG_API float __stdcall refgen_float_computeref_batch(void *fleet, float RG_IN *data, const unsigned int RG_IN *offsets, unsigned int spaceSize,
+												   unsigned int n_agents, float RG_OUT *refs);
+
+	/** Computes the next reference of many agents from their global positions using a single precision fleet.
+	* Each agent only sees the agents closer than the gaussian cutoff (derived from d_gauss, min_alpha_gauss and eps) plus
+	* max_var, found with a uniform grid, so the cost of the update grows linearly with the number of agents.
+	* @param fleet pointer to a single precision fleet.
+	* @param positions actual positions of the agents (row major, spaceSize x n_agents: x1, x2, ..., xn, y1, y2, ..., yn, ...).
+	* @param targets targets of the agents (same layout of positions).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param n_agents number of agents to update (at most the number of agents of the fleet).
+	* @param eps tolerated contribution of a single excluded neighbor to the cost (in (0, 1), e.g. 1e-6).
+	* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+	*	references (the reference of agent k starts at refs + k * spaceSize).
+	* @param truncation NULL or a pointer to n_agents elements in which store the bound on the cost error of each agent due to the
+	*	excluded neighbors.
+	* @return the sum of the final costs of the agents, NaN (no reference computed) if eps is not in (0, 1), min_alpha_gauss is
+	*	not greater than 1 or n_agents is greater than the number of agents of the fleet.
+	*/
+	RG_API float __stdcall refgen_float_computeref_grid(void *fleet, const float RG_IN *positions, const float RG_IN *targets, unsigned int spaceSize,
+												  unsigned int n_agents, float eps, float RG_OUT *refs, float RG_OUT *truncation);
+
+	/** Allocates a double precision fleet, e.g. a group of reference generators (one for each agent) updated together.
+	* @param n_agents number of agents.
+	* @param n_threads maximum number of threads used to update the fleet (0: all hardware threads).
+	* @param alpha_rate1 growth rate of the external constrain multiplier.
+	* @param r1 external attractive constrain radius.
+	* @param alpha_rate2 growth rate of the internal constrain multiplier.
+	* @param r2 internal repulsive constrain radius.
+	* @param max_ni multipliers saturation.
+	* @param alpha_slow dynamic friction coefficient.
+	* @param d_gauss safe distance among agents.
+	* @param min_alpha_gauss minimum value for the gauss repulsive distribution of the agent respect others.
+	* @param max_var maximum distance of the new reference with respect to the actual position.
+	* @see Fleet
+	*/
+	RG_API void * __stdcall new_refgen_double_fleet(unsigned int n_agents, unsigned int n_threads,
+												double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
+												double d_gauss, double min_alpha_gauss, double max_var);
+
+	/** Allocates a double precision fleet specifying the SPSA algorithm parameters.
+	* @param n_agents number of agents.
+	* @param n_threads maximum number of threads used to update the fleet (0: all hardware threads).
+	* @param alpha_rate1 growth rate of the external constrain multiplier.
+	* @param r1 external attractive constrain radius.
+	* @param alpha_rate2 growth rate of the internal constrain multiplier.
+	* @param r2 internal repulsive constrain radius.
+	* @param max_ni multipliers saturation.
+	* @param alpha_slow dynamic friction coefficient.
+	* @param d_gauss safe distance among agents.
+	* @param min_alpha_gauss minimum value for the gauss repulsive distribution of the agent respect others.
+	* @param max_var maximum distance of the new reference with respect to the actual position.
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param seed fleet seed (each agent gets its own perturbation stream, results do not depend on n_threads).
+	* @see Fleet
+	*/
+	RG_API void * __stdcall new_refgen_double_fleet_ext(unsigned int n_agents, unsigned int n_threads,
+													double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
+													double d_gauss, double min_alpha_gauss, double max_var,
+													unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma,
+													unsigned long long seed);
+
+	/** Destroy a double precision fleet.
+	* @param fleet pointer to a double precision fleet to destroy.
+	* @see Fleet
+	*/
+	RG_API void __stdcall delete_refgen_double_fleet(void *fleet);
+
+	/** Selects the optimization algorithm of all the agents of a double precision fleet (@see refgen_double_set_solver).
+	* @param fleet pointer to a double precision fleet.
+	* @param solver RG_SOLVER_SPSA, RG_SOLVER_2SPSA, RG_SOLVER_GRADIENT or RG_SOLVER_CEM.
+	* @return 1 on success, 0 if the solver is not known (the previous one is kept).
+	*/
+	RG_API int __stdcall refgen_double_fleet_set_solver(void *fleet, unsigned int solver);
+
+	/** Sets the SPSA stopping rules of all the agents of a double precision fleet.
+	* @param fleet pointer to a double precision fleet.
+	* @see refgen_double_set_stop
+	*/
+	RG_API void __stdcall refgen_double_fleet_set_stop(void *fleet, double step_tol, unsigned int window, double plateau_tol, unsigned int min_iter);
+
+	/** Sets the warm start mode of all the agents of a double precision fleet.
+	* @param fleet pointer to a double precision fleet.
+	* @see refgen_double_set_warm_start
+	*/
+	RG_API void __stdcall refgen_double_fleet_set_warm_start(void *fleet, int enable, unsigned int iterations, unsigned int gain_offset, double reset_dist);
+
+	/** Sets the multi-start mode of all the agents of a double precision fleet (the chains of an agent run on its thread).
+	* @param fleet pointer to a double precision fleet.
+	* @see refgen_double_set_multi_start
+	*/
+	RG_API void __stdcall refgen_double_fleet_set_multi_start(void *fleet, unsigned int chains, unsigned int iterations, double spread);
+
+	/** Computes the next reference of many agents at once using a double precision fleet.
+	* @param fleet pointer to a double precision fleet.
+	* @param data double pointer to the packed data of all the agents. The block of agent k starts at data + offsets[k] and it has the
+	*	same properties required by refgen_double_computeref:
+	*	- rank: 2
+	*	- shape: spaceSize x length_k, where length_k = (offsets[k + 1] - offsets[k]) / spaceSize
+	*	- memory layout: row major (e.g. x1, x2, ..., xk, y1, y2, ..., yk, ...)
+	*	- data meaning: [target agentActualPosition othersPosition...].
+	* @param offsets n_agents + 1 element offsets of the agent blocks (offsets[n_agents] is the total data size).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param n_agents number of agents to update (at most the number of agents of the fleet).
+	* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+	*	references (the reference of agent k starts at refs + k * spaceSize).
+	* @return the sum of the final costs of the agents, NaN (no reference computed) if n_agents is greater than the number of
+	*	agents of the fleet.
+	*/
+	RG_API double __stdcall refgen_double_computeref_batch(void *fleet, double RG_IN *data, const unsigned int RG_IN *offsets, unsigned int spaceSize,
+												   unsigned int n_agents, double RG_OUT *refs);
+
+	/** Computes the next reference of many agents from their global positions using a double precision fleet.
+	* Each agent only sees the agents closer than the gaussian cutoff (derived from d_gauss, min_alpha_gauss and eps) plus
+	* max_var, found with a uniform grid, so the cost of the update grows linearly with the number of agents.
+	* @param fleet pointer to a double precision fleet.
+	* @param positions actual positions of the agents (row major, spaceSize x n_agents: x1, x2, ..., xn, y1, y2, ..., yn, ...).
+	* @param targets targets of the agents (same layout of positions).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param n_agents number of agents to update (at most the number of agents of the fleet).
+	* @param eps tolerated contribution of a single excluded neighbor to the cost (in (0, 1), e.g. 1e-6).
+	* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+	*	references (the reference of agent k starts at refs + k * spaceSize).
+	* @param truncation NULL or a pointer to n_agents elements in which store the bound on the cost error of each agent due to the
+	*	excluded neighbors.
+	* @return the sum of the final costs of the agents, NaN (no reference computed) if eps is not in (0, 1), min_alpha_gauss is
+	*	not greater than 1 or n_agents is greater than the number of agents of the fleet.
+	*/
+	RG_API double __stdcall refgen_double_computeref_grid(void *fleet, const double RG_IN *positions, const double RG_IN *targets, unsigned int spaceSize,
+												  unsigned int n_agents, double eps, double RG_OUT *refs, double RG_OUT *truncation);
+
+	/** Allocates a pool of worker threads running reference computations with work stealing.
+	* @param n_threads number of threads running the jobs, the calling one included (0: all hardware threads).
+	* @param pin non zero to pin each worker thread to its own core.
+	* @see ThreadPool
+	*/
+	RG_API void * __stdcall new_refgen_pool(unsigned int n_threads, int pin);
+
+	/** Deallocates a thread pool (its worker threads are joined).
+	* @param pool pointer to the thread pool to destroy.
+	*/
+	RG_API void __stdcall delete_refgen_pool(void *pool);
+
+	/** Computes the next reference of a set of single precision reference generators at once (e.g. one tick of many agents),
+	* spreading them over the threads of a pool: idle threads steal jobs from the busy ones.
+	* @param pool pointer to a thread pool.
+	* @param refgens n_jobs pointers to distinct single precision reference generators.
+	* @param data n_jobs pointers to the data memory of each job (@see refgen_float_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param lengths n_jobs numbers of columns of the data memory of each job.
+	* @param refs n_jobs pointers to memory of size spaceSize in which store the new reference of each job.
+	* @param n_jobs number of jobs.
+	* @param costs NULL or a pointer to n_jobs elements in which store the cost of each new reference.
+	* @return the sum of the costs of the jobs.
+	*/
+	RG_API float __stdcall refgen_float_computeref_jobs(void *pool, void * const RG_IN *refgens, float * const RG_IN *data, unsigned int spaceSize,
+												  const unsigned int RG_IN *lengths, float * const RG_OUT *refs, unsigned int n_jobs, float RG_OUT *costs);
+
+	/** Restarts the thread pool of a single precision fleet.
+	* @param fleet pointer to a single precision fleet.
+	* @param n_threads number of threads used by the fleet updates (0: all hardware threads).
+	* @param pin non zero to pin each worker thread to its own core.
+	*/
+	RG_API void __stdcall refgen_float_fleet_set_threads(void *fleet, unsigned int n_threads, int pin);
+
+	/** Computes the next reference of a set of double precision reference generators at once (e.g. one tick of many agents),
+	* spreading them over the threads of a pool: idle threads steal jobs from the busy ones.
+	* @param pool pointer to a thread pool.
+	* @param refgens n_jobs pointers to distinct double precision reference generators.
+	* @param data n_jobs pointers to the data memory of each job (@see refgen_double_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param lengths n_jobs numbers of columns of the data memory of each job.
+	* @param refs n_jobs pointers to memory of size spaceSize in which store the new reference of each job.
+	* @param n_jobs number of jobs.
+	* @param costs NULL or a pointer to n_jobs elements in which store the cost of each new reference.
+	* @return the sum of the costs of the jobs.
+	*/
+	RG_API double __stdcall refgen_double_computeref_jobs(void *pool, void * const RG_IN *refgens, double * const RG_IN *data, unsigned int spaceSize,
+												  const unsigned int RG_IN *lengths, double * const RG_OUT *refs, unsigned int n_jobs, double RG_OUT *costs);
+
+	/** Restarts the thread pool of a double precision fleet.
+	* @param fleet pointer to a double precision fleet.
+	* @param n_threads number of threads used by the fleet updates (0: all hardware threads).
+	* @param pin non zero to pin each worker thread to its own core.
+	*/
+	RG_API void __stdcall refgen_double_fleet_set_threads(void *fleet, unsigned int n_threads, int pin);
+
+	/** State of an asynchronous computation: queued or running.
+	*/
+#define RG_ASYNC_PENDING 0
+	/** State of an asynchronous computation: completed (the reference has been written).
+	*/
+#define RG_ASYNC_DONE 1
+	/** State of an asynchronous computation: the computation failed.
+	*/
+#define RG_ASYNC_FAILED (-1)
+	/** State of an asynchronous computation: the ticket was never issued.
+	*/
+#define RG_ASYNC_UNKNOWN (-2)
+
+	/** Completion callback of an asynchronous single precision computation, called on a worker thread.
+	*/
+	typedef void (*refgen_float_callback)(unsigned long long ticket, float cost, void *user);
+
+	/** Completion callback of an asynchronous double precision computation, called on a worker thread.
+	*/
+	typedef void (*refgen_double_callback)(unsigned long long ticket, double cost, void *user);
+
+	/** Starts the worker threads of the asynchronous computations (otherwise the first submit starts them with the defaults).
+	* @param n_threads number of worker threads (0: all hardware threads).
+	* @param capacity maximum number of computations in flight (0: 1024); the result of a ticket stays available until capacity newer ones are submitted.
+	* @return 0 on success, 1 if the workers are already running.
+	* @see AsyncEngine
+	*/
+	RG_API int __stdcall refgen_async_start(unsigned int n_threads, unsigned int capacity);
+
+	/** Runs the computations still queued and stops the worker threads. It may overlap other asynchronous calls: it waits
+	* for the polls and waits in progress (a refgen_wait without timeout on a queued computation until it completes), the
+	* later ones report RG_ASYNC_UNKNOWN and a later submit starts the workers again. It must not be called from a callback.
+	*/
+	RG_API void __stdcall refgen_async_stop(void);
+
+	/** Queues the computation of the next reference of a single precision reference generator and returns at once.
+	* The generator must not have other computations in flight, and data and ref must stay valid until it completes.
+	* @param refgen pointer to a single precision reference generator.
+	* @param data data memory (@see refgen_float_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory.
+	* @param ref memory of size spaceSize in which store the new reference.
+	* @param callback NULL or function called once the reference is written.
+	* @param user pointer passed to the callback.
+	* @param ticket pointer in which store the ticket of the computation.
+	* @return 0 on success, 1 if capacity computations are already in flight or the computation could not be queued (nothing is queued).
+	*/
+	RG_API int __stdcall refgen_float_submit(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length, float RG_OUT *ref,
+									 refgen_float_callback callback, void *user, unsigned long long RG_OUT *ticket);
+
+	/** Queues the computation of the next reference of a double precision reference generator and returns at once.
+	* The generator must not have other computations in flight, and data and ref must stay valid until it completes.
+	* @param refgen pointer to a double precision reference generator.
+	* @param data data memory (@see refgen_double_computeref).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory.
+	* @param ref memory of size spaceSize in which store the new reference.
+	* @param callback NULL or function called once the reference is written.
+	* @param user pointer passed to the callback.
+	* @param ticket pointer in which store the ticket of the computation.
+	* @return 0 on success, 1 if capacity computations are already in flight or the computation could not be queued (nothing is queued).
+	*/
+	RG_API int __stdcall refgen_double_submit(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref,
+									  refgen_double_callback callback, void *user, unsigned long long RG_OUT *ticket);
+
+	/** State of an asynchronous computation, without blocking.
+	* @param ticket ticket of the computation.
+	* @param cost NULL or a pointer in which store the cost of the new reference (if done and still available).
+	* @return RG_ASYNC_PENDING, RG_ASYNC_DONE, RG_ASYNC_FAILED or RG_ASYNC_UNKNOWN.
+	*/
+	RG_API int __stdcall refgen_poll(unsigned long long ticket, double RG_OUT *cost);
+
+	/** Waits for an asynchronous computation to complete.
+	* @param ticket ticket of the computation.
+	* @param timeout_ns maximum waiting time in nanoseconds (0: no limit).
+	* @param cost NULL or a pointer in which store the cost of the new reference (@see refgen_poll).
+	* @return the state of the computation (RG_ASYNC_PENDING if the timeout expired first).
+	*/
+	RG_API int __stdcall refgen_wait(unsigned long long ticket, unsigned long long timeout_ns, double RG_OUT *cost);
+
+	/** Performance counters of a single precision reference generator since its creation or the last reset.
+	* @param refgen pointer to a single precision reference generator.
+	* @param stats pointer in which store the counters (all zero but the multipliers when the counters are compiled out).
+	* @return 1 if the library counts (built with RG_ENABLE_STATS), 0 otherwise.
+	*/
+	RG_API int __stdcall refgen_float_get_stats(void *refgen, refgen_stats RG_OUT *stats);
+
+	/** Zeroes the performance counters of a single precision reference generator.
+	* @param refgen pointer to a single precision reference generator.
+	*/
+	RG_API void __stdcall refgen_float_reset_stats(void *refgen);
+
+	/** Performance counters of an agent of a single precision fleet (@see refgen_float_get_stats).
+	* @param fleet pointer to a single precision fleet.
+	* @param agent index of the agent.
+	* @param stats pointer in which store the counters.
+	* @return 1 if the library counts (built with RG_ENABLE_STATS), 0 otherwise or if agent is out of range (stats untouched).
+	*/
+	RG_API int __stdcall refgen_float_fleet_get_stats(void *fleet, unsigned int agent, refgen_stats RG_OUT *stats);
+
+	/** Performance counters of a double precision reference generator since its creation or the last reset.
+	* @param refgen pointer to a double precision reference generator.
+	* @param stats pointer in which store the counters (all zero but the multipliers when the counters are compiled out).
+	* @return 1 if the library counts (built with RG_ENABLE_STATS), 0 otherwise.
+	*/
+	RG_API int __stdcall refgen_double_get_stats(void *refgen, refgen_stats RG_OUT *stats);
+
+	/** Zeroes the performance counters of a double precision reference generator.
+	* @param refgen pointer to a double precision reference generator.
+	*/
+	RG_API void __stdcall refgen_double_reset_stats(void *refgen);
+
+	/** Performance counters of an agent of a double precision fleet (@see refgen_double_get_stats).
+	* @param fleet pointer to a double precision fleet.
+	* @param agent index of the agent.
+	* @param stats pointer in which store the counters.
+	* @return 1 if the library counts (built with RG_ENABLE_STATS), 0 otherwise or if agent is out of range (stats untouched).
+	*/
+	RG_API int __stdcall refgen_double_fleet_get_stats(void *fleet, unsigned int agent, refgen_stats RG_OUT *stats);
+
+	/** Performance counters summed over all the reference generators of the process, of both precisions.
+	* @param stats pointer in which store the counters (the multipliers are 0).
+	* @return 1 if the library counts (built with RG_ENABLE_STATS), 0 otherwise.
+	*/
+	RG_API int __stdcall refgen_get_global_stats(refgen_stats RG_OUT *stats);
+
+	/** Zeroes the performance counters summed over all the reference generators.
+	*/
+	RG_API void __stdcall refgen_reset_global_stats(void);
+
+	/** Allocates a ring buffer of solver trace records (@see TraceBuffer), shared by any number of reference generators.
+	* @param capacity number of records kept (rounded up to a power of two), the oldest ones are overwritten.
+	*/
+	RG_API void * __stdcall new_refgen_trace(unsigned int capacity);
+
+	/** Deallocates a trace buffer: no reference generator may still use it.
+	* @param trace pointer to the trace buffer to destroy.
+	*/
+	RG_API void __stdcall delete_refgen_trace(void *trace);
+
+	/** Writes the records of a trace buffer to a binary file (@see TraceFileHeader), to be read by the rgtrace tool.
+	* @param trace pointer to a trace buffer.
+	* @param path file to (over)write.
+	* @return the number of records written, -1 if the file cannot be written.
+	*/
+	RG_API long long __stdcall refgen_trace_dump(void *trace, const char *path);
+
+	/** Tells if the library records traces.
+	* @return 1 if the library is built with RG_ENABLE_TRACE, 0 otherwise (the trace buffers stay empty).
+	*/
+	RG_API int __stdcall refgen_trace_enabled(void);
+
+	/** Records the solver iterations of a single precision reference generator in a trace buffer.
+	* @param refgen pointer to a single precision reference generator.
+	* @param trace pointer to a trace buffer (NULL: no tracing).
+	* @param source id written in the records of this generator.
+	*/
+	RG_API void __stdcall refgen_float_set_trace(void *refgen, void *trace, unsigned int source);
+
+	/** Records the solver iterations of all the agents of a single precision fleet in a trace buffer (source: agent index).
+	* @param fleet pointer to a single precision fleet.
+	* @param trace pointer to a trace buffer (NULL: no tracing).
+	*/
+	RG_API void __stdcall refgen_float_fleet_set_trace(void *fleet, void *trace);
+
+	/** Records the solver iterations of a double precision reference generator in a trace buffer.
+	* @param refgen pointer to a double precision reference generator.
+	* @param trace pointer to a trace buffer (NULL: no tracing).
+	* @param source id written in the records of this generator.
+	*/
+	RG_API void __stdcall refgen_double_set_trace(void *refgen, void *trace, unsigned int source);
+
+	/** Records the solver iterations of all the agents of a double precision fleet in a trace buffer (source: agent index).
+	* @param fleet pointer to a double precision fleet.
+	* @param trace pointer to a trace buffer (NULL: no tracing).
+	*/
+	RG_API void __stdcall refgen_double_fleet_set_trace(void *fleet, void *trace);
+
+	/** Opens a record log (@see RefgenRecorder): the computeRef calls of the reference generators attached to it are
+	* appended with their inputs, state and results, to be replayed offline (@see refgen_replay and the rgreplay tool).
+	* @param path file to (over)write.
+	* @return pointer to the recorder, NULL if the file cannot be written.
+	*/
+	RG_API void * __stdcall new_refgen_recorder(const char *path);
+
+	/** Closes a record log and deallocates its recorder: no reference generator may still use it.
+	* @param recorder pointer to the recorder to destroy.
+	*/
+	RG_API void __stdcall delete_refgen_recorder(void *recorder);
+
+	/** Writes the buffered records of a record log to its file.
+	* @param recorder pointer to a recorder.
+	* @return 0 if every write succeeded so far, -1 otherwise.
+	*/
+	RG_API int __stdcall refgen_recorder_flush(void *recorder);
+
+	/** Records the computeRef calls of a single precision reference generator.
+	* @param refgen pointer to a single precision reference generator.
+	* @param recorder pointer to a recorder (NULL: no recording).
+	* @param source id written in the records of this generator.
+	*/
+	RG_API void __stdcall refgen_float_set_recorder(void *refgen, void *recorder, unsigned int source);
+
+	/** Records the computeRef calls of a double precision reference generator.
+	* @param refgen pointer to a double precision reference generator.
+	* @param recorder pointer to a recorder (NULL: no recording).
+	* @param source id written in the records of this generator.
+	*/
+	RG_API void __stdcall refgen_double_set_recorder(void *refgen, void *recorder, unsigned int source);
+
+	/** Replays a record log and compares the results with the recorded ones (@see replayLog).
+	* @param path record log.
+	* @param calls optional pointer where to store the number of replayed calls.
+	* @param mismatches optional pointer where to store the number of replayed calls whose results differ.
+	* @return 0 on success (the calls of a generator with invalid recorded settings are skipped), -1 if the file is not a
+	* readable record log or the replay fails.
+	*/
+	RG_API int __stdcall refgen_replay(const char *path, unsigned long long *calls, unsigned long long *mismatches);
+
+	/** Creates or opens a single precision shared position board (@see PositionBoard): the agents of several processes
+	* publish their positions there and compute their references reading the others in place.
+	* @param name name of the shared memory segment.
+	* @param capacity number of slots (ignored when opening).
+	* @param spaceSize space dimention (ignored when opening).
+	* @param create 1: create (or recreate) the board, 0: open an existing one.
+	* @return pointer to the board, NULL if it cannot be created or opened.
+	*/
+	RG_API void * __stdcall refgen_float_board_open(const char *name, unsigned int capacity, unsigned int spaceSize, int create);
+
+	/** Unmaps a single precision shared position board and deallocates it.
+	* @param board pointer to the board.
+	* @param unlink 1: also remove the segment name, so that no other process can open it.
+	*/
+	RG_API void __stdcall refgen_float_board_close(void *board, int unlink);
+
+	/** Publishes the position of an agent on a single precision shared position board.
+	* @param board pointer to the board.
+	* @param slot slot of the agent.
+	* @param position spaceSize coordinates.
+	* @return 1 on success, 0 if the slot is out of range (nothing is written).
+	*/
+	RG_API int __stdcall refgen_float_board_publish(void *board, unsigned int slot, const float *position);
+
+	/** Reads a consistent copy of a position of a single precision shared position board.
+	* @param board pointer to the board.
+	* @param slot slot to read.
+	* @param position spaceSize elements where to store the coordinates.
+	* @return 1 if the slot has a position, 0 otherwise (or if the slot is out of range).
+	*/
+	RG_API int __stdcall refgen_float_board_read(void *board, unsigned int slot, float *position);
+
+	/** Computes the next reference of an agent of a single precision shared position board, all the other published
+	* agents being its neighbors (read in place).
+	* @param refgen pointer to a single precision reference generator.
+	* @param board pointer to the board.
+	* @param slot slot of the agent.
+	* @param target spaceSize coordinates of the target.
+	* @param position spaceSize coordinates of the actual position.
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param changed optional pointer where to store the number of neighbors updated while they were read.
+	* @return the cost of the reference, NaN if it cannot be computed.
+	*/
+	RG_API float __stdcall refgen_float_board_computeref(void *refgen, void *board, unsigned int slot, const float *target,
+		const float *position, float *ref, unsigned int *changed);
+
+	/** Creates or opens a double precision shared position board (@see PositionBoard): the agents of several processes
+	* publish their positions there and compute their references reading the others in place.
+	* @param name name of the shared memory segment.
+	* @param capacity number of slots (ignored when opening).
+	* @param spaceSize space dimention (ignored when opening).
+	* @param create 1: create (or recreate) the board, 0: open an existing one.
+	* @return pointer to the board, NULL if it cannot be created or opened.
+	*/
+	RG_API void * __stdcall refgen_double_board_open(const char *name, unsigned int capacity, unsigned int spaceSize, int create);
+
+	/** Unmaps a double precision shared position board and deallocates it.
+	* @param board pointer to the board.
+	* @param unlink 1: also remove the segment name, so that no other process can open it.
+	*/
+	RG_API void __stdcall refgen_double_board_close(void *board, int unlink);
+
+	/** Publishes the position of an agent on a double precision shared position board.
+	* @param board pointer to the board.
+	* @param slot slot of the agent.
+	* @param position spaceSize coordinates.
+	* @return 1 on success, 0 if the slot is out of range (nothing is written).
+	*/
+	RG_API int __stdcall refgen_double_board_publish(void *board, unsigned int slot, const double *position);
+
+	/** Reads a consistent copy of a position of a double precision shared position board.
+	* @param board pointer to the board.
+	* @param slot slot to read.
+	* @param position spaceSize elements where to store the coordinates.
+	* @return 1 if the slot has a position, 0 otherwise (or if the slot is out of range).
+	*/
+	RG_API int __stdcall refgen_double_board_read(void *board, unsigned int slot, double *position);
+
+	/** Computes the next reference of an agent of a double precision shared position board, all the other published
+	* agents being its neighbors (read in place).
+	* @param refgen pointer to a double precision reference generator.
+	* @param board pointer to the board.
+	* @param slot slot of the agent.
+	* @param target spaceSize coordinates of the target.
+	* @param position spaceSize coordinates of the actual position.
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @param changed optional pointer where to store the number of neighbors updated while they were read.
+	* @return the cost of the reference, NaN if it cannot be computed.
+	*/
+	RG_API double __stdcall refgen_double_board_computeref(void *refgen, void *board, unsigned int slot, const double *target,
+		const double *position, double *ref, unsigned int *changed);
+
+	/** Computes the next reference of a single precision reference generator on a data block of any layout, read in
+	* place (e.g. interleaved records as received, without transposing them, @see refgen_float_computeref).
+	* @param refgen pointer to a single precision reference generator.
+	* @param data data block [target agentActualPosition othersPosition...] (row major and interleaved layouts).
+	* @param axes spaceSize pointers, one row [target agentActualPosition othersPosition...] for each axis (axes layout).
+	* @param layout RG_LAYOUT_ROW_MAJOR, RG_LAYOUT_INTERLEAVED or RG_LAYOUT_AXES.
+	* @param stride distance between the rows (row major) or the records (interleaved) of data, 0: length (row major) or spaceSize (interleaved).
+	* @param spaceSize space dimention (e.g planar -> 2)
+	* @param length number of columns of the data block (e.g. 2 + number of visible other agents).
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @return the cost of the reference, NaN (ref untouched) if length is less than 2 or the data of the layout is NULL.
+	*/
+	RG_API float __stdcall refgen_float_computeref_layout(void *refgen, const float RG_IN *data, const float * const RG_IN *axes, unsigned int layout,
+		unsigned int stride, unsigned int spaceSize, unsigned int length, float RG_OUT *ref);
+
+	/** Computes the next reference of a double precision reference generator on a data block of any layout, read in
+	* place (e.g. interleaved records as received, without transposing them, @see refgen_double_computeref).
+	* @param refgen pointer to a double precision reference generator.
+	* @param data data block [target agentActualPosition othersPosition...] (row major and interleaved layouts).
+	* @param axes spaceSize pointers, one row [target agentActualPosition othersPosition...] for each axis (axes layout).
+	* @param layout RG_LAYOUT_ROW_MAJOR, RG_LAYOUT_INTERLEAVED or RG_LAYOUT_AXES.
+	* @param stride distance between the rows (row major) or the records (interleaved) of data, 0: length (row major) or spaceSize (interleaved).
+	* @param spaceSize space dimention (e.g planar -> 2)
+	* @param length number of columns of the data block (e.g. 2 + number of visible other agents).
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+	* @return the cost of the reference, NaN (ref untouched) if length is less than 2 or the data of the layout is NULL.
+	*/
+	RG_API double __stdcall refgen_double_computeref_layout(void *refgen, const double RG_IN *data, const double * const RG_IN *axes, unsigned int layout,
+		unsigned int stride, unsigned int spaceSize, unsigned int length, double RG_OUT *ref);
+
+	/** Instruction set of the neighbor kernels used by the cost functions, selected when the library is loaded: the widest
+	* one the CPU supports among the ones the library is built for, unless the environment variable RG_SIMD_ARCH names
+	* another available one ("scalar", "baseline", "avx2" or "avx512").
+	* @param float_lanes NULL or pointer where to store the single precision values processed at once.
+	* @param double_lanes NULL or pointer where to store the double precision values processed at once.
+	* @return the name of the kernels, "builtin" if the library is built without RG_SIMD_DISPATCH.
+	*/
+	RG_API const char * __stdcall refgen_simd_arch(unsigned int RG_OUT *float_lanes, unsigned int RG_OUT *double_lanes);
+
+	/** Allocates a Q16.16 fixed point reference generator, for targets without a floating point unit: the computations
+	* use only integer arithmetic (@see FixedRefgen). Every parameter is the raw Q16.16 value (@see RG_Q16) of the
+	* corresponding parameter of new_refgen_float, e.g. RG_Q16(1.414) for r1, and the SPSA parameters are the default ones.
+	* @return the reference generator, NULL if d_gauss is not greater than 0.
+	*/
+	RG_API void * __stdcall new_refgen_q16(int32_t alpha_rate1, int32_t r1, int32_t alpha_rate2, int32_t r2, int32_t max_ni, int32_t alpha_slow,
+										   int32_t d_gauss, int32_t min_alpha_gauss, int32_t max_var);
+
+	/** Allocates a Q16.16 fixed point reference generator specifing the SPSA algorithm parameters (@see new_refgen_float_ext).
+	* Every parameter but max_iter and seed is a raw Q16.16 value; the solver is always the first order SPSA.
+	* @return the reference generator, NULL if a, c or d_gauss are not greater than 0.
+	*/
+	RG_API void * __stdcall new_refgen_q16_ext(int32_t alpha_rate1, int32_t r1, int32_t alpha_rate2, int32_t r2, int32_t max_ni, int32_t alpha_slow,
+											   int32_t d_gauss, int32_t min_alpha_gauss, int32_t max_var,
+											   unsigned int max_iter, int32_t max_delta, int32_t a, int32_t A, int32_t alpha, int32_t c, int32_t gamma,
+											   unsigned long long seed);
+
+	/** Destroy a Q16.16 fixed point reference generator.
+	* @param refgen pointer to a Q16.16 reference generator to destroy.
+	*/
+	RG_API void __stdcall delete_refgen_q16(void *refgen);
+
+	/** Computes the next reference using a Q16.16 fixed point reference generator.
+	* @param refgen pointer to a Q16.16 reference generator.
+	* @param data raw Q16.16 data block (@see refgen_float_computeref for its layout).
+	* @param spaceSize space dimension (e.g planar -> 2)
+	* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+	* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the raw Q16.16 reference.
+	* @return the cost of the reference, Q47.16 raw value (saturated).
+	*/
+	RG_API int64_t __stdcall refgen_q16_computeref(void *refgen, const int32_t RG_IN *data, unsigned int spaceSize, unsigned int length, int32_t RG_OUT *ref);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,303 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <xtensor/xarray.hpp>
+#include <xtensor/xfixed.hpp>
+#include "spsa.h"
+#include "gradient.h"
+#include "rademacher.h"
+
+
+
+namespace rg {
+
+	/** Memory used by the cross-entropy iterations: the population of a round and the sampling distribution on top of
+	* the gradient workspace, so that the reference generator keeps one workspace for all its solvers.
+	* The population buffers are sized by the solver: they allocate only when the population or the dimension grows.
+	*/
+	template<class R, size_t Dim>
+	struct CEMWorkspace : public GradientWorkspace<R, Dim> {
+		using vector_type = typename SPSAWorkspace<R, Dim>::vector_type;
+
+		/** Standard deviation of the sampling distribution along each axis (its mean is theta). */
+		vector_type sigma;
+		/** Best candidate found so far (the starting mean until a candidate has a cost). */
+		vector_type best;
+		/** Cost of best (NaN until a candidate has a cost). */
+		R bestCost;
+		/** Candidates of a round, row major spaceSize x population: the component i of the candidate p is population[i * P + p]. */
+		std::vector<R> population;
+		/** Costs of the candidates of a round. */
+		std::vector<R> costs;
+		/** Candidate indices, the elites first after the selection. */
+		std::vector<size_t> order;
+
+		CEMWorkspace(size_t size = Dim) : GradientWorkspace<R, Dim>(size),
+			sigma(spsa_vector<R, Dim>::make(size)), best(spsa_vector<R, Dim>::make(size)), bestCost(std::numeric_limits<R>::quiet_NaN()) {
+		}
+
+		/** Makes the workspace fit a size x 1 problem (no-op for fixed size workspaces).
+		*/
+		void resize(size_t size) {
+			GradientWorkspace<R, Dim>::resize(size);
+			spsa_vector<R, Dim>::resize(sigma, size);
+			spsa_vector<R, Dim>::resize(best, size);
+		}
+	};
+
+	namespace detail {
+
+		/** Evaluates a loss with a batched entry point on the candidates of a round in one call.
+		*/
+		template<class R, class B>
+		struct loss_batch_ptr {
+			B batch;
+
+			template<class V>
+			void operator()(const R *candidates, size_t stride, size_t count, void *params, R *costs, V &) const {
+				batch(candidates, stride, count, params, costs);
+			}
+		};
+
+		/** All the candidates through the batch member of a loss functor, when it has one.
+		*/
+		template<class F, class R, class V>
+		auto functor_batch_eval(F &loss, const R *candidates, size_t stride, size_t count, R *costs, V &, int)
+			-> decltype(loss.batch(candidates, stride, count, costs), void()) {
+			loss.batch(candidates, stride, count, costs);
+		}
+
+		template<class F, class R, class V>
+		void functor_batch_eval(F &loss, const R *candidates, size_t stride, size_t count, R *costs, V &scratch, long) {
+			size_t size = scratch.size();
+			for (size_t p = 0; p < count; p++) {
+				for (size_t i = 0; i < size; i++) {
+					scratch(i, 0) = candidates[i * stride + p];
+				}
+				costs[p] = loss(scratch);
+			}
+		}
+
+		template<class R, class F>
+		struct functor_batch {
+			F &loss;
+
+			template<class V>
+			void operator()(const R *candidates, size_t stride, size_t count, void *, R *costs, V &scratch) const {
+				functor_batch_eval(loss, candidates, stride, count, costs, scratch, 0);
+			}
+		};
+
+		/** Cross-entropy iterations working in place on a workspace (ws.theta is the mean of the distribution, ws.best the result).
+		* batch evaluates the loss on all the candidates of a round, loss is used only when no round is run.
+		* With ws.resume set the call goes on with the distribution and the best candidate of the previous one.
+		* @see CEM
+		*/
+		template<class R, size_t Dim, class L, class B>
+		R cem_loop(L loss, B batch, CEMWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, size_t population, size_t elites, R sigma0,
+			R sigma_min, R smoothing, void *params, RademacherGen &gen, const SPSAStop<R> &stop, SPSAInfo *info) {
+
+			size_t size = ws.theta.size();
+			population = std::max<size_t>(population, 2);
+			elites = std::min(std::max<size_t>(elites, 1), population);
+
+			if (!ws.resume) {
+				for (size_t i = 0; i < size; i++) {
+					ws.sigma(i, 0) = sigma0;
+					ws.best(i, 0) = ws.theta(i, 0);
+				}
+				ws.bestCost = std::numeric_limits<R>::quiet_NaN();
+			}
+
+			if (max_iter == 0) {
+				if (info != nullptr) {
+					info->iterations = 0;
+					info->evaluations = ws.resume ? 0 : 1;
+					info->clipped = 0;
+				}
+				if (!ws.resume) {
+					ws.bestCost = loss(std::move(ws.theta), params);
+				}
+				return ws.bestCost;
+			}
+
+			ws.population.resize(size * population);
+			ws.costs.resize(population);
+			ws.order.resize(population);
+
+			R windowSum = 0;
+			R lastMean = 0;
+			bool hasLastMean = false;
+
+			auto better = [&ws](size_t l, size_t r) {
+				return ws.costs[l] < ws.costs[r] || (ws.costs[l] == ws.costs[r] && l < r);
+			};
+
+			size_t k = 1;
+			for (; k <= max_iter; k++) {
+
+				// candidate 0 is the mean itself: a round never loses the current solution
+				R *candidates = ws.population.data();
+				for (size_t i = 0; i < size; i++) {
+					candidates[i * population] = ws.theta(i, 0);
+				}
+				for (size_t p = 1; p < population; p++) {
+					for (size_t i = 0; i < size; i++) {
+						candidates[i * population + p] = ws.theta(i, 0) + ws.sigma(i, 0) * gen.template normal<R>();
+					}
+				}
+
+				batch(candidates, population, population, params, ws.costs.data(), ws.thetaPlus);
+
+				for (size_t p = 0; p < population; p++) {
+					ws.order[p] = p;
+				}
+				std::nth_element(ws.order.begin(), ws.order.begin() + (elites - 1), ws.order.end(), better);
+
+				size_t roundBest = ws.order[0];
+				for (size_t e = 1; e < elites; e++) {
+					if (better(ws.order[e], roundBest)) {
+						roundBest = ws.order[e];
+					}
+				}
+				R y = ws.costs[roundBest];
+				if (y < ws.bestCost || (std::isnan(ws.bestCost) && !std::isnan(y))) {
+					ws.bestCost = y;
+					for (size_t i = 0; i < size; i++) {
+						ws.best(i, 0) = candidates[i * population + roundBest];
+					}
+				}
+
+				// smoothed mean and standard deviation of the elites
+				R stepNorm_sq = 0;
+				R sigmaMean = 0;
+				for (size_t i = 0; i < size; i++) {
+					const R *row = candidates + i * population;
+
+					R mean = 0;
+					for (size_t e = 0; e < elites; e++) {
+						mean += row[ws.order[e]];
+					}
+					mean /= (R)elites;
+
+					R var = 0;
+					for (size_t e = 0; e < elites; e++) {
+						R dev = row[ws.order[e]] - mean;
+						var += dev * dev;
+					}
+					var /= (R)elites;
+
+					R step = smoothing * (mean - ws.theta(i, 0));
+					ws.theta(i, 0) += step;
+					ws.sigma(i, 0) = std::max(smoothing * std::sqrt(var) + (1 - smoothing) * ws.sigma(i, 0), sigma_min);
+
+					stepNorm_sq += step * step;
+					sigmaMean += ws.sigma(i, 0);
+				}
+
+				R stepNorm = std::sqrt(stepNorm_sq);
+
+				RG_TRACE(
+					if (ws.trace.buffer != nullptr) {
+						trace_iteration(ws.trace, 3, k, sigmaMean / (R)size, (R)0, y, ws.costs[0], stepNorm, (R)1, ws.theta, size);
+					}
+				)
+
+				if (stop.expired()) {
+					break;
+				}
+
+				bool checked = k >= stop.min_iter;
+
+				if (checked && stepNorm < stop.step_tol) {
+					break;
+				}
+
+				if (stop.window > 0) {
+					windowSum += y;
+					if (k % stop.window == 0) {
+						R mean = windowSum / (R)stop.window;
+						if (checked && hasLastMean && std::abs(mean - lastMean) <= stop.plateau_tol * std::abs(lastMean)) {
+							break;
+						}
+						lastMean = mean;
+						hasLastMean = true;
+						windowSum = 0;
+					}
+				}
+			}
+
+			if (info != nullptr) {
+				info->iterations = std::min(k, max_iter);
+				info->evaluations = info->iterations * population;
+				info->clipped = 0;
+			}
+
+			return ws.bestCost;
+		}
+	}
+
+	/** Cross-entropy method: a population based solver that needs no gradient estimate.
+	* Each round samples population candidates from a gaussian with diagonal covariance centred in ws.theta (the first
+	* candidate is the centre itself), evaluates all of them in one batched call and moves the centre and the standard
+	* deviations towards the ones of the elites best candidates. Being a global search over the sampled region it may
+	* escape the local minima where a descent stalls, at the price of population cost evaluations per round.
+	* The result is the best candidate ever evaluated, stored in ws.best, so no final evaluation is needed; ws.theta is
+	* left at the mean of the distribution, so that a call with ws.resume set goes on with the same run.
+	* @param loss function pointer to a loss function used when no round is run (@see SPSA).
+	* @param lossBatch function pointer to a loss function evaluated on a block of candidates:
+	*	- args: row major spaceSize x count block (the component i of the candidate p is at i * stride + p), stride, count
+	*	- args: pointer to other data useful
+	*	- args: output costs (count, in candidate order).
+	* @param ws workspace, already sized to the problem (@see CEMWorkspace::resize).
+	* @param max_iter number of rounds.
+	* @param population candidates of each round (at least 2).
+	* @param elites best candidates fitting the distribution of the next round (1..population).
+	* @param sigma0 initial standard deviation along each axis (kept from the previous call when ws.resume is set).
+	* @param sigma_min lower bound of the standard deviations: the search never collapses to a point.
+	* @param smoothing weight of the elites in the update of the distribution (1: no memory of the previous round).
+	* @param params a pointer to other parameters used from the loss function.
+	* @param gen sampling generator: it goes on with its stream, so consecutive calls use different candidates.
+	* @param stop stopping rules: the step rule checks the move of the centre, the plateau rule the best cost of the rounds.
+	* @param info optional pointer where to store the rounds and the loss evaluations actually used.
+	* @see R. Y. Rubinstein, D. P. Kroese, "The cross-entropy method", Springer, 2004.
+	* @see costfncV2_batch
+	*/
+	template<class R, size_t Dim>
+	R CEM(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *),
+		void (*lossBatch)(const R *, size_t, size_t, void *, R *),
+		CEMWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, size_t population, size_t elites, R sigma0, R sigma_min, R smoothing, void *params,
+		RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		using B = void (*)(const R *, size_t, size_t, void *, R *);
+		return detail::cem_loop(loss, detail::loss_batch_ptr<R, B>{ lossBatch }, ws, max_iter, population, elites, sigma0, sigma_min, smoothing,
+								params, gen, stop, info);
+	}
+
+	/** Cross-entropy method with a loss functor known at compile time (@see the SPSA functor overload).
+	* @param loss callable object: loss(theta) gives the cost in theta, the optional loss.batch(candidates, stride, count, costs)
+	*	the costs of a block of candidates at once (@see CostV2::batch, otherwise one call for each candidate).
+	* @see CEM
+	*/
+	template<class R, size_t Dim, class F>
+	R CEM(F &&loss, CEMWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, size_t population, size_t elites, R sigma0, R sigma_min, R smoothing,
+		RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		using L = typename std::remove_reference<F>::type;
+		return detail::cem_loop(detail::functor_loss<R, L>{ loss }, detail::functor_batch<R, L>{ loss }, ws, max_iter, population, elites, sigma0,
+								sigma_min, smoothing, nullptr, gen, stop, info);
+	}
+}
@@ -11,12 +11,19 @@
 
 #include <vector>
 #include <array>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
 #include <xtl/xsequence.hpp>
 #include <xtensor/xarray.hpp>
 #include <xtensor/xrandom.hpp>
 #include <xtensor/xview.hpp>
 #include <xtensor/xnorm.hpp>
 #include "c_api_comm.h"
+#include "simd.h"
+#include "layout.h"
+#include "dispatch.h"
 
 
 namespace rg {
@@ -86,60 +93,728 @@ namespace rg {
 		R			D_gauss;
 		R			min_alpha_gauss;
 		raw_xarray	data_raw;
+
+		/** Neighbors read in place from an external block instead of the columns 2.. of data_raw (e.g. a shared
+		* position board, @see PositionBoard, or interleaved records): data_raw then holds only the target and the actual position.
+		*/
+		const DataLayout<R>	*others = nullptr;			/**< neighbor block (nullptr: neighbors in data_raw). */
+		size_t		others_count = 0;					/**< columns of others. */
+		size_t		others_skip = (size_t)-1;			/**< column of others that is not a neighbor (e.g. the agent itself). */
 	};
 
-	/** Cost function used by the reference generator.
-	* @param theta xtensor expression or container.
+	namespace detail {
+
+		/** Neighbor access of the kernels for each layout (@see DataLayout): n(i, j) is the component i of the column j.
+		* When contiguous is true the columns of an axis are adjacent and row(i) + j points to n(i, j).
+		*/
+		template<class R>
+		struct rows_access {
+			static constexpr bool contiguous = true;
+			const R *data;
+			size_t stride;
+
+			R operator()(size_t i, size_t j) const {
+				return data[i * stride + j];
+			}
+			const R * row(size_t i) const {
+				return data + i * stride;
+			}
+			DataLayout<R> layout() const {
+				return DataLayout<R>::rowMajor(data, stride);
+			}
+		};
+
+		template<class R>
+		struct axes_access {
+			static constexpr bool contiguous = true;
+			const R * const *axes;
+			size_t first;
+
+			R operator()(size_t i, size_t j) const {
+				return axes[i][first + j];
+			}
+			const R * row(size_t i) const {
+				return axes[i] + first;
+			}
+			DataLayout<R> layout() const {
+				return DataLayout<R>::perAxis(axes).columns(first);
+			}
+		};
+
+		template<class R>
+		struct records_access {
+			static constexpr bool contiguous = false;
+			const R *data;
+			size_t stride;
+
+			R operator()(size_t i, size_t j) const {
+				return data[j * stride + i];
+			}
+			DataLayout<R> layout() const {
+				return DataLayout<R>::interleaved(data, stride);
+			}
+		};
+
+#ifdef XTENSOR_USE_XSIMD
+		/** Components i of the columns j..j+W-1 in a batch: a load when they are adjacent, W reads of the same
+		* cache lines otherwise (interleaved records).
+		*/
+		template<class B, class A>
+		B load_axis(const A &neigh, size_t i, size_t j, std::true_type) {
+			return simd::load<B>(neigh.row(i) + j);
+		}
+
+		template<class B, class A>
+		B load_axis(const A &neigh, size_t i, size_t j, std::false_type) {
+			typename B::value_type lanes[B::size];
+			for (size_t w = 0; w < B::size; w++) {
+				lanes[w] = neigh(i, j + w);
+			}
+			return simd::load<B>(lanes);
+		}
+#endif
+
+		/** Calls f(neigh, begin, end) for each range of neighbors, neigh(i, j) being the component i of the column j
+		* (j in [begin, end)): the columns 2..length-1 of the data block or the external block without its skipped column.
+		*/
+		template<class R, class F>
+		void neighbor_blocks(const costParamV2<R> &params, const R *data, size_t length, F &&f) {
+			if (params.others == nullptr) {
+				f(rows_access<R>{ data, length }, (size_t)2, length);
+				return;
+			}
+
+			const DataLayout<R> &others = *params.others;
+			size_t skip = std::min(params.others_skip, params.others_count);
+			auto split = [&](const auto &neigh) {
+				if (skip > 0) {
+					f(neigh, (size_t)0, skip);
+				}
+				if (skip + 1 < params.others_count) {
+					f(neigh, skip + 1, params.others_count);
+				}
+			};
+
+			switch (others.type) {
+			case LAYOUT_INTERLEAVED:
+				split(records_access<R>{ others.data + others.first * others.stride, others.stride });
+				break;
+			case LAYOUT_AXES:
+				split(axes_access<R>{ others.axes, others.first });
+				break;
+			default:
+				split(rows_access<R>{ others.data + others.first, others.stride });
+				break;
+			}
+		}
+
+		/** Gaussian neighbor sums of K points at once: sums[k] += sum_j exp(rate * |theta_k - neigh_j|^2).
+		* Neighbors are the columns begin..end-1 of a block (@see neighbor_blocks) and each column is read once for all
+		* the K points. theta(k, i) gives the component i of the point k.
+		* This is the scalar version, used when R has no SIMD support.
+		*/
+		template<size_t K, class R, class A, class T>
+		void gauss_sums(const A &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const T &theta, R (&sums)[K], std::false_type) {
+
+			for (size_t j = begin; j < end; j++) {
+				R diff_sq[K] = {};
+				for (size_t i = 0; i < spaceSize; i++) {
+					R n = neigh(i, j);
+					for (size_t k = 0; k < K; k++) {
+						R relPos = theta(k, i) - n;
+						diff_sq[k] += relPos * relPos;
+					}
+				}
+				for (size_t k = 0; k < K; k++) {
+					sums[k] += std::exp(rate * diff_sq[k]);
+				}
+			}
+		}
+
+#ifdef XTENSOR_USE_XSIMD
+		/** SIMD version of gauss_sums: the neighbors are processed B::size at a time, the remaining ones with scalar code.
+		*/
+		template<size_t K, class R, class A, class T, class B>
+		void gauss_sums(const A &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const T &theta, R (&sums)[K], simd::batch_tag<B>) {
+
+			constexpr size_t W = B::size;
+
+			const B vrate(rate);
+			B acc[K];
+			for (size_t k = 0; k < K; k++) {
+				acc[k] = B(R(0));
+			}
+
+			size_t j = begin;
+			for (; j + W <= end; j += W) {
+				B diff_sq[K];
+				for (size_t k = 0; k < K; k++) {
+					diff_sq[k] = B(R(0));
+				}
+				for (size_t i = 0; i < spaceSize; i++) {
+					B n = load_axis<B>(neigh, i, j, std::integral_constant<bool, A::contiguous>());
+					for (size_t k = 0; k < K; k++) {
+						B relPos = B(theta(k, i)) - n;
+						diff_sq[k] += relPos * relPos;
+					}
+				}
+				for (size_t k = 0; k < K; k++) {
+					acc[k] += simd::exp(vrate * diff_sq[k]);
+				}
+			}
+
+			for (size_t k = 0; k < K; k++) {
+				sums[k] += simd::sum(acc[k]);
+			}
+
+			gauss_sums(neigh, j, end, spaceSize, rate, theta, sums, std::false_type());
+		}
+#endif
+
+		/** Gaussian neighbor sums of K points over all the neighbors of a problem, SIMD version when available.
+		* In a library built with RG_SIMD_DISPATCH the kernels of the instruction set selected at load time are used
+		* (@see simdArch), the compile time ones only for more than SimdKernels<R>::max_dim dimensions.
+		*/
+		template<size_t K, class R, class T>
+		void gauss_sums(const costParamV2<R> &params, const R *data, size_t spaceSize, size_t length, R rate, const T &theta, R (&sums)[K]) {
+			for (size_t k = 0; k < K; k++) {
+				sums[k] = 0;
+			}
+
+#ifdef RG_SIMD_DISPATCH
+			const SimdKernels<R> *kernels = dispatched_kernels(R());
+			if (kernels != nullptr && spaceSize <= SimdKernels<R>::max_dim) {
+				R points[K * SimdKernels<R>::max_dim];
+				for (size_t k = 0; k < K; k++) {
+					for (size_t i = 0; i < spaceSize; i++) {
+						points[k * spaceSize + i] = theta(k, i);
+					}
+				}
+				neighbor_blocks(params, data, length, [&](const auto &neigh, size_t begin, size_t end) {
+					kernels->sums(neigh.layout(), begin, end, spaceSize, rate, points, K, sums);
+				});
+				return;
+			}
+#endif
+
+			neighbor_blocks(params, data, length, [&](const auto &neigh, size_t begin, size_t end) {
+				gauss_sums(neigh, begin, end, spaceSize, rate, theta, sums, simd::kernel_tag<R>());
+			});
+		}
+
+		/** Gaussian neighbor sum and its first moment over the columns begin..end-1 of a block (@see gauss_sums):
+		* returns sum_j w_j and adds sum_j w_j * (theta_i - neigh_ji) to rel(i, 0), with w_j = exp(rate * |theta - neigh_j|^2).
+		* This is the scalar version, used when R has no SIMD support.
+		*/
+		template<class R, class A, class E, class G>
+		R gauss_moments(const A &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const E &theta, G &rel, std::false_type) {
+
+			R sum = 0;
+			for (size_t j = begin; j < end; j++) {
+				R diff_sq = 0;
+				for (size_t i = 0; i < spaceSize; i++) {
+					R relPos = (R)theta(i, 0) - neigh(i, j);
+					diff_sq += relPos * relPos;
+				}
+				R w = std::exp(rate * diff_sq);
+				sum += w;
+				for (size_t i = 0; i < spaceSize; i++) {
+					rel(i, 0) += w * ((R)theta(i, 0) - neigh(i, j));
+				}
+			}
+
+			return sum;
+		}
+
+#ifdef XTENSOR_USE_XSIMD
+		/** SIMD version of gauss_moments: the weights of B::size neighbors are computed at once.
+		*/
+		template<class R, class A, class E, class G, class B>
+		R gauss_moments(const A &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const E &theta, G &rel, simd::batch_tag<B>) {
+
+			constexpr size_t W = B::size;
+			using contiguous = std::integral_constant<bool, A::contiguous>;
+
+			const B vrate(rate);
+			B acc(R(0));
+
+			size_t j = begin;
+			for (; j + W <= end; j += W) {
+				B diff_sq(R(0));
+				for (size_t i = 0; i < spaceSize; i++) {
+					B relPos = B((R)theta(i, 0)) - load_axis<B>(neigh, i, j, contiguous());
+					diff_sq += relPos * relPos;
+				}
+				B w = simd::exp(vrate * diff_sq);
+				acc += w;
+				for (size_t i = 0; i < spaceSize; i++) {
+					B relPos = B((R)theta(i, 0)) - load_axis<B>(neigh, i, j, contiguous());
+					rel(i, 0) += simd::sum(B(w * relPos));
+				}
+			}
+
+			R sum = simd::sum(acc);
+
+			for (; j < end; j++) {
+				R diff_sq = 0;
+				for (size_t i = 0; i < spaceSize; i++) {
+					R relPos = (R)theta(i, 0) - neigh(i, j);
+					diff_sq += relPos * relPos;
+				}
+				R w = std::exp(rate * diff_sq);
+				sum += w;
+				for (size_t i = 0; i < spaceSize; i++) {
+					rel(i, 0) += w * ((R)theta(i, 0) - neigh(i, j));
+				}
+			}
+
+			return sum;
+		}
+#endif
+
+		/** Gaussian neighbor sum and first moment over all the neighbors of a problem (rel is overwritten), SIMD version when available.
+		*/
+		template<class R, class E, class G>
+		R gauss_moments(const costParamV2<R> &params, const R *data, size_t spaceSize, size_t length, R rate, const E &theta, G &rel) {
+			for (size_t i = 0; i < spaceSize; i++) {
+				rel(i, 0) = 0;
+			}
+
+			R sum = 0;
+
+#ifdef RG_SIMD_DISPATCH
+			const SimdKernels<R> *kernels = dispatched_kernels(R());
+			if (kernels != nullptr && spaceSize <= SimdKernels<R>::max_dim) {
+				R point[SimdKernels<R>::max_dim], moment[SimdKernels<R>::max_dim];
+				for (size_t i = 0; i < spaceSize; i++) {
+					point[i] = (R)theta(i, 0);
+					moment[i] = 0;
+				}
+				neighbor_blocks(params, data, length, [&](const auto &neigh, size_t begin, size_t end) {
+					sum += kernels->moments(neigh.layout(), begin, end, spaceSize, rate, point, moment);
+				});
+				for (size_t i = 0; i < spaceSize; i++) {
+					rel(i, 0) = moment[i];
+				}
+				return sum;
+			}
+#endif
+
+			neighbor_blocks(params, data, length, [&](const auto &neigh, size_t begin, size_t end) {
+				sum += gauss_moments(neigh, begin, end, spaceSize, rate, theta, rel, simd::kernel_tag<R>());
+			});
+			return sum;
+		}
+
+		/** Amplitude and exponential rate of the gaussian repulsion of costfncV2 (they depend only on the data).
+		*/
+		template<class R>
+		void gauss_coeffs(const costParamV2<R> &params, const R *data, size_t spaceSize, size_t length, R &alpha_gauss, R &gauss_rate) {
+
+			R targetOldDiff_sq = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R targetOld = data[i * length] - data[i * length + 1];
+				targetOldDiff_sq += targetOld * targetOld;
+			}
+
+			alpha_gauss = std::pow<R>(params.ni1 * targetOldDiff_sq, 4);
+			alpha_gauss = std::max<R>(alpha_gauss, params.min_alpha_gauss);
+			R coeff_gauss = params.D_gauss / (std::log(alpha_gauss));
+			gauss_rate = - 1 / (2 * coeff_gauss);
+		}
+
+		/** Target and friction terms of costfncV2 (the ones not depending on the neighbors).
+		*/
+		template<class R, class E>
+		R costV2_local(const E &theta, const costParamV2<R> &params, const R *data, size_t spaceSize, size_t length) {
+
+			R targetSqDist = 0;
+			R mySqVar = 0;
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				const R *row = data + i * length;
+				R th = theta(i, 0);
+
+				R tarRelPos = row[0] - th;
+				R myVar = th - row[1];
+
+				targetSqDist += tarRelPos * tarRelPos;
+				mySqVar += myVar * myVar;
+			}
+
+			//target actractive factor
+			R cstr1 = targetSqDist - params.r1*params.r1;
+			R cstr2 = targetSqDist - params.r2*params.r2;
+
+			R targetFactor = params.ni1 * cstr1 * cstr1 + params.ni2 * cstr2 * cstr2;
+
+			//dynamic friction
+			R frictionFactor = params.alpha_slow * mySqVar;
+
+			return targetFactor + frictionFactor;
+		}
+
+		/** Column p of a row major block of candidate points, accessed as theta(i, 0) (@see CostV2::batch).
+		*/
+		template<class R>
+		struct candidate_column {
+			const R *candidates;
+			size_t stride, p;
+
+			R operator()(size_t i, size_t) const {
+				return candidates[i * stride + p];
+			}
+		};
+
+		/** Costs of the K candidates first..first+K-1 of a block, with a single sweep over the neighbors.
+		*/
+		template<size_t K, class R>
+		void batch_costs(const costParamV2<R> &params, const R *data, size_t spaceSize, size_t length, R alpha_gauss, R gauss_rate,
+			const R *candidates, size_t stride, size_t first, R *costs) {
+
+			R gauss_sum[K];
+			detail::gauss_sums(params, data, spaceSize, length, gauss_rate,
+				[candidates, stride, first](size_t k, size_t i) { return candidates[i * stride + first + k]; }, gauss_sum);
+
+			for (size_t k = 0; k < K; k++) {
+				costs[first + k] = alpha_gauss * gauss_sum[k] +
+					costV2_local(candidate_column<R>{ candidates, stride, first + k }, params, data, spaceSize, length);
+			}
+		}
+	}
+
+	/** Cost function used by the reference generator and its gradient with respect to theta.
+	* Same data access of costfnc, read in place from params->data_raw. The friction coefficient depends on the
+	* nearest neighbor, which is assumed unique (the gradient is not defined where two neighbors are equally close).
+	* @param theta xtensor expression or container (shape spaceSize x 1).
 	* @param parameters pointer to other data useful.
-	* @see SPSA
-	* @see Refgen
+	* @param grad container (shape spaceSize x 1) in which store the gradient.
+	* @return the cost in theta (the same of costfnc).
+	* @see costfnc
 	*/
-	template<class R, class E>
-	R costfncV2(E &&theta, void *parameters) {
+	template<class R, class E, class G>
+	R costfnc_grad(const E &theta, void *parameters, G & RG_OUT grad) {
 
-		costParamV2<R> *params = (costParamV2<R> *) parameters;
+		costParam<R> *params = (costParam<R> *) parameters;
 
-		auto data = xtc::xarray_map_raw<R>(&(params->data_raw));
+		const R *data = (const R *)params->data_raw.data;
+		size_t spaceSize = params->data_raw.shape[0];
+		size_t length = params->data_raw.shape[1];
+
+		R targetSqDist = 0;
+		R mySqVar = 0;
+		for (size_t i = 0; i < spaceSize; i++) {
+			R tarRelPos = (R)theta(i, 0) - data[i * length];
+			R myVar = (R)theta(i, 0) - data[i * length + 1];
+			targetSqDist += tarRelPos * tarRelPos;
+			mySqVar += myVar * myVar;
+			grad(i, 0) = 0;
+		}
+
+		//neighborhood repulsive factor: d exp(1 / d) / dtheta = -exp(1 / d) / d^3 * (theta - neigh)
+		R neighFactor = 0;
+		R minDiff = 0;
+		size_t nearest = 0;
+		for (size_t j = 2; j < length; j++) {
+			R diff_sq = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R relPos = (R)theta(i, 0) - data[i * length + j];
+				diff_sq += relPos * relPos;
+			}
+			R diff = std::sqrt(diff_sq);
+			R expDiff = std::exp(1 / diff);
+			neighFactor += expDiff;
+
+			R coeff = -expDiff / (diff_sq * diff);
+			for (size_t i = 0; i < spaceSize; i++) {
+				grad(i, 0) += coeff * ((R)theta(i, 0) - data[i * length + j]);
+			}
+
+			if (j == 2 || diff < minDiff) {
+				minDiff = diff;
+				nearest = j;
+			}
+		}
 
-		//mapping
-		auto target = xt::view(data, xt::all(), xt::range(0, 1));
-		auto mylastPos = xt::view(data, xt::all(), xt::range(1, 2));
-		auto neigh = xt::view(data, xt::all(), xt::range(2, xt::placeholders::_));
+		//target actractive factor
+		R cstr1 = targetSqDist - params->r1*params->r1;
+		R cstr2 = targetSqDist - params->r2*params->r2;
 
+		R targetFactor = params->ni1 * cstr1 * cstr1 + params->ni2 * cstr2 * cstr2;
+		R targetCoeff = 4 * (params->ni1 * cstr1 + params->ni2 * cstr2);
 
-		//neighborhood repulsive factor
-		auto relPos = theta - neigh;
-		auto diff_sq = xt::norm_sq(relPos, { 0 });
+		//dynamic friction
+		R friction = params->alpha_slow / (1 + minDiff);
+		R frictionFactor = friction * mySqVar;
+		R nearestCoeff = (nearest > 0) ? -frictionFactor / ((1 + minDiff) * minDiff) : 0;
+
+		for (size_t i = 0; i < spaceSize; i++) {
+			R th = (R)theta(i, 0);
+			grad(i, 0) += targetCoeff * (th - data[i * length]) + 2 * friction * (th - data[i * length + 1]);
+			if (nearest > 0) {
+				grad(i, 0) += nearestCoeff * (th - data[i * length + nearest]);
+			}
+		}
+
+		return neighFactor + targetFactor + frictionFactor;
+	}
 
-		auto targetOldDiff_sq = xt::norm_sq(target - mylastPos);
+	/** Cost policy of the reference generator (@see Refgen): the cost of costfncV2 with typed parameters, so that the
+	* solvers call it directly and the compiler can inline it in their iterations.
+	* A cost policy is any type with a const call operator cost(theta, params) returning the cost in theta (shape
+	* spaceSize x 1) for the problem params. Optionally it has:
+	*	- pair(thetaPlus, thetaMinus, params, yplus, yminus): both the SPSA perturbed points at once (otherwise two calls);
+	*	- grad(theta, params, grad): the cost and its gradient, needed by the gradient solver.
+	* A custom policy may add its own terms to this one, e.g. CostV2<R>()(theta, params) + extra(theta).
+	*/
+	template<typename R>
+	struct CostV2 {
+
+		/** Cost in theta.
+		* The data are read in place from params.data_raw (row major, spaceSize x length) one column at a time: no
+		* temporary is created, so the function never allocates. With params.others set, the neighbors are read in
+		* place from that block instead (@see costParamV2).
+		*/
+		template<class E>
+		R operator()(const E &theta, const costParamV2<R> &params) const {
+
+			//mapping (columns: target 0, mylastPos 1, neighbors 2..length-1)
+			const R *data = (const R *)params.data_raw.data;
+			size_t spaceSize = params.data_raw.shape[0];
+			size_t length = params.data_raw.shape[1];
+
+			//neighborhood repulsive factor
+			R alpha_gauss, gauss_rate;
+			detail::gauss_coeffs(params, data, spaceSize, length, alpha_gauss, gauss_rate);
+
+			R gauss_sum[1];
+			detail::gauss_sums(params, data, spaceSize, length, gauss_rate,
+				[&theta](size_t, size_t i) { return (R)theta(i, 0); }, gauss_sum);
+
+			R neighFactor = alpha_gauss * gauss_sum[0];
+
+			// total
+
+			return neighFactor + detail::costV2_local(theta, params, data, spaceSize, length);
+		}
+
+		/** Costs in the two SPSA perturbed points: the neighbor columns are read only once for both points and the
+		* gaussian terms are computed with SIMD lanes over the neighbors.
+		*/
+		template<class Ep, class Em>
+		void pair(const Ep &thetaPlus, const Em &thetaMinus, const costParamV2<R> &params, R & RG_OUT yplus, R & RG_OUT yminus) const {
+
+			const R *data = (const R *)params.data_raw.data;
+			size_t spaceSize = params.data_raw.shape[0];
+			size_t length = params.data_raw.shape[1];
+
+			R alpha_gauss, gauss_rate;
+			detail::gauss_coeffs(params, data, spaceSize, length, alpha_gauss, gauss_rate);
+
+			R gauss_sum[2];
+			detail::gauss_sums(params, data, spaceSize, length, gauss_rate,
+				[&thetaPlus, &thetaMinus](size_t k, size_t i) { return (R)(k == 0 ? thetaPlus(i, 0) : thetaMinus(i, 0)); }, gauss_sum);
+
+			yplus = alpha_gauss * gauss_sum[0] + detail::costV2_local(thetaPlus, params, data, spaceSize, length);
+			yminus = alpha_gauss * gauss_sum[1] + detail::costV2_local(thetaMinus, params, data, spaceSize, length);
+		}
+
+		/** Number of candidates sharing a sweep over the neighbors in batch.
+		*/
+		static constexpr size_t batch_block = 8;
+
+		/** Costs of count candidate points at once (e.g. the population of a CEM round): the candidate p is the column p
+		* of a row major spaceSize x count block, its component i being candidates[i * stride + p]. The neighbor columns
+		* are read once for every batch_block candidates and the gaussian terms of all of them are computed in the same
+		* SIMD sweep; each candidate gets the cost of operator() bit for bit.
+		* @param candidates first component of the first candidate.
+		* @param stride distance between the rows of the block (at least count).
+		* @param count number of candidates.
+		* @param params data of the problem.
+		* @param costs count costs, in candidate order.
+		*/
+		void batch(const R *candidates, size_t stride, size_t count, const costParamV2<R> &params, R * RG_OUT costs) const {
+
+			const R *data = (const R *)params.data_raw.data;
+			size_t spaceSize = params.data_raw.shape[0];
+			size_t length = params.data_raw.shape[1];
+
+			R alpha_gauss, gauss_rate;
+			detail::gauss_coeffs(params, data, spaceSize, length, alpha_gauss, gauss_rate);
+
+			size_t p = 0;
+			for (; p + batch_block <= count; p += batch_block) {
+				detail::batch_costs<batch_block>(params, data, spaceSize, length, alpha_gauss, gauss_rate, candidates, stride, p, costs);
+			}
+			for (; p < count; p++) {
+				detail::batch_costs<1>(params, data, spaceSize, length, alpha_gauss, gauss_rate, candidates, stride, p, costs);
+			}
+		}
+
+		/** Cost in theta and its gradient (stored in grad, shape spaceSize x 1), in one data sweep.
+		*/
+		template<class E, class G>
+		R grad(const E &theta, const costParamV2<R> &params, G & RG_OUT grad) const {
+
+			const R *data = (const R *)params.data_raw.data;
+			size_t spaceSize = params.data_raw.shape[0];
+			size_t length = params.data_raw.shape[1];
+
+			//neighborhood repulsive factor: alpha_gauss * sum_j exp(rate * d_j^2), gradient 2 * rate * alpha_gauss * sum_j w_j * (theta - neigh_j)
+			R alpha_gauss, gauss_rate;
+			detail::gauss_coeffs(params, data, spaceSize, length, alpha_gauss, gauss_rate);
+
+			R gauss_sum = detail::gauss_moments(params, data, spaceSize, length, gauss_rate, theta, grad);
+			R gauss_coeff = 2 * gauss_rate * alpha_gauss;
+
+			R targetSqDist = 0;
+			R mySqVar = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R tarRelPos = (R)theta(i, 0) - data[i * length];
+				R myVar = (R)theta(i, 0) - data[i * length + 1];
+				targetSqDist += tarRelPos * tarRelPos;
+				mySqVar += myVar * myVar;
+			}
+
+			//target actractive factor
+			R cstr1 = targetSqDist - params.r1*params.r1;
+			R cstr2 = targetSqDist - params.r2*params.r2;
+
+			R targetFactor = params.ni1 * cstr1 * cstr1 + params.ni2 * cstr2 * cstr2;
+			R targetCoeff = 4 * (params.ni1 * cstr1 + params.ni2 * cstr2);
+
+			//dynamic friction
+			R frictionFactor = params.alpha_slow * mySqVar;
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				R th = (R)theta(i, 0);
+				grad(i, 0) = gauss_coeff * grad(i, 0) + targetCoeff * (th - data[i * length]) + 2 * params.alpha_slow * (th - data[i * length + 1]);
+			}
+
+			return alpha_gauss * gauss_sum + targetFactor + frictionFactor;
+		}
+	};
 
-		R alpha_gauss = std::pow<R>(params->ni1 * targetOldDiff_sq(0, 0), 4);
-		alpha_gauss = std::max<R>(alpha_gauss, params->min_alpha_gauss);
-		R coeff_gauss = params->D_gauss / (std::log(alpha_gauss));
+	namespace detail {
 
-		auto gauss_factor = xt::exp(- 1 / (2 * coeff_gauss) * diff_sq );
+		template<class Cost, class R, class Ep, class Em>
+		auto cost_pair_eval(const Cost &cost, const Ep &thetaPlus, const Em &thetaMinus, const costParamV2<R> &params, R &yplus, R &yminus, int)
+			-> decltype(cost.pair(thetaPlus, thetaMinus, params, yplus, yminus), void()) {
+			cost.pair(thetaPlus, thetaMinus, params, yplus, yminus);
+		}
 
-		auto neighFactor = xt::sum(alpha_gauss * gauss_factor, 0);
+		template<class Cost, class R, class Ep, class Em>
+		void cost_pair_eval(const Cost &cost, const Ep &thetaPlus, const Em &thetaMinus, const costParamV2<R> &params, R &yplus, R &yminus, long) {
+			yplus = cost(thetaPlus, params);
+			yminus = cost(thetaMinus, params);
+		}
 
-		//target actractive factor
-		auto tarRelPos = target - theta;
-		auto targetSqDist = xt::norm_sq(tarRelPos, { 0 });
+		template<class Cost, class R, class V, class = void>
+		struct cost_has_grad : std::false_type {
+		};
 
-		auto targetFactor = params->ni1 * xt::pow(targetSqDist - params->r1*params->r1, 2) +
-			params->ni2 * xt::pow(targetSqDist - params->r2*params->r2, 2);
-
-		//dynamic friction
-		auto mySqVar = xt::norm_sq(theta - mylastPos, { 0 });
+		template<class Cost, class R, class V>
+		struct cost_has_grad<Cost, R, V, decltype((void)std::declval<const Cost &>().grad(std::declval<const V &>(),
+			std::declval<const costParamV2<R> &>(), std::declval<V &>()))> : std::true_type {
+		};
+	}
 
+	/** A cost policy bound to the data of a problem: the loss functor taken by the solvers (e.g. the SPSA functor overload).
+	*/
+	template<class R, class Cost>
+	struct bound_cost {
+		const Cost &cost;
+		const costParamV2<R> &params;
+
+		template<class E>
+		R operator()(const E &theta) const {
+			return cost(theta, params);
+		}
+
+		template<class Ep, class Em>
+		void pair(const Ep &thetaPlus, const Em &thetaMinus, R &yplus, R &yminus) const {
+			detail::cost_pair_eval(cost, thetaPlus, thetaMinus, params, yplus, yminus, 0);
+		}
+
+		template<class E, class G>
+		R grad(const E &theta, G &grad) const {
+			return cost.grad(theta, params, grad);
+		}
+
+		/** Batched costs (@see CostV2::batch), only when the policy has them.
+		*/
+		template<class C = Cost>
+		auto batch(const R *candidates, size_t stride, size_t count, R *costs) const
+			-> decltype(std::declval<const C &>().batch(candidates, stride, count, std::declval<const costParamV2<R> &>(), costs), void()) {
+			cost.batch(candidates, stride, count, params, costs);
+		}
+	};
 
-		auto frictionFactor = params->alpha_slow  * mySqVar; 
+	/** Binds a cost policy (@see CostV2) to the data of a problem.
+	*/
+	template<class R, class Cost>
+	bound_cost<R, Cost> bind_cost(const Cost &cost, const costParamV2<R> &params) {
+		return bound_cost<R, Cost>{ cost, params };
+	}
 
-		// total
+	/** Cost function used by the reference generator.
+	* The data are read in place from params->data_raw (row major, spaceSize x length) one column at a time: no
+	* temporary is created, so the function never allocates. With params->others set, the neighbors are read in place
+	* from that block instead (@see costParamV2).
+	* This is the function pointer form of CostV2, used by the solvers taking a loss and a void * parameter block.
+	* @param theta xtensor expression or container (shape spaceSize x 1).
+	* @param parameters pointer to other data useful.
+	* @see SPSA
+	* @see Refgen
+	*/
+	template<class R, class E>
+	R costfncV2(E &&theta, void *parameters) {
+		return CostV2<R>()(theta, *(const costParamV2<R> *)parameters);
+	}
 
-		auto total = neighFactor + targetFactor + frictionFactor;
+	/** Cost function used by the reference generator evaluated on the two SPSA perturbed points at once.
+	* Same result of two costfncV2 calls, but the neighbor columns are read only once for both points and the
+	* gaussian terms are computed with SIMD lanes over the neighbors.
+	* @param thetaPlus xtensor expression or container (shape spaceSize x 1).
+	* @param thetaMinus xtensor expression or container (shape spaceSize x 1).
+	* @param parameters pointer to other data useful.
+	* @param yplus cost in thetaPlus.
+	* @param yminus cost in thetaMinus.
+	* @see SPSA
+	* @see costfncV2
+	*/
+	template<class R, class Ep, class Em>
+	void costfncV2_pair(const Ep &thetaPlus, const Em &thetaMinus, void *parameters, R & RG_OUT yplus, R & RG_OUT yminus) {
+		CostV2<R>().pair(thetaPlus, thetaMinus, *(const costParamV2<R> *)parameters, yplus, yminus);
+	}
 
-		return (R)total(0, 0);
+	/** Cost function used by the reference generator evaluated on a block of candidate points at once.
+	* Same result of one costfncV2 call for each candidate (@see CostV2::batch).
+	* @param candidates row major spaceSize x count block: the component i of the candidate p is candidates[i * stride + p].
+	* @param stride distance between the rows of the block.
+	* @param count number of candidates.
+	* @param parameters pointer to other data useful.
+	* @param costs count costs, in candidate order.
+	* @see CEM
+	* @see costfncV2
+	*/
+	template<class R>
+	void costfncV2_batch(const R *candidates, size_t stride, size_t count, void *parameters, R * RG_OUT costs) {
+		CostV2<R>().batch(candidates, stride, count, *(const costParamV2<R> *)parameters, costs);
+	}
 
+	/** Cost function used by the reference generator and its gradient with respect to theta, in one data sweep.
+	* Used by the gradient solver: one exact gradient per iteration instead of the two noisy SPSA evaluations.
+	* @param theta xtensor expression or container (shape spaceSize x 1).
+	* @param parameters pointer to other data useful.
+	* @param grad container (shape spaceSize x 1) in which store the gradient.
+	* @return the cost in theta (the same of costfncV2).
+	* @see costfncV2
+	* @see Adam
+	*/
+	template<class R, class E, class G>
+	R costfncV2_grad(const E &theta, void *parameters, G & RG_OUT grad) {
+		return CostV2<R>().grad(theta, *(const costParamV2<R> *)parameters, grad);
 	}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstddef>
+#include "simd.h"
+#include "layout.h"
+
+
+namespace rg {
+
+	/** Neighbor kernels of costfncV2 compiled for one instruction set.
+	* A library built with RG_SIMD_DISPATCH holds one table for each instruction set it was compiled for (scalar, the
+	* baseline of the build, AVX2, AVX-512) and picks the widest one the CPU supports when it is loaded, so a single
+	* binary runs on every host of a family. The environment variable RG_SIMD_ARCH (scalar, baseline, avx2, avx512)
+	* forces a narrower one, e.g. to compare them in a benchmark: a name that is not available is ignored.
+	*/
+	template<class R>
+	struct SimdKernels {
+		/** Largest space dimension served by the tables (larger problems use the compile time kernels). */
+		static constexpr size_t max_dim = 16;
+
+		const char *name;	/**< instruction set: "scalar", "baseline", "avx2" or "avx512". */
+		size_t lanes;		/**< values of R processed at once. */
+
+		/** Adds sum_j exp(rate * |p_k - n_j|^2) to sums[k] for the count points p_k (component i of p_k: points[k * spaceSize + i])
+		* and the columns j in [begin, end) of neigh (@see detail::gauss_sums).
+		*/
+		void (*sums)(const DataLayout<R> &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const R *points, size_t count, R *sums);
+
+		/** Returns sum_j w_j and adds sum_j w_j * (theta_i - n_ji) to rel[i], with w_j = exp(rate * |theta - n_j|^2)
+		* (@see detail::gauss_moments).
+		*/
+		R (*moments)(const DataLayout<R> &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const R *theta, R *rel);
+	};
+
+	namespace detail {
+
+		/** Kernels selected at load time (nullptr: library built without RG_SIMD_DISPATCH, or R not float nor double).
+		*/
+		RG_API const SimdKernels<float> * dispatched_kernels(float);
+		RG_API const SimdKernels<double> * dispatched_kernels(double);
+
+		template<class R>
+		const SimdKernels<R> * dispatched_kernels(R) {
+			return nullptr;
+		}
+	}
+
+	/** Instruction set of the neighbor kernels used by the computations in precision R.
+	* @param lanes optional pointer where to store the values of R processed at once.
+	* @return the name of the kernels selected at load time (@see SimdKernels), "builtin" when they are the ones of
+	*	the compiler flags of the caller (library built without RG_SIMD_DISPATCH).
+	*/
+	template<class R>
+	const char * simdArch(size_t RG_OUT *lanes = nullptr) {
+#ifdef RG_SIMD_DISPATCH
+		const SimdKernels<R> *kernels = detail::dispatched_kernels(R());
+		if (kernels != nullptr) {
+			if (lanes != nullptr) {
+				*lanes = kernels->lanes;
+			}
+			return kernels->name;
+		}
+#endif
+		if (lanes != nullptr) {
+			*lanes = simd::traits<R>::size;
+		}
+		return "builtin";
+	}
+}
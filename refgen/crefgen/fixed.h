@@ -0,0 +1,449 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstdint>
+#include <cstddef>
+
+
+/** @brief Saturating fixed point arithmetic for targets without a floating point unit.
+* Values are integers scaled by 2^F: no operation below uses floating point, except the conversions from and to
+* double meant for the setup and the tests. exp2 and log2 are computed from 257 entry tables with linear interpolation.
+*/
+namespace rg {
+
+	namespace detail {
+
+		const int32_t fixed_max32 = 2147483647;
+		const int64_t fixed_max64 = 9223372036854775807LL;
+
+		inline int32_t fixed_sat32(int64_t v) {
+			return v > fixed_max32 ? fixed_max32 : (v < -fixed_max32 ? -fixed_max32 : (int32_t)v);
+		}
+
+		inline int64_t fixed_add64(int64_t a, int64_t b) {
+			if (b > 0 && a > fixed_max64 - b) {
+				return fixed_max64;
+			}
+			if (b < 0 && a < -fixed_max64 - b) {
+				return -fixed_max64;
+			}
+			return a + b;
+		}
+
+		/** v / 2^shift rounded to nearest (0 <= shift < 64).
+		*/
+		inline int64_t fixed_shr64(int64_t v, int shift) {
+			if (shift == 0) {
+				return v;
+			}
+			if (shift >= 63) {
+				return 0;
+			}
+			int64_t half = (int64_t)1 << (shift - 1);
+			return v >= 0 ? (int64_t)(((uint64_t)v + (uint64_t)half) >> shift) : -(int64_t)(((uint64_t)(-v) + (uint64_t)half) >> shift);
+		}
+
+		/** v * 2^shift, saturated (0 <= shift).
+		*/
+		inline int64_t fixed_shl64(int64_t v, int shift) {
+			if (v == 0 || shift == 0) {
+				return v;
+			}
+			if (shift >= 63 || (v > 0 ? v > (fixed_max64 >> shift) : v < -(fixed_max64 >> shift))) {
+				return v > 0 ? fixed_max64 : -fixed_max64;
+			}
+			return (int64_t)((uint64_t)v << shift);
+		}
+
+		/** a * b / 2^shift rounded to nearest and saturated, with a 128 bit intermediate product (0 <= shift < 64).
+		*/
+		inline int64_t fixed_mul64(int64_t a, int64_t b, int shift) {
+			bool negative = (a < 0) != (b < 0);
+			uint64_t ua = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+			uint64_t ub = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+
+			uint64_t a0 = ua & 0xffffffffULL, a1 = ua >> 32;
+			uint64_t b0 = ub & 0xffffffffULL, b1 = ub >> 32;
+			uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+			uint64_t mid = (p00 >> 32) + (p01 & 0xffffffffULL) + (p10 & 0xffffffffULL);
+			uint64_t lo = (p00 & 0xffffffffULL) | (mid << 32);
+			uint64_t hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+
+			if (shift > 0) {
+				uint64_t half = (uint64_t)1 << (shift - 1);
+				lo += half;
+				hi += lo < half ? 1 : 0;
+				lo = (lo >> shift) | (hi << (64 - shift));
+				hi >>= shift;
+			}
+			if (hi != 0 || lo > (uint64_t)fixed_max64) {
+				return negative ? -fixed_max64 : fixed_max64;
+			}
+			return negative ? -(int64_t)lo : (int64_t)lo;
+		}
+
+		/** 2^(i / 256), i = 0..256, in Q2.30.
+		*/
+		inline const uint32_t * fixed_exp2_table() {
+			static const uint32_t table[257] = {
+				1073741824U, 1076653033U, 1079572136U, 1082499153U, 1085434106U, 1088377016U, 1091327906U, 1094286796U,
+				1097253708U, 1100228665U, 1103211687U, 1106202798U, 1109202018U, 1112209370U, 1115224875U, 1118248556U,
+				1121280436U, 1124320536U, 1127368878U, 1130425485U, 1133490379U, 1136563583U, 1139645120U, 1142735011U,
+				1145833280U, 1148939949U, 1152055042U, 1155178580U, 1158310587U, 1161451085U, 1164600099U, 1167757650U,
+				1170923762U, 1174098458U, 1177281762U, 1180473697U, 1183674286U, 1186883552U, 1190101520U, 1193328213U,
+				1196563654U, 1199807867U, 1203060876U, 1206322705U, 1209593378U, 1212872918U, 1216161350U, 1219458698U,
+				1222764986U, 1226080238U, 1229404479U, 1232737732U, 1236080024U, 1239431376U, 1242791816U, 1246161366U,
+				1249540052U, 1252927899U, 1256324931U, 1259731174U, 1263146652U, 1266571390U, 1270005413U, 1273448747U,
+				1276901417U, 1280363448U, 1283834865U, 1287315695U, 1290805962U, 1294305692U, 1297814910U, 1301333643U,
+				1304861917U, 1308399756U, 1311947188U, 1315504238U, 1319070932U, 1322647296U, 1326233356U, 1329829140U,
+				1333434672U, 1337049980U, 1340675091U, 1344310030U, 1347954824U, 1351609500U, 1355274085U, 1358948606U,
+				1362633090U, 1366327563U, 1370032052U, 1373746586U, 1377471191U, 1381205894U, 1384950723U, 1388705706U,
+				1392470869U, 1396246240U, 1400031848U, 1403827719U, 1407633882U, 1411450365U, 1415277195U, 1419114401U,
+				1422962010U, 1426820052U, 1430688553U, 1434567544U, 1438457051U, 1442357104U, 1446267730U, 1450188960U,
+				1454120821U, 1458063343U, 1462016553U, 1465980482U, 1469955159U, 1473940611U, 1477936870U, 1481943963U,
+				1485961921U, 1489990772U, 1494030547U, 1498081275U, 1502142985U, 1506215708U, 1510299473U, 1514394310U,
+				1518500250U, 1522617322U, 1526745556U, 1530884983U, 1535035634U, 1539197537U, 1543370725U, 1547555228U,
+				1551751076U, 1555958300U, 1560176931U, 1564406999U, 1568648537U, 1572901575U, 1577166143U, 1581442275U,
+				1585730000U, 1590029350U, 1594340357U, 1598663052U, 1602997467U, 1607343634U, 1611701585U, 1616071351U,
+				1620452965U, 1624846459U, 1629251865U, 1633669214U, 1638098541U, 1642539877U, 1646993254U, 1651458706U,
+				1655936265U, 1660425963U, 1664927835U, 1669441912U, 1673968228U, 1678506817U, 1683057710U, 1687620943U,
+				1692196547U, 1696784557U, 1701385007U, 1705997930U, 1710623359U, 1715261330U, 1719911875U, 1724575029U,
+				1729250827U, 1733939301U, 1738640488U, 1743354420U, 1748081133U, 1752820662U, 1757573041U, 1762338305U,
+				1767116489U, 1771907628U, 1776711757U, 1781528911U, 1786359126U, 1791202437U, 1796058879U, 1800928489U,
+				1805811301U, 1810707353U, 1815616678U, 1820539314U, 1825475297U, 1830424663U, 1835387448U, 1840363688U,
+				1845353420U, 1850356681U, 1855373507U, 1860403934U, 1865448001U, 1870505744U, 1875577199U, 1880662405U,
+				1885761398U, 1890874216U, 1896000896U, 1901141476U, 1906295993U, 1911464486U, 1916646992U, 1921843549U,
+				1927054196U, 1932278970U, 1937517909U, 1942771053U, 1948038440U, 1953320108U, 1958616096U, 1963926443U,
+				1969251188U, 1974590370U, 1979944027U, 1985312200U, 1990694927U, 1996092249U, 2001504204U, 2006930832U,
+				2012372174U, 2017828268U, 2023299156U, 2028784876U, 2034285470U, 2039800978U, 2045331439U, 2050876895U,
+				2056437387U, 2062012954U, 2067603638U, 2073209480U, 2078830522U, 2084466803U, 2090118366U, 2095785251U,
+				2101467502U, 2107165158U, 2112878262U, 2118606857U, 2124350982U, 2130110682U, 2135885998U, 2141676973U,
+				2147483648U
+			};
+			return table;
+		}
+
+		/** log2(1 + i / 256), i = 0..256, in Q2.30.
+		*/
+		inline const uint32_t * fixed_log2_table() {
+			static const uint32_t table[257] = {
+				0U, 6039314U, 12055174U, 18047761U, 24017256U, 29963836U, 35887675U, 41788947U,
+				47667823U, 53524472U, 59359063U, 65171760U, 70962728U, 76732128U, 82480119U, 88206862U,
+				93912511U, 99597222U, 105261148U, 110904440U, 116527248U, 122129721U, 127712004U, 133274244U,
+				138816582U, 144339162U, 149842124U, 155325606U, 160789745U, 166234679U, 171660541U, 177067464U,
+				182455581U, 187825021U, 193175914U, 198508388U, 203822568U, 209118580U, 214396548U, 219656594U,
+				224898839U, 230123404U, 235330407U, 240519966U, 245692198U, 250847218U, 255985140U, 261106077U,
+				266210141U, 271297442U, 276368092U, 281422197U, 286459867U, 291481207U, 296486323U, 301475319U,
+				306448299U, 311405366U, 316346620U, 321272163U, 326182095U, 331076513U, 335955515U, 340819199U,
+				345667660U, 350500993U, 355319292U, 360122651U, 364911162U, 369684916U, 374444004U, 379188517U,
+				383918542U, 388634168U, 393335482U, 398022572U, 402695523U, 407354420U, 411999347U, 416630388U,
+				421247625U, 425851141U, 430441017U, 435017334U, 439580170U, 444129607U, 448665721U, 453188592U,
+				457698295U, 462194908U, 466678506U, 471149164U, 475606957U, 480051959U, 484484242U, 488903880U,
+				493310944U, 497705506U, 502087636U, 506457405U, 510814882U, 515160136U, 519493235U, 523814248U,
+				528123241U, 532420281U, 536705435U, 540978767U, 545240343U, 549490228U, 553728485U, 557955178U,
+				562170370U, 566374123U, 570566499U, 574747559U, 578917365U, 583075977U, 587223455U, 591359858U,
+				595485245U, 599599675U, 603703206U, 607795895U, 611877800U, 615948977U, 620009483U, 624059373U,
+				628098702U, 632127527U, 636145900U, 640153876U, 644151509U, 648138853U, 652115959U, 656082880U,
+				660039669U, 663986377U, 667923055U, 671849754U, 675766525U, 679673418U, 683570481U, 687457766U,
+				691335320U, 695203192U, 699061430U, 702910083U, 706749198U, 710578822U, 714399001U, 718209783U,
+				722011213U, 725803337U, 729586201U, 733359850U, 737124328U, 740879680U, 744625951U, 748363183U,
+				752091421U, 755810707U, 759521085U, 763222597U, 766915285U, 770599192U, 774274358U, 777940826U,
+				781598637U, 785247830U, 788888448U, 792520529U, 796144114U, 799759243U, 803365955U, 806964289U,
+				810554283U, 814135978U, 817709409U, 821274617U, 824831638U, 828380510U, 831921271U, 835453956U,
+				838978604U, 842495250U, 846003931U, 849504683U, 852997541U, 856482542U, 859959719U, 863429109U,
+				866890747U, 870344666U, 873790901U, 877229486U, 880660455U, 884083842U, 887499680U, 890908003U,
+				894308843U, 897702233U, 901088206U, 904466794U, 907838029U, 911201944U, 914558569U, 917907937U,
+				921250079U, 924585025U, 927912807U, 931233456U, 934547002U, 937853475U, 941152905U, 944445323U,
+				947730758U, 951009239U, 954280797U, 957545460U, 960803257U, 964054218U, 967298370U, 970535742U,
+				973766362U, 976990259U, 980207461U, 983417995U, 986621888U, 989819169U, 993009864U, 996194001U,
+				999371606U, 1002542707U, 1005707329U, 1008865499U, 1012017244U, 1015162589U, 1018301561U, 1021434185U,
+				1024560487U, 1027680492U, 1030794226U, 1033901713U, 1037002979U, 1040098049U, 1043186948U, 1046269699U,
+				1049346328U, 1052416858U, 1055481314U, 1058539720U, 1061592099U, 1064638476U, 1067678873U, 1070713315U,
+				1073741824U
+			};
+			return table;
+		}
+
+		/** Table lookup with linear interpolation: index is the integer part, rem / 2^bits the fractional one.
+		*/
+		inline int64_t fixed_lookup(const uint32_t *table, uint32_t index, uint64_t rem, int bits) {
+			int64_t low = table[index];
+			int64_t high = table[index + 1];
+			return low + fixed_shr64((high - low) * (int64_t)rem, bits);
+		}
+	}
+
+	template<int F>
+	struct FixedAcc;
+
+	/** Signed fixed point number Q(31-F).F stored in 32 bits: the value is raw / 2^F (e.g. Fixed<16> is Q16.16, range
+	* +-32767 and resolution 1.5e-5, Fixed<24> is Q8.24, range +-127 and resolution 6e-8).
+	* Results out of range saturate to the largest value of their sign instead of wrapping around, products and
+	* quotients are rounded to nearest.
+	*/
+	template<int F>
+	struct Fixed {
+		static_assert(F >= 8 && F <= 24 && F % 2 == 0, "Fixed: an even number of fractional bits from 8 to 24");
+
+		int32_t raw;
+
+		static Fixed fromRaw(int32_t raw) {
+			return Fixed{ raw };
+		}
+
+		static Fixed fromInt(int64_t v) {
+			return Fixed{ detail::fixed_sat32(detail::fixed_shl64(v, F)) };
+		}
+
+		/** Nearest fixed point value (setup only: it uses floating point).
+		*/
+		static Fixed fromDouble(double v) {
+			double scaled = v * (double)((int64_t)1 << F);
+			scaled += scaled >= 0 ? 0.5 : -0.5;
+			return Fixed{ scaled >= (double)detail::fixed_max32 ? detail::fixed_max32 :
+						  (scaled <= -(double)detail::fixed_max32 ? -detail::fixed_max32 : (int32_t)scaled) };
+		}
+
+		double toDouble() const {
+			return (double)raw / (double)((int64_t)1 << F);
+		}
+
+		/** Negation (the raw INT32_MIN, outside the symmetric range, saturates to the largest value).
+		*/
+		Fixed operator-() const {
+			return Fixed{ raw < -detail::fixed_max32 ? detail::fixed_max32 : -raw };
+		}
+
+		friend Fixed operator+(Fixed a, Fixed b) {
+			return Fixed{ detail::fixed_sat32((int64_t)a.raw + b.raw) };
+		}
+
+		friend Fixed operator-(Fixed a, Fixed b) {
+			return Fixed{ detail::fixed_sat32((int64_t)a.raw - b.raw) };
+		}
+
+		friend Fixed operator*(Fixed a, Fixed b) {
+			return Fixed{ detail::fixed_sat32(detail::fixed_shr64((int64_t)a.raw * b.raw, F)) };
+		}
+
+		/** Quotient (the largest value of the sign of a for b = 0).
+		*/
+		friend Fixed operator/(Fixed a, Fixed b) {
+			if (b.raw == 0) {
+				return Fixed{ a.raw >= 0 ? detail::fixed_max32 : -detail::fixed_max32 };
+			}
+			int64_t num = (int64_t)a.raw * ((int64_t)1 << F);
+			int64_t q = (num + ((num >= 0) == (b.raw >= 0) ? b.raw / 2 : -b.raw / 2)) / b.raw;
+			return Fixed{ detail::fixed_sat32(q) };
+		}
+
+		friend bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+		friend bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+		friend bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+		friend bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+		friend bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+		friend bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+	};
+
+	/** Fixed point accumulator with the fractional bits of Fixed<F> stored in 64 bits (Q(63-F).F): squared
+	* distances, costs and their sums, that do not fit the range of Fixed<F>. Saturating as Fixed.
+	*/
+	template<int F>
+	struct FixedAcc {
+		int64_t raw;
+
+		static FixedAcc fromRaw(int64_t raw) {
+			FixedAcc a;
+			a.raw = raw;
+			return a;
+		}
+
+		static FixedAcc max() {
+			return FixedAcc::fromRaw(detail::fixed_max64);
+		}
+
+		double toDouble() const {
+			return (double)raw / (double)((int64_t)1 << F);
+		}
+
+		/** Exact widening of a Fixed value.
+		*/
+		FixedAcc(Fixed<F> v) : raw(v.raw) {
+		}
+
+		FixedAcc() : raw(0) {
+		}
+
+		/** Saturated to the range of Fixed<F>.
+		*/
+		Fixed<F> narrow() const {
+			return Fixed<F>::fromRaw(detail::fixed_sat32(raw));
+		}
+
+		/** Negation (the raw INT64_MIN, outside the symmetric range, saturates to the largest value).
+		*/
+		FixedAcc operator-() const {
+			return FixedAcc::fromRaw(raw < -detail::fixed_max64 ? detail::fixed_max64 : -raw);
+		}
+
+		FixedAcc & operator+=(FixedAcc b) {
+			raw = detail::fixed_add64(raw, b.raw);
+			return *this;
+		}
+
+		friend FixedAcc operator+(FixedAcc a, FixedAcc b) {
+			return a += b;
+		}
+
+		friend FixedAcc operator-(FixedAcc a, FixedAcc b) {
+			return a += -b;
+		}
+
+		friend FixedAcc operator*(FixedAcc a, FixedAcc b) {
+			return FixedAcc::fromRaw(detail::fixed_mul64(a.raw, b.raw, F));
+		}
+
+		/** Quotient (the largest value of the sign of a for b = 0): full precision while a * 2^F fits 64 bits.
+		*/
+		friend FixedAcc operator/(FixedAcc a, FixedAcc b) {
+			if (b.raw == 0) {
+				return FixedAcc::fromRaw(a.raw >= 0 ? detail::fixed_max64 : -detail::fixed_max64);
+			}
+			int64_t bound = detail::fixed_max64 >> F;
+			if (a.raw <= bound && a.raw >= -bound) {
+				int64_t num = a.raw * ((int64_t)1 << F);
+				return FixedAcc::fromRaw(num / b.raw);
+			}
+			return FixedAcc::fromRaw(detail::fixed_shl64(a.raw / b.raw, F));
+		}
+
+		/** Value / 2^shift, rounded to nearest.
+		*/
+		friend FixedAcc operator>>(FixedAcc a, int shift) {
+			return FixedAcc::fromRaw(detail::fixed_shr64(a.raw, shift));
+		}
+
+		/** Value * 2^shift, saturated.
+		*/
+		friend FixedAcc operator<<(FixedAcc a, int shift) {
+			return FixedAcc::fromRaw(detail::fixed_shl64(a.raw, shift));
+		}
+
+		friend bool operator<(FixedAcc a, FixedAcc b) { return a.raw < b.raw; }
+		friend bool operator>(FixedAcc a, FixedAcc b) { return a.raw > b.raw; }
+		friend bool operator<=(FixedAcc a, FixedAcc b) { return a.raw <= b.raw; }
+		friend bool operator>=(FixedAcc a, FixedAcc b) { return a.raw >= b.raw; }
+		friend bool operator==(FixedAcc a, FixedAcc b) { return a.raw == b.raw; }
+		friend bool operator!=(FixedAcc a, FixedAcc b) { return a.raw != b.raw; }
+	};
+
+	namespace fixed {
+
+		/** ln(2) and log2(e) in Q2.30.
+		*/
+		const int64_t ln2_q30 = 744261118;
+		const int64_t log2e_q30 = 1549082005;
+
+		/** Constant given in Q2.30 (e.g. ln2_q30) as a Fixed<F>.
+		*/
+		template<int F>
+		Fixed<F> constant(int64_t q30) {
+			return Fixed<F>::fromRaw((int32_t)detail::fixed_shr64(q30, 30 - F));
+		}
+
+		/** 2^x: 0 below the resolution of FixedAcc<F>, saturated above its range.
+		*/
+		template<int F>
+		FixedAcc<F> exp2(FixedAcc<F> x) {
+			const int64_t limit = (int64_t)64 << F;
+			if (x.raw < -limit) {
+				return FixedAcc<F>();
+			}
+			if (x.raw > limit) {
+				return FixedAcc<F>::max();
+			}
+
+			// x = n + f, f in [0, 1): 2^f from the table in Q2.30
+			int64_t n = x.raw >> F;
+			uint64_t f = (uint64_t)(x.raw - n * ((int64_t)1 << F));
+			int64_t mantissa = detail::fixed_lookup(detail::fixed_exp2_table(), (uint32_t)(f >> (F - 8)), f & (((uint64_t)1 << (F - 8)) - 1), F - 8);
+
+			int64_t shift = n + F - 30;
+			return FixedAcc<F>::fromRaw(shift >= 0 ? detail::fixed_shl64(mantissa, (int)shift) : detail::fixed_shr64(mantissa, (int)-shift));
+		}
+
+		template<int F>
+		FixedAcc<F> exp2(Fixed<F> x) {
+			return exp2(FixedAcc<F>(x));
+		}
+
+		/** log2(x) for x > 0, the lowest value of Fixed<F> for x <= 0.
+		*/
+		template<int F>
+		Fixed<F> log2(FixedAcc<F> x) {
+			if (x.raw <= 0) {
+				return Fixed<F>::fromRaw(-detail::fixed_max32);
+			}
+
+			// x = 2^(msb - F) * m, m in [1, 2) normalized to Q2.30
+			uint64_t u = (uint64_t)x.raw;
+			int msb = 0;
+			while ((u >> msb) > 1) {
+				msb++;
+			}
+			uint64_t m = msb >= 30 ? u >> (msb - 30) : u << (30 - msb);
+			uint64_t f = m - ((uint64_t)1 << 30);
+			int64_t mantissa = detail::fixed_lookup(detail::fixed_log2_table(), (uint32_t)(f >> 22), f & (((uint64_t)1 << 22) - 1), 22);
+
+			return Fixed<F>::fromRaw((int32_t)((int64_t)(msb - F) * ((int64_t)1 << F) + detail::fixed_shr64(mantissa, 30 - F)));
+		}
+
+		template<int F>
+		Fixed<F> log2(Fixed<F> x) {
+			return log2(FixedAcc<F>(x));
+		}
+
+		/** Integer square root (floor).
+		*/
+		inline uint64_t isqrt(uint64_t v) {
+			uint64_t root = 0;
+			uint64_t bit = (uint64_t)1 << 62;
+			while (bit > v) {
+				bit >>= 2;
+			}
+			while (bit != 0) {
+				if (v >= root + bit) {
+					v -= root + bit;
+					root = (root >> 1) + bit;
+				}
+				else {
+					root >>= 1;
+				}
+				bit >>= 2;
+			}
+			return root;
+		}
+
+		/** Square root of x >= 0 (0 for x < 0).
+		*/
+		template<int F>
+		FixedAcc<F> sqrt(FixedAcc<F> x) {
+			if (x.raw <= 0) {
+				return FixedAcc<F>();
+			}
+			uint64_t u = (uint64_t)x.raw;
+			if (u <= ((uint64_t)detail::fixed_max64 >> F)) {
+				return FixedAcc<F>::fromRaw((int64_t)isqrt(u << F));
+			}
+			return FixedAcc<F>::fromRaw((int64_t)(isqrt(u) << (F / 2)));
+		}
+	}
+}
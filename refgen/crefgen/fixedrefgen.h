@@ -0,0 +1,316 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+#include "fixed.h"
+#include "rademacher.h"
+
+
+
+namespace rg {
+
+	namespace detail {
+
+		/** Sign vector accessed as delta(i, 0), filled by RademacherGen::fill.
+		*/
+		struct fixed_signs {
+			std::vector<int8_t> &signs;
+
+			int8_t & operator()(size_t i, size_t) {
+				return signs[i];
+			}
+		};
+
+		/** Cost of costfncV2 in fixed point, scaled by 2^-shift so that the gaussian terms of the closest neighbors fit
+		* the accumulator (block floating point: the exponent is chosen once for each call, from the amplitude of the
+		* gaussians). The neighbor terms are computed in base 2, alpha_gauss * exp(-ln(alpha_gauss) * d^2 / (2 * d_gauss))
+		* being 2^(log2Amp - rate * d^2) with rate = log2Amp / (2 * d_gauss).
+		*/
+		template<int F>
+		struct fixed_cost {
+			const int32_t *data;
+			size_t spaceSize, length;
+			Fixed<F> ni1, alpha_slow;
+			FixedAcc<F> ni2, r1_sq, r2_sq;
+			Fixed<F> log2Amp, rate;
+			int shift;
+
+			FixedAcc<F> operator()(const Fixed<F> *theta) const {
+
+				FixedAcc<F> targetSqDist, mySqVar;
+				for (size_t i = 0; i < spaceSize; i++) {
+					const int32_t *row = data + i * length;
+					FixedAcc<F> tarRelPos = FixedAcc<F>(Fixed<F>::fromRaw(row[0])) - FixedAcc<F>(theta[i]);
+					FixedAcc<F> myVar = FixedAcc<F>(theta[i]) - FixedAcc<F>(Fixed<F>::fromRaw(row[1]));
+					targetSqDist += tarRelPos * tarRelPos;
+					mySqVar += myVar * myVar;
+				}
+
+				FixedAcc<F> cstr1 = targetSqDist - r1_sq;
+				FixedAcc<F> cstr2 = targetSqDist - r2_sq;
+				FixedAcc<F> local = FixedAcc<F>(ni1) * (cstr1 * cstr1) + ni2 * (cstr2 * cstr2) + FixedAcc<F>(alpha_slow) * mySqVar;
+
+				FixedAcc<F> gauss;
+				FixedAcc<F> exponent0 = FixedAcc<F>(log2Amp) - FixedAcc<F>::fromRaw((int64_t)shift << F);
+				for (size_t j = 2; j < length; j++) {
+					FixedAcc<F> dist_sq;
+					for (size_t i = 0; i < spaceSize; i++) {
+						FixedAcc<F> relPos = FixedAcc<F>(theta[i]) - FixedAcc<F>(Fixed<F>::fromRaw(data[i * length + j]));
+						dist_sq += relPos * relPos;
+					}
+					gauss += fixed::exp2(exponent0 - FixedAcc<F>(rate) * dist_sq);
+				}
+
+				return (local >> shift) + gauss;
+			}
+		};
+	}
+
+	/** Reference generator in fixed point, for targets without a floating point unit (e.g. soft-float microcontrollers,
+	* where each exp and pow of the floating point generator is emulated in software).
+	* Same problem of Refgen with the first order SPSA solver: same multipliers update, same cost (costfncV2), same
+	* perturbation stream for a given seed and the same max_var clamp, with every value in Fixed<F> (Q16.16 for F = 16,
+	* Q8.24 for F = 24) and the sums in 64 bit accumulators. exp and pow are computed in base 2 from tables, the gains
+	* of SPSA as 2^(log2(a) - alpha * log2(k + A)). Nothing is allocated but the vectors of the solution, once for each
+	* space dimension.
+	* The references follow the ones of Refgen within the resolution of the format; the arithmetic saturates, so a
+	* cost of the closest approaches (or of positions out of range) stays the largest one instead of wrapping around.
+	* Warm start, stopping rules, the other solvers and the other data layouts are not available in fixed point.
+	* @see Refgen
+	*/
+	template<int F = 16>
+	class FixedRefgen {
+
+	public:
+		using value_type = Fixed<F>;
+		using acc_type = FixedAcc<F>;
+
+	private:
+		Fixed<F> _alpha_rate1, _alpha_rate2;
+		Fixed<F> _max_var, _max_ni;
+		Fixed<F> _alpha_slow, _d_gauss;
+		FixedAcc<F> _r1_sq, _r2_sq;
+		Fixed<F> _log2_min_alpha;
+		size_t _max_iter;
+		Fixed<F> _max_delta, _A, _alpha, _gamma;
+		Fixed<F> _log2_a, _log2_c;
+		RademacherGen _perturbation;
+
+		// multipliers
+		Fixed<F> _ni1;
+		FixedAcc<F> _ni2;
+
+		// solution, perturbed points and perturbation signs
+		std::vector<Fixed<F>> _theta, _thetaPlus, _thetaMinus;
+		std::vector<int8_t> _delta;
+
+	public:
+
+		/** Fixed point reference generator constructor (same parameters of Refgen, @see Refgen::Refgen).
+		* @param min_alpha_gauss minimum value for the gauss repulsive distribution (in the range of Fixed<F>, at least 1).
+		* @param a SPSA initial step size and c initial perturbation coefficient: both greater than 0.
+		*/
+		FixedRefgen(Fixed<F> alpha_rate1, Fixed<F> r1, Fixed<F> alpha_rate2, Fixed<F> r2, Fixed<F> max_ni, Fixed<F> alpha_slow,
+			Fixed<F> d_gauss, Fixed<F> min_alpha_gauss, Fixed<F> max_var, size_t max_iter, Fixed<F> max_delta, Fixed<F> a, Fixed<F> A,
+			Fixed<F> alpha, Fixed<F> c, Fixed<F> gamma, uint64_t seed = 0) :
+			_alpha_rate1(alpha_rate1), _alpha_rate2(alpha_rate2), _max_var(max_var), _max_ni(max_ni), _alpha_slow(alpha_slow),
+			_d_gauss(d_gauss), _r1_sq(FixedAcc<F>(r1) * FixedAcc<F>(r1)), _r2_sq(FixedAcc<F>(r2) * FixedAcc<F>(r2)),
+			_log2_min_alpha(fixed::log2(min_alpha_gauss)), _max_iter(max_iter), _max_delta(max_delta), _A(A), _alpha(alpha), _gamma(gamma),
+			_log2_a(fixed::log2(a)), _log2_c(fixed::log2(c)), _perturbation(seed), _ni1(Fixed<F>::fromRaw(0)), _ni2() {
+
+			if (a.raw <= 0 || c.raw <= 0 || d_gauss.raw <= 0) {
+				THROW_EXCPT("FixedRefgen: a, c and d_gauss must be greater than 0");
+			}
+		}
+
+		/** Fixed point reference generator with the default SPSA parameters of Refgen (max_iter 120, max_delta 0.3, a 0.4,
+		* A 1, alpha 0.602, c 0.1, gamma 0.1).
+		*/
+		FixedRefgen(Fixed<F> alpha_rate1, Fixed<F> r1, Fixed<F> alpha_rate2, Fixed<F> r2, Fixed<F> max_ni, Fixed<F> alpha_slow,
+			Fixed<F> d_gauss, Fixed<F> min_alpha_gauss, Fixed<F> max_var) :
+			FixedRefgen(alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var, 120,
+						fixed::constant<F>(322122547), fixed::constant<F>(429496730), Fixed<F>::fromInt(1),
+						fixed::constant<F>(646392578), fixed::constant<F>(107374182), fixed::constant<F>(107374182)) {
+		}
+
+		/** Restarts the SPSA perturbation stream with a new seed.
+		*/
+		void setSeed(uint64_t seed) {
+			_perturbation.seed(seed);
+		}
+
+		/** Computes the next reference (@see Refgen::computeRef), every value being the raw integer of a Fixed<F>.
+		* @param data data block [target agentActualPosition othersPosition...], row major spaceSize x length.
+		* @param spaceSize space dimension (e.g planar -> 2).
+		* @param length number of columns of the data block (e.g. 2 + number of visible other agents).
+		* @param ref spaceSize values where to store the new reference.
+		* @return the cost of the reference (saturated to the range of FixedAcc<F>).
+		*/
+		FixedAcc<F> computeRef(const int32_t RG_IN *data, size_t spaceSize, size_t length, int32_t RG_OUT *ref) {
+
+			if (_theta.size() != spaceSize) {
+				_theta.resize(spaceSize);
+				_thetaPlus.resize(spaceSize);
+				_thetaMinus.resize(spaceSize);
+				_delta.resize(spaceSize);
+			}
+
+			detail::fixed_cost<F> cost = prepare(data, spaceSize, length);
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				_theta[i] = Fixed<F>::fromRaw(data[i * length + 1]);
+			}
+
+			FixedAcc<F> y = solve(cost, spaceSize);
+
+			// the reference cannot be farther than max_var from the actual position
+			FixedAcc<F> variation_sq;
+			for (size_t i = 0; i < spaceSize; i++) {
+				FixedAcc<F> variation = FixedAcc<F>(_theta[i]) - FixedAcc<F>(Fixed<F>::fromRaw(data[i * length + 1]));
+				variation_sq += variation * variation;
+			}
+			FixedAcc<F> variation_eval = fixed::sqrt(variation_sq);
+
+			if (variation_eval > FixedAcc<F>(_max_var)) {
+				Fixed<F> normalization = (FixedAcc<F>(_max_var) / variation_eval).narrow();
+				for (size_t i = 0; i < spaceSize; i++) {
+					Fixed<F> actualPos = Fixed<F>::fromRaw(data[i * length + 1]);
+					_theta[i] = actualPos + (_theta[i] - actualPos) * normalization;
+				}
+				y = cost(_theta.data());
+			}
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				ref[i] = _theta[i].raw;
+			}
+
+			return y << cost.shift;
+		}
+
+		/** External constrain multiplier.
+		*/
+		Fixed<F> getNi1() const {
+			return _ni1;
+		}
+
+	private:
+
+		/** Multipliers update (@see Refgen) and cost of the call.
+		*/
+		detail::fixed_cost<F> prepare(const int32_t *data, size_t spaceSize, size_t length) {
+
+			FixedAcc<F> targetSqDist_eval;
+			for (size_t i = 0; i < spaceSize; i++) {
+				FixedAcc<F> tarRelPos = FixedAcc<F>(Fixed<F>::fromRaw(data[i * length])) - FixedAcc<F>(Fixed<F>::fromRaw(data[i * length + 1]));
+				targetSqDist_eval += tarRelPos * tarRelPos;
+			}
+
+			FixedAcc<F> cstr1_err = targetSqDist_eval - _r1_sq;
+			FixedAcc<F> ni1 = FixedAcc<F>(_ni1) + FixedAcc<F>(_alpha_rate1) * (cstr1_err * cstr1_err);
+			_ni1 = ni1 < FixedAcc<F>(_max_ni) ? ni1.narrow() : _max_ni;
+
+			FixedAcc<F> cstr2_err = targetSqDist_eval - _r2_sq;
+			if (cstr2_err.raw > 0) {
+				_ni2 = FixedAcc<F>();
+			}
+			else {
+				_ni2 += FixedAcc<F>(_alpha_rate2) * (cstr2_err * cstr2_err);
+			}
+
+			// alpha_gauss = max((ni1 * |target - position|^2)^4, min_alpha_gauss), in base 2 logarithm
+			Fixed<F> log2Amp = _log2_min_alpha;
+			if (_ni1.raw > 0 && targetSqDist_eval.raw > 0) {
+				Fixed<F> log2Pow = Fixed<F>::fromInt(4) * (fixed::log2(_ni1) + fixed::log2(targetSqDist_eval));
+				log2Amp = log2Pow > log2Amp ? log2Pow : log2Amp;
+			}
+
+			detail::fixed_cost<F> cost;
+			cost.data = data;
+			cost.spaceSize = spaceSize;
+			cost.length = length;
+			cost.ni1 = _ni1;
+			cost.ni2 = _ni2;
+			cost.alpha_slow = _alpha_slow;
+			cost.r1_sq = _r1_sq;
+			cost.r2_sq = _r2_sq;
+			cost.log2Amp = log2Amp;
+			cost.rate = log2Amp / (Fixed<F>::fromInt(2) * _d_gauss);
+
+			// the sum of the gaussians of all the neighbors must fit 62 bits: 2^(log2Amp - shift + F) * neighbors
+			int neighborBits = 0;
+			while (neighborBits < 32 && (length >> neighborBits) > 0) {
+				neighborBits++;
+			}
+			int64_t ceilAmp = (log2Amp.raw + ((int64_t)1 << F) - 1) >> F;
+			int64_t shift = ceilAmp + F + neighborBits - 61;
+			cost.shift = shift > 0 ? (int)(shift < 62 ? shift : 62) : 0;
+
+			return cost;
+		}
+
+		/** SPSA iterations from _theta (@see SPSA), every gain and step in fixed point.
+		* @return the (scaled) cost of the solution.
+		*/
+		FixedAcc<F> solve(const detail::fixed_cost<F> &cost, size_t spaceSize) {
+
+			detail::fixed_signs delta{ _delta };
+			Fixed<F> sqrtSize = fixed::sqrt(FixedAcc<F>(Fixed<F>::fromInt((int64_t)spaceSize))).narrow();
+
+			for (size_t k = 1; k <= _max_iter; k++) {
+
+				// ak = a / (k + A)^alpha, ck = c / k^gamma
+				Fixed<F> kf = Fixed<F>::fromInt((int64_t)k);
+				Fixed<F> ak = fixed::exp2(_log2_a - _alpha * fixed::log2(kf + _A)).narrow();
+				Fixed<F> ck = fixed::exp2(_log2_c - _gamma * fixed::log2(kf)).narrow();
+
+				_perturbation.fill(delta, spaceSize);
+
+				for (size_t i = 0; i < spaceSize; i++) {
+					Fixed<F> step = _delta[i] > 0 ? ck : -ck;
+					_thetaPlus[i] = _theta[i] + step;
+					_thetaMinus[i] = _theta[i] - step;
+				}
+
+				FixedAcc<F> yplus = cost(_thetaPlus.data());
+				FixedAcc<F> yminus = cost(_thetaMinus.data());
+
+				// ghat_i = (yplus - yminus) / (2 * ck * delta_i), with delta_i = +-1 (back to the cost scale)
+				FixedAcc<F> ghatAbs = ((yplus - yminus) / FixedAcc<F>(ck + ck)) << cost.shift;
+
+				FixedAcc<F> ghatMag = ghatAbs.raw >= 0 ? ghatAbs : -ghatAbs;
+				FixedAcc<F> varNorm_eval = ghatMag * FixedAcc<F>(sqrtSize);
+
+				// step of every component: ak * ghatAbs, or ak * max_delta / sqrt(size) when the step norm is clipped
+				Fixed<F> stepAbs;
+				if (varNorm_eval > FixedAcc<F>(_max_delta)) {
+					Fixed<F> clipped = ak * (_max_delta / sqrtSize);
+					stepAbs = ghatAbs.raw >= 0 ? clipped : -clipped;
+				}
+				else {
+					stepAbs = (FixedAcc<F>(ak) * ghatAbs).narrow();
+				}
+
+				for (size_t i = 0; i < spaceSize; i++) {
+					_theta[i] = _delta[i] > 0 ? _theta[i] - stepAbs : _theta[i] + stepAbs;
+				}
+			}
+
+			return cost(_theta.data());
+		}
+	};
+
+	/** Q16.16 reference generator (@see FixedRefgen).
+	*/
+	using RefgenQ16 = FixedRefgen<16>;
+}
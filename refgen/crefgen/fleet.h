@@ -0,0 +1,308 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+#include <memory>
+
+#include "refgen.h"
+#include "threadpool.h"
+#include "spatialgrid.h"
+
+
+namespace rg {
+
+	/** A group of reference generators, one for each agent, updated together.
+	* Each agent keeps its own multipliers (e.g. its own Refgen), while the whole group is computed
+	* with a single call spreading the agents over the available cores (work stealing pool owned by the fleet).
+	*/
+	template<typename R>
+	class Fleet {
+
+	private:
+		std::vector<Refgen<R>> _agents;
+		std::unique_ptr<ThreadPool> _pool;
+
+		R _d_gauss;
+		R _min_alpha_gauss;
+		R _max_var;
+
+		// computeRefGrid and computeRefRadius buffers: grid of the actual positions and per agent neighbor lists and data blocks
+		SpatialGrid<R> _grid;
+		std::vector<std::vector<size_t>> _neighbors;
+		std::vector<std::vector<R>> _blocks;
+
+		// final cost of each agent of the last update
+		std::vector<R> _costs;
+
+	public:
+
+		/** Fleet constructor: all the agents share the same parameters.
+		* @param n_agents number of agents (e.g. number of reference generators).
+		* @param num_threads number of threads used by computeRefBatch and computeRefGrid (0: all hardware threads).
+		* @param alpha_rate1 growth rate of the external constrain multiplier.
+		* @param r1 external attractive constrain radius.
+		* @param alpha_rate2 growth rate of the internal constrain multiplier.
+		* @param r2 internal repulsive constrain radius.
+		* @param max_ni multipliers saturation.
+		* @param alpha_slow dynamic friction coefficient.
+		* @param d_gauss safe distance among agents.
+		* @param min_alpha_gauss minimum value for the gauss repulsive distribution of the agent respect others.
+		* @param max_var maximum distance of the new reference with respect to the actual position.
+		* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+		* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+		* @param a SPSA initial step size (use: 0.4).
+		* @param A SPSA stability factor (use: 1).
+		* @param alpha SPSA step size decay rate (use: 0.602).
+		* @param c SPSA initial perturbation coefficient (use: 0.1).
+		* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+		* @param seed fleet seed: agent k uses the perturbation stream agentSeed(seed, k), so results do not depend on the number of threads.
+		* @param solver optimization algorithm of the agents.
+		* @see Refgen
+		*/
+		Fleet(size_t n_agents, size_t num_threads, R alpha_rate1, R r1, R alpha_rate2, R r2, R max_ni, R alpha_slow, R d_gauss, R min_alpha_gauss, R max_var,
+			size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1, uint64_t seed = 0,
+			SolverType solver = SOLVER_SPSA) {
+
+			_pool.reset(new ThreadPool(num_threads));
+			_d_gauss = d_gauss;
+			_min_alpha_gauss = min_alpha_gauss;
+			_max_var = max_var;
+
+			_neighbors.resize(n_agents);
+			_blocks.resize(n_agents);
+			_costs.resize(n_agents);
+
+			_agents.reserve(n_agents);
+			for (size_t k = 0; k < n_agents; k++) {
+				_agents.emplace_back(alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
+									max_iter, max_delta, a, A, alpha, c, gamma, agentSeed(seed, k), solver);
+			}
+		}
+
+		/** Seed of the perturbation stream of the agent k of a fleet with the given seed.
+		*/
+		static uint64_t agentSeed(uint64_t seed, size_t k) {
+			return RademacherGen::word(seed, k);
+		}
+
+		/** Fleet destructor.
+		*/
+		~Fleet() {};
+
+		/** Number of agents of the fleet.
+		*/
+		size_t size() const {
+			return _agents.size();
+		}
+
+		/** Reference generator of a single agent.
+		* @param k agent index.
+		*/
+		Refgen<R> & agent(size_t k) {
+			return _agents[k];
+		}
+
+		/** Selects the optimization algorithm of all the agents.
+		* @see Refgen::setSolver
+		*/
+		void setSolver(SolverType solver, R hess_min = (R)1e-3) {
+			for (auto &agent : _agents) {
+				agent.setSolver(solver, hess_min);
+			}
+		}
+
+		/** Sets the SPSA stopping rules of all the agents.
+		* @see Refgen::setStop
+		*/
+		void setStop(const SPSAStop<R> &stop) {
+			for (auto &agent : _agents) {
+				agent.setStop(stop);
+			}
+		}
+
+		/** Sets the warm start mode of all the agents.
+		* @see Refgen::setWarmStart
+		*/
+		void setWarmStart(bool enable, size_t iterations, size_t gain_offset, R reset_dist) {
+			for (auto &agent : _agents) {
+				agent.setWarmStart(enable, iterations, gain_offset, reset_dist);
+			}
+		}
+
+		/** Sets the multi-start mode of all the agents (their chains run on the thread of the agent).
+		* @see Refgen::setMultiStart
+		*/
+		void setMultiStart(size_t chains, size_t iterations, R spread) {
+			for (auto &agent : _agents) {
+				agent.setMultiStart(chains, iterations, spread, 1);
+			}
+		}
+
+		/** Records the solver iterations of all the agents in a trace buffer, the agent index being the source of the records.
+		* @see Refgen::setTrace
+		*/
+		void setTrace(TraceBuffer *trace) {
+			for (size_t k = 0; k < _agents.size(); k++) {
+				_agents[k].setTrace(trace, (uint32_t)k);
+			}
+		}
+
+		/** Restarts the thread pool of the fleet.
+		* @param num_threads number of threads used by computeRefBatch and computeRefGrid (0: all hardware threads).
+		* @param pin true to pin each worker thread to its own core.
+		*/
+		void setNumThreads(size_t num_threads, bool pin = false) {
+			_pool.reset();
+			_pool.reset(new ThreadPool(num_threads, pin));
+		}
+
+		/** Computes the next reference of the first n_agents agents at once.
+		* @param data pointer to the packed data of all the agents: the block of agent k starts at data + offsets[k]
+		*	and it has the same properties required by Refgen::computeRef:
+		*	- rank: 2
+		*	- shape: spaceSize x length_k, where length_k = (offsets[k + 1] - offsets[k]) / spaceSize
+		*	- memory layout: row major (e.g. x1, x2, ..., xk, y1, y2, ..., yk, ...)
+		*	- data meaning: [target agentActualPosition othersPosition...].
+		* @param offsets n_agents + 1 element offsets of the agent blocks (offsets[n_agents] is the total data size).
+		* @param spaceSize space dimension (e.g planar -> 2)
+		* @param n_agents number of agents to update (at most size()).
+		* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+		*	references (the reference of agent k starts at refs + k * spaceSize).
+		* @param losses optional pointer to n_agents elements where to store the final cost of each agent.
+		* @return the sum of the final costs of the agents.
+		* @see Refgen::computeRef
+		*/
+		template<typename O>
+		R computeRefBatch(R RG_IN *data, const O RG_IN *offsets, size_t spaceSize, size_t n_agents, R RG_OUT *refs, R RG_OUT *losses = nullptr) {
+
+			if (n_agents > _agents.size()) {
+				THROW_EXCPT("Fleet: more agents requested than the allocated ones");
+			}
+
+			_pool->parallelFor(n_agents, 1, [&](size_t k) {
+				size_t length = (size_t)(offsets[k + 1] - offsets[k]) / spaceSize;
+				_costs[k] = _agents[k].computeRef(data + (size_t)offsets[k], spaceSize, length, refs + k * spaceSize);
+			});
+
+			R total = 0;
+			for (size_t k = 0; k < n_agents; k++) {
+				total += _costs[k];
+				if (losses != nullptr) {
+					losses[k] = _costs[k];
+				}
+			}
+
+			return total;
+		}
+
+		/** Computes the next reference of the first n_agents agents from the global positions, each agent seeing only its relevant neighbors.
+		* The neighbors of an agent are the agents closer than gaussCutoff(d_gauss, min_alpha_gauss, eps) + max_var to its
+		* actual position, found with a uniform grid (O(n_agents * k) instead of O(n_agents^2), k: mean number of neighbors).
+		* Each excluded agent adds less than eps to the gaussian repulsion at any point within max_var from the actual position,
+		* e.g. where the reference ends up.
+		* @param positions actual positions of the agents (row major, spaceSize x n_agents: x1, x2, ..., xn, y1, y2, ..., yn, ...).
+		* @param targets targets of the agents (same layout of positions).
+		* @param spaceSize space dimension (e.g planar -> 2)
+		* @param n_agents number of agents to update (at most size()).
+		* @param eps tolerated contribution of a single excluded neighbor (in (0, 1)).
+		* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+		*	references (the reference of agent k starts at refs + k * spaceSize).
+		* @param losses optional pointer to n_agents elements where to store the final cost of each agent.
+		* @param truncation optional pointer to n_agents elements where to store the bound on the cost error of each agent
+		*	due to the excluded neighbors (number of excluded neighbors x eps).
+		* @return the sum of the final costs of the agents.
+		* @see gaussCutoff
+		* @see SpatialGrid
+		*/
+		R computeRefGrid(const R RG_IN *positions, const R RG_IN *targets, size_t spaceSize, size_t n_agents, R eps, R RG_OUT *refs,
+			R RG_OUT *losses = nullptr, R RG_OUT *truncation = nullptr) {
+
+			R radius = gaussCutoff(_d_gauss, _min_alpha_gauss, eps) + _max_var;
+			R total = computeRefRadius(positions, targets, spaceSize, n_agents, radius, refs, losses);
+
+			if (truncation != nullptr) {
+				for (size_t k = 0; k < n_agents; k++) {
+					truncation[k] = (R)(n_agents - 1 - _neighbors[k].size()) * eps;
+				}
+			}
+
+			return total;
+		}
+
+		/** Computes the next reference of the first n_agents agents from the global positions, each agent seeing the agents
+		* closer than radius to its actual position (found with a uniform grid, @see computeRefGrid).
+		* @param positions actual positions of the agents (row major, spaceSize x n_agents: x1, x2, ..., xn, y1, y2, ..., yn, ...).
+		* @param targets targets of the agents (same layout of positions).
+		* @param spaceSize space dimension (e.g planar -> 2)
+		* @param n_agents number of agents to update (at most size()).
+		* @param radius neighbor radius (greater than 0).
+		* @param refs a pointer to an already allocated memory of size equal to spaceSize x n_agents in which store the new computed
+		*	references (the reference of agent k starts at refs + k * spaceSize).
+		* @param losses optional pointer to n_agents elements where to store the final cost of each agent.
+		* @return the sum of the final costs of the agents.
+		*/
+		R computeRefRadius(const R RG_IN *positions, const R RG_IN *targets, size_t spaceSize, size_t n_agents, R radius, R RG_OUT *refs,
+			R RG_OUT *losses = nullptr) {
+
+			if (n_agents > _agents.size()) {
+				THROW_EXCPT("Fleet: more agents requested than the allocated ones");
+			}
+			if (!(radius > 0)) {
+				THROW_EXCPT("Fleet: the neighbor radius must be greater than 0");
+			}
+
+			_grid.build(positions, spaceSize, n_agents, radius);
+
+			_pool->parallelFor(n_agents, 1, [&](size_t k) {
+
+				std::vector<size_t> &neighbors = _neighbors[k];
+				neighbors.clear();
+				_grid.forEachNeighborOf(k, radius, [&neighbors](size_t j) {
+					neighbors.push_back(j);
+				});
+
+				// data block: [target agentActualPosition neighborsPosition...]
+				size_t length = 2 + neighbors.size();
+				std::vector<R> &block = _blocks[k];
+				block.resize(spaceSize * length);
+
+				for (size_t i = 0; i < spaceSize; i++) {
+					R *row = block.data() + i * length;
+					row[0] = targets[i * n_agents + k];
+					row[1] = positions[i * n_agents + k];
+					for (size_t j = 0; j < neighbors.size(); j++) {
+						row[2 + j] = positions[i * n_agents + neighbors[j]];
+					}
+				}
+
+				_costs[k] = _agents[k].computeRef(block.data(), spaceSize, length, refs + k * spaceSize);
+			});
+
+			R total = 0;
+			for (size_t k = 0; k < n_agents; k++) {
+				total += _costs[k];
+				if (losses != nullptr) {
+					losses[k] = _costs[k];
+				}
+			}
+
+			return total;
+		}
+
+		/** Number of neighbors seen by the agent k in the last computeRefGrid or computeRefRadius.
+		*/
+		size_t neighborCount(size_t k) const {
+			return k < _neighbors.size() ? _neighbors[k].size() : 0;
+		}
+	};
+}
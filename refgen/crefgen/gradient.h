@@ -0,0 +1,197 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cmath>
+#include <algorithm>
+#include <xtensor/xarray.hpp>
+#include <xtensor/xfixed.hpp>
+#include "spsa.h"
+#include "spsa2.h"
+
+
+
+namespace rg {
+
+	/** Memory used by the gradient iterations: the Adam moments on top of the 2SPSA workspace (whose grad vector is reused).
+	* A gradient workspace can be used by the SPSA solvers too, so the reference generator keeps one workspace for all of them.
+	*/
+	template<class R, size_t Dim>
+	struct GradientWorkspace : public SPSA2Workspace<R, Dim> {
+		using vector_type = typename SPSAWorkspace<R, Dim>::vector_type;
+
+		/** Running averages of the gradient and of its squared components. */
+		vector_type moment1;
+		vector_type moment2;
+		/** Number of gradients averaged in the moments. */
+		size_t moment_k;
+
+		GradientWorkspace(size_t size = Dim) : SPSA2Workspace<R, Dim>(size),
+			moment1(spsa_vector<R, Dim>::make(size)), moment2(spsa_vector<R, Dim>::make(size)), moment_k(0) {
+		}
+
+		/** Makes the workspace fit a size x 1 problem (no-op for fixed size workspaces).
+		*/
+		void resize(size_t size) {
+			SPSA2Workspace<R, Dim>::resize(size);
+			spsa_vector<R, Dim>::resize(moment1, size);
+			spsa_vector<R, Dim>::resize(moment2, size);
+		}
+	};
+
+	namespace detail {
+
+		/** Adam iterations working in place on a workspace (ws.theta is the initial hint and the result).
+		* lossGrad gives the cost and its gradient in one call, loss gives the final cost.
+		* @see Adam
+		*/
+		template<class R, size_t Dim, class L, class G>
+		R adam_loop(L loss, G lossGrad, GradientWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha,
+			R beta1, R beta2, void *params, const SPSAStop<R> &stop, SPSAInfo *info) {
+
+			size_t size = ws.theta.size();
+			const R eps = (R)1e-8;
+
+			R windowSum = 0;
+			R lastMean = 0;
+			bool hasLastMean = false;
+
+			if (!ws.resume) {
+				for (size_t i = 0; i < size; i++) {
+					ws.moment1(i, 0) = 0;
+					ws.moment2(i, 0) = 0;
+				}
+				ws.moment_k = 0;
+			}
+
+			size_t clipped = 0;
+			size_t k = 1;
+			for (; k <= max_iter; k++) {
+
+				R ak = a / std::pow(ws.k0 + k + A, alpha);
+
+				R y = lossGrad(ws.theta, params, ws.grad);
+
+				// bias corrected moments
+				ws.moment_k++;
+				R beta1k = std::pow(beta1, (R)ws.moment_k);
+				R beta2k = std::pow(beta2, (R)ws.moment_k);
+
+				R stepNorm_sq = 0;
+				for (size_t i = 0; i < size; i++) {
+					R g = ws.grad(i, 0);
+					ws.moment1(i, 0) = beta1 * ws.moment1(i, 0) + (1 - beta1) * g;
+					ws.moment2(i, 0) = beta2 * ws.moment2(i, 0) + (1 - beta2) * g * g;
+
+					R step = (ws.moment1(i, 0) / (1 - beta1k)) / (std::sqrt(ws.moment2(i, 0) / (1 - beta2k)) + eps);
+					ws.step(i, 0) = step;
+					stepNorm_sq += step * step;
+				}
+
+				R stepNorm = std::sqrt(stepNorm_sq);
+
+				R normalization = 1;
+
+				if (stepNorm > max_delta) {
+					normalization = max_delta / stepNorm;
+					clipped++;
+				}
+
+				for (size_t i = 0; i < size; i++) {
+					ws.theta(i, 0) += -ak * ws.step(i, 0) * normalization;
+				}
+
+				RG_TRACE(
+					if (ws.trace.buffer != nullptr) {
+						trace_iteration(ws.trace, 2, k, ak, (R)0, y, (R)0, stepNorm, normalization, ws.theta, size);
+					}
+				)
+
+				if (stop.expired()) {
+					break;
+				}
+
+				bool checked = k >= stop.min_iter;
+
+				if (checked && ak * stepNorm * normalization < stop.step_tol) {
+					break;
+				}
+
+				if (stop.window > 0) {
+					windowSum += y;
+					if (k % stop.window == 0) {
+						R mean = windowSum / (R)stop.window;
+						if (checked && hasLastMean && std::abs(mean - lastMean) <= stop.plateau_tol * std::abs(lastMean)) {
+							break;
+						}
+						lastMean = mean;
+						hasLastMean = true;
+						windowSum = 0;
+					}
+				}
+			}
+
+			if (info != nullptr) {
+				info->iterations = std::min(k, max_iter);
+				info->evaluations = info->iterations + 1;
+				info->clipped = clipped;
+			}
+
+			return loss(std::move(ws.theta), params);
+		}
+	}
+
+	/** Deterministic first order solver (Adam) for losses with an analytic gradient.
+	* Each iteration evaluates the cost and its exact gradient once (instead of the two noisy SPSA evaluations) and moves
+	* along the bias corrected Adam direction. As in SPSA the gains decay as a / (k + A)^alpha and the step, before the
+	* gain, is clipped to max_delta, so the same parameters fit both the solvers.
+	* @param loss function pointer to a loss function used for the final cost (@see SPSA).
+	* @param lossGrad function pointer to a loss function with gradient:
+	*	- return: R (the cost)
+	*	- args: theta (SPSAWorkspace<R, Dim>::vector_type)
+	*	- args: pointer to other data useful
+	*	- args: output gradient (same type of theta).
+	* @param ws workspace, already sized to the problem (@see GradientWorkspace::resize).
+	* @param max_iter number of iterations.
+	* @param max_delta maximal step admitted (before the gain ak).
+	* @param a initial step size (use: 0.4).
+	* @param A stability factor (use: 1).
+	* @param alpha step size decay rate (use: 0.602).
+	* @param beta1 decay rate of the gradient average (use: 0.9).
+	* @param beta2 decay rate of the squared gradient average (use: 0.999).
+	* @param params a pointer to other parameters used from the loss function.
+	* @param stop stopping rules (by default exactly max_iter iterations are run).
+	* @param info optional pointer where to store the number of iterations and cost evaluations actually used (a cost and
+	*	gradient evaluation counts as one).
+	* @see D. P. Kingma, J. Ba, "Adam: a method for stochastic optimization", ICLR, 2015.
+	* @see costfncV2_grad
+	*/
+	template<class R, size_t Dim>
+	R Adam(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *),
+		R (*lossGrad)(const typename SPSAWorkspace<R, Dim>::vector_type &, void *, typename SPSAWorkspace<R, Dim>::vector_type &),
+		GradientWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R beta1, R beta2, void *params,
+		const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		return detail::adam_loop(loss, lossGrad, ws, max_iter, max_delta, a, A, alpha, beta1, beta2, params, stop, info);
+	}
+
+	/** Deterministic first order solver (Adam) with a loss functor known at compile time (@see the SPSA functor overload).
+	* @param loss callable object: loss(theta) gives the cost in theta, loss.grad(theta, grad) the cost and its gradient.
+	* @see Adam
+	*/
+	template<class R, size_t Dim, class F>
+	R Adam(F &&loss, GradientWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R beta1, R beta2,
+		const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		using L = typename std::remove_reference<F>::type;
+		return detail::adam_loop(detail::functor_loss<R, L>{ loss }, detail::functor_grad<R, L>{ loss }, ws, max_iter, max_delta, a, A, alpha,
+								 beta1, beta2, nullptr, stop, info);
+	}
+}
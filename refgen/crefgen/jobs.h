@@ -0,0 +1,57 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstddef>
+
+#include "refgen.h"
+#include "threadpool.h"
+
+
+namespace rg {
+
+	/** A reference computation to run on a thread pool: the arguments of Refgen::computeRef and its results.
+	*/
+	template<typename R, size_t Dim = 0>
+	struct RefgenJob {
+		Refgen<R, Dim> *refgen;	/**< reference generator (at most one job for each of them in a call). */
+		R *data;				/**< data memory (@see Refgen::computeRef). */
+		size_t spaceSize;		/**< space dimension. */
+		size_t length;			/**< number of columns of the data memory. */
+		R *ref;					/**< memory of size spaceSize in which store the new reference. */
+		R cost;					/**< output: cost of the new reference. */
+		SPSAInfo info;			/**< output: iterations and cost evaluations used. */
+	};
+
+	/** Runs a set of independent reference computations (e.g. one tick of many agents) on a thread pool.
+	* Jobs are taken one at a time and idle threads steal them from the busy ones, so agents with many
+	* neighbors do not leave the other cores waiting.
+	* @param pool thread pool running the jobs.
+	* @param jobs pointer to count jobs: cost and info of each one are filled.
+	* @param count number of jobs.
+	* @return the sum of the costs of the jobs.
+	* @see ThreadPool
+	*/
+	template<typename R, size_t Dim>
+	R computeRefJobs(ThreadPool &pool, RefgenJob<R, Dim> RG_INOUT *jobs, size_t count) {
+
+		pool.parallelFor(count, 1, [jobs](size_t k) {
+			RefgenJob<R, Dim> &job = jobs[k];
+			job.cost = job.refgen->computeRef(job.data, job.spaceSize, job.length, job.ref, &job.info);
+		});
+
+		R total = 0;
+		for (size_t k = 0; k < count; k++) {
+			total += jobs[k].cost;
+		}
+
+		return total;
+	}
+}
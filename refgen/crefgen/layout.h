@@ -0,0 +1,76 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstddef>
+
+
+namespace rg {
+
+	/** Memory layouts of a block of points (values match the RG_LAYOUT_* C constants).
+	*/
+	enum LayoutType {
+		LAYOUT_ROW_MAJOR = 0,	/**< one row for each axis: the component i of the column j is data[i * stride + j] (all the x, then all the y, ...). */
+		LAYOUT_INTERLEAVED = 1,	/**< one record for each point (column major): the component i of the column j is data[j * stride + i] ({x, y, z}, {x, y, z}, ...). */
+		LAYOUT_AXES = 2			/**< a separate array for each axis: the component i of the column j is axes[i][j]. */
+	};
+
+	/** Description of a block of points read in place, whatever its layout: the computations run on it directly instead
+	* of on a row major copy (@see Refgen::computeRef and Refgen::computeRefView).
+	*/
+	template<typename R>
+	struct DataLayout {
+		LayoutType type;
+		const R *data;				/**< first value (row major and interleaved layouts). */
+		const R * const *axes;		/**< one pointer for each axis (axes layout). */
+		size_t stride;				/**< distance between the rows (row major) or between the records (interleaved). */
+		size_t first;				/**< index of the column 0 of the block. */
+
+		/** Row major block: the component i of the column j is data[i * stride + j].
+		*/
+		static DataLayout rowMajor(const R *data, size_t stride) {
+			return DataLayout{ LAYOUT_ROW_MAJOR, data, nullptr, stride, 0 };
+		}
+
+		/** Interleaved (column major) block: the component i of the column j is data[j * stride + i], stride being at least the space dimension.
+		*/
+		static DataLayout interleaved(const R *data, size_t stride) {
+			return DataLayout{ LAYOUT_INTERLEAVED, data, nullptr, stride, 0 };
+		}
+
+		/** A separate array for each axis: the component i of the column j is axes[i][j] (the array of pointers is not copied).
+		*/
+		static DataLayout perAxis(const R * const *axes) {
+			return DataLayout{ LAYOUT_AXES, nullptr, axes, 0, 0 };
+		}
+
+		/** The same block without its first columns.
+		*/
+		DataLayout columns(size_t from) const {
+			DataLayout block = *this;
+			block.first += from;
+			return block;
+		}
+
+		/** Component i of the column j.
+		*/
+		R at(size_t i, size_t j) const {
+			j += first;
+			switch (type) {
+			case LAYOUT_INTERLEAVED:
+				return data[j * stride + i];
+			case LAYOUT_AXES:
+				return axes[i][j];
+			default:
+				return data[i * stride + j];
+			}
+		}
+	};
+}
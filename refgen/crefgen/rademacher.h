@@ -0,0 +1,118 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstdint>
+#include <cmath>
+#include <type_traits>
+
+
+namespace rg {
+
+	/** Counter based generator of Rademacher (+1/-1 with equal probability) vectors.
+	* The k-th 64 bit word of the stream is a pure function of (seed, k) (splitmix64), so the generator is cheap to
+	* seed, it has no shared state and two instances with the same seed produce the same perturbations whatever
+	* thread runs them. A whole vector of up to 64 components costs a single word.
+	*/
+	class RademacherGen {
+
+	private:
+		uint64_t _seed;
+		uint64_t _counter;
+
+	public:
+
+		/** Generator constructor.
+		* @param seed stream seed.
+		*/
+		RademacherGen(uint64_t seed = 0) : _seed(seed), _counter(0) {
+		}
+
+		/** Restarts the stream with a new seed.
+		*/
+		void seed(uint64_t seed) {
+			_seed = seed;
+			_counter = 0;
+		}
+
+		/** Seed of the stream.
+		*/
+		uint64_t seed() const {
+			return _seed;
+		}
+
+		/** Number of words drawn so far (position in the stream).
+		*/
+		uint64_t counter() const {
+			return _counter;
+		}
+
+		/** Moves to an arbitrary position of the stream.
+		*/
+		void counter(uint64_t counter) {
+			_counter = counter;
+		}
+
+		/** splitmix64 finalizer: a bijective 64 bit mixing function.
+		*/
+		static uint64_t mix(uint64_t z) {
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			return z ^ (z >> 31);
+		}
+
+		/** Word at a given position of the stream of a given seed.
+		*/
+		static uint64_t word(uint64_t seed, uint64_t counter) {
+			return mix(seed + (counter + 1) * 0x9e3779b97f4a7c15ULL);
+		}
+
+		/** Next 64 random bits of the stream.
+		*/
+		uint64_t next() {
+			return word(_seed, _counter++);
+		}
+
+		/** Next word of the stream mapped to a uniform value in [-1, 1).
+		*/
+		template<class T>
+		T uniform() {
+			return (T)((double)(next() >> 11) * (1.0 / 4503599627370496.0) - 1.0);
+		}
+
+		/** Next word of the stream mapped to a standard normal value (Box-Muller on the two 32 bit halves).
+		*/
+		template<class T>
+		T normal() {
+			uint64_t bits = next();
+			double u1 = (double)((bits >> 32) + 1) * (1.0 / 4294967296.0);
+			double u2 = (double)(bits & 0xffffffffULL) * (1.0 / 4294967296.0);
+			return (T)(std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2));
+		}
+
+		/** Fills the first size components of a column vector (accessed as delta(i, 0)) with random signs.
+		* @param delta an xtensor container or any object with operator()(i, 0).
+		* @param size number of components to draw.
+		*/
+		template<class V>
+		void fill(V & RG_OUT delta, size_t size) {
+			using value_type = typename std::decay<decltype(delta(0, 0))>::type;
+
+			uint64_t bits = 0;
+			for (size_t i = 0; i < size; i++) {
+				if (i % 64 == 0) {
+					bits = next();
+				}
+				delta(i, 0) = (bits & 1) ? value_type(1) : value_type(-1);
+				bits >>= 1;
+			}
+		}
+	};
+}
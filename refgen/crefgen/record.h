@@ -0,0 +1,490 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+#include "c_api_comm.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace rg {
+
+	/** Record log: the inputs and outputs of the computeRef calls of one or more reference generators, written by a
+	* RefgenRecorder and read back in place (memory mapped) by a RecordLog, e.g. to replay the calls of a flight offline
+	* (@see replayLog). The file is a RecordFileHeader followed by records, each made of a RecordHeader and a payload:
+	*	- RECORD_PARAMS: RecordParams, written before the first call of a generator and after each change of its settings;
+	*	- RECORD_CALL: RecordCall, then data (spaceSize x length), ref (spaceSize) and, with RECORD_WARM_VALID, the warm
+	*	  start memory (previous reference and target, spaceSize each), all of the precision given by real_size.
+	* Every field is 8 bytes aligned and each record is padded to a multiple of 8 bytes (native byte order), so that the
+	* arrays can be used directly from the mapped file. A call record holds all the state the call started from
+	* (multipliers, perturbation stream position, warm start memory): any call can be replayed on its own.
+	*/
+	struct RecordFileHeader {
+		char magic[8];			/**< "RGRECRD" and a terminating 0. */
+		uint32_t version;		/**< format version (2). */
+		uint32_t header_size;	/**< sizeof(RecordHeader). */
+		uint32_t params_size;	/**< sizeof(RecordParams). */
+		uint32_t call_size;		/**< sizeof(RecordCall). */
+		uint64_t reserved;		/**< 0. */
+	};
+
+	/** Header of a record.
+	*/
+	struct RecordHeader {
+		uint32_t kind;			/**< RECORD_PARAMS or RECORD_CALL. */
+		uint32_t size;			/**< bytes of the record, header and padding included. */
+		uint64_t seq;			/**< position of the record in the log. */
+		uint32_t source;		/**< generator that wrote the record (@see Refgen::setRecorder). */
+		uint16_t real_size;		/**< sizeof(R) of the generator: 4 (float) or 8 (double). */
+		uint16_t dim;			/**< RECORD_CALL: space dimension (spaceSize). */
+		uint32_t length;		/**< RECORD_CALL: columns of the data (length). */
+		uint32_t flags;			/**< RECORD_CALL: RECORD_WARM_VALID, RECORD_DEADLINE. */
+	};
+
+	enum {
+		RECORD_PARAMS = 1,
+		RECORD_CALL = 2
+	};
+
+	enum {
+		RECORD_WARM_VALID = 1,	/**< the warm start memory follows the reference. */
+		RECORD_DEADLINE = 2		/**< a stopping deadline was set: the result depends on the timing, a replay may differ. */
+	};
+
+	/** Settings of a reference generator (all the reals as double: a float survives the round trip).
+	*/
+	struct RecordParams {
+		double alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var;
+		double max_delta, a, A, alpha, c, gamma, hess_min;
+		double sigma, sigma_min, smoothing;
+		double warm_reset, chain_spread;
+		double step_tol, plateau_tol;
+		uint64_t max_iter;
+		uint64_t warm_iter, warm_k0;
+		uint64_t chains, chain_iter;
+		uint64_t population, elites;
+		uint64_t window, min_iter;
+		uint32_t solver;		/**< SolverType. */
+		uint32_t warm;			/**< 1: warm start mode enabled. */
+	};
+
+	/** State a call started from and its results.
+	*/
+	struct RecordCall {
+		double ni1, ni2;		/**< multipliers before the call. */
+		uint64_t seed;			/**< perturbation stream seed. */
+		uint64_t counter;		/**< perturbation stream position before the call. */
+		double cost;			/**< returned cost. */
+		uint32_t iterations;	/**< solver iterations (SPSAInfo). */
+		uint32_t evaluations;	/**< loss evaluations (SPSAInfo). */
+	};
+
+	static_assert(sizeof(RecordFileHeader) == 32 && sizeof(RecordHeader) == 32 && sizeof(RecordParams) % 8 == 0 &&
+				  sizeof(RecordCall) % 8 == 0, "record log: the headers must keep the payloads 8 bytes aligned");
+
+	/** Appends the calls of reference generators to a record log (@see RecordFileHeader). Recording is opt-in
+	* (@see Refgen::setRecorder) and any number of generators, even on different threads, may share a recorder: each
+	* record is written under a lock, through the buffered stdio file.
+	*/
+	class RefgenRecorder {
+
+	private:
+		std::FILE *_file;
+		mutable std::mutex _mutex;
+		uint64_t _records;
+		bool _good;
+
+		// writes a part of a record, remembering any failure
+		void put(const void *bytes, size_t size) {
+			if (size > 0 && std::fwrite(bytes, 1, size, _file) != size) {
+				_good = false;
+			}
+		}
+
+		void pad(size_t size) {
+			static const char zeros[8] = { 0 };
+			put(zeros, (8 - size % 8) % 8);
+		}
+
+	public:
+
+		/** Recorder constructor: nothing is written until open.
+		*/
+		RefgenRecorder() : _file(nullptr), _records(0), _good(false) {
+		}
+
+		/** Recorder constructor: opens a log (@see open and good).
+		*/
+		explicit RefgenRecorder(const char *path) : RefgenRecorder() {
+			open(path);
+		}
+
+		RefgenRecorder(const RefgenRecorder &) = delete;
+		RefgenRecorder & operator=(const RefgenRecorder &) = delete;
+
+		~RefgenRecorder() {
+			close();
+		}
+
+		/** (Over)writes a log file and its header. No generator may be recording.
+		* @return false if the file cannot be written.
+		*/
+		bool open(const char *path) {
+			close();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_file = std::fopen(path, "wb");
+			_records = 0;
+			_good = _file != nullptr;
+			if (_good) {
+				RecordFileHeader header;
+				std::memset(&header, 0, sizeof(header));
+				std::memcpy(header.magic, "RGRECRD", 8);
+				header.version = 2;
+				header.header_size = (uint32_t)sizeof(RecordHeader);
+				header.params_size = (uint32_t)sizeof(RecordParams);
+				header.call_size = (uint32_t)sizeof(RecordCall);
+				put(&header, sizeof(header));
+			}
+			return _good;
+		}
+
+		/** Closes the log. No generator may be recording.
+		* @return false if any write failed.
+		*/
+		bool close() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_file != nullptr) {
+				_good = std::fclose(_file) == 0 && _good;
+				_file = nullptr;
+			}
+			return _good;
+		}
+
+		/** Writes the buffered records to the file (e.g. before a crash prone section).
+		*/
+		void flush() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_file != nullptr && std::fflush(_file) != 0) {
+				_good = false;
+			}
+		}
+
+		/** True if the log is open and every write succeeded so far.
+		*/
+		bool good() const {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _good && _file != nullptr;
+		}
+
+		/** Number of records written.
+		*/
+		uint64_t records() const {
+			std::lock_guard<std::mutex> lock(_mutex);
+			return _records;
+		}
+
+		/** Writes the settings of a generator.
+		*/
+		template<typename R>
+		void writeParams(uint32_t source, const RecordParams &params) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_file == nullptr) {
+				return;
+			}
+
+			RecordHeader header;
+			std::memset(&header, 0, sizeof(header));
+			header.kind = RECORD_PARAMS;
+			header.size = (uint32_t)(sizeof(RecordHeader) + sizeof(RecordParams));
+			header.seq = _records++;
+			header.source = source;
+			header.real_size = (uint16_t)sizeof(R);
+
+			put(&header, sizeof(header));
+			put(&params, sizeof(params));
+		}
+
+		/** Writes a call.
+		* @param last_ref previous reference (warm start memory), nullptr if not valid.
+		* @param last_target previous target (warm start memory), nullptr if not valid.
+		*/
+		template<typename R>
+		void writeCall(uint32_t source, const RecordCall &call, uint32_t flags, const R *data, size_t spaceSize, size_t length, const R *ref,
+			const R *last_ref, const R *last_target) {
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_file == nullptr) {
+				return;
+			}
+
+			bool warm = last_ref != nullptr && last_target != nullptr;
+			size_t arrays = sizeof(R) * spaceSize * (length + 1 + (warm ? 2 : 0));
+
+			RecordHeader header;
+			std::memset(&header, 0, sizeof(header));
+			header.kind = RECORD_CALL;
+			header.size = (uint32_t)(sizeof(RecordHeader) + sizeof(RecordCall) + arrays + (8 - arrays % 8) % 8);
+			header.seq = _records++;
+			header.source = source;
+			header.real_size = (uint16_t)sizeof(R);
+			header.dim = (uint16_t)spaceSize;
+			header.length = (uint32_t)length;
+			header.flags = (flags & ~(uint32_t)RECORD_WARM_VALID) | (warm ? RECORD_WARM_VALID : 0);
+
+			put(&header, sizeof(header));
+			put(&call, sizeof(call));
+			put(data, sizeof(R) * spaceSize * length);
+			put(ref, sizeof(R) * spaceSize);
+			if (warm) {
+				put(last_ref, sizeof(R) * spaceSize);
+				put(last_target, sizeof(R) * spaceSize);
+			}
+			pad(arrays);
+		}
+	};
+
+	/** A record of a log, pointing into the mapped file (valid while the log is open). The raw_xarray members map the
+	* arrays of a call in place (@see xtc::xarray_map_raw) and point to the shapes of the entry: do not copy entries.
+	*/
+	struct RecordEntry {
+		const RecordHeader *header;
+		const RecordParams *params;		/**< RECORD_PARAMS: settings, nullptr otherwise. */
+		const RecordCall *call;			/**< RECORD_CALL: state and results, nullptr otherwise. */
+		raw_xarray data;				/**< RECORD_CALL: inputs (spaceSize x length). */
+		raw_xarray ref;					/**< RECORD_CALL: recorded reference (spaceSize x 1). */
+		const char *last_ref;			/**< RECORD_CALL with RECORD_WARM_VALID: previous reference, nullptr otherwise. */
+		const char *last_target;		/**< RECORD_CALL with RECORD_WARM_VALID: previous target, nullptr otherwise. */
+		size_t dataShape[2];
+		size_t refShape[2];
+
+		RecordEntry() : header(nullptr), params(nullptr), call(nullptr), last_ref(nullptr), last_target(nullptr) {
+			data.rank = 2;
+			ref.rank = 2;
+		}
+
+		RecordEntry(const RecordEntry &) = delete;
+		RecordEntry & operator=(const RecordEntry &) = delete;
+	};
+
+	/** Memory mapped record log, read sequentially without copies. The mapping is private (copy on write): the inputs of
+	* the calls can be passed to computeRef as they are.
+	*/
+	class RecordLog {
+
+	private:
+		char *_base;
+		size_t _size;
+		size_t _pos;
+		bool _truncated;
+#ifdef _WIN32
+		HANDLE _file, _mapping;
+#else
+		int _fd;
+#endif
+
+	public:
+
+		/** Empty log constructor.
+		*/
+		RecordLog() : _base(nullptr), _size(0), _pos(0), _truncated(false) {
+#ifdef _WIN32
+			_file = INVALID_HANDLE_VALUE;
+			_mapping = nullptr;
+#else
+			_fd = -1;
+#endif
+		}
+
+		/** Log constructor: maps a file (@see open and isOpen).
+		*/
+		explicit RecordLog(const char *path) : RecordLog() {
+			open(path);
+		}
+
+		RecordLog(const RecordLog &) = delete;
+		RecordLog & operator=(const RecordLog &) = delete;
+
+		~RecordLog() {
+			close();
+		}
+
+		/** Maps a log file and checks its header.
+		* @return false if the file cannot be mapped or it is not a log of this version.
+		*/
+		bool open(const char *path) {
+			close();
+
+#ifdef _WIN32
+			_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER size;
+			if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || size.QuadPart < (LONGLONG)sizeof(RecordFileHeader)) {
+				close();
+				return false;
+			}
+			_mapping = CreateFileMappingA(_file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			_base = _mapping != nullptr ? (char *)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+			_size = (size_t)size.QuadPart;
+#else
+			_fd = ::open(path, O_RDONLY);
+			struct stat st;
+			if (_fd < 0 || fstat(_fd, &st) != 0 || st.st_size < (off_t)sizeof(RecordFileHeader)) {
+				close();
+				return false;
+			}
+			void *base = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+			_base = base != MAP_FAILED ? (char *)base : nullptr;
+			_size = (size_t)st.st_size;
+#endif
+			if (_base == nullptr) {
+				close();
+				return false;
+			}
+
+			const RecordFileHeader *header = (const RecordFileHeader *)_base;
+			if (std::memcmp(header->magic, "RGRECRD", 8) != 0 || header->version != 2 || header->header_size != sizeof(RecordHeader) ||
+				header->params_size != sizeof(RecordParams) || header->call_size != sizeof(RecordCall)) {
+				close();
+				return false;
+			}
+
+			rewind();
+			return true;
+		}
+
+		/** Unmaps the log.
+		*/
+		void close() {
+#ifdef _WIN32
+			if (_base != nullptr) {
+				UnmapViewOfFile(_base);
+			}
+			if (_mapping != nullptr) {
+				CloseHandle(_mapping);
+			}
+			if (_file != INVALID_HANDLE_VALUE) {
+				CloseHandle(_file);
+			}
+			_file = INVALID_HANDLE_VALUE;
+			_mapping = nullptr;
+#else
+			if (_base != nullptr) {
+				munmap(_base, _size);
+			}
+			if (_fd >= 0) {
+				::close(_fd);
+			}
+			_fd = -1;
+#endif
+			_base = nullptr;
+			_size = 0;
+			_pos = 0;
+			_truncated = false;
+		}
+
+		/** True if a log is mapped.
+		*/
+		bool isOpen() const {
+			return _base != nullptr;
+		}
+
+		/** Size of the mapped file in bytes.
+		*/
+		size_t bytes() const {
+			return _size;
+		}
+
+		/** True if the last next found an incomplete record (e.g. the recording process died while writing it).
+		*/
+		bool truncated() const {
+			return _truncated;
+		}
+
+		/** Goes back to the first record.
+		*/
+		void rewind() {
+			_pos = sizeof(RecordFileHeader);
+			_truncated = false;
+		}
+
+		/** Reads the next record.
+		* @param entry filled with the pointers into the mapped file.
+		* @return false at the end of the log (or at an incomplete record, @see truncated).
+		*/
+		bool next(RecordEntry &entry) {
+
+			if (_base == nullptr || _pos + sizeof(RecordHeader) > _size) {
+				_truncated = _base != nullptr && _pos != _size;
+				return false;
+			}
+
+			const RecordHeader *header = (const RecordHeader *)(_base + _pos);
+			size_t payload = header->kind == RECORD_PARAMS ? sizeof(RecordParams) : sizeof(RecordCall);
+			size_t arrays = header->kind == RECORD_CALL ?
+				(size_t)header->real_size * header->dim * (header->length + 1 + ((header->flags & RECORD_WARM_VALID) ? 2 : 0)) : 0;
+			if (header->size < sizeof(RecordHeader) + payload + arrays || header->size % 8 != 0 || _pos + header->size > _size) {
+				_truncated = true;
+				return false;
+			}
+
+			char *body = _base + _pos + sizeof(RecordHeader);
+			entry.header = header;
+			entry.params = nullptr;
+			entry.call = nullptr;
+			entry.data.data = nullptr;
+			entry.ref.data = nullptr;
+			entry.last_ref = nullptr;
+			entry.last_target = nullptr;
+
+			if (header->kind == RECORD_PARAMS) {
+				entry.params = (const RecordParams *)body;
+			}
+			else if (header->kind == RECORD_CALL) {
+				entry.call = (const RecordCall *)body;
+
+				char *arraysStart = body + sizeof(RecordCall);
+				size_t dataBytes = (size_t)header->real_size * header->dim * header->length;
+				size_t refBytes = (size_t)header->real_size * header->dim;
+
+				entry.dataShape[0] = header->dim;
+				entry.dataShape[1] = header->length;
+				entry.data.data = arraysStart;
+				entry.data.shape = entry.dataShape;
+
+				entry.refShape[0] = header->dim;
+				entry.refShape[1] = 1;
+				entry.ref.data = arraysStart + dataBytes;
+				entry.ref.shape = entry.refShape;
+
+				if (header->flags & RECORD_WARM_VALID) {
+					entry.last_ref = arraysStart + dataBytes + refBytes;
+					entry.last_target = arraysStart + dataBytes + 2 * refBytes;
+				}
+			}
+
+			_pos += header->size;
+			return true;
+		}
+	};
+}
@@ -15,29 +15,166 @@
 #include <xtensor/xmath.hpp>
 #include <xtensor/xnoalias.hpp>
 #include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <memory>
 
 #include "spsa.h"
+#include "spsa2.h"
+#include "gradient.h"
+#include "cem.h"
+#include "rademacher.h"
 #include "costfnc.h"
+#include "threadpool.h"
+#include "stats.h"
+#include "record.h"
 
 
 /** @brief Reference generator namespace.
 */
 namespace rg {
 
+	namespace detail {
+
+		/** Solver workspaces owned by a reference generator with compile time dimension Dim (the CEM ones extend all the others and serve all the solvers).
+		*/
+		template<typename R, size_t Dim>
+		struct refgen_workspace {
+			CEMWorkspace<R, Dim> fixed;
+			std::vector<CEMWorkspace<R, Dim>> fixedChains;
+
+			CEMWorkspace<R, Dim> & get(std::integral_constant<size_t, Dim>) {
+				return fixed;
+			}
+
+			std::vector<CEMWorkspace<R, Dim>> & chains(std::integral_constant<size_t, Dim>) {
+				return fixedChains;
+			}
+		};
+
+		/** Solver workspaces owned by a reference generator with runtime dimension: one for each solver it may dispatch to.
+		*/
+		template<typename R>
+		struct refgen_workspace<R, 0> {
+			CEMWorkspace<R, 0> dynamic;
+			CEMWorkspace<R, 2> planar;
+			CEMWorkspace<R, 3> spatial;
+			std::vector<CEMWorkspace<R, 0>> dynamicChains;
+			std::vector<CEMWorkspace<R, 2>> planarChains;
+			std::vector<CEMWorkspace<R, 3>> spatialChains;
+
+			CEMWorkspace<R, 0> & get(std::integral_constant<size_t, 0>) {
+				return dynamic;
+			}
+
+			CEMWorkspace<R, 2> & get(std::integral_constant<size_t, 2>) {
+				return planar;
+			}
+
+			CEMWorkspace<R, 3> & get(std::integral_constant<size_t, 3>) {
+				return spatial;
+			}
+
+			std::vector<CEMWorkspace<R, 0>> & chains(std::integral_constant<size_t, 0>) {
+				return dynamicChains;
+			}
+
+			std::vector<CEMWorkspace<R, 2>> & chains(std::integral_constant<size_t, 2>) {
+				return planarChains;
+			}
+
+			std::vector<CEMWorkspace<R, 3>> & chains(std::integral_constant<size_t, 3>) {
+				return spatialChains;
+			}
+		};
+	}
+
+	/** Solvers available to the reference generators (values match the RG_SOLVER_* C constants).
+	*/
+	enum SolverType {
+		SOLVER_SPSA = 0,	/**< first order SPSA (2 cost evaluations for each iteration). */
+		SOLVER_2SPSA = 1,	/**< adaptive second order SPSA (4 cost evaluations for each iteration, Hessian preconditioned steps: use a = 1 or less). */
+		SOLVER_GRADIENT = 2,	/**< deterministic Adam steps on the analytic gradient of the cost (1 cost and gradient evaluation for each iteration). */
+		SOLVER_CEM = 3		/**< cross-entropy method: max_iter rounds of a sampled population, scored with one batched cost call for each round (@see Refgen::setPopulation). */
+	};
+
 	/** Reference Generator system.
 	* It stores data and multipliers and it offers a method used to dynamically compute intermedial reference to
 	* reach the target domain while avoiding collisions with others.
+	* The space dimension may be fixed at compile time through Dim (e.g. Refgen<float, 2>), otherwise (Dim = 0) it is
+	* taken at each call and the planar and 3D cases are dispatched to the fixed size solver anyway.
+	* The cost minimized is given by the Cost policy (@see CostV2): the solvers call it directly, so a custom policy
+	* (e.g. with additional cost terms) costs no indirect call.
 	*/
-	template<typename R>
+	template<typename R, size_t Dim = 0, class Cost = CostV2<R>>
 	class Refgen {
 
 	private:
 		costParamV2<R> params;
+		Cost _cost;
 		R _alpha_rate1, _alpha_rate2;
 		R _max_var;
 		R _max_ni;
 		size_t _max_iter;
 		R _max_delta, _a, _A, _alpha, _c, _gamma;
+		RademacherGen _perturbation; // own generator: different instances can run on different threads
+		SPSAStop<R> _stop;
+		SolverType _solver;
+		R _hess_min;
+
+		// cross-entropy solver: population, elites and sampling distribution
+		size_t _population, _elites;
+		R _sigma, _sigma_min, _smoothing;
+
+		// warm start: settings and state carried between consecutive calls
+		bool _warm;
+		size_t _warm_iter, _warm_k0;
+		R _warm_reset;
+		bool _warm_valid;
+		std::vector<R> _last_ref, _last_target;
+
+		// multi-start: settings and per chain results
+		size_t _chains, _chain_iter;
+		R _chain_spread;
+		std::shared_ptr<ThreadPool> _chain_pool;	// null: the chains run on the calling thread
+		std::vector<R> _chain_costs;
+		std::vector<SPSAInfo> _chain_info;
+
+		// resumable run: problem and best solution between begin and finish
+		bool _run_active;
+		R *_run_data;
+		size_t _run_spaceSize, _run_length;
+		size_t _run_k0, _run_done;
+		bool _run_converged;
+		R _run_best;
+		std::vector<R> _run_best_theta;
+		SPSAInfo _run_info;
+
+		detail::refgen_workspace<R, Dim> _workspace;
+		size_t _datashape[2];
+
+		// solver tracing: buffer (nullptr: disabled), id of the records and number of traced calls
+		TraceBuffer *_trace;
+		uint32_t _trace_source, _trace_calls;
+
+		// record log: recorder (nullptr: disabled), id of the records, settings not yet written and warm start memory at the call start
+		RefgenRecorder *_recorder;
+		uint32_t _record_source;
+		bool _record_params;
+		std::vector<R> _record_last_ref, _record_last_target;
+
+		// target and actual position (or the whole row major block, when recording) of the calls on other layouts
+		std::vector<R> _layout_block;
+
+#ifdef RG_ENABLE_STATS
+		// performance counters of the instance and of the call in progress
+		RefgenStats _stats, _call_stats;
+#endif
 	public:
 
 		/** Reference Generator object constructor.
@@ -57,9 +194,17 @@ namespace rg {
 		* @param alpha SPSA step size decay rate (use: 0.602).
 		* @param c SPSA initial perturbation coefficient (use: 0.1).
 		* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+		* @param seed seed of the SPSA perturbation generator: instances with the same seed and inputs give the same references.
+		* @param solver optimization algorithm (the SPSA parameters above are used by the SPSA and gradient solvers, max_iter by all of them).
 		*/
 		Refgen(R alpha_rate1, R r1, R alpha_rate2, R r2, R max_ni, R alpha_slow, R d_gauss, R min_alpha_gauss, R max_var, 
-			size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1) : params(){
+			size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1, uint64_t seed = 0,
+			SolverType solver = SOLVER_SPSA) :
+			params(), _perturbation(seed), _solver(solver), _hess_min((R)1e-3),
+			_population(32), _elites(8), _sigma((R)0.1), _sigma_min((R)1e-3), _smoothing((R)0.7),
+			_warm(false), _warm_iter(0), _warm_k0(0), _warm_reset(0), _warm_valid(false),
+			_chains(1), _chain_iter(0), _chain_spread(0), _run_active(false), _trace(nullptr), _trace_source(0), _trace_calls(0),
+			_recorder(nullptr), _record_source(0), _record_params(false) {
 			
 			_alpha_rate1 = alpha_rate1;
 			_alpha_rate2 = alpha_rate2;
@@ -82,13 +227,260 @@ namespace rg {
 			params.r2 = r2;
 			params.D_gauss = d_gauss;
 			params.min_alpha_gauss = min_alpha_gauss;
-			
+
+			checkSolver(solver);
 		}
 
 		/** Reference generator destructor.
 		*/
 		~Refgen() {};
 
+		/** Restarts the SPSA perturbation stream with a new seed.
+		*/
+		void setSeed(uint64_t seed) {
+			_perturbation.seed(seed);
+		}
+
+		/** Seed of the SPSA perturbation stream.
+		*/
+		uint64_t getSeed() const {
+			return _perturbation.seed();
+		}
+
+		/** Selects the optimization algorithm.
+		* @param solver the solver used by the next calls.
+		* @param hess_min 2SPSA only: minimum absolute eigenvalue of the Hessian estimate used as preconditioner.
+		*/
+		void setSolver(SolverType solver, R hess_min = (R)1e-3) {
+			checkSolver(solver);
+			_solver = solver;
+			_hess_min = hess_min;
+			_record_params = true;
+		}
+
+		/** Optimization algorithm in use.
+		*/
+		SolverType getSolver() const {
+			return _solver;
+		}
+
+		/** Cost policy instance used by the solvers (e.g. to set the state of a custom policy between calls).
+		*/
+		Cost & cost() {
+			return _cost;
+		}
+
+		const Cost & cost() const {
+			return _cost;
+		}
+
+		/** Sets the cross-entropy solver (SOLVER_CEM): each round samples population candidates around the current
+		* solution, scores them with one batched cost call and refits the sampling distribution on the elites best ones.
+		* With this solver max_iter (and the warm start and multi-start iterations) counts the rounds.
+		* @param population candidates of each round (at least 2, multiples of CostV2::batch_block use the SIMD lanes best).
+		* @param elites best candidates fitting the distribution of the next round (1..population).
+		* @param sigma initial standard deviation of the candidates along each axis.
+		* @param sigma_min lower bound of the standard deviations.
+		* @param smoothing weight of the elites in each update of the distribution (0..1].
+		* @see CEM
+		*/
+		void setPopulation(size_t population, size_t elites, R sigma, R sigma_min, R smoothing) {
+			if (population < 2 || elites < 1 || elites > population) {
+				THROW_EXCPT("Refgen: the population needs at least 2 candidates and 1..population elites");
+			}
+			if (!(smoothing > 0 && smoothing <= 1)) {
+				THROW_EXCPT("Refgen: the smoothing of the cross-entropy solver must be in (0, 1]");
+			}
+			_population = population;
+			_elites = elites;
+			_sigma = sigma;
+			_sigma_min = sigma_min;
+			_smoothing = smoothing;
+			_record_params = true;
+		}
+
+		/** Candidates of each round of the cross-entropy solver.
+		*/
+		size_t getPopulation() const {
+			return _population;
+		}
+
+		/** Sets the SPSA stopping rules: with a converged solution (e.g. an agent holding its position on the target ring)
+		* a reference computation may end well before max_iter iterations.
+		* @param stop stopping rules (the default ones run exactly max_iter iterations).
+		* @see SPSAStop
+		*/
+		void setStop(const SPSAStop<R> &stop) {
+			_stop = stop;
+			_record_params = true;
+		}
+
+		/** SPSA stopping rules.
+		*/
+		const SPSAStop<R> & getStop() const {
+			return _stop;
+		}
+
+		/** Enables or disables the warm start mode.
+		* In warm start mode SPSA starts from the previous reference instead of the actual position and it runs only
+		* iterations iterations, with the gain sequence resumed at gain_offset (gain_offset = max_iter: the gains go on from
+		* where a full run ends, smaller values partially reset them). A full run from the actual position is done on the
+		* first call, when the space dimension changes and when the target moves more than reset_dist from the previous call.
+		* @param enable true to enable the warm start mode.
+		* @param iterations SPSA iterations of a warm started call.
+		* @param gain_offset gain sequence offset of a warm started call (@see SPSAWorkspace::k0).
+		* @param reset_dist target jump that triggers a full run.
+		*/
+		void setWarmStart(bool enable, size_t iterations, size_t gain_offset, R reset_dist) {
+			_warm = enable;
+			_warm_iter = iterations;
+			_warm_k0 = gain_offset;
+			_warm_reset = reset_dist;
+			_warm_valid = false;
+			_record_params = true;
+		}
+
+		/** Forgets the previous reference: the next call does a full run from the actual position.
+		*/
+		void resetWarmStart() {
+			_warm_valid = false;
+		}
+
+		/** Sets the multi-start mode: each call runs chains independent SPSA chains and keeps the best solution.
+		* The first chain starts from the usual point (actual position or previous reference), the others from random
+		* points within spread from it along each axis, so that some of them may avoid the local minima created by the
+		* gaussian repulsion among close agents. Each chain has its own workspace and perturbation stream: the result
+		* does not depend on the number of threads. The reported iterations and evaluations are summed over the chains.
+		* @param chains number of chains (1: single chain, e.g. multi-start disabled).
+		* @param iterations SPSA iterations of each chain (0: the usual budget).
+		* @param spread maximum distance of the starting points of the chains along each axis.
+		* @param num_threads maximum number of threads running the chains (0: all hardware threads, use 1 inside a Fleet).
+		*	More than one thread starts a pool of workers kept by the instance (and shared by its copies).
+		*/
+		void setMultiStart(size_t chains, size_t iterations, R spread, size_t num_threads) {
+			_chains = std::max<size_t>(chains, 1);
+			_chain_iter = iterations;
+			_chain_spread = spread;
+			_chain_pool.reset();
+			_record_params = true;
+			if (_chains > 1 && num_threads != 1) {
+				_chain_pool = std::make_shared<ThreadPool>(num_threads == 0 ? std::min(hardwareThreads(), _chains) : std::min(num_threads, _chains));
+			}
+		}
+
+		/** Records the solver iterations of the next calls (computeRef and the resumable computations) in a trace buffer.
+		* Effective only when the library is built with RG_ENABLE_TRACE (@see traceEnabled): each record tells the call,
+		* the chain and the iteration, so one buffer can be shared by many generators (with different sources), even on different threads.
+		* @param trace buffer receiving the records, it has to outlive its use (nullptr: no tracing).
+		* @param source id written in the records of this generator (e.g. the agent index).
+		*/
+		void setTrace(TraceBuffer *trace, uint32_t source = 0) {
+			_trace = trace;
+			_trace_source = source;
+		}
+
+		/** Trace buffer in use (nullptr: no tracing).
+		*/
+		TraceBuffer * getTrace() const {
+			return _trace;
+		}
+
+		/** Appends the next computeRef calls (inputs, state they start from and results) to a record log, e.g. to replay
+		* a flight offline (@see replayLog). The settings are written before the first recorded call.
+		* @param recorder open recorder, it has to outlive its use (nullptr: no recording).
+		* @param source id written in the records of this generator (e.g. the agent index).
+		*/
+		void setRecorder(RefgenRecorder *recorder, uint32_t source = 0) {
+			_recorder = recorder;
+			_record_source = source;
+			_record_params = true;
+		}
+
+		/** Recorder in use (nullptr: no recording).
+		*/
+		RefgenRecorder * getRecorder() const {
+			return _recorder;
+		}
+
+		/** Settings of the generator as written in a record log.
+		*/
+		RecordParams recordParams() const {
+			RecordParams p;
+			std::memset(&p, 0, sizeof(p));
+			p.alpha_rate1 = (double)_alpha_rate1;
+			p.r1 = (double)params.r1;
+			p.alpha_rate2 = (double)_alpha_rate2;
+			p.r2 = (double)params.r2;
+			p.max_ni = (double)_max_ni;
+			p.alpha_slow = (double)params.alpha_slow;
+			p.d_gauss = (double)params.D_gauss;
+			p.min_alpha_gauss = (double)params.min_alpha_gauss;
+			p.max_var = (double)_max_var;
+			p.max_delta = (double)_max_delta;
+			p.a = (double)_a;
+			p.A = (double)_A;
+			p.alpha = (double)_alpha;
+			p.c = (double)_c;
+			p.gamma = (double)_gamma;
+			p.hess_min = (double)_hess_min;
+			p.sigma = (double)_sigma;
+			p.sigma_min = (double)_sigma_min;
+			p.smoothing = (double)_smoothing;
+			p.warm_reset = (double)_warm_reset;
+			p.chain_spread = (double)_chain_spread;
+			p.step_tol = (double)_stop.step_tol;
+			p.plateau_tol = (double)_stop.plateau_tol;
+			p.max_iter = _max_iter;
+			p.warm_iter = _warm_iter;
+			p.warm_k0 = _warm_k0;
+			p.chains = _chains;
+			p.chain_iter = _chain_iter;
+			p.population = _population;
+			p.elites = _elites;
+			p.window = _stop.window;
+			p.min_iter = _stop.min_iter;
+			p.solver = (uint32_t)_solver;
+			p.warm = _warm ? 1 : 0;
+			return p;
+		}
+
+		/** Restores the state a recorded call started from: multipliers, perturbation stream and warm start memory.
+		* @param call recorded call.
+		* @param spaceSize space dimension of the call.
+		* @param last_ref previous reference (spaceSize elements), nullptr if the warm start memory was not valid.
+		* @param last_target previous target (spaceSize elements), nullptr if the warm start memory was not valid.
+		*/
+		void restoreRecordedState(const RecordCall &call, size_t spaceSize, const R *last_ref, const R *last_target) {
+			params.ni1 = (R)call.ni1;
+			params.ni2 = (R)call.ni2;
+			_perturbation.seed(call.seed);
+			_perturbation.counter(call.counter);
+
+			_warm_valid = last_ref != nullptr && last_target != nullptr;
+			if (_warm_valid) {
+				_last_ref.assign(last_ref, last_ref + spaceSize);
+				_last_target.assign(last_target, last_target + spaceSize);
+			}
+		}
+
+		/** Performance counters of this generator since its construction or the last resetStats: all zero (but the
+		* multipliers) unless the library is built with RG_ENABLE_STATS.
+		* @see statsEnabled
+		*/
+		RefgenStats getStats() const {
+			RefgenStats stats;
+			RG_STATS(stats = _stats;)
+			stats.ni1 = (double)params.ni1;
+			stats.ni2 = (double)params.ni2;
+			return stats;
+		}
+
+		/** Zeroes the performance counters of this generator.
+		*/
+		void resetStats() {
+			RG_STATS(_stats = RefgenStats();)
+		}
+
 		/** Computes the next reference.
 		* @param data pointer to proper data memory with the following properties:
 		*	- rank: 2
@@ -98,32 +490,251 @@ namespace rg {
 		* @param spaceSize space dimention (e.g planar -> 2)
 		* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
 		* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+		* @param info optional pointer where to store the number of SPSA iterations and cost evaluations actually used.
 		*/
-		R computeRef(R RG_IN *data, size_t spaceSize, size_t length, R RG_OUT *ref) {
+		R computeRef(R RG_IN *data, size_t spaceSize, size_t length, R RG_OUT *ref, SPSAInfo RG_OUT *info = nullptr) {
+			return computeRefRecorded(data, spaceSize, length, ref, info, _recorder != nullptr);
+		}
 
-			size_t refshape[2];
-			refshape[0] = spaceSize;
-			refshape[1] = 1u;
+		/** Computes the next reference on a data block of any layout (e.g. interleaved {x, y, z} records or a separate
+		* array for each axis), read in place: only the target and the actual position are copied.
+		* When recording (@see setRecorder) the block is copied in row major order, the layout of the records.
+		* @param data data block [target agentActualPosition othersPosition...] (@see DataLayout).
+		* @param spaceSize space dimention (e.g planar -> 2)
+		* @param length number of columns of the data block (e.g. 2 + number of visible other agents).
+		* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+		* @param info optional pointer where to store the number of SPSA iterations and cost evaluations actually used.
+		* @see computeRef
+		*/
+		R computeRef(const DataLayout<R> &data, size_t spaceSize, size_t length, R RG_OUT *ref, SPSAInfo RG_OUT *info = nullptr) {
 
-			auto ref_map = xtc::xarray_map_raw<R>(ref, refshape, 2u);
+			if (length < 2) {
+				THROW_EXCPT("Refgen: the data block needs the target and the actual position");
+			}
 
-			size_t datashape[2];
-			datashape[0] = spaceSize;
-			datashape[1] = length;
+			if (_recorder != nullptr) {
+				_layout_block.resize(spaceSize * length);
+				for (size_t i = 0; i < spaceSize; i++) {
+					for (size_t j = 0; j < length; j++) {
+						_layout_block[i * length + j] = data.at(i, j);
+					}
+				}
+				return computeRef(_layout_block.data(), spaceSize, length, ref, info);
+			}
 
-			params.data_raw.data = (char *)data;
-			params.data_raw.shape = datashape;
-			params.data_raw.rank = 2u;
+			_layout_block.resize(2 * spaceSize);
+			for (size_t i = 0; i < spaceSize; i++) {
+				_layout_block[2 * i] = data.at(i, 0);
+				_layout_block[2 * i + 1] = data.at(i, 1);
+			}
+			return computeRefView(_layout_block.data(), data.columns(2), length - 2, length, spaceSize, ref, info);
+		}
 
-			//multiplier growth
-			auto data_map = xtc::xarray_map_raw<R>(&(params.data_raw));
+		/** Computes the next reference reading the neighbors in place from an external block (e.g. a shared position
+		* board, @see PositionBoard) instead of a data block holding copies of their positions.
+		* These calls are not recorded (@see setRecorder).
+		* @param self pointer to the spaceSize x 2 row major block [target agentActualPosition].
+		* @param others neighbor positions, in any layout (@see DataLayout).
+		* @param count number of columns of others.
+		* @param skip column of others that is not a neighbor (e.g. the agent itself, count or more: none).
+		* @param spaceSize space dimention (e.g planar -> 2)
+		* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+		* @param info optional pointer where to store the number of SPSA iterations and cost evaluations actually used.
+		* @see computeRef
+		*/
+		R computeRefView(R RG_IN *self, const DataLayout<R> &others, size_t count, size_t skip, size_t spaceSize, R RG_OUT *ref,
+			SPSAInfo RG_OUT *info = nullptr) {
 
-			auto target = xt::view(data_map, xt::all(), xt::range(0, 1)); //TODO: check view what does!
-			auto actualPos = xt::view(data_map, xt::all(), xt::range(1, 2));
-			auto tarRelPos = target - actualPos;
-			auto targetSqDist = xt::norm_sq(tarRelPos, { 0 });
+			if (Dim != 0 && spaceSize != Dim) {
+				THROW_EXCPT("Refgen: space dimension differs from the compile time one");
+			}
 
-			R targetSqDist_eval = (R) targetSqDist(0);
+			// the next calls use their data block again, even if this one throws
+			struct OthersReset {
+				costParamV2<R> &p;
+				~OthersReset() {
+					p.others = nullptr;
+				}
+			} reset{ params };
+
+			params.others = &others;
+			params.others_count = count;
+			params.others_skip = skip;
+
+			return computeRefRecorded(self, spaceSize, 2, ref, info, false);
+		}
+
+		/** computeRefView on a row major block: the component i of the neighbor j is others[i * stride + j].
+		* @param stride distance between the rows (axes) of others.
+		*/
+		R computeRefView(R RG_IN *self, const R RG_IN *others, size_t stride, size_t count, size_t skip, size_t spaceSize, R RG_OUT *ref,
+			SPSAInfo RG_OUT *info = nullptr) {
+			return computeRefView(self, DataLayout<R>::rowMajor(others, stride), count, skip, spaceSize, ref, info);
+		}
+
+		/** Starts a resumable reference computation: same problem of computeRef, but the solver iterations are run by step
+		* as many times as needed (e.g. in the spare time of each control frame) and the reference is taken by finish.
+		* The best solution found so far is tracked, so finish gives a valid reference at any time, even without steps
+		* (e.g. the starting point). Multi-start is not used by a resumable computation, the warm start mode only changes
+		* the starting point and the gains.
+		* @param data pointer to the data memory (@see computeRef): it has to stay valid until finish.
+		* @param spaceSize space dimention (e.g planar -> 2)
+		* @param length number of columns of the data memory (e.g. 2 + number of visible other agents).
+		* @return the cost of the starting point.
+		*/
+		R begin(R RG_IN *data, size_t spaceSize, size_t length) {
+
+			prepare(data, spaceSize, length);
+
+			_run_data = data;
+			_run_spaceSize = spaceSize;
+			_run_length = length;
+
+			return dispatch(spaceSize, [&](auto d) {
+				return this->template beginRun<decltype(d)::value>();
+			});
+		}
+
+		/** Runs more iterations of the computation started by begin, going on from where the previous step ended.
+		* Consecutive steps run the same iterations of a single longer run (same gains, perturbations and solver state).
+		* @param iterations maximum number of iterations of this step.
+		* @param deadline the step ends after the first iteration ending past deadline (time_point::max(): no deadline).
+		* @return the cost of the best solution found so far.
+		*/
+		R step(size_t iterations, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+
+			if (!_run_active) {
+				THROW_EXCPT("Refgen: step called without begin");
+			}
+
+			return dispatch(_run_spaceSize, [&](auto d) {
+				return this->template stepRun<decltype(d)::value>(iterations, deadline);
+			});
+		}
+
+		/** Cost of the best solution found so far by the computation started by begin.
+		*/
+		R bestCost() const {
+			return _run_best;
+		}
+
+		/** True if the stopping rules ended the computation started by begin: further steps do nothing.
+		*/
+		bool converged() const {
+			return _run_converged;
+		}
+
+		/** Ends the computation started by begin, writing its best solution as the new reference (within max_var from the
+		* actual position, as computeRef does).
+		* @param ref a pointer to an already allocated memory of size equal to spaceSize in which store the new computed reference.
+		* @param info optional pointer where to store the number of iterations and cost evaluations used by all the steps.
+		* @return the cost of the reference.
+		*/
+		R finish(R RG_OUT *ref, SPSAInfo RG_OUT *info = nullptr) {
+
+			if (!_run_active) {
+				THROW_EXCPT("Refgen: finish called without begin");
+			}
+			_run_active = false;
+
+			SPSAInfo localInfo;
+			if (info == nullptr) {
+				info = &localInfo;
+			}
+
+			return dispatch(_run_spaceSize, [&](auto d) {
+				return this->template finishRun<decltype(d)::value>(ref, info);
+			});
+		}
+
+	private:
+
+		/** computeRef, recording the call if record is true.
+		*/
+		R computeRefRecorded(R *data, size_t spaceSize, size_t length, R RG_OUT *ref, SPSAInfo RG_OUT *info, bool record) {
+
+			RecordCall recordCall;
+			if (record) {
+				recordBegin(recordCall);
+			}
+
+			prepare(data, spaceSize, length);
+
+			// optimization step
+
+			SPSAInfo localInfo;
+			if (info == nullptr) {
+				info = &localInfo;
+			}
+
+			R cost = dispatch(spaceSize, [&](auto d) {
+				return this->template optimize<decltype(d)::value>(data, spaceSize, length, ref, info);
+			});
+
+			if (record) {
+				recordEnd(recordCall, data, spaceSize, length, ref, cost, *info);
+			}
+
+			return cost;
+		}
+
+		/** Saves the state a recorded call starts from (before the multipliers update).
+		*/
+		void recordBegin(RecordCall &record) {
+			record.ni1 = (double)params.ni1;
+			record.ni2 = (double)params.ni2;
+			record.seed = _perturbation.seed();
+			record.counter = _perturbation.counter();
+
+			_record_last_ref.clear();
+			_record_last_target.clear();
+			if (_warm_valid) {
+				_record_last_ref.assign(_last_ref.begin(), _last_ref.end());
+				_record_last_target.assign(_last_target.begin(), _last_target.end());
+			}
+		}
+
+		/** Writes a recorded call, preceded by the settings if they changed.
+		*/
+		void recordEnd(RecordCall &record, const R *data, size_t spaceSize, size_t length, const R *ref, R cost, const SPSAInfo &info) {
+			if (_record_params) {
+				_recorder->template writeParams<R>(_record_source, recordParams());
+				_record_params = false;
+			}
+
+			record.cost = (double)cost;
+			record.iterations = (uint32_t)info.iterations;
+			record.evaluations = (uint32_t)info.evaluations;
+
+			bool warm = _record_last_ref.size() == spaceSize;
+			uint32_t flags = _stop.deadline != std::chrono::steady_clock::time_point::max() ? RECORD_DEADLINE : 0;
+			_recorder->template writeCall<R>(_record_source, record, flags, data, spaceSize, length, ref,
+											 warm ? _record_last_ref.data() : nullptr, warm ? _record_last_target.data() : nullptr);
+		}
+
+		/** Data mapping and multipliers update shared by computeRef and begin.
+		*/
+		void prepare(R *data, size_t spaceSize, size_t length) {
+
+			RG_STATS(auto statsStart = std::chrono::steady_clock::now();)
+
+			if (Dim != 0 && spaceSize != Dim) {
+				THROW_EXCPT("Refgen: space dimension differs from the compile time one");
+			}
+
+			_datashape[0] = spaceSize;
+			_datashape[1] = length;
+
+			params.data_raw.data = (char *)data;
+			params.data_raw.shape = _datashape;
+			params.data_raw.rank = 2u;
+
+			//multiplier growth (column 0: target, column 1: actual position)
+			R targetSqDist_eval = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R tarRelPos = data[i * length] - data[i * length + 1];
+				targetSqDist_eval += tarRelPos * tarRelPos;
+			}
 
 
 			R cstr1SqErr = std::pow(targetSqDist_eval - params.r1*params.r1, 2);
@@ -141,30 +752,379 @@ namespace rg {
 				params.ni2 = params.ni2 + _alpha_rate2 * cstr2_err * cstr2_err;
 			}
 
+			RG_STATS(
+				_call_stats = RefgenStats();
+				_call_stats.ni1_saturated = params.ni1 >= _max_ni ? 1 : 0;
+				_call_stats.ns_prepare = detail::statsElapsed(statsStart, std::chrono::steady_clock::now());
+			)
+		}
 
-			// optimization step
+#ifdef RG_ENABLE_STATS
+		/** Adds the counters of the call just ended to the ones of the instance and to the global ones.
+		*/
+		void commitStats(const SPSAInfo &info) {
+			_call_stats.calls = 1;
+			_call_stats.iterations = info.iterations;
+			_call_stats.evaluations = info.evaluations;
+			_call_stats.delta_clips = info.clipped;
+			_stats += _call_stats;
+			detail::globalStatsCounters().add(_call_stats);
+		}
+#endif
 
-			xt::xarray<R> theta(std::vector<size_t>{spaceSize, 1});
-			xt::noalias(theta) = actualPos * 1; //this makes a copy!
+		/** Runtime space dimension: planar and 3D problems go to the fixed size solver.
+		* f is called with std::integral_constant<size_t, D>, D being the dimension of the solver to use.
+		*/
+		template<class F>
+		R dispatch(size_t spaceSize, F &&f, std::true_type) {
+			switch (spaceSize) {
+			case 2:
+				return f(std::integral_constant<size_t, 2>());
+			case 3:
+				return f(std::integral_constant<size_t, 3>());
+			default:
+				return f(std::integral_constant<size_t, 0>());
+			}
+		}
 
-			R toRet = SPSA<R, xt::xarray<R>>(costfncV2, theta, _max_iter, _max_delta, _a, _A, _alpha, _c, _gamma, &params);
+		template<class F>
+		R dispatch(size_t /*spaceSize*/, F &&f, std::false_type) {
+			return f(std::integral_constant<size_t, Dim>());
+		}
 
-			
-			auto variation = xt::norm_l2(ref_map - actualPos, { 0 });
-			R variation_eval = (R) variation(0);
+		template<class F>
+		R dispatch(size_t spaceSize, F &&f) {
+			return dispatch(spaceSize, std::forward<F>(f), std::integral_constant<bool, Dim == 0>());
+		}
+
+		/** True if the warm start mode is enabled and the previous reference is a good starting point for the actual problem.
+		*/
+		bool warmStarted(const R *data, size_t spaceSize, size_t length) const {
+
+			if (!_warm || !_warm_valid || _last_target.size() != spaceSize) {
+				return false;
+			}
+
+			R targetJump_sq = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R jump = data[i * length] - _last_target[i];
+				targetJump_sq += jump * jump;
+			}
+
+			return targetJump_sq <= _warm_reset * _warm_reset;
+		}
+
+		/** Runs the selected solver from ws.theta.
+		*/
+		template<size_t D>
+		R solve(CEMWorkspace<R, D> &ws, size_t max_iter, RademacherGen &gen, const SPSAStop<R> &stop, SPSAInfo RG_OUT *info) {
+			auto loss = bind_cost(_cost, params);
+			switch (_solver) {
+			case SOLVER_2SPSA:
+				return SPSA2(loss, ws, max_iter, _max_delta, _a, _A, _alpha, _c, _gamma, _hess_min, gen, stop, info);
+			case SOLVER_GRADIENT:
+				return solveGradient(loss, ws, max_iter, stop, info, costHasGrad());
+			case SOLVER_CEM:
+				return CEM(loss, ws, max_iter, _population, _elites, _sigma, _sigma_min, _smoothing, gen, stop, info);
+			default:
+				return SPSA(loss, ws, max_iter, _max_delta, _a, _A, _alpha, _c, _gamma, gen, stop, info);
+			}
+		}
+
+		/** Solution of the last solve: the best candidate for the cross-entropy solver (ws.theta stays the mean of its
+		* distribution, so that a resumed step goes on with it), ws.theta otherwise.
+		*/
+		template<size_t D>
+		const typename SPSAWorkspace<R, D>::vector_type & solution(const CEMWorkspace<R, D> &ws) const {
+			return _solver == SOLVER_CEM ? ws.best : ws.theta;
+		}
+
+		using costHasGrad = detail::cost_has_grad<Cost, R, typename GradientWorkspace<R, 0>::vector_type>;
+
+		template<class L, size_t D>
+		R solveGradient(L &loss, CEMWorkspace<R, D> &ws, size_t max_iter, const SPSAStop<R> &stop, SPSAInfo RG_OUT *info, std::true_type) {
+			return Adam(loss, ws, max_iter, _max_delta, _a, _A, _alpha, (R)0.9, (R)0.999, stop, info);
+		}
+
+		template<class L, size_t D>
+		R solveGradient(L &, CEMWorkspace<R, D> &, size_t, const SPSAStop<R> &, SPSAInfo RG_OUT *, std::false_type) {
+			THROW_EXCPT("Refgen: the cost policy has no gradient");
+		}
+
+		/** Throws if the cost policy cannot be minimized by a solver.
+		*/
+		void checkSolver(SolverType solver) const {
+			if (solver == SOLVER_GRADIENT && !costHasGrad::value) {
+				THROW_EXCPT("Refgen: the gradient solver needs a cost policy with a gradient");
+			}
+		}
+
+		/** Runs the multi-start chains from ws.theta and stores the best solution in ws.theta.
+		* The chain workspaces are kept by the instance, so only the first call (for a given dimension) allocates.
+		*/
+		template<size_t D>
+		R multiStart(CEMWorkspace<R, D> &ws, size_t spaceSize, size_t max_iter, SPSAInfo RG_OUT *info) {
+
+			std::vector<CEMWorkspace<R, D>> &chains = _workspace.chains(std::integral_constant<size_t, D>());
+			if (chains.size() != _chains) {
+				chains.resize(_chains);
+			}
+			_chain_costs.resize(_chains);
+			_chain_info.resize(_chains);
+
+			// one word of the instance stream seeds all the chains of this call
+			uint64_t base = _perturbation.next();
+
+			auto chain = [&](size_t c) {
+				CEMWorkspace<R, D> &cws = chains[c];
+				cws.resize(spaceSize);
+				cws.k0 = ws.k0;
+				cws.trace = ws.trace;
+				cws.trace.chain = (uint16_t)c;
+
+				RademacherGen gen(RademacherGen::word(base, c));
+				for (size_t i = 0; i < spaceSize; i++) {
+					cws.theta(i, 0) = ws.theta(i, 0) + (c == 0 ? R(0) : _chain_spread * gen.template uniform<R>());
+				}
+
+				_chain_costs[c] = solve(cws, max_iter, gen, _stop, &_chain_info[c]);
+			};
+
+			if (_chain_pool) {
+				_chain_pool->parallelFor(_chains, 1, chain);
+			}
+			else {
+				for (size_t c = 0; c < _chains; c++) {
+					chain(c);
+				}
+			}
+
+			size_t best = 0;
+			info->iterations = 0;
+			info->evaluations = 0;
+			info->clipped = 0;
+			for (size_t c = 0; c < _chains; c++) {
+				if (_chain_costs[c] < _chain_costs[best]) {
+					best = c;
+				}
+				info->iterations += _chain_info[c].iterations;
+				info->evaluations += _chain_info[c].evaluations;
+				info->clipped += _chain_info[c].clipped;
+			}
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				ws.theta(i, 0) = solution(chains[best])(i, 0);
+			}
+
+			return _chain_costs[best];
+		}
+
+		/** Starting point of a computation: previous reference in warm start mode, actual position otherwise.
+		* It sets ws.theta and ws.k0 and returns the number of iterations of the run.
+		*/
+		template<size_t D>
+		size_t start(CEMWorkspace<R, D> &ws, const R *data, size_t spaceSize, size_t length) {
+
+			ws.resize(spaceSize);
+			ws.resume = false;
+			ws.k0 = 0;
+
+			ws.trace.buffer = _trace;
+			ws.trace.source = _trace_source;
+			ws.trace.call = _trace_calls++;
+			ws.trace.chain = 0;
+
+			if (warmStarted(data, spaceSize, length)) {
+				// previous optimum, shorter run and resumed gains
+				for (size_t i = 0; i < spaceSize; i++) {
+					ws.theta(i, 0) = _last_ref[i];
+				}
+				ws.k0 = _warm_k0;
+				return _warm_iter;
+			}
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				ws.theta(i, 0) = data[i * length + 1];
+			}
+			return _max_iter;
+		}
+
+		/** Writes ws.theta as the new reference: it cannot be farther than max_var from the actual position.
+		* @param cost cost in ws.theta.
+		* @return the cost of the reference.
+		*/
+		template<size_t D>
+		R finalize(CEMWorkspace<R, D> &ws, const R *data, size_t spaceSize, size_t length, R cost, R RG_OUT *ref, SPSAInfo RG_OUT *info) {
+
+			R variation_eval = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				R variation = ws.theta(i, 0) - data[i * length + 1];
+				variation_eval += variation * variation;
+			}
+			variation_eval = std::sqrt(variation_eval);
 
 
 			if (variation_eval > _max_var) {
 				R normalization = _max_var / variation_eval;
-				theta = actualPos + (theta - actualPos) * normalization;
+				for (size_t i = 0; i < spaceSize; i++) {
+					R actualPos = data[i * length + 1];
+					ws.theta(i, 0) = actualPos + (ws.theta(i, 0) - actualPos) * normalization;
+				}
+
+				cost = _cost(ws.theta, params);
+				info->evaluations++;
+				RG_STATS(_call_stats.var_clamps++;)
+			}
+
+			for (size_t i = 0; i < spaceSize; i++) {
+				ref[i] = ws.theta(i, 0);
+			}
+
+			if (_warm) {
+				_last_ref.resize(spaceSize);
+				_last_target.resize(spaceSize);
+				for (size_t i = 0; i < spaceSize; i++) {
+					_last_ref[i] = ws.theta(i, 0);
+					_last_target[i] = data[i * length];
+				}
+				_warm_valid = true;
+			}
 
-				toRet = costfncV2<R>(ref_map, &params);
+			return cost;
+		}
+
+		/** Optimization step of computeRef using D x 1 fixed size vectors (D = 0: runtime sized).
+		* It runs on the instance workspace, so it allocates only when a runtime sized problem changes dimension.
+		*/
+		template<size_t D>
+		R optimize(R *data, size_t spaceSize, size_t length, R RG_OUT *ref, SPSAInfo RG_OUT *info) {
+
+			CEMWorkspace<R, D> &ws = _workspace.get(std::integral_constant<size_t, D>());
+
+			RG_STATS(auto statsStart = std::chrono::steady_clock::now();)
+
+			size_t max_iter = start(ws, data, spaceSize, length);
+
+			R toRet;
+			if (_chains > 1) {
+				toRet = multiStart(ws, spaceSize, _chain_iter > 0 ? _chain_iter : max_iter, info);
+			}
+			else {
+				toRet = solve(ws, max_iter, _perturbation, _stop, info);
+				for (size_t i = 0; i < spaceSize; i++) {
+					ws.theta(i, 0) = solution(ws)(i, 0);
+				}
 			}
 
-			xtc::xarray_copy_raw(theta, ref);
+			RG_STATS(
+				auto statsSolved = std::chrono::steady_clock::now();
+				_call_stats.ns_solve += detail::statsElapsed(statsStart, statsSolved);
+			)
+
+			toRet = finalize(ws, data, spaceSize, length, toRet, ref, info);
+
+			RG_STATS(
+				_call_stats.ns_finalize += detail::statsElapsed(statsSolved, std::chrono::steady_clock::now());
+				commitStats(*info);
+			)
 
 			return toRet;
+		}
+
+		/** begin using D x 1 fixed size vectors: the starting point is the first best solution.
+		*/
+		template<size_t D>
+		R beginRun() {
+
+			CEMWorkspace<R, D> &ws = _workspace.get(std::integral_constant<size_t, D>());
+
+			start(ws, _run_data, _run_spaceSize, _run_length);
+			_run_k0 = ws.k0;
+			_run_done = 0;
+			_run_converged = false;
+
+			_run_best = _cost(ws.theta, params);
+			_run_best_theta.resize(_run_spaceSize);
+			for (size_t i = 0; i < _run_spaceSize; i++) {
+				_run_best_theta[i] = ws.theta(i, 0);
+			}
+
+			_run_info.iterations = 0;
+			_run_info.evaluations = 1;
+			_run_info.clipped = 0;
+			_run_active = true;
+
+			return _run_best;
+		}
+
+		/** step using D x 1 fixed size vectors: the workspace keeps the solver state between the steps.
+		*/
+		template<size_t D>
+		R stepRun(size_t iterations, std::chrono::steady_clock::time_point deadline) {
+
+			if (_run_converged || iterations == 0 || std::chrono::steady_clock::now() >= deadline) {
+				return _run_best;
+			}
+
+			CEMWorkspace<R, D> &ws = _workspace.get(std::integral_constant<size_t, D>());
+
+			SPSAStop<R> stop = _stop;
+			stop.deadline = deadline;
+
+			// gains and adaptive state go on from the previous steps
+			ws.k0 = _run_k0 + _run_done;
+			ws.resume = _run_done > 0;
+
+			RG_STATS(auto statsStart = std::chrono::steady_clock::now();)
+
+			SPSAInfo stepInfo;
+			R cost = solve(ws, iterations, _perturbation, stop, &stepInfo);
+
+			RG_STATS(_call_stats.ns_solve += detail::statsElapsed(statsStart, std::chrono::steady_clock::now());)
+
+			_run_done += stepInfo.iterations;
+			_run_info.iterations += stepInfo.iterations;
+			_run_info.evaluations += stepInfo.evaluations;
+			_run_info.clipped += stepInfo.clipped;
+
+			// a stopping rule, not the deadline, ended the step early
+			if (stepInfo.iterations < iterations && !stop.expired()) {
+				_run_converged = true;
+			}
+
+			if (cost < _run_best) {
+				_run_best = cost;
+				for (size_t i = 0; i < _run_spaceSize; i++) {
+					_run_best_theta[i] = solution(ws)(i, 0);
+				}
+			}
+
+			return _run_best;
+		}
+
+		/** finish using D x 1 fixed size vectors.
+		*/
+		template<size_t D>
+		R finishRun(R RG_OUT *ref, SPSAInfo RG_OUT *info) {
+
+			CEMWorkspace<R, D> &ws = _workspace.get(std::integral_constant<size_t, D>());
+
+			for (size_t i = 0; i < _run_spaceSize; i++) {
+				ws.theta(i, 0) = _run_best_theta[i];
+			}
+
+			*info = _run_info;
+
+			RG_STATS(auto statsStart = std::chrono::steady_clock::now();)
+
+			R cost = finalize(ws, _run_data, _run_spaceSize, _run_length, _run_best, ref, info);
+
+			RG_STATS(
+				_call_stats.ns_finalize += detail::statsElapsed(statsStart, std::chrono::steady_clock::now());
+				commitStats(*info);
+			)
 
+			return cost;
 		}
 
 	};
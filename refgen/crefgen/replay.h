@@ -0,0 +1,184 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "refgen.h"
+#include "record.h"
+
+
+namespace rg {
+
+	/** Outcome of the replay of a record log.
+	*/
+	struct ReplayReport {
+		uint64_t params;			/**< settings records read. */
+		uint64_t calls;				/**< calls replayed. */
+		uint64_t mismatches;		/**< replayed calls whose reference, cost or iterations differ from the recorded ones. */
+		uint64_t timing;			/**< differing calls recorded with a stopping deadline (not counted as mismatches). */
+		uint64_t skipped;			/**< calls of a generator without valid settings or of an unknown precision. */
+		uint64_t invalid;			/**< settings records refused (e.g. of a corrupt log): the calls of their generator are skipped. */
+		uint64_t first_mismatch;	/**< seq of the first mismatching record (max: none). */
+		bool truncated;				/**< the log ends with an incomplete record. */
+		std::vector<double> ns;		/**< nanoseconds spent by each replayed computeRef. */
+
+		ReplayReport() : params(0), calls(0), mismatches(0), timing(0), skipped(0), invalid(0),
+			first_mismatch(std::numeric_limits<uint64_t>::max()), truncated(false) {
+		}
+	};
+
+	namespace detail {
+
+		/** Recorded settings a generator accepts (the setters throw on the others).
+		*/
+		inline bool validRecordParams(const RecordParams &p) {
+			return p.solver <= SOLVER_CEM && p.population >= 2 && p.elites >= 1 && p.elites <= p.population &&
+				p.smoothing > 0 && p.smoothing <= 1;
+		}
+
+		/** Reference generator with recorded settings. The multi-start chains run on the calling thread (same results).
+		*/
+		template<typename R>
+		std::unique_ptr<Refgen<R>> makeRecordedRefgen(const RecordParams &p) {
+			std::unique_ptr<Refgen<R>> gen(new Refgen<R>((R)p.alpha_rate1, (R)p.r1, (R)p.alpha_rate2, (R)p.r2, (R)p.max_ni, (R)p.alpha_slow,
+				(R)p.d_gauss, (R)p.min_alpha_gauss, (R)p.max_var, (size_t)p.max_iter, (R)p.max_delta, (R)p.a, (R)p.A, (R)p.alpha,
+				(R)p.c, (R)p.gamma, 0, (SolverType)p.solver));
+
+			gen->setSolver((SolverType)p.solver, (R)p.hess_min);
+			gen->setStop(SPSAStop<R>((R)p.step_tol, (size_t)p.window, (R)p.plateau_tol, (size_t)p.min_iter));
+			gen->setWarmStart(p.warm != 0, (size_t)p.warm_iter, (size_t)p.warm_k0, (R)p.warm_reset);
+			gen->setMultiStart((size_t)p.chains, (size_t)p.chain_iter, (R)p.chain_spread, 1);
+			gen->setPopulation((size_t)p.population, (size_t)p.elites, (R)p.sigma, (R)p.sigma_min, (R)p.smoothing);
+			return gen;
+		}
+
+		/** Generators of one precision, by source, and the output buffer of the replayed calls.
+		*/
+		template<typename R>
+		struct ReplayGenerators {
+			std::map<uint32_t, std::unique_ptr<Refgen<R>>> generators;
+			std::vector<R> ref;
+
+			/** Replaces the generator of the source of a settings record.
+			* @return false if the settings are refused: the source has no generator until its next valid settings.
+			*/
+			bool params(const RecordEntry &entry) {
+				if (validRecordParams(*entry.params)) {
+					try {
+						generators[entry.header->source] = makeRecordedRefgen<R>(*entry.params);
+						return true;
+					}
+					catch (const std::exception &) {
+					}
+				}
+				generators.erase(entry.header->source);
+				return false;
+			}
+
+			void call(const RecordEntry &entry, ReplayReport &report) {
+				auto it = generators.find(entry.header->source);
+				if (it == generators.end()) {
+					report.skipped++;
+					return;
+				}
+
+				Refgen<R> &gen = *it->second;
+				size_t spaceSize = entry.header->dim;
+				gen.restoreRecordedState(*entry.call, spaceSize, (const R *)entry.last_ref, (const R *)entry.last_target);
+				ref.resize(spaceSize);
+
+				// inputs used in place from the mapped log
+				SPSAInfo info;
+				auto t1 = std::chrono::steady_clock::now();
+				R cost = gen.computeRef((R *)entry.data.data, spaceSize, entry.header->length, ref.data(), &info);
+				auto t2 = std::chrono::steady_clock::now();
+				report.ns.push_back(std::chrono::duration_cast<std::chrono::duration<double, std::nano>>(t2 - t1).count());
+				report.calls++;
+
+				// bitwise comparison: NaNs match themselves
+				double costd = (double)cost;
+				bool same = std::memcmp(ref.data(), entry.ref.data, sizeof(R) * spaceSize) == 0 &&
+					std::memcmp(&costd, &entry.call->cost, sizeof(double)) == 0 && info.iterations == entry.call->iterations;
+				if (!same) {
+					if (entry.header->flags & RECORD_DEADLINE) {
+						report.timing++;
+					}
+					else {
+						report.mismatches++;
+						report.first_mismatch = std::min(report.first_mismatch, entry.header->seq);
+					}
+				}
+			}
+		};
+	}
+
+	/** Replays a record log at full speed: each call is run again by a generator with the recorded settings, from the
+	* recorded state and on the recorded inputs (used in place from the mapped file), and its results are compared with
+	* the recorded ones. Calls are independent: a log of a multi-threaded application replays the same on a single thread.
+	* @param log open log (it is rewound).
+	* @param source replays only the calls of this source (-1: all).
+	* @param passes number of times the whole log is replayed (e.g. to profile short logs).
+	* @return counters and per call times.
+	*/
+	inline ReplayReport replayLog(RecordLog &log, long long source = -1, size_t passes = 1) {
+
+		ReplayReport report;
+		detail::ReplayGenerators<float> floats;
+		detail::ReplayGenerators<double> doubles;
+		RecordEntry entry;
+
+		for (size_t pass = 0; pass < passes; pass++) {
+			log.rewind();
+			while (log.next(entry)) {
+				const RecordHeader &header = *entry.header;
+				if (source >= 0 && header.source != (uint64_t)source) {
+					continue;
+				}
+
+				if (entry.params != nullptr) {
+					bool valid = true;
+					if (header.real_size == sizeof(float)) {
+						valid = floats.params(entry);
+					}
+					else if (header.real_size == sizeof(double)) {
+						valid = doubles.params(entry);
+					}
+					if (pass == 0) {
+						report.params++;
+						report.invalid += valid ? 0 : 1;
+					}
+				}
+				else if (entry.call != nullptr) {
+					if (header.real_size == sizeof(float)) {
+						floats.call(entry, report);
+					}
+					else if (header.real_size == sizeof(double)) {
+						doubles.call(entry, report);
+					}
+					else {
+						report.skipped++;
+					}
+				}
+			}
+			report.truncated = log.truncated();
+		}
+
+		return report;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <cstddef>
+#include <type_traits>
+
+#ifdef XTENSOR_USE_XSIMD
+#include <xsimd/xsimd.hpp>
+#endif
+
+
+/** @brief Thin layer over xsimd used by the hand written kernels.
+* simd::traits<R>::size is 1 when R has no SIMD support (or xsimd is not used): kernels then fall back to scalar code.
+*/
+namespace rg {
+	namespace simd {
+
+		/** SIMD batch of R and its number of lanes (1: no batch available).
+		*/
+		template<class R>
+		struct traits {
+			using type = R;
+			static constexpr size_t size = 1;
+		};
+
+		/** Tag selecting the SIMD version of a kernel working on batches of type B (@see kernel_tag).
+		*/
+		template<class B>
+		struct batch_tag {
+			using type = B;
+		};
+
+#ifdef XTENSOR_USE_XSIMD
+#if XSIMD_VERSION_MAJOR >= 8
+
+		template<>
+		struct traits<float> {
+			using type = xsimd::batch<float>;
+			static constexpr size_t size = xsimd::batch<float>::size;
+		};
+
+		template<>
+		struct traits<double> {
+			using type = xsimd::batch<double>;
+			static constexpr size_t size = xsimd::batch<double>::size;
+		};
+
+		template<class B, class R>
+		inline B load(const R *p) {
+			return B::load_unaligned(p);
+		}
+
+		template<class B>
+		inline typename B::value_type sum(const B &b) {
+			return xsimd::reduce_add(b);
+		}
+
+#else
+
+		template<>
+		struct traits<float> {
+			using type = xsimd::simd_type<float>;
+			static constexpr size_t size = xsimd::simd_traits<float>::size;
+		};
+
+		template<>
+		struct traits<double> {
+			using type = xsimd::simd_type<double>;
+			static constexpr size_t size = xsimd::simd_traits<double>::size;
+		};
+
+		template<class B, class R>
+		inline B load(const R *p) {
+			B b;
+			b.load_unaligned(p);
+			return b;
+		}
+
+		template<class B>
+		inline typename B::value_type sum(const B &b) {
+			return xsimd::hadd(b);
+		}
+
+#endif
+
+		template<class B>
+		inline B exp(const B &b) {
+			return xsimd::exp(b);
+		}
+#endif
+
+		/** Tag of the kernels of R: batch_tag of its batch, std::false_type (scalar kernels) when R has no SIMD support.
+		*/
+		template<class R>
+		using kernel_tag = typename std::conditional<(traits<R>::size > 1), batch_tag<typename traits<R>::type>, std::false_type>::type;
+	}
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+
+
+namespace rg {
+
+	/** Uniform grid index of a set of points, used to find the agents near a given position without scanning all of them.
+	* Points are bucketed in cubic cells (side: cellSize) and the cells are stored hashed and sorted, so the grid has no
+	* bounds and its memory depends only on the number of points. A radius query visits the 3^spaceSize cells around the
+	* query point (a radius not greater than the cell size is assumed), e.g. 9 cells in the plane and 27 in the space.
+	* Buffers are kept between builds: once warmed up, building and querying do not allocate.
+	*/
+	template<typename R>
+	class SpatialGrid {
+
+	private:
+		std::vector<std::pair<uint64_t, size_t>> _cells;	// (cell key, point index) sorted by key
+		const R *_points;
+		size_t _spaceSize;
+		size_t _count;
+		R _cellSize;
+
+		int64_t cellCoord(R x) const {
+			return (int64_t)std::floor(x / _cellSize);
+		}
+
+		static const uint64_t keySeed = 0xcbf29ce484222325ULL;
+
+		// FNV-1a like hash of the cell coordinates, one coordinate at a time
+		static uint64_t cellKey(uint64_t key, int64_t coord) {
+			return (key ^ (uint64_t)coord) * 0x100000001b3ULL;
+		}
+
+		R point(size_t i, size_t k) const {
+			return _points[i * _count + k];
+		}
+
+	public:
+
+		/** Empty grid constructor.
+		*/
+		SpatialGrid() : _points(nullptr), _spaceSize(0), _count(0), _cellSize(1) {
+		}
+
+		/** Indexes a set of points.
+		* @param points pointer to the points coordinates (row major, spaceSize x count: x1, x2, ..., xn, y1, y2, ..., yn, ...).
+		*	The memory is not copied and it has to stay valid while the grid is queried.
+		* @param spaceSize space dimension (e.g planar -> 2).
+		* @param count number of points.
+		* @param cellSize side of a cell (use the query radius).
+		*/
+		void build(const R RG_IN *points, size_t spaceSize, size_t count, R cellSize) {
+
+			if (!(cellSize > 0)) {
+				THROW_EXCPT("SpatialGrid: the cell size must be positive");
+			}
+
+			_points = points;
+			_spaceSize = spaceSize;
+			_count = count;
+			_cellSize = cellSize;
+
+			_cells.resize(count);
+
+			for (size_t k = 0; k < count; k++) {
+				uint64_t key = keySeed;
+				for (size_t i = 0; i < spaceSize; i++) {
+					key = cellKey(key, cellCoord(point(i, k)));
+				}
+				_cells[k] = std::make_pair(key, k);
+			}
+
+			std::sort(_cells.begin(), _cells.end());
+		}
+
+		/** Number of indexed points.
+		*/
+		size_t size() const {
+			return _count;
+		}
+
+		/** Visits the indexed points closer than radius to a position. Queries do not modify the grid (thread safe).
+		* @param position query position (spaceSize components, stride: stride).
+		* @param stride distance between consecutive components of position.
+		* @param radius query radius (not greater than the cell size).
+		* @param visit callable object invoked as visit(size_t index) for each point in the ball.
+		*/
+		template<class F>
+		void forEachNeighbor(const R *position, size_t stride, R radius, F &&visit) const {
+
+			if (_count == 0) {
+				return;
+			}
+
+			R radius_sq = radius * radius;
+
+			// the neighbor cells are enumerated as the base 3 digits of c (offsets -1, 0, 1 on each axis)
+			size_t n_cells = 1;
+			for (size_t i = 0; i < _spaceSize; i++) {
+				n_cells *= 3;
+			}
+
+			for (size_t c = 0; c < n_cells; c++) {
+				size_t code = c;
+				uint64_t key = keySeed;
+				for (size_t i = 0; i < _spaceSize; i++) {
+					key = cellKey(key, cellCoord(position[i * stride]) + (int64_t)(code % 3) - 1);
+					code /= 3;
+				}
+
+				auto first = std::lower_bound(_cells.begin(), _cells.end(), std::make_pair(key, (size_t)0));
+
+				// different cells may share a key: the distance check filters them out
+				for (auto it = first; it != _cells.end() && it->first == key; ++it) {
+					size_t j = it->second;
+					R dist_sq = 0;
+					for (size_t i = 0; i < _spaceSize; i++) {
+						R rel = position[i * stride] - point(i, j);
+						dist_sq += rel * rel;
+					}
+					if (dist_sq <= radius_sq) {
+						visit(j);
+					}
+				}
+			}
+		}
+
+		/** Visits the indexed points closer than radius to the indexed point k (k excluded).
+		* @param k index of the query point.
+		* @param radius query radius (not greater than the cell size).
+		* @param visit callable object invoked as visit(size_t index) for each point in the ball.
+		*/
+		template<class F>
+		void forEachNeighborOf(size_t k, R radius, F &&visit) const {
+			forEachNeighbor(_points + k, _count, radius, [k, &visit](size_t j) {
+				if (j != k) {
+					visit(j);
+				}
+			});
+		}
+	};
+
+	/** Distance beyond which a neighbor contributes less than eps to the gaussian repulsion of costfncV2.
+	* Each term is alpha_gauss * exp(-d^2 / (2 * D_gauss / log(alpha_gauss))) = alpha_gauss^(1 - d^2 / (2 * D_gauss)) and,
+	* since alpha_gauss >= min_alpha_gauss > 1, it is below eps whenever d^2 >= 2 * D_gauss * (1 + log(1 / eps) / log(min_alpha_gauss)).
+	* @param d_gauss safe distance among agents.
+	* @param min_alpha_gauss minimum value for the gauss repulsive distribution (greater than 1).
+	* @param eps tolerated contribution of a single neighbor (in (0, 1)).
+	*/
+	template<typename R>
+	R gaussCutoff(R d_gauss, R min_alpha_gauss, R eps) {
+
+		if (!(min_alpha_gauss > 1) || !(eps > 0 && eps < 1)) {
+			THROW_EXCPT("gaussCutoff: min_alpha_gauss must be greater than 1 and eps in (0, 1)");
+		}
+
+		return std::sqrt(2 * d_gauss * (1 + std::log(1 / eps) / std::log(min_alpha_gauss)));
+	}
+}
@@ -11,17 +11,298 @@
 
 #include <vector>
 #include <array>
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <chrono>
+#include <type_traits>
 #include <xtl/xsequence.hpp>
 #include <xtensor/xarray.hpp>
+#include <xtensor/xfixed.hpp>
 #include <xtensor/xrandom.hpp>
 #include <xtensor/xnorm.hpp>
 #include <xtensor/xnoalias.hpp>
 #include "c_api_comm.h"
+#include "rademacher.h"
+#include "trace.h"
 
 
 
 namespace rg {
 
+	/** Container used by the SPSA solver to store a Dim x 1 column vector.
+	* Dim = 0 means that the space dimension is known only at runtime (heap backed xarray), otherwise a
+	* stack backed fixed size tensor is used and all the vector operations are unrolled at compile time.
+	*/
+	template<class R, size_t Dim>
+	struct spsa_vector {
+		using type = xt::xtensor_fixed<R, xt::xshape<Dim, 1>>;
+
+		static type make(size_t /*size*/) {
+			return type();
+		}
+
+		static void resize(type & /*v*/, size_t /*size*/) {
+		}
+	};
+
+	template<class R>
+	struct spsa_vector<R, 0> {
+		using type = xt::xarray<R>;
+
+		static type make(size_t size) {
+			return type(std::vector<size_t>{size, 1});
+		}
+
+		/** Reallocates only if the size really changes. */
+		static void resize(type &v, size_t size) {
+			if (v.dimension() != 2 || v.shape()[0] != size || v.shape()[1] != 1) {
+				v.resize(std::vector<size_t>{size, 1});
+			}
+		}
+	};
+
+	/** Memory used by the SPSA iterations.
+	* Allocate it once and pass it to SPSA at each call: after the first call (for a given size) the solver
+	* does not touch the heap anymore.
+	*/
+	template<class R, size_t Dim>
+	struct SPSAWorkspace {
+		using vector_type = typename spsa_vector<R, Dim>::type;
+
+		/** Initial hint of the solver on input, optimized solution on output. */
+		vector_type theta;
+		vector_type delta;
+		vector_type thetaPlus;
+		vector_type thetaMinus;
+		/** Gain sequence offset: the iteration k uses the gains of k0 + k (0: the run starts with the initial gains). */
+		size_t k0;
+		/** Go on with the adaptive state of the previous call (2SPSA Hessian, Adam moments) instead of resetting it. */
+		bool resume;
+		/** Where to record the iterations (only when built with RG_ENABLE_TRACE). */
+		TraceTarget trace;
+
+		SPSAWorkspace(size_t size = Dim) :
+			theta(spsa_vector<R, Dim>::make(size)), delta(spsa_vector<R, Dim>::make(size)),
+			thetaPlus(spsa_vector<R, Dim>::make(size)), thetaMinus(spsa_vector<R, Dim>::make(size)), k0(0), resume(false) {
+		}
+
+		/** Makes the workspace fit a size x 1 problem (no-op for fixed size workspaces).
+		*/
+		void resize(size_t size) {
+			spsa_vector<R, Dim>::resize(theta, size);
+			spsa_vector<R, Dim>::resize(delta, size);
+			spsa_vector<R, Dim>::resize(thetaPlus, size);
+			spsa_vector<R, Dim>::resize(thetaMinus, size);
+		}
+	};
+
+	/** Stopping rules of the SPSA solver: each enabled rule may end the run before max_iter iterations.
+	* All the rules are disabled by default, e.g. exactly max_iter iterations are run.
+	*/
+	template<class R>
+	struct SPSAStop {
+		R step_tol;			/**< stop when the length of the last step is below step_tol (0: disabled). */
+		size_t window;		/**< plateau window: number of iterations averaged by the plateau rule (0: disabled). */
+		R plateau_tol;		/**< stop when the mean loss of a window changes less than plateau_tol (relative) from the previous one. */
+		size_t min_iter;	/**< no rule is checked before min_iter iterations. */
+		std::chrono::steady_clock::time_point deadline;	/**< stop after the first iteration ending past deadline (min_iter ignored, time_point::max(): disabled). */
+
+		SPSAStop(R step_tol = 0, size_t window = 0, R plateau_tol = 0, size_t min_iter = 0) :
+			step_tol(step_tol), window(window), plateau_tol(plateau_tol), min_iter(min_iter),
+			deadline(std::chrono::steady_clock::time_point::max()) {
+		}
+
+		/** True if the deadline is enabled and already passed.
+		*/
+		bool expired() const {
+			return deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline;
+		}
+	};
+
+	/** Work done by a SPSA run.
+	*/
+	struct SPSAInfo {
+		size_t iterations;	/**< iterations actually run. */
+		size_t evaluations;	/**< loss evaluations (SPSA: two for each iteration plus the final one, other solvers: @see their info parameter). */
+		size_t clipped;		/**< iterations whose step was scaled down to max_delta. */
+
+		SPSAInfo() : iterations(0), evaluations(0), clipped(0) {
+		}
+	};
+
+	namespace detail {
+
+		/** Draws a 64 bit seed from a standard random engine.
+		*/
+		template<class _En>
+		uint64_t seed_from(_En &engine) {
+			return ((uint64_t)engine() << 32) ^ (uint64_t)engine();
+		}
+
+		/** Evaluates a loss on the two perturbed points with two separate calls.
+		*/
+		template<class R, class L>
+		struct loss_pair {
+			L loss;
+
+			template<class V>
+			void operator()(V &thetaPlus, V &thetaMinus, void *params, R &yplus, R &yminus) const {
+				// the loss only reads its argument
+				yplus = loss(std::move(thetaPlus), params);
+				yminus = loss(std::move(thetaMinus), params);
+			}
+		};
+
+		template<class R, class L>
+		loss_pair<R, L> make_loss_pair(L loss) {
+			return loss_pair<R, L>{ loss };
+		}
+
+		/** Both the perturbed points through the pair member of a loss functor, when it has one.
+		*/
+		template<class F, class V, class R>
+		auto functor_pair_eval(F &loss, V &thetaPlus, V &thetaMinus, R &yplus, R &yminus, int)
+			-> decltype(loss.pair(thetaPlus, thetaMinus, yplus, yminus), void()) {
+			loss.pair(thetaPlus, thetaMinus, yplus, yminus);
+		}
+
+		template<class F, class V, class R>
+		void functor_pair_eval(F &loss, V &thetaPlus, V &thetaMinus, R &yplus, R &yminus, long) {
+			yplus = loss(thetaPlus);
+			yminus = loss(thetaMinus);
+		}
+
+		/** Adapts a loss functor, called as loss(theta), to the (theta, params) convention of the solver loops: the
+		* params pointer is not used, the functor holds its own data. Being a template argument of the loops, the loss
+		* is called directly (and may be inlined) instead of through a function pointer.
+		*/
+		template<class R, class F>
+		struct functor_loss {
+			F &loss;
+
+			template<class V>
+			R operator()(V &&theta, void *) const {
+				return loss(theta);
+			}
+		};
+
+		template<class R, class F>
+		struct functor_pair {
+			F &loss;
+
+			template<class V>
+			void operator()(V &thetaPlus, V &thetaMinus, void *, R &yplus, R &yminus) const {
+				functor_pair_eval(loss, thetaPlus, thetaMinus, yplus, yminus, 0);
+			}
+		};
+
+		template<class R, class F>
+		struct functor_grad {
+			F &loss;
+
+			template<class V, class G>
+			R operator()(const V &theta, void *, G &grad) const {
+				return loss.grad(theta, grad);
+			}
+		};
+
+		/** SPSA iterations working in place on a workspace (ws.theta is the initial hint and the result).
+		* Components are accessed one by one so that neither temporaries nor reducers are created inside the loop.
+		* pair evaluates the loss on both the perturbed points, loss gives the final cost.
+		* @see SPSA
+		*/
+		template<class R, size_t Dim, class L, class P>
+		R spsa_loop(L loss, P pair, SPSAWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, void *params,
+			RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo *info = nullptr) {
+
+			//std::array<size_t, 2> shape = { size, 1 };
+			//xt::xtensor<R, 2> thetaInternal(shape);   <--- wrong result on PI (????)
+			size_t size = ws.theta.size();
+
+			R ak = a;
+			R ck = c;
+
+			// plateau rule: mean of the loss estimates (yplus + yminus) / 2 over the current and the previous window
+			R windowSum = 0;
+			R lastMean = 0;
+			bool hasLastMean = false;
+
+			size_t clipped = 0;
+			size_t k = 1;
+			for (; k <= max_iter; k++) {
+
+				ak = a / std::pow(ws.k0 + k + A, alpha);
+				ck = c / std::pow(ws.k0 + k, gamma);
+
+				gen.fill(ws.delta, size);
+
+				for (size_t i = 0; i < size; i++) {
+					R delta = ws.delta(i, 0);
+					ws.thetaPlus(i, 0) = ws.theta(i, 0) + ck * delta;
+					ws.thetaMinus(i, 0) = ws.theta(i, 0) - ck * delta;
+				}
+
+				R yplus, yminus;
+				pair(ws.thetaPlus, ws.thetaMinus, params, yplus, yminus);
+
+				// ghat_i = (yplus - yminus) / (2 * ck * delta_i), with delta_i = +-1
+				R ghatAbs = (yplus - yminus) / (2 * ck);
+
+				R varNorm_eval = std::sqrt(ghatAbs * ghatAbs * (R)size);
+
+				R normalization = 1;
+
+				if (varNorm_eval > max_delta) {
+					normalization = max_delta / varNorm_eval;
+					clipped++;
+				}
+
+				for (size_t i = 0; i < size; i++) {
+					ws.theta(i, 0) += -ak * (ghatAbs * ws.delta(i, 0)) * normalization;
+				}
+
+				RG_TRACE(
+					if (ws.trace.buffer != nullptr) {
+						trace_iteration(ws.trace, 0, k, ak, ck, yplus, yminus, ghatAbs, normalization, ws.theta, size);
+					}
+				)
+
+				if (stop.expired()) {
+					break;
+				}
+
+				bool checked = k >= stop.min_iter;
+
+				if (checked && ak * varNorm_eval * normalization < stop.step_tol) {
+					break;
+				}
+
+				if (stop.window > 0) {
+					windowSum += (yplus + yminus) / 2;
+					if (k % stop.window == 0) {
+						R mean = windowSum / (R)stop.window;
+						if (checked && hasLastMean && std::abs(mean - lastMean) <= stop.plateau_tol * std::abs(lastMean)) {
+							break;
+						}
+						lastMean = mean;
+						hasLastMean = true;
+						windowSum = 0;
+					}
+				}
+			}
+
+			if (info != nullptr) {
+				info->iterations = std::min(k, max_iter);
+				info->evaluations = 2 * info->iterations + 1;
+				info->clipped = clipped;
+			}
+
+			return loss(std::move(ws.theta), params);
+		}
+	}
+
 	/** Simultaneous Perturbation Stochastic Approximation algorithm implementation.
 	* An efficient and white noise robust optimization alghorihm.
 	* @param loss function pointer to a loss function:
@@ -37,60 +318,140 @@ namespace rg {
 	* @param c SPSA initial perturbation coefficient (use: 0.1).
 	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
 	* @param params a pointer to other parameters used from the loss function.
+	* @param engine random engine used to seed the perturbation generator (the xtensor global one by default, which is not thread safe).
 	* @see https://www.jhuapl.edu/SPSA/
 	*/
-	template<class R, class E, class _Ey>
-	R SPSA(R (*loss)(E &&, void *), _Ey && RG_INOUT theta, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, void *params = nullptr) {
-		
-		size_t size = theta.size();
+	template<class R, class E, class _Ey, class _En = xt::random::default_engine_type>
+	R SPSA(R (*loss)(E &&, void *), _Ey && RG_INOUT theta, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, void *params = nullptr,
+		_En &engine = xt::random::get_default_random_engine()) {
 
-		xt::xarray<R> thetaInternal(std::vector<size_t>{size, 1});
-		//std::array<size_t, 2> shape = { size, 1 };
-		//xt::xtensor<R, 2> thetaInternal(shape);   <--- wrong result on PI (????)
-		thetaInternal = xt::eval(theta);
+		SPSAWorkspace<R, 0> ws(theta.size());
+		xt::noalias(ws.theta) = theta;
 
-		//xt::xtensor<R, 2> delta(shape);
+		RademacherGen gen(detail::seed_from(engine));
+		R toRet = detail::spsa_loop(loss, detail::make_loss_pair<R>(loss), ws, max_iter, max_delta, a, A, alpha, c, gamma, params, gen);
 
-		R ak = a;
-		R ck = c;
-
-
-		for (size_t k = 1; k <= max_iter; k++) {
-
-			ak = a / std::pow(k + A, alpha);
-			ck = c / std::pow(k, gamma);
-
-			auto perturbation = xt::random::rand<R>(thetaInternal.shape());
-
-			xt::xarray<R> delta = 2 * xt::round(perturbation) - 1;
-			//delta = 2 * xt::round(perturbation) - 1;
+		xt::noalias(theta) = ws.theta;
+		return toRet;
+	}
 
-			auto thetaplus = thetaInternal + ck * delta;
-			auto thetaminus = thetaInternal - ck * delta;
+	/** Simultaneous Perturbation Stochastic Approximation algorithm with a space dimension known at compile time.
+	* Same algorithm of the dynamic version, but all the internal vectors are Dim x 1 fixed size tensors (no heap allocation
+	* and dimension dependent loops resolved at compile time). Given the same engine state the results match the dynamic version.
+	* @param loss function pointer to a loss function:
+	*	- return: R
+	*	- args: Dim x 1 fixed size container (e.g. spsa_vector<R, Dim>::type)
+	*	- args: pointer to other data useful.
+	* @param theta an xarray or xtensor container (shape Dim x 1) used to pass intial hint to the solver and to get back the optimized solution.
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param params a pointer to other parameters used from the loss function.
+	* @param engine random engine used to seed the perturbation generator (the xtensor global one by default, which is not thread safe).
+	* @see https://www.jhuapl.edu/SPSA/
+	*/
+	template<class R, size_t Dim, class _Ey, class _En = xt::random::default_engine_type>
+	R SPSA(R (*loss)(typename spsa_vector<R, Dim>::type &&, void *), _Ey && RG_INOUT theta, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma,
+		void *params = nullptr, _En &engine = xt::random::get_default_random_engine()) {
 
-			R yplus = loss(thetaplus, params);
-			R yminus = loss(thetaminus, params); 
-			//std::cout << "plus " << yplus << " minus" << yminus << std::endl;
+		SPSAWorkspace<R, Dim> ws(Dim);
+		xt::noalias(ws.theta) = theta;
 
-			auto ghat = (yplus - yminus) / (2 * ck * delta);
+		RademacherGen gen(detail::seed_from(engine));
+		R toRet = detail::spsa_loop(loss, detail::make_loss_pair<R>(loss), ws, max_iter, max_delta, a, A, alpha, c, gamma, params, gen);
 
-			auto varNorm = xt::norm_l2(ghat, { 0 });
-			R varNorm_eval = (R)varNorm(0);
+		xt::noalias(theta) = ws.theta;
+		return toRet;
+	}
 
-			R normalization = 1;
+	/** Simultaneous Perturbation Stochastic Approximation algorithm working on a preallocated workspace.
+	* This is the allocation free version used by the reference generator: ws.theta is the initial hint and it
+	* receives the optimized solution.
+	* @param loss function pointer to a loss function:
+	*	- return: R
+	*	- args: the workspace vector type (e.g. SPSAWorkspace<R, Dim>::vector_type)
+	*	- args: pointer to other data useful.
+	* @param ws workspace, already sized to the problem (@see SPSAWorkspace::resize).
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param params a pointer to other parameters used from the loss function.
+	* @param gen perturbation generator: it goes on with its stream, so consecutive calls use different perturbations.
+	* @param stop stopping rules (by default exactly max_iter iterations are run).
+	* @param info optional pointer where to store the number of iterations and loss evaluations actually used.
+	* @see https://www.jhuapl.edu/SPSA/
+	*/
+	template<class R, size_t Dim>
+	R SPSA(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *), SPSAWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter,
+		R max_delta, R a, R A, R alpha, R c, R gamma, void *params, RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
 
-			if (varNorm_eval > max_delta) {
-				normalization = max_delta / varNorm_eval;
-			}
-			
-			thetaInternal += - ak * ghat * normalization;
+		return detail::spsa_loop(loss, detail::make_loss_pair<R>(loss), ws, max_iter, max_delta, a, A, alpha, c, gamma, params, gen, stop, info);
+	}
 
-			//std::cout << "x " << thetaInternal(0, 0) << " y" << thetaInternal(1, 0) << "shape " << thetaInternal.shape()[0] << " " << thetaInternal.shape()[1] << std::endl;
+	/** Simultaneous Perturbation Stochastic Approximation algorithm working on a preallocated workspace, with a loss
+	* functor known at compile time instead of a function pointer and a void * parameter block: the loss is called
+	* directly in the iterations, so that the compiler can inline it.
+	* @param loss callable object (e.g. a lambda or a cost policy bound to its data, @see bind_cost):
+	*	- loss(theta): cost in theta (SPSAWorkspace<R, Dim>::vector_type);
+	*	- optional loss.pair(thetaPlus, thetaMinus, yplus, yminus): costs of both the perturbed points at once (otherwise two calls).
+	* @param ws workspace, already sized to the problem (@see SPSAWorkspace::resize).
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param gen perturbation generator: it goes on with its stream, so consecutive calls use different perturbations.
+	* @param stop stopping rules (by default exactly max_iter iterations are run).
+	* @param info optional pointer where to store the number of iterations and loss evaluations actually used.
+	* @see https://www.jhuapl.edu/SPSA/
+	*/
+	template<class R, size_t Dim, class F>
+	R SPSA(F &&loss, SPSAWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, RademacherGen &gen,
+		const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
 
-		}
-		xt::noalias(theta) = xt::eval(thetaInternal);
+		using L = typename std::remove_reference<F>::type;
+		return detail::spsa_loop(detail::functor_loss<R, L>{ loss }, detail::functor_pair<R, L>{ loss }, ws, max_iter, max_delta, a, A, alpha, c,
+								 gamma, nullptr, gen, stop, info);
+	}
 
+	/** Simultaneous Perturbation Stochastic Approximation algorithm working on a preallocated workspace, with a loss
+	* able to evaluate both the perturbed points of an iteration in one call (e.g. sharing the data sweep between them).
+	* @param loss function pointer to a loss function used for the final cost (@see the other workspace overload).
+	* @param lossPair function pointer to a loss function evaluated on the two perturbed points:
+	*	- args: thetaPlus and thetaMinus (SPSAWorkspace<R, Dim>::vector_type)
+	*	- args: pointer to other data useful
+	*	- args: output costs in thetaPlus and thetaMinus.
+	* @param ws workspace, already sized to the problem (@see SPSAWorkspace::resize).
+	* @param max_iter SPSA number of iteration for each reference computation (use: 120).
+	* @param max_delta SPSA maximal perturbation admitted (use: 0.3).
+	* @param a SPSA initial step size (use: 0.4).
+	* @param A SPSA stability factor (use: 1).
+	* @param alpha SPSA step size decay rate (use: 0.602).
+	* @param c SPSA initial perturbation coefficient (use: 0.1).
+	* @param gamma SPSA perturbation coefficient decay rate (use: 0.1).
+	* @param params a pointer to other parameters used from the loss function.
+	* @param gen perturbation generator: it goes on with its stream, so consecutive calls use different perturbations.
+	* @param stop stopping rules (by default exactly max_iter iterations are run).
+	* @param info optional pointer where to store the number of iterations and loss evaluations actually used.
+	* @see https://www.jhuapl.edu/SPSA/
+	* @see costfncV2_pair
+	*/
+	template<class R, size_t Dim>
+	R SPSA(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *),
+		void (*lossPair)(const typename SPSAWorkspace<R, Dim>::vector_type &, const typename SPSAWorkspace<R, Dim>::vector_type &, void *, R &, R &),
+		SPSAWorkspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, void *params, RademacherGen &gen,
+		const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
 
-		return loss(std::forward<E>(thetaInternal), params);
+		return detail::spsa_loop(loss, lossPair, ws, max_iter, max_delta, a, A, alpha, c, gamma, params, gen, stop, info);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,358 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <xtensor/xarray.hpp>
+#include <xtensor/xfixed.hpp>
+#include "spsa.h"
+#include "rademacher.h"
+
+
+
+namespace rg {
+
+	/** Container used by the 2SPSA solver to store a Dim x Dim matrix (Dim = 0: runtime sized).
+	* @see spsa_vector
+	*/
+	template<class R, size_t Dim>
+	struct spsa_matrix {
+		using type = xt::xtensor_fixed<R, xt::xshape<Dim, Dim>>;
+
+		static type make(size_t /*size*/) {
+			return type();
+		}
+
+		static void resize(type & /*m*/, size_t /*size*/) {
+		}
+	};
+
+	template<class R>
+	struct spsa_matrix<R, 0> {
+		using type = xt::xarray<R>;
+
+		static type make(size_t size) {
+			return type(std::vector<size_t>{size, size});
+		}
+
+		/** Reallocates only if the size really changes. */
+		static void resize(type &m, size_t size) {
+			if (m.dimension() != 2 || m.shape()[0] != size || m.shape()[1] != size) {
+				m.resize(std::vector<size_t>{size, size});
+			}
+		}
+	};
+
+	/** Memory used by the 2SPSA iterations: the SPSA one plus the Hessian estimate.
+	* A 2SPSA workspace can be used by the first order solver too.
+	*/
+	template<class R, size_t Dim>
+	struct SPSA2Workspace : public SPSAWorkspace<R, Dim> {
+		using matrix_type = typename spsa_matrix<R, Dim>::type;
+		using vector_type = typename SPSAWorkspace<R, Dim>::vector_type;
+
+		vector_type delta2;
+		vector_type grad;
+		vector_type step;
+		/** Running average of the per iteration Hessian estimates. */
+		matrix_type hessian;
+		matrix_type eigvec;
+		matrix_type work;
+		/** Number of estimates averaged in hessian. */
+		size_t hessian_k;
+
+		SPSA2Workspace(size_t size = Dim) : SPSAWorkspace<R, Dim>(size),
+			delta2(spsa_vector<R, Dim>::make(size)), grad(spsa_vector<R, Dim>::make(size)), step(spsa_vector<R, Dim>::make(size)),
+			hessian(spsa_matrix<R, Dim>::make(size)), eigvec(spsa_matrix<R, Dim>::make(size)), work(spsa_matrix<R, Dim>::make(size)), hessian_k(0) {
+		}
+
+		/** Makes the workspace fit a size x 1 problem (no-op for fixed size workspaces).
+		*/
+		void resize(size_t size) {
+			SPSAWorkspace<R, Dim>::resize(size);
+			spsa_vector<R, Dim>::resize(delta2, size);
+			spsa_vector<R, Dim>::resize(grad, size);
+			spsa_vector<R, Dim>::resize(step, size);
+			spsa_matrix<R, Dim>::resize(hessian, size);
+			spsa_matrix<R, Dim>::resize(eigvec, size);
+			spsa_matrix<R, Dim>::resize(work, size);
+		}
+	};
+
+	namespace detail {
+
+		/** Eigen decomposition of a symmetric size x size matrix with the cyclic Jacobi method.
+		* On output the diagonal of m holds the eigenvalues and the columns of v the eigenvectors.
+		*/
+		template<class M>
+		void jacobi_eigen(M & RG_INOUT m, M & RG_OUT v, size_t size) {
+
+			using R = typename std::decay<decltype(m(0, 0))>::type;
+
+			for (size_t i = 0; i < size; i++) {
+				for (size_t j = 0; j < size; j++) {
+					v(i, j) = (i == j) ? R(1) : R(0);
+				}
+			}
+
+			for (size_t sweep = 0; sweep < 32; sweep++) {
+
+				R off = 0, diag = 0;
+				for (size_t i = 0; i < size; i++) {
+					diag += m(i, i) * m(i, i);
+					for (size_t j = i + 1; j < size; j++) {
+						off += m(i, j) * m(i, j);
+					}
+				}
+				if (off <= std::numeric_limits<R>::epsilon() * std::numeric_limits<R>::epsilon() * diag || off == 0) {
+					break;
+				}
+
+				for (size_t p = 0; p < size; p++) {
+					for (size_t q = p + 1; q < size; q++) {
+
+						if (m(p, q) == 0) {
+							continue;
+						}
+
+						// rotation annihilating m(p, q)
+						R theta = (m(q, q) - m(p, p)) / (2 * m(p, q));
+						R t = (theta >= 0 ? R(1) : R(-1)) / (std::abs(theta) + std::sqrt(theta * theta + 1));
+						R c = 1 / std::sqrt(t * t + 1);
+						R s = t * c;
+
+						for (size_t k = 0; k < size; k++) {
+							R mkp = m(k, p);
+							R mkq = m(k, q);
+							m(k, p) = c * mkp - s * mkq;
+							m(k, q) = s * mkp + c * mkq;
+						}
+						for (size_t k = 0; k < size; k++) {
+							R mpk = m(p, k);
+							R mqk = m(q, k);
+							m(p, k) = c * mpk - s * mqk;
+							m(q, k) = s * mpk + c * mqk;
+						}
+						for (size_t k = 0; k < size; k++) {
+							R vkp = v(k, p);
+							R vkq = v(k, q);
+							v(k, p) = c * vkp - s * vkq;
+							v(k, q) = s * vkp + c * vkq;
+						}
+					}
+				}
+			}
+		}
+
+		/** 2SPSA iterations working in place on a workspace (ws.theta is the initial hint and the result).
+		* @see SPSA2
+		*/
+		template<class R, size_t Dim, class L, class P>
+		R spsa2_loop(L loss, P pair, SPSA2Workspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma,
+			R hess_min, void *params, RademacherGen &gen, const SPSAStop<R> &stop, SPSAInfo *info) {
+
+			size_t size = ws.theta.size();
+
+			R windowSum = 0;
+			R lastMean = 0;
+			bool hasLastMean = false;
+
+			if (!ws.resume) {
+				for (size_t i = 0; i < size; i++) {
+					for (size_t j = 0; j < size; j++) {
+						ws.hessian(i, j) = 0;
+					}
+				}
+				ws.hessian_k = 0;
+			}
+
+			size_t clipped = 0;
+			size_t k = 1;
+			for (; k <= max_iter; k++) {
+
+				R ak = a / std::pow(ws.k0 + k + A, alpha);
+				R ck = c / std::pow(ws.k0 + k, gamma);
+
+				gen.fill(ws.delta, size);
+				gen.fill(ws.delta2, size);
+
+				for (size_t i = 0; i < size; i++) {
+					R delta = ws.delta(i, 0);
+					ws.thetaPlus(i, 0) = ws.theta(i, 0) + ck * delta;
+					ws.thetaMinus(i, 0) = ws.theta(i, 0) - ck * delta;
+				}
+
+				R yplus, yminus;
+				pair(ws.thetaPlus, ws.thetaMinus, params, yplus, yminus);
+
+				// second perturbation of both the points, for the one sided gradients used by the Hessian estimate
+				for (size_t i = 0; i < size; i++) {
+					R delta2 = ws.delta2(i, 0);
+					ws.thetaPlus(i, 0) += ck * delta2;
+					ws.thetaMinus(i, 0) += ck * delta2;
+				}
+
+				R yplus2, yminus2;
+				pair(ws.thetaPlus, ws.thetaMinus, params, yplus2, yminus2);
+
+				R ghatAbs = (yplus - yminus) / (2 * ck);
+
+				// H_k = s / 2 * (delta2 * delta^T + delta * delta2^T), with delta_i, delta2_i = +-1 and s ~ delta2^T H delta.
+				// Feedback: the part of s explained by the actual average (delta2^T Hbar delta) is removed, since its
+				// off diagonal terms are pure noise (with Hbar = H the estimate has no noise at all)
+				R s = ((yplus2 - yplus) - (yminus2 - yminus)) / (2 * ck * ck);
+				R t = 0;
+				for (size_t i = 0; i < size; i++) {
+					for (size_t j = 0; j < size; j++) {
+						t += ws.delta2(i, 0) * ws.hessian(i, j) * ws.delta(j, 0);
+					}
+				}
+				ws.hessian_k++;
+				R weight = (R)1 / (R)ws.hessian_k;
+
+				for (size_t i = 0; i < size; i++) {
+					ws.grad(i, 0) = ghatAbs * ws.delta(i, 0);
+					for (size_t j = 0; j < size; j++) {
+						R hkFeedback = (s - t) / 2 * (ws.delta2(i, 0) * ws.delta(j, 0) + ws.delta(i, 0) * ws.delta2(j, 0));
+						ws.hessian(i, j) += hkFeedback * weight;
+						ws.work(i, j) = ws.hessian(i, j);
+					}
+				}
+
+				// step = V |Lambda|^-1 V^T grad, eigenvalues kept away from zero
+				jacobi_eigen(ws.work, ws.eigvec, size);
+
+				for (size_t j = 0; j < size; j++) {
+					R proj = 0;
+					for (size_t i = 0; i < size; i++) {
+						proj += ws.eigvec(i, j) * ws.grad(i, 0);
+					}
+					ws.delta2(j, 0) = proj / std::max(std::abs(ws.work(j, j)), hess_min);
+				}
+
+				R stepNorm_sq = 0;
+				for (size_t i = 0; i < size; i++) {
+					R step = 0;
+					for (size_t j = 0; j < size; j++) {
+						step += ws.eigvec(i, j) * ws.delta2(j, 0);
+					}
+					ws.step(i, 0) = step;
+					stepNorm_sq += step * step;
+				}
+
+				R stepNorm = std::sqrt(stepNorm_sq);
+				R normalization = 1;
+				if (stepNorm > max_delta) {
+					normalization = max_delta / stepNorm;
+					clipped++;
+				}
+
+				for (size_t i = 0; i < size; i++) {
+					ws.theta(i, 0) += -ak * ws.step(i, 0) * normalization;
+				}
+
+				RG_TRACE(
+					if (ws.trace.buffer != nullptr) {
+						trace_iteration(ws.trace, 1, k, ak, ck, yplus, yminus, stepNorm, normalization, ws.theta, size);
+					}
+				)
+
+				if (stop.expired()) {
+					break;
+				}
+
+				bool checked = k >= stop.min_iter;
+
+				if (checked && ak * stepNorm * normalization < stop.step_tol) {
+					break;
+				}
+
+				if (stop.window > 0) {
+					windowSum += (yplus + yminus) / 2;
+					if (k % stop.window == 0) {
+						R mean = windowSum / (R)stop.window;
+						if (checked && hasLastMean && std::abs(mean - lastMean) <= stop.plateau_tol * std::abs(lastMean)) {
+							break;
+						}
+						lastMean = mean;
+						hasLastMean = true;
+						windowSum = 0;
+					}
+				}
+			}
+
+			if (info != nullptr) {
+				info->iterations = std::min(k, max_iter);
+				info->evaluations = 4 * info->iterations + 1;
+				info->clipped = clipped;
+			}
+
+			return loss(std::move(ws.theta), params);
+		}
+	}
+
+	/** Adaptive second order SPSA (2SPSA).
+	* Besides the SPSA gradient estimate, each iteration estimates the Hessian from two more loss evaluations and keeps
+	* its running average: steps are preconditioned with it (Newton like), so badly scaled costs (e.g. costfncV2 when
+	* the multipliers grow) converge in fewer iterations. The averaged Hessian is made positive definite through its
+	* eigen decomposition (absolute eigenvalues, not smaller than hess_min). Each iteration costs 4 loss evaluations.
+	* @param loss function pointer to a loss function used for the final cost (@see SPSA).
+	* @param lossPair function pointer to a loss function evaluated on two points at once (@see SPSA).
+	* @param ws workspace, already sized to the problem (@see SPSA2Workspace::resize).
+	* @param max_iter number of iterations.
+	* @param max_delta maximal step admitted (before the gain ak).
+	* @param a initial step size (the preconditioned step is already scaled: use 1 or less).
+	* @param A stability factor.
+	* @param alpha step size decay rate.
+	* @param c initial perturbation coefficient.
+	* @param gamma perturbation coefficient decay rate.
+	* @param hess_min minimum absolute eigenvalue of the preconditioner.
+	* @param params a pointer to other parameters used from the loss function.
+	* @param gen perturbation generator.
+	* @param stop stopping rules (by default exactly max_iter iterations are run).
+	* @param info optional pointer where to store the number of iterations and loss evaluations actually used.
+	* @see J. C. Spall, "Adaptive stochastic approximation by the simultaneous perturbation method", IEEE TAC, 2000.
+	*/
+	template<class R, size_t Dim>
+	R SPSA2(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *),
+		void (*lossPair)(const typename SPSAWorkspace<R, Dim>::vector_type &, const typename SPSAWorkspace<R, Dim>::vector_type &, void *, R &, R &),
+		SPSA2Workspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, R hess_min, void *params,
+		RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		return detail::spsa2_loop(loss, lossPair, ws, max_iter, max_delta, a, A, alpha, c, gamma, hess_min, params, gen, stop, info);
+	}
+
+	/** Adaptive second order SPSA (2SPSA) with a single point loss function.
+	* @see SPSA2
+	*/
+	template<class R, size_t Dim>
+	R SPSA2(R (*loss)(typename SPSAWorkspace<R, Dim>::vector_type &&, void *), SPSA2Workspace<R, Dim> & RG_INOUT ws, size_t max_iter,
+		R max_delta, R a, R A, R alpha, R c, R gamma, R hess_min, void *params, RademacherGen &gen,
+		const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		return detail::spsa2_loop(loss, detail::make_loss_pair<R>(loss), ws, max_iter, max_delta, a, A, alpha, c, gamma, hess_min, params, gen, stop, info);
+	}
+
+	/** Adaptive second order SPSA (2SPSA) with a loss functor known at compile time (@see the SPSA functor overload).
+	* @see SPSA2
+	*/
+	template<class R, size_t Dim, class F>
+	R SPSA2(F &&loss, SPSA2Workspace<R, Dim> & RG_INOUT ws, size_t max_iter, R max_delta, R a, R A, R alpha, R c, R gamma, R hess_min,
+		RademacherGen &gen, const SPSAStop<R> &stop = SPSAStop<R>(), SPSAInfo RG_OUT *info = nullptr) {
+
+		using L = typename std::remove_reference<F>::type;
+		return detail::spsa2_loop(detail::functor_loss<R, L>{ loss }, detail::functor_pair<R, L>{ loss }, ws, max_iter, max_delta, a, A, alpha,
+								  c, gamma, hess_min, nullptr, gen, stop, info);
+	}
+}
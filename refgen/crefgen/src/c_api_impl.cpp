@@ -7,17 +7,31 @@
 
 #include "rgcommon.h"
 #include "crefgen/refgen.h"
+#include "crefgen/fleet.h"
+#include "crefgen/threadpool.h"
+#include "crefgen/async.h"
+#include "crefgen/replay.h"
+#include "crefgen/board.h"
+#include "crefgen/dispatch.h"
+#include "crefgen/fixedrefgen.h"
 
 #include "crefgen/c_api.h"
 
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 
 
 template<typename R>
 inline void *new_refgen(R alpha_rate1, R r1, R alpha_rate2, R r2, R max_ni, R alpha_slow, R d_gauss, R min_alpha_gauss, R max_var, 
-	size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1) {
+	size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1, uint64_t seed = 0) {
 	
 	return new rg::Refgen<R>(alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
-							max_iter, max_delta, a, A, alpha, c, gamma);
+							max_iter, max_delta, a, A, alpha, c, gamma, seed);
 }
 
 template<typename R>
@@ -26,6 +40,45 @@ inline void delete_refgen(void *refgen) {
 	delete refgenR;
 }
 
+template<typename R>
+inline void *new_fleet(size_t n_agents, size_t n_threads, R alpha_rate1, R r1, R alpha_rate2, R r2, R max_ni, R alpha_slow, R d_gauss, R min_alpha_gauss, R max_var,
+	size_t max_iter = 120, R max_delta = 0.3, R a = 0.4, R A = 1, R alpha = 0.602, R c = 0.1, R gamma = 0.1, uint64_t seed = 0) {
+
+	return new rg::Fleet<R>(n_agents, n_threads, alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
+							max_iter, max_delta, a, A, alpha, c, gamma, seed);
+}
+
+template<typename R>
+inline void delete_fleet(void *fleet) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+	delete fleetR;
+}
+
+template<typename R>
+inline R refgeg_computeref_batch_impl(void *fleet, R RG_IN *data, const unsigned int RG_IN *offsets, size_t spaceSize, size_t n_agents, R RG_OUT *refs) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	try {
+		return fleetR->computeRefBatch(data, offsets, spaceSize, n_agents, refs);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+}
+
+template<typename R>
+inline R refgeg_computeref_grid_impl(void *fleet, const R RG_IN *positions, const R RG_IN *targets, size_t spaceSize, size_t n_agents, R eps,
+									 R RG_OUT *refs, R RG_OUT *truncation) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	try {
+		return fleetR->computeRefGrid(positions, targets, spaceSize, n_agents, eps, refs, nullptr, truncation);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+}
+
 template<typename R>
 inline R refgeg_computeref_impl(void *refgen, R RG_IN *data, size_t spaceSize, size_t length, R RG_OUT *ref) {
 	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
@@ -33,6 +86,379 @@ inline R refgeg_computeref_impl(void *refgen, R RG_IN *data, size_t spaceSize, s
 	return refgenR->computeRef(data, spaceSize, length, ref);
 }
 
+template<typename R>
+inline R refgen_computeref_layout_impl(void *refgen, const R RG_IN *data, const R * const RG_IN *axes, unsigned int layout, size_t stride,
+									   size_t spaceSize, size_t length, R RG_OUT *ref) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	if ((layout == RG_LAYOUT_AXES ? axes == nullptr : data == nullptr)) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+	try {
+		switch (layout) {
+		case RG_LAYOUT_INTERLEAVED:
+			return refgenR->computeRef(rg::DataLayout<R>::interleaved(data, stride != 0 ? stride : spaceSize), spaceSize, length, ref);
+		case RG_LAYOUT_AXES:
+			return refgenR->computeRef(rg::DataLayout<R>::perAxis(axes), spaceSize, length, ref);
+		default:
+			return refgenR->computeRef(rg::DataLayout<R>::rowMajor(data, stride != 0 ? stride : length), spaceSize, length, ref);
+		}
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+}
+
+template<typename R>
+inline R refgeg_computeref_ext_impl(void *refgen, R RG_IN *data, size_t spaceSize, size_t length, R RG_OUT *ref,
+									unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	rg::SPSAInfo info;
+	R toRet = refgenR->computeRef(data, spaceSize, length, ref, &info);
+
+	if (iterations != nullptr) {
+		*iterations = (unsigned int)info.iterations;
+	}
+	if (evaluations != nullptr) {
+		*evaluations = (unsigned int)info.evaluations;
+	}
+
+	return toRet;
+}
+
+template<typename R>
+inline void refgen_set_stop_impl(void *refgen, R step_tol, size_t window, R plateau_tol, size_t min_iter) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->setStop(rg::SPSAStop<R>(step_tol, window, plateau_tol, min_iter));
+}
+
+template<typename R>
+inline void fleet_set_stop_impl(void *fleet, R step_tol, size_t window, R plateau_tol, size_t min_iter) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	fleetR->setStop(rg::SPSAStop<R>(step_tol, window, plateau_tol, min_iter));
+}
+
+template<typename R>
+inline void refgen_set_warm_start_impl(void *refgen, bool enable, size_t iterations, size_t gain_offset, R reset_dist) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->setWarmStart(enable, iterations, gain_offset, reset_dist);
+}
+
+template<typename R>
+inline void fleet_set_warm_start_impl(void *fleet, bool enable, size_t iterations, size_t gain_offset, R reset_dist) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	fleetR->setWarmStart(enable, iterations, gain_offset, reset_dist);
+}
+
+template<typename R>
+inline void refgen_set_multi_start_impl(void *refgen, size_t chains, size_t iterations, R spread, size_t n_threads) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->setMultiStart(chains, iterations, spread, n_threads);
+}
+
+template<typename R>
+inline int refgen_set_solver_impl(void *refgen, unsigned int solver) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	if (solver > RG_SOLVER_CEM) {
+		return 0;
+	}
+	try {
+		refgenR->setSolver((rg::SolverType)solver);
+	}
+	catch (const std::exception &) {
+		return 0;
+	}
+	return 1;
+}
+
+template<typename R>
+inline int fleet_set_solver_impl(void *fleet, unsigned int solver) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	if (solver > RG_SOLVER_CEM) {
+		return 0;
+	}
+	try {
+		fleetR->setSolver((rg::SolverType)solver);
+	}
+	catch (const std::exception &) {
+		return 0;
+	}
+	return 1;
+}
+
+template<typename R>
+inline int refgen_set_population_impl(void *refgen, size_t population, size_t elites, R sigma, R sigma_min, R smoothing) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	try {
+		refgenR->setPopulation(population, elites, sigma, sigma_min, smoothing);
+	}
+	catch (const std::exception &) {
+		return 0;
+	}
+	return 1;
+}
+
+template<typename R>
+inline R refgen_computeref_jobs_impl(void *pool, void * const RG_IN *refgens, R * const RG_IN *data, size_t spaceSize,
+									 const unsigned int RG_IN *lengths, R * const RG_OUT *refs, size_t n_jobs, R RG_OUT *costs) {
+	rg::ThreadPool *poolT = (rg::ThreadPool *)pool;
+
+	std::vector<R> localCosts;
+	if (costs == nullptr) {
+		localCosts.resize(n_jobs);
+		costs = localCosts.data();
+	}
+
+	poolT->parallelFor(n_jobs, 1, [&](size_t k) {
+		rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgens[k];
+		costs[k] = refgenR->computeRef(data[k], spaceSize, lengths[k], refs[k]);
+	});
+
+	R total = 0;
+	for (size_t k = 0; k < n_jobs; k++) {
+		total += costs[k];
+	}
+
+	return total;
+}
+
+template<typename R>
+inline void fleet_set_threads_impl(void *fleet, size_t n_threads, bool pin) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	fleetR->setNumThreads(n_threads, pin);
+}
+
+template<typename R>
+inline R refgen_begin_impl(void *refgen, R RG_IN *data, size_t spaceSize, size_t length) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	try {
+		return refgenR->begin(data, spaceSize, length);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+}
+
+template<typename R>
+inline R refgen_step_impl(void *refgen, size_t iterations, unsigned long long budget_ns) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	if (iterations == 0 && budget_ns == 0) {
+		return refgenR->bestCost();
+	}
+
+	auto deadline = std::chrono::steady_clock::time_point::max();
+	if (budget_ns > 0) {
+		deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(budget_ns);
+	}
+
+	try {
+		return refgenR->step(iterations > 0 ? iterations : std::numeric_limits<size_t>::max(), deadline);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+}
+
+template<typename R>
+inline R refgen_finish_impl(void *refgen, R RG_OUT *ref, unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	rg::SPSAInfo info;
+	R toRet;
+	try {
+		toRet = refgenR->finish(ref, &info);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+
+	if (iterations != nullptr) {
+		*iterations = (unsigned int)info.iterations;
+	}
+	if (evaluations != nullptr) {
+		*evaluations = (unsigned int)info.evaluations;
+	}
+
+	return toRet;
+}
+
+template<typename R>
+inline void fleet_set_multi_start_impl(void *fleet, size_t chains, size_t iterations, R spread) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	fleetR->setMultiStart(chains, iterations, spread);
+}
+
+
+inline int copy_stats(const rg::RefgenStats &from, refgen_stats RG_OUT *to) {
+	to->calls = from.calls;
+	to->iterations = from.iterations;
+	to->evaluations = from.evaluations;
+	to->delta_clips = from.delta_clips;
+	to->var_clamps = from.var_clamps;
+	to->ni1_saturated = from.ni1_saturated;
+	to->ns_prepare = from.ns_prepare;
+	to->ns_solve = from.ns_solve;
+	to->ns_finalize = from.ns_finalize;
+	to->ni1 = from.ni1;
+	to->ni2 = from.ni2;
+	return rg::statsEnabled() ? 1 : 0;
+}
+
+template<typename R>
+inline int refgen_get_stats_impl(void *refgen, refgen_stats RG_OUT *stats) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	return copy_stats(refgenR->getStats(), stats);
+}
+
+template<typename R>
+inline void refgen_reset_stats_impl(void *refgen) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->resetStats();
+}
+
+template<typename R>
+inline int fleet_get_stats_impl(void *fleet, size_t agent, refgen_stats RG_OUT *stats) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+	if (agent >= fleetR->size()) {
+		return 0;
+	}
+
+	return copy_stats(fleetR->agent(agent).getStats(), stats);
+}
+
+
+template<typename R>
+inline void refgen_set_trace_impl(void *refgen, void *trace, uint32_t source) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->setTrace((rg::TraceBuffer *)trace, source);
+}
+
+template<typename R>
+inline void fleet_set_trace_impl(void *fleet, void *trace) {
+	rg::Fleet<R> *fleetR = (rg::Fleet<R> *)fleet;
+
+	fleetR->setTrace((rg::TraceBuffer *)trace);
+}
+
+template<typename R>
+inline void refgen_set_recorder_impl(void *refgen, void *recorder, uint32_t source) {
+	rg::Refgen<R> *refgenR = (rg::Refgen<R> *)refgen;
+
+	refgenR->setRecorder((rg::RefgenRecorder *)recorder, source);
+}
+
+template<typename R>
+inline void *board_open_impl(const char *name, unsigned int capacity, unsigned int spaceSize, int create) {
+	rg::PositionBoard<R> *board = new rg::PositionBoard<R>();
+	if (!(create ? board->create(name, capacity, spaceSize) : board->open(name))) {
+		delete board;
+		return nullptr;
+	}
+	return board;
+}
+
+template<typename R>
+inline void board_close_impl(void *board, int unlink) {
+	rg::PositionBoard<R> *boardR = (rg::PositionBoard<R> *)board;
+	std::string name = boardR->name();
+	delete boardR;
+	if (unlink) {
+		rg::PositionBoard<R>::remove(name.c_str());
+	}
+}
+
+template<typename R>
+inline int board_publish_impl(void *board, unsigned int slot, const R *position) {
+	rg::PositionBoard<R> *boardR = (rg::PositionBoard<R> *)board;
+	if (slot >= boardR->capacity()) {
+		return 0;
+	}
+	boardR->publish(slot, position);
+	return 1;
+}
+
+template<typename R>
+inline int board_read_impl(void *board, unsigned int slot, R *position) {
+	rg::PositionBoard<R> *boardR = (rg::PositionBoard<R> *)board;
+	if (slot >= boardR->capacity()) {
+		return 0;
+	}
+	return boardR->read(slot, position) ? 1 : 0;
+}
+
+template<typename R>
+inline R board_computeref_impl(void *refgen, void *board, unsigned int slot, const R *target, const R *position, R *ref, unsigned int *changed) {
+	static thread_local rg::BoardReader<R> reader;
+
+	size_t torn = 0;
+	R cost;
+	try {
+		cost = reader.computeRef(*(rg::Refgen<R> *)refgen, *(rg::PositionBoard<R> *)board, slot, target, position, ref, &torn);
+	}
+	catch (const std::exception &) {
+		return std::numeric_limits<R>::quiet_NaN();
+	}
+	if (changed != nullptr) {
+		*changed = (unsigned int)torn;
+	}
+	return cost;
+}
+
+
+static std::mutex async_mutex;
+static std::atomic<rg::AsyncEngine *> async_engine(nullptr);
+static std::atomic<size_t> async_users(0);
+
+// calls using the engine are counted from before they load it, so refgen_async_stop deletes it only after the calls
+// that may still hold the pointer are over (the later ones load nullptr)
+struct AsyncUse {
+	AsyncUse() { async_users.fetch_add(1, std::memory_order_seq_cst); }
+	~AsyncUse() { async_users.fetch_sub(1, std::memory_order_seq_cst); }
+};
+
+inline rg::AsyncEngine *async_get() {
+	rg::AsyncEngine *engine = async_engine.load(std::memory_order_seq_cst);
+	if (engine == nullptr) {
+		std::lock_guard<std::mutex> lock(async_mutex);
+		engine = async_engine.load(std::memory_order_relaxed);
+		if (engine == nullptr) {
+			engine = new rg::AsyncEngine();
+			async_engine.store(engine, std::memory_order_release);
+		}
+	}
+	return engine;
+}
+
+template<typename R>
+inline int refgen_submit_impl(void *refgen, R RG_IN *data, unsigned int spaceSize, unsigned int length, R RG_OUT *ref,
+							  void (*callback)(unsigned long long, R, void *), void *user, unsigned long long RG_OUT *ticket) {
+	AsyncUse use;
+	rg::AsyncTicket t = 0;
+	if (!async_get()->submit(*(rg::Refgen<R> *)refgen, data, spaceSize, length, ref, t, callback, user)) {
+		return 1;
+	}
+	if (ticket != nullptr) {
+		*ticket = t;
+	}
+	return 0;
+}
+
 
 void *new_refgen_float(float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
 						float d_gauss, float min_alpha_gauss, float max_var) {
@@ -41,10 +467,11 @@ void *new_refgen_float(float alpha_rate1, float r1, float alpha_rate2, float r2,
 
 void *new_refgen_float_ext(float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
 							float d_gauss, float min_alpha_gauss, float max_var,
-							unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma) {
+							unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma,
+							unsigned long long seed) {
 
 	return new_refgen<float>(alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
-							max_iter, max_delta, a, A, alpha, c, gamma);
+							max_iter, max_delta, a, A, alpha, c, gamma, seed);
 }
 
 void *new_refgen_double(double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
@@ -54,10 +481,11 @@ void *new_refgen_double(double alpha_rate1, double r1, double alpha_rate2, doubl
 
 void *new_refgen_double_ext(double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
 							double d_gauss, double min_alpha_gauss, double max_var,
-							unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma) {
+							unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma,
+							unsigned long long seed) {
 
 	return new_refgen<double>(alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
-							  max_iter, max_delta, a, A, alpha, c, gamma);
+							  max_iter, max_delta, a, A, alpha, c, gamma, seed);
 }
 
 void delete_refgen_float(void *refgen) {
@@ -75,3 +503,454 @@ float refgen_float_computeref(void *refgen, float RG_IN *data, unsigned int spac
 double refgen_double_computeref(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref) {
 	return refgeg_computeref_impl<double>(refgen, data, spaceSize, length, ref);
 }
+
+void *new_refgen_float_fleet(unsigned int n_agents, unsigned int n_threads, float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
+							float d_gauss, float min_alpha_gauss, float max_var) {
+	return new_fleet<float>(n_agents, n_threads, alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var);
+}
+
+void *new_refgen_float_fleet_ext(unsigned int n_agents, unsigned int n_threads, float alpha_rate1, float r1, float alpha_rate2, float r2, float max_ni, float alpha_slow,
+								float d_gauss, float min_alpha_gauss, float max_var,
+								unsigned int max_iter, float max_delta, float a, float A, float alpha, float c, float gamma,
+								unsigned long long seed) {
+
+	return new_fleet<float>(n_agents, n_threads, alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
+							max_iter, max_delta, a, A, alpha, c, gamma, seed);
+}
+
+void *new_refgen_double_fleet(unsigned int n_agents, unsigned int n_threads, double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
+							double d_gauss, double min_alpha_gauss, double max_var) {
+	return new_fleet<double>(n_agents, n_threads, alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var);
+}
+
+void *new_refgen_double_fleet_ext(unsigned int n_agents, unsigned int n_threads, double alpha_rate1, double r1, double alpha_rate2, double r2, double max_ni, double alpha_slow,
+								double d_gauss, double min_alpha_gauss, double max_var,
+								unsigned int max_iter, double max_delta, double a, double A, double alpha, double c, double gamma,
+								unsigned long long seed) {
+
+	return new_fleet<double>(n_agents, n_threads, alpha_rate1, r1, alpha_rate2, r2, max_ni, alpha_slow, d_gauss, min_alpha_gauss, max_var,
+							max_iter, max_delta, a, A, alpha, c, gamma, seed);
+}
+
+void delete_refgen_float_fleet(void *fleet) {
+	delete_fleet<float>(fleet);
+}
+
+void delete_refgen_double_fleet(void *fleet) {
+	delete_fleet<double>(fleet);
+}
+
+float refgen_float_computeref_batch(void *fleet, float RG_IN *data, const unsigned int RG_IN *offsets, unsigned int spaceSize,
+									unsigned int n_agents, float RG_OUT *refs) {
+	return refgeg_computeref_batch_impl<float>(fleet, data, offsets, spaceSize, n_agents, refs);
+}
+
+double refgen_double_computeref_batch(void *fleet, double RG_IN *data, const unsigned int RG_IN *offsets, unsigned int spaceSize,
+									  unsigned int n_agents, double RG_OUT *refs) {
+	return refgeg_computeref_batch_impl<double>(fleet, data, offsets, spaceSize, n_agents, refs);
+}
+
+float refgen_float_computeref_grid(void *fleet, const float RG_IN *positions, const float RG_IN *targets, unsigned int spaceSize,
+								   unsigned int n_agents, float eps, float RG_OUT *refs, float RG_OUT *truncation) {
+	return refgeg_computeref_grid_impl<float>(fleet, positions, targets, spaceSize, n_agents, eps, refs, truncation);
+}
+
+double refgen_double_computeref_grid(void *fleet, const double RG_IN *positions, const double RG_IN *targets, unsigned int spaceSize,
+									 unsigned int n_agents, double eps, double RG_OUT *refs, double RG_OUT *truncation) {
+	return refgeg_computeref_grid_impl<double>(fleet, positions, targets, spaceSize, n_agents, eps, refs, truncation);
+}
+
+float refgen_float_computeref_ext(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length, float RG_OUT *ref,
+								  unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	return refgeg_computeref_ext_impl<float>(refgen, data, spaceSize, length, ref, iterations, evaluations);
+}
+
+double refgen_double_computeref_ext(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref,
+									unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	return refgeg_computeref_ext_impl<double>(refgen, data, spaceSize, length, ref, iterations, evaluations);
+}
+
+void refgen_float_set_stop(void *refgen, float step_tol, unsigned int window, float plateau_tol, unsigned int min_iter) {
+	refgen_set_stop_impl<float>(refgen, step_tol, window, plateau_tol, min_iter);
+}
+
+void refgen_double_set_stop(void *refgen, double step_tol, unsigned int window, double plateau_tol, unsigned int min_iter) {
+	refgen_set_stop_impl<double>(refgen, step_tol, window, plateau_tol, min_iter);
+}
+
+void refgen_float_fleet_set_stop(void *fleet, float step_tol, unsigned int window, float plateau_tol, unsigned int min_iter) {
+	fleet_set_stop_impl<float>(fleet, step_tol, window, plateau_tol, min_iter);
+}
+
+void refgen_double_fleet_set_stop(void *fleet, double step_tol, unsigned int window, double plateau_tol, unsigned int min_iter) {
+	fleet_set_stop_impl<double>(fleet, step_tol, window, plateau_tol, min_iter);
+}
+
+void refgen_float_set_warm_start(void *refgen, int enable, unsigned int iterations, unsigned int gain_offset, float reset_dist) {
+	refgen_set_warm_start_impl<float>(refgen, enable != 0, iterations, gain_offset, reset_dist);
+}
+
+void refgen_double_set_warm_start(void *refgen, int enable, unsigned int iterations, unsigned int gain_offset, double reset_dist) {
+	refgen_set_warm_start_impl<double>(refgen, enable != 0, iterations, gain_offset, reset_dist);
+}
+
+void refgen_float_fleet_set_warm_start(void *fleet, int enable, unsigned int iterations, unsigned int gain_offset, float reset_dist) {
+	fleet_set_warm_start_impl<float>(fleet, enable != 0, iterations, gain_offset, reset_dist);
+}
+
+void refgen_double_fleet_set_warm_start(void *fleet, int enable, unsigned int iterations, unsigned int gain_offset, double reset_dist) {
+	fleet_set_warm_start_impl<double>(fleet, enable != 0, iterations, gain_offset, reset_dist);
+}
+
+void refgen_float_set_multi_start(void *refgen, unsigned int chains, unsigned int iterations, float spread, unsigned int n_threads) {
+	refgen_set_multi_start_impl<float>(refgen, chains, iterations, spread, n_threads);
+}
+
+void refgen_double_set_multi_start(void *refgen, unsigned int chains, unsigned int iterations, double spread, unsigned int n_threads) {
+	refgen_set_multi_start_impl<double>(refgen, chains, iterations, spread, n_threads);
+}
+
+int refgen_float_set_solver(void *refgen, unsigned int solver) {
+	return refgen_set_solver_impl<float>(refgen, solver);
+}
+
+int refgen_double_set_solver(void *refgen, unsigned int solver) {
+	return refgen_set_solver_impl<double>(refgen, solver);
+}
+
+int refgen_float_fleet_set_solver(void *fleet, unsigned int solver) {
+	return fleet_set_solver_impl<float>(fleet, solver);
+}
+
+int refgen_double_fleet_set_solver(void *fleet, unsigned int solver) {
+	return fleet_set_solver_impl<double>(fleet, solver);
+}
+
+int refgen_float_set_population(void *refgen, unsigned int population, unsigned int elites, float sigma, float sigma_min, float smoothing) {
+	return refgen_set_population_impl<float>(refgen, population, elites, sigma, sigma_min, smoothing);
+}
+
+int refgen_double_set_population(void *refgen, unsigned int population, unsigned int elites, double sigma, double sigma_min, double smoothing) {
+	return refgen_set_population_impl<double>(refgen, population, elites, sigma, sigma_min, smoothing);
+}
+
+float refgen_float_begin(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length) {
+	return refgen_begin_impl<float>(refgen, data, spaceSize, length);
+}
+
+float refgen_float_step(void *refgen, unsigned int iterations, unsigned long long budget_ns) {
+	return refgen_step_impl<float>(refgen, iterations, budget_ns);
+}
+
+float refgen_float_finish(void *refgen, float RG_OUT *ref, unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	return refgen_finish_impl<float>(refgen, ref, iterations, evaluations);
+}
+
+double refgen_double_begin(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length) {
+	return refgen_begin_impl<double>(refgen, data, spaceSize, length);
+}
+
+double refgen_double_step(void *refgen, unsigned int iterations, unsigned long long budget_ns) {
+	return refgen_step_impl<double>(refgen, iterations, budget_ns);
+}
+
+double refgen_double_finish(void *refgen, double RG_OUT *ref, unsigned int RG_OUT *iterations, unsigned int RG_OUT *evaluations) {
+	return refgen_finish_impl<double>(refgen, ref, iterations, evaluations);
+}
+
+void refgen_float_fleet_set_multi_start(void *fleet, unsigned int chains, unsigned int iterations, float spread) {
+	fleet_set_multi_start_impl<float>(fleet, chains, iterations, spread);
+}
+
+void refgen_double_fleet_set_multi_start(void *fleet, unsigned int chains, unsigned int iterations, double spread) {
+	fleet_set_multi_start_impl<double>(fleet, chains, iterations, spread);
+}
+
+void *new_refgen_pool(unsigned int n_threads, int pin) {
+	return new rg::ThreadPool(n_threads, pin != 0);
+}
+
+void delete_refgen_pool(void *pool) {
+	delete (rg::ThreadPool *)pool;
+}
+
+float refgen_float_computeref_jobs(void *pool, void * const RG_IN *refgens, float * const RG_IN *data, unsigned int spaceSize,
+								 const unsigned int RG_IN *lengths, float * const RG_OUT *refs, unsigned int n_jobs, float RG_OUT *costs) {
+	return refgen_computeref_jobs_impl<float>(pool, refgens, data, spaceSize, lengths, refs, n_jobs, costs);
+}
+
+void refgen_float_fleet_set_threads(void *fleet, unsigned int n_threads, int pin) {
+	fleet_set_threads_impl<float>(fleet, n_threads, pin != 0);
+}
+
+double refgen_double_computeref_jobs(void *pool, void * const RG_IN *refgens, double * const RG_IN *data, unsigned int spaceSize,
+								 const unsigned int RG_IN *lengths, double * const RG_OUT *refs, unsigned int n_jobs, double RG_OUT *costs) {
+	return refgen_computeref_jobs_impl<double>(pool, refgens, data, spaceSize, lengths, refs, n_jobs, costs);
+}
+
+void refgen_double_fleet_set_threads(void *fleet, unsigned int n_threads, int pin) {
+	fleet_set_threads_impl<double>(fleet, n_threads, pin != 0);
+}
+
+int refgen_async_start(unsigned int n_threads, unsigned int capacity) {
+	std::lock_guard<std::mutex> lock(async_mutex);
+	if (async_engine.load() != nullptr) {
+		return 1;
+	}
+	async_engine.store(new rg::AsyncEngine(n_threads, capacity == 0 ? 1024 : capacity));
+	return 0;
+}
+
+void refgen_async_stop(void) {
+	rg::AsyncEngine *engine;
+	{
+		std::lock_guard<std::mutex> lock(async_mutex);
+		engine = async_engine.exchange(nullptr, std::memory_order_seq_cst);
+	}
+	// the mutex is released first: a concurrent submit may be starting a new engine
+	while (async_users.load(std::memory_order_seq_cst) > 0) {
+		std::this_thread::yield();
+	}
+	delete engine;
+}
+
+int refgen_float_submit(void *refgen, float RG_IN *data, unsigned int spaceSize, unsigned int length, float RG_OUT *ref,
+						refgen_float_callback callback, void *user, unsigned long long RG_OUT *ticket) {
+	return refgen_submit_impl<float>(refgen, data, spaceSize, length, ref, callback, user, ticket);
+}
+
+int refgen_double_submit(void *refgen, double RG_IN *data, unsigned int spaceSize, unsigned int length, double RG_OUT *ref,
+						 refgen_double_callback callback, void *user, unsigned long long RG_OUT *ticket) {
+	return refgen_submit_impl<double>(refgen, data, spaceSize, length, ref, callback, user, ticket);
+}
+
+int refgen_poll(unsigned long long ticket, double RG_OUT *cost) {
+	AsyncUse use;
+	rg::AsyncEngine *engine = async_engine.load(std::memory_order_seq_cst);
+	return engine == nullptr ? RG_ASYNC_UNKNOWN : engine->poll(ticket, cost);
+}
+
+int refgen_wait(unsigned long long ticket, unsigned long long timeout_ns, double RG_OUT *cost) {
+	AsyncUse use;
+	rg::AsyncEngine *engine = async_engine.load(std::memory_order_seq_cst);
+	if (engine == nullptr) {
+		return RG_ASYNC_UNKNOWN;
+	}
+	if (timeout_ns == 0) {
+		return engine->wait(ticket, std::chrono::steady_clock::time_point::max(), cost);
+	}
+	return engine->wait(ticket, std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeout_ns), cost);
+}
+
+int refgen_float_get_stats(void *refgen, refgen_stats RG_OUT *stats) {
+	return refgen_get_stats_impl<float>(refgen, stats);
+}
+
+void refgen_float_reset_stats(void *refgen) {
+	refgen_reset_stats_impl<float>(refgen);
+}
+
+int refgen_float_fleet_get_stats(void *fleet, unsigned int agent, refgen_stats RG_OUT *stats) {
+	return fleet_get_stats_impl<float>(fleet, agent, stats);
+}
+
+int refgen_double_get_stats(void *refgen, refgen_stats RG_OUT *stats) {
+	return refgen_get_stats_impl<double>(refgen, stats);
+}
+
+void refgen_double_reset_stats(void *refgen) {
+	refgen_reset_stats_impl<double>(refgen);
+}
+
+int refgen_double_fleet_get_stats(void *fleet, unsigned int agent, refgen_stats RG_OUT *stats) {
+	return fleet_get_stats_impl<double>(fleet, agent, stats);
+}
+
+int refgen_get_global_stats(refgen_stats RG_OUT *stats) {
+	return copy_stats(rg::globalStats(), stats);
+}
+
+void refgen_reset_global_stats(void) {
+	rg::resetGlobalStats();
+}
+
+void *new_refgen_trace(unsigned int capacity) {
+	return new rg::TraceBuffer(capacity);
+}
+
+void delete_refgen_trace(void *trace) {
+	delete (rg::TraceBuffer *)trace;
+}
+
+long long refgen_trace_dump(void *trace, const char *path) {
+	return ((rg::TraceBuffer *)trace)->dump(path);
+}
+
+int refgen_trace_enabled(void) {
+	return rg::traceEnabled() ? 1 : 0;
+}
+
+void refgen_float_set_trace(void *refgen, void *trace, unsigned int source) {
+	refgen_set_trace_impl<float>(refgen, trace, source);
+}
+
+void refgen_float_fleet_set_trace(void *fleet, void *trace) {
+	fleet_set_trace_impl<float>(fleet, trace);
+}
+
+void refgen_double_set_trace(void *refgen, void *trace, unsigned int source) {
+	refgen_set_trace_impl<double>(refgen, trace, source);
+}
+
+void refgen_double_fleet_set_trace(void *fleet, void *trace) {
+	fleet_set_trace_impl<double>(fleet, trace);
+}
+
+void *new_refgen_recorder(const char *path) {
+	rg::RefgenRecorder *recorder = new rg::RefgenRecorder(path);
+	if (!recorder->good()) {
+		delete recorder;
+		return nullptr;
+	}
+	return recorder;
+}
+
+void delete_refgen_recorder(void *recorder) {
+	delete (rg::RefgenRecorder *)recorder;
+}
+
+int refgen_recorder_flush(void *recorder) {
+	rg::RefgenRecorder *recorderR = (rg::RefgenRecorder *)recorder;
+	recorderR->flush();
+	return recorderR->good() ? 0 : -1;
+}
+
+void refgen_float_set_recorder(void *refgen, void *recorder, unsigned int source) {
+	refgen_set_recorder_impl<float>(refgen, recorder, source);
+}
+
+void refgen_double_set_recorder(void *refgen, void *recorder, unsigned int source) {
+	refgen_set_recorder_impl<double>(refgen, recorder, source);
+}
+
+int refgen_replay(const char *path, unsigned long long *calls, unsigned long long *mismatches) {
+	rg::RecordLog log;
+	if (!log.open(path)) {
+		return -1;
+	}
+
+	rg::ReplayReport report;
+	try {
+		report = rg::replayLog(log);
+	}
+	catch (const std::exception &) {
+		return -1;
+	}
+	if (calls != nullptr) {
+		*calls = report.calls;
+	}
+	if (mismatches != nullptr) {
+		*mismatches = report.mismatches;
+	}
+	return 0;
+}
+
+void *refgen_float_board_open(const char *name, unsigned int capacity, unsigned int spaceSize, int create) {
+	return board_open_impl<float>(name, capacity, spaceSize, create);
+}
+
+void refgen_float_board_close(void *board, int unlink) {
+	board_close_impl<float>(board, unlink);
+}
+
+int refgen_float_board_publish(void *board, unsigned int slot, const float *position) {
+	return board_publish_impl<float>(board, slot, position);
+}
+
+int refgen_float_board_read(void *board, unsigned int slot, float *position) {
+	return board_read_impl<float>(board, slot, position);
+}
+
+float refgen_float_board_computeref(void *refgen, void *board, unsigned int slot, const float *target, const float *position, float *ref,
+	unsigned int *changed) {
+	return board_computeref_impl<float>(refgen, board, slot, target, position, ref, changed);
+}
+
+void *refgen_double_board_open(const char *name, unsigned int capacity, unsigned int spaceSize, int create) {
+	return board_open_impl<double>(name, capacity, spaceSize, create);
+}
+
+void refgen_double_board_close(void *board, int unlink) {
+	board_close_impl<double>(board, unlink);
+}
+
+int refgen_double_board_publish(void *board, unsigned int slot, const double *position) {
+	return board_publish_impl<double>(board, slot, position);
+}
+
+int refgen_double_board_read(void *board, unsigned int slot, double *position) {
+	return board_read_impl<double>(board, slot, position);
+}
+
+double refgen_double_board_computeref(void *refgen, void *board, unsigned int slot, const double *target, const double *position, double *ref,
+	unsigned int *changed) {
+	return board_computeref_impl<double>(refgen, board, slot, target, position, ref, changed);
+}
+
+float refgen_float_computeref_layout(void *refgen, const float *data, const float * const *axes, unsigned int layout, unsigned int stride,
+	unsigned int spaceSize, unsigned int length, float *ref) {
+	return refgen_computeref_layout_impl<float>(refgen, data, axes, layout, stride, spaceSize, length, ref);
+}
+
+double refgen_double_computeref_layout(void *refgen, const double *data, const double * const *axes, unsigned int layout, unsigned int stride,
+	unsigned int spaceSize, unsigned int length, double *ref) {
+	return refgen_computeref_layout_impl<double>(refgen, data, axes, layout, stride, spaceSize, length, ref);
+}
+
+const char *refgen_simd_arch(unsigned int *float_lanes, unsigned int *double_lanes) {
+	size_t flanes = 0, dlanes = 0;
+	const char *name = rg::simdArch<float>(&flanes);
+	rg::simdArch<double>(&dlanes);
+	if (float_lanes != nullptr) {
+		*float_lanes = (unsigned int)flanes;
+	}
+	if (double_lanes != nullptr) {
+		*double_lanes = (unsigned int)dlanes;
+	}
+	return name;
+}
+
+void *new_refgen_q16(int32_t alpha_rate1, int32_t r1, int32_t alpha_rate2, int32_t r2, int32_t max_ni, int32_t alpha_slow,
+					 int32_t d_gauss, int32_t min_alpha_gauss, int32_t max_var) {
+	using Q = rg::Fixed<16>;
+	try {
+		return new rg::RefgenQ16(Q::fromRaw(alpha_rate1), Q::fromRaw(r1), Q::fromRaw(alpha_rate2), Q::fromRaw(r2), Q::fromRaw(max_ni),
+								 Q::fromRaw(alpha_slow), Q::fromRaw(d_gauss), Q::fromRaw(min_alpha_gauss), Q::fromRaw(max_var));
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void *new_refgen_q16_ext(int32_t alpha_rate1, int32_t r1, int32_t alpha_rate2, int32_t r2, int32_t max_ni, int32_t alpha_slow,
+						 int32_t d_gauss, int32_t min_alpha_gauss, int32_t max_var,
+						 unsigned int max_iter, int32_t max_delta, int32_t a, int32_t A, int32_t alpha, int32_t c, int32_t gamma,
+						 unsigned long long seed) {
+	using Q = rg::Fixed<16>;
+	try {
+		return new rg::RefgenQ16(Q::fromRaw(alpha_rate1), Q::fromRaw(r1), Q::fromRaw(alpha_rate2), Q::fromRaw(r2), Q::fromRaw(max_ni),
+								 Q::fromRaw(alpha_slow), Q::fromRaw(d_gauss), Q::fromRaw(min_alpha_gauss), Q::fromRaw(max_var),
+								 max_iter, Q::fromRaw(max_delta), Q::fromRaw(a), Q::fromRaw(A), Q::fromRaw(alpha), Q::fromRaw(c), Q::fromRaw(gamma), seed);
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void delete_refgen_q16(void *refgen) {
+	delete (rg::RefgenQ16 *)refgen;
+}
+
+int64_t refgen_q16_computeref(void *refgen, const int32_t *data, unsigned int spaceSize, unsigned int length, int32_t *ref) {
+	return ((rg::RefgenQ16 *)refgen)->computeRef(data, spaceSize, length, ref).raw;
+}
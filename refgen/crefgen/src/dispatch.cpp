@@ -0,0 +1,109 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+// Selection of the neighbor kernels (@see dispatch.h): scalar and baseline tables, built with the flags of the
+// library, and the ones of the translation units of the wider instruction sets.
+
+#include "simd_kernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+namespace rg {
+	namespace detail {
+
+#ifdef RG_SIMD_DISPATCH
+
+		namespace {
+
+			template<class R>
+			const SimdKernels<R> * scalar_kernels() {
+				static const SimdKernels<R> kernels = isa::make<R, std::false_type>("scalar");
+				return &kernels;
+			}
+
+			template<class R>
+			const SimdKernels<R> * baseline_kernels() {
+				static const SimdKernels<R> kernels = isa::make<R, simd::kernel_tag<R>>("baseline");
+				return &kernels;
+			}
+
+			bool cpu_avx2() {
+#if defined(XTENSOR_USE_XSIMD) && XSIMD_VERSION_MAJOR >= 8
+				return xsimd::available_architectures().avx2 != 0;
+#else
+				return false;
+#endif
+			}
+
+			bool cpu_avx512() {
+#if defined(XTENSOR_USE_XSIMD) && XSIMD_VERSION_MAJOR >= 8
+				return xsimd::available_architectures().avx512f != 0;
+#else
+				return false;
+#endif
+			}
+
+			/** The widest kernels available on this CPU, or the ones named by RG_SIMD_ARCH if they are available.
+			*/
+			template<class R>
+			const SimdKernels<R> * select_kernels() {
+				// from the widest, the tables of the wider instruction sets only if the CPU runs them
+				const SimdKernels<R> *available[4] = {
+					cpu_avx512() ? avx512_kernels(R()) : nullptr,
+					cpu_avx2() ? avx2_kernels(R()) : nullptr,
+					baseline_kernels<R>(),
+					scalar_kernels<R>()
+				};
+
+				const char *forced = std::getenv("RG_SIMD_ARCH");
+				if (forced != nullptr) {
+					for (const SimdKernels<R> *kernels : available) {
+						if (kernels != nullptr && std::strcmp(kernels->name, forced) == 0) {
+							return kernels;
+						}
+					}
+				}
+
+				for (const SimdKernels<R> *kernels : available) {
+					if (kernels != nullptr) {
+						return kernels;
+					}
+				}
+				return nullptr;
+			}
+		}
+
+		const SimdKernels<float> * dispatched_kernels(float) {
+			static const SimdKernels<float> *kernels = select_kernels<float>();
+			return kernels;
+		}
+
+		const SimdKernels<double> * dispatched_kernels(double) {
+			static const SimdKernels<double> *kernels = select_kernels<double>();
+			return kernels;
+		}
+
+		namespace {
+			// the kernels are selected when the library is loaded, not by the first computation
+			const bool kernels_selected = dispatched_kernels(float()) != nullptr && dispatched_kernels(double()) != nullptr;
+		}
+
+#else
+
+		const SimdKernels<float> * dispatched_kernels(float) {
+			return nullptr;
+		}
+
+		const SimdKernels<double> * dispatched_kernels(double) {
+			return nullptr;
+		}
+
+#endif
+	}
+}
@@ -0,0 +1,40 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+// AVX2 kernels: built with the AVX2 flags of the compiler when RG_SIMD_DISPATCH is enabled (@see dispatch.h).
+
+#include "simd_kernels.h"
+
+
+namespace rg {
+	namespace detail {
+
+#if defined(RG_SIMD_DISPATCH) && defined(XTENSOR_USE_XSIMD) && XSIMD_VERSION_MAJOR >= 8 && XSIMD_WITH_AVX2
+
+		const SimdKernels<float> * avx2_kernels(float) {
+			static const SimdKernels<float> kernels = isa::make<float, simd::batch_tag<xsimd::batch<float, xsimd::avx2>>>("avx2");
+			return &kernels;
+		}
+
+		const SimdKernels<double> * avx2_kernels(double) {
+			static const SimdKernels<double> kernels = isa::make<double, simd::batch_tag<xsimd::batch<double, xsimd::avx2>>>("avx2");
+			return &kernels;
+		}
+
+#else
+
+		const SimdKernels<float> * avx2_kernels(float) {
+			return nullptr;
+		}
+
+		const SimdKernels<double> * avx2_kernels(double) {
+			return nullptr;
+		}
+
+#endif
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "crefgen/costfnc.h"
+
+#include <type_traits>
+
+
+namespace rg {
+	namespace detail {
+
+		/** Kernel tables of the translation units built for wider instruction sets (@see SimdKernels): nullptr when
+		* the library is built without RG_SIMD_DISPATCH or the compiler cannot target them. Call them only if the CPU
+		* supports the instruction set: even their initialization may use it.
+		*/
+		const SimdKernels<float> * avx2_kernels(float);
+		const SimdKernels<double> * avx2_kernels(double);
+		const SimdKernels<float> * avx512_kernels(float);
+		const SimdKernels<double> * avx512_kernels(double);
+	}
+}
+
+// The kernels of each instruction set are instances of the templates of costfnc.h with their own batch type. The
+// types below have internal linkage, so every instance built with wider instruction sets is private to its
+// translation unit: the linker never merges it with (and never replaces) the baseline code of the rest of the library.
+namespace {
+	namespace isa {
+
+		template<class R>
+		struct rows {
+			static constexpr bool contiguous = true;
+			const R *data;
+			size_t stride;
+
+			R operator()(size_t i, size_t j) const {
+				return data[i * stride + j];
+			}
+			const R * row(size_t i) const {
+				return data + i * stride;
+			}
+		};
+
+		template<class R>
+		struct per_axis {
+			static constexpr bool contiguous = true;
+			const R * const *axes;
+			size_t first;
+
+			R operator()(size_t i, size_t j) const {
+				return axes[i][first + j];
+			}
+			const R * row(size_t i) const {
+				return axes[i] + first;
+			}
+		};
+
+		template<class R>
+		struct records {
+			static constexpr bool contiguous = false;
+			const R *data;
+			size_t stride;
+
+			R operator()(size_t i, size_t j) const {
+				return data[j * stride + i];
+			}
+		};
+
+		// points packed one after the other, accessed as theta(k, i)
+		template<class R>
+		struct packed {
+			const R *points;
+			size_t spaceSize;
+
+			R operator()(size_t k, size_t i) const {
+				return points[k * spaceSize + i];
+			}
+		};
+
+		// column vector accessed as v(i, 0)
+		template<class R>
+		struct column {
+			R *values;
+
+			R & operator()(size_t i, size_t) const {
+				return values[i];
+			}
+		};
+
+		template<class R, class F>
+		void with_access(const rg::DataLayout<R> &neigh, F &&f) {
+			switch (neigh.type) {
+			case rg::LAYOUT_INTERLEAVED:
+				f(records<R>{ neigh.data + neigh.first * neigh.stride, neigh.stride });
+				break;
+			case rg::LAYOUT_AXES:
+				f(per_axis<R>{ neigh.axes, neigh.first });
+				break;
+			default:
+				f(rows<R>{ neigh.data + neigh.first, neigh.stride });
+				break;
+			}
+		}
+
+		template<size_t K, class R, class A, class Tag>
+		void block_sums(const A &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const R *points, R *out, Tag) {
+			R sums[K];
+			for (size_t k = 0; k < K; k++) {
+				sums[k] = out[k];
+			}
+			rg::detail::gauss_sums(neigh, begin, end, spaceSize, rate, packed<R>{ points, spaceSize }, sums, Tag());
+			for (size_t k = 0; k < K; k++) {
+				out[k] = sums[k];
+			}
+		}
+
+		template<class R, class Tag>
+		void sums(const rg::DataLayout<R> &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const R *points, size_t count, R *out) {
+			with_access(neigh, [&](const auto &access) {
+				switch (count) {
+				case 1:
+					block_sums<1>(access, begin, end, spaceSize, rate, points, out, Tag());
+					break;
+				case 2:
+					block_sums<2>(access, begin, end, spaceSize, rate, points, out, Tag());
+					break;
+				case 8:
+					block_sums<8>(access, begin, end, spaceSize, rate, points, out, Tag());
+					break;
+				default:
+					for (size_t k = 0; k < count; k++) {
+						block_sums<1>(access, begin, end, spaceSize, rate, points + k * spaceSize, out + k, Tag());
+					}
+					break;
+				}
+			});
+		}
+
+		template<class R, class Tag>
+		R moments(const rg::DataLayout<R> &neigh, size_t begin, size_t end, size_t spaceSize, R rate, const R *theta, R *rel) {
+			R sum = 0;
+			column<R> out{ rel };
+			with_access(neigh, [&](const auto &access) {
+				sum = rg::detail::gauss_moments(access, begin, end, spaceSize, rate, column<const R>{ theta }, out, Tag());
+			});
+			return sum;
+		}
+
+		inline size_t lanes(std::false_type) {
+			return 1;
+		}
+
+		template<class B>
+		size_t lanes(rg::simd::batch_tag<B>) {
+			return B::size;
+		}
+
+		/** Kernel table of the instruction set of Tag (std::false_type: scalar, rg::simd::batch_tag<B>: batches B).
+		*/
+		template<class R, class Tag>
+		rg::SimdKernels<R> make(const char *name) {
+			return rg::SimdKernels<R>{ name, lanes(Tag()), &sums<R, Tag>, &moments<R, Tag> };
+		}
+	}
+}
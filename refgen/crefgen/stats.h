@@ -0,0 +1,140 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <atomic>
+#include <chrono>
+
+
+/** Performance counters: compiled in only when RG_ENABLE_STATS is defined (it changes the layout of Refgen, so the
+* library and its users have to agree on it: the CMake option RG_ENABLE_STATS defines it for both).
+* RG_STATS(code) expands to code only when the counters are enabled.
+*/
+#ifdef RG_ENABLE_STATS
+#define RG_STATS(...) __VA_ARGS__
+#else
+#define RG_STATS(...)
+#endif
+
+
+namespace rg {
+
+	/** Counters of the reference computations of a generator (or of all the generators, @see globalStats).
+	*/
+	struct RefgenStats {
+		unsigned long long calls;			/**< references computed (computeRef or finish). */
+		unsigned long long iterations;		/**< solver iterations. */
+		unsigned long long evaluations;		/**< loss evaluations. */
+		unsigned long long delta_clips;		/**< iterations whose step was scaled down to max_delta. */
+		unsigned long long var_clamps;		/**< references pulled back to max_var from the actual position. */
+		unsigned long long ni1_saturated;	/**< calls run with the external constrain multiplier at max_ni. */
+		unsigned long long ns_prepare;		/**< nanoseconds spent mapping the data and updating the multipliers. */
+		unsigned long long ns_solve;		/**< nanoseconds spent in the solver. */
+		unsigned long long ns_finalize;		/**< nanoseconds spent clamping and writing the references. */
+		double ni1;							/**< external constrain multiplier of the last call (0 for the global counters). */
+		double ni2;							/**< internal constrain multiplier of the last call (0 for the global counters). */
+
+		RefgenStats() : calls(0), iterations(0), evaluations(0), delta_clips(0), var_clamps(0), ni1_saturated(0),
+			ns_prepare(0), ns_solve(0), ns_finalize(0), ni1(0), ni2(0) {
+		}
+
+		/** Adds the counters of other (the multipliers are not summed).
+		*/
+		RefgenStats & operator+=(const RefgenStats &other) {
+			calls += other.calls;
+			iterations += other.iterations;
+			evaluations += other.evaluations;
+			delta_clips += other.delta_clips;
+			var_clamps += other.var_clamps;
+			ni1_saturated += other.ni1_saturated;
+			ns_prepare += other.ns_prepare;
+			ns_solve += other.ns_solve;
+			ns_finalize += other.ns_finalize;
+			return *this;
+		}
+	};
+
+	/** True if the library has been built with the performance counters.
+	*/
+	inline bool statsEnabled() {
+#ifdef RG_ENABLE_STATS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	namespace detail {
+
+		/** Counters summed over all the generators: relaxed atomics, written once per reference.
+		*/
+		struct GlobalStats {
+			std::atomic<unsigned long long> calls, iterations, evaluations, delta_clips, var_clamps, ni1_saturated,
+				ns_prepare, ns_solve, ns_finalize;
+
+			GlobalStats() : calls(0), iterations(0), evaluations(0), delta_clips(0), var_clamps(0), ni1_saturated(0),
+				ns_prepare(0), ns_solve(0), ns_finalize(0) {
+			}
+
+			void add(const RefgenStats &s) {
+				calls.fetch_add(s.calls, std::memory_order_relaxed);
+				iterations.fetch_add(s.iterations, std::memory_order_relaxed);
+				evaluations.fetch_add(s.evaluations, std::memory_order_relaxed);
+				delta_clips.fetch_add(s.delta_clips, std::memory_order_relaxed);
+				var_clamps.fetch_add(s.var_clamps, std::memory_order_relaxed);
+				ni1_saturated.fetch_add(s.ni1_saturated, std::memory_order_relaxed);
+				ns_prepare.fetch_add(s.ns_prepare, std::memory_order_relaxed);
+				ns_solve.fetch_add(s.ns_solve, std::memory_order_relaxed);
+				ns_finalize.fetch_add(s.ns_finalize, std::memory_order_relaxed);
+			}
+		};
+
+		inline GlobalStats & globalStatsCounters() {
+			static GlobalStats stats;
+			return stats;
+		}
+
+		inline unsigned long long statsElapsed(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+			return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+		}
+	}
+
+	/** Counters summed over all the generators of the process (all zero unless built with RG_ENABLE_STATS).
+	*/
+	inline RefgenStats globalStats() {
+		detail::GlobalStats &g = detail::globalStatsCounters();
+		RefgenStats s;
+		s.calls = g.calls.load(std::memory_order_relaxed);
+		s.iterations = g.iterations.load(std::memory_order_relaxed);
+		s.evaluations = g.evaluations.load(std::memory_order_relaxed);
+		s.delta_clips = g.delta_clips.load(std::memory_order_relaxed);
+		s.var_clamps = g.var_clamps.load(std::memory_order_relaxed);
+		s.ni1_saturated = g.ni1_saturated.load(std::memory_order_relaxed);
+		s.ns_prepare = g.ns_prepare.load(std::memory_order_relaxed);
+		s.ns_solve = g.ns_solve.load(std::memory_order_relaxed);
+		s.ns_finalize = g.ns_finalize.load(std::memory_order_relaxed);
+		return s;
+	}
+
+	/** Zeroes the counters summed over all the generators.
+	*/
+	inline void resetGlobalStats() {
+		detail::GlobalStats &g = detail::globalStatsCounters();
+		g.calls.store(0);
+		g.iterations.store(0);
+		g.evaluations.store(0);
+		g.delta_clips.store(0);
+		g.var_clamps.store(0);
+		g.ni1_saturated.store(0);
+		g.ns_prepare.store(0);
+		g.ns_solve.store(0);
+		g.ns_finalize.store(0);
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+// Allocation counting hook for tests and benchmarks: it replaces the global operator new/delete,
+// so it must be included by exactly one translation unit of the executable.
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // operator new is malloc based as well
+#endif
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+namespace rgtest {
+
+	inline std::atomic<size_t> & allocCounter() {
+		static std::atomic<size_t> counter(0);
+		return counter;
+	}
+
+	/** Number of heap allocations done by the program so far.
+	*/
+	inline size_t allocations() {
+		return allocCounter().load();
+	}
+}
+
+void * operator new(std::size_t size) {
+	rgtest::allocCounter().fetch_add(1, std::memory_order_relaxed);
+	void *p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void * operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+	std::free(p);
+}
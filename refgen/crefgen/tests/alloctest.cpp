@@ -0,0 +1,98 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/fleet.h"
+#include "alloccount.h"
+#include "testutil.h"
+
+#include <vector>
+#include <iostream>
+
+
+// after the first call a reference generator must not touch the heap anymore
+template<class R, size_t Dim>
+int steadyStateAllocations(size_t spaceSize, size_t length) {
+
+	rg::Refgen<R, Dim> gen((R)0.01, (R)1.414, (R)1000.0, (R)0.0001, (R)500.0, (R)6.0, (R)1.5, (R)30.0, (R)0.3);
+
+	std::vector<R> data(spaceSize * length);
+	for (size_t k = 0; k < data.size(); k++) {
+		data[k] = rgtest::random_value<R>(10);
+	}
+	std::vector<R> ref(spaceSize);
+
+	gen.computeRef(data.data(), spaceSize, length, ref.data()); // warm up
+
+	size_t before = rgtest::allocations();
+	for (int k = 0; k < 100; k++) {
+		gen.computeRef(data.data(), spaceSize, length, ref.data());
+		for (size_t i = 0; i < spaceSize; i++) {
+			data[i * length + 1] = ref[i];
+		}
+	}
+	size_t count = rgtest::allocations() - before;
+
+	std::cout << "space " << spaceSize << " length " << length << " sizeof(R) " << sizeof(R) << " allocations: " << count << std::endl;
+
+	return count == 0 ? 0 : 1;
+}
+
+// the same for a fleet, in the batched and in the grid update (a radius covering the whole fleet: same neighbors in every call)
+template<class R>
+int fleetSteadyStateAllocations(size_t spaceSize, size_t n_agents) {
+
+	rg::Fleet<R> fleet(n_agents, 2, (R)0.01, (R)1.414, (R)1000.0, (R)0.0001, (R)500.0, (R)6.0, (R)1.5, (R)30.0, (R)0.3);
+
+	size_t length = n_agents + 1;
+	std::vector<R> data(n_agents * spaceSize * length), positions(spaceSize * n_agents), targets(spaceSize * n_agents);
+	for (size_t k = 0; k < data.size(); k++) {
+		data[k] = rgtest::random_value<R>(10);
+	}
+	for (size_t k = 0; k < positions.size(); k++) {
+		positions[k] = data[k];
+		targets[k] = data[positions.size() + k];
+	}
+	std::vector<unsigned int> offsets(n_agents + 1);
+	for (size_t k = 0; k <= n_agents; k++) {
+		offsets[k] = (unsigned int)(k * spaceSize * length);
+	}
+	std::vector<R> refs(spaceSize * n_agents);
+
+	// warm up
+	fleet.computeRefBatch(data.data(), offsets.data(), spaceSize, n_agents, refs.data());
+	fleet.computeRefRadius(positions.data(), targets.data(), spaceSize, n_agents, (R)100, refs.data());
+
+	size_t before = rgtest::allocations();
+	for (int k = 0; k < 20; k++) {
+		fleet.computeRefBatch(data.data(), offsets.data(), spaceSize, n_agents, refs.data());
+		fleet.computeRefRadius(positions.data(), targets.data(), spaceSize, n_agents, (R)100, refs.data());
+	}
+	size_t count = rgtest::allocations() - before;
+
+	std::cout << "fleet space " << spaceSize << " agents " << n_agents << " sizeof(R) " << sizeof(R) << " allocations: " << count << std::endl;
+
+	return count == 0 ? 0 : 1;
+}
+
+int main(void) {
+
+	int errors = 0;
+
+	errors += steadyStateAllocations<float, 0>(2, 4);
+	errors += steadyStateAllocations<float, 0>(3, 200);
+	errors += steadyStateAllocations<float, 0>(4, 20);
+	errors += steadyStateAllocations<double, 2>(2, 50);
+	errors += steadyStateAllocations<double, 3>(3, 2);
+	errors += fleetSteadyStateAllocations<float>(2, 8);
+	errors += fleetSteadyStateAllocations<double>(3, 5);
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/async.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <atomic>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <iostream>
+
+
+
+std::atomic<int> completed(0);
+std::atomic<bool> release(false);
+
+void count_completion(rg::AsyncTicket, float, void *user) {
+	(*(std::atomic<int> *)user)++;
+	completed++;
+}
+
+// keeps the worker busy until released
+void hold_completion(rg::AsyncTicket, float, void *) {
+	while (!release.load()) {
+		std::this_thread::yield();
+	}
+}
+
+void failing_completion(rg::AsyncTicket, float, void *) {
+	throw std::runtime_error("callback");
+}
+
+void count_completion_c(unsigned long long, double, void *) {
+	completed++;
+}
+
+
+rg::Refgen<float> make_refgen(size_t seed) {
+	return rg::Refgen<float>(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, seed);
+}
+
+
+int main(void) {
+
+	const size_t n_agents = 32;
+	const size_t spaceSize = 2;
+	const size_t length = 6;
+	const size_t episode_size = 5;
+
+	int errors = 0;
+
+	std::vector<rg::Refgen<float>> serial, async;
+	for (size_t k = 0; k < n_agents; k++) {
+		serial.push_back(make_refgen(k));
+		async.push_back(make_refgen(k));
+	}
+
+	std::vector<float> sdata(n_agents * spaceSize * length), adata;
+	srand(5);
+	for (auto &x : sdata) {
+		x = rgtest::random_value<float>(20);
+	}
+	adata = sdata;
+
+	std::vector<float> srefs(n_agents * spaceSize), arefs(n_agents * spaceSize);
+	std::vector<rg::AsyncTicket> tickets(n_agents);
+	std::vector<std::atomic<int>> calls(n_agents);
+	for (auto &c : calls) {
+		c.store(0);
+	}
+
+	{
+		rg::AsyncEngine engine(3, 64);
+
+		// the jobs of every tick match the serial computation, and each callback runs once
+		for (size_t t = 0; t < episode_size; t++) {
+			for (size_t k = 0; k < n_agents; k++) {
+				if (!engine.submit(async[k], &adata[k * spaceSize * length], spaceSize, length, &arefs[k * spaceSize], tickets[k],
+								   &count_completion, &calls[k])) {
+					errors++;
+				}
+			}
+
+			std::vector<float> scosts(n_agents);
+			for (size_t k = 0; k < n_agents; k++) {
+				scosts[k] = serial[k].computeRef(&sdata[k * spaceSize * length], spaceSize, length, &srefs[k * spaceSize]);
+			}
+
+			for (size_t k = 0; k < n_agents; k++) {
+				double cost = -1;
+				if (engine.wait(tickets[k], std::chrono::steady_clock::time_point::max(), &cost) != rg::ASYNC_DONE || (float)cost != scosts[k]) {
+					errors++;
+				}
+			}
+
+			for (size_t k = 0; k < n_agents * spaceSize; k++) {
+				if (arefs[k] != srefs[k]) {
+					errors++;
+				}
+			}
+
+			// closed loop
+			for (size_t k = 0; k < n_agents; k++) {
+				for (size_t i = 0; i < spaceSize; i++) {
+					sdata[k * spaceSize * length + i * length + 1] = srefs[k * spaceSize + i];
+					adata[k * spaceSize * length + i * length + 1] = arefs[k * spaceSize + i];
+				}
+			}
+		}
+
+		for (auto &c : calls) {
+			if (c.load() != (int)episode_size) {
+				errors++;
+			}
+		}
+		if (engine.poll(0) != rg::ASYNC_UNKNOWN || engine.poll(tickets.back() + 1) != rg::ASYNC_UNKNOWN) {
+			errors++;
+		}
+	}
+
+	{
+		// a single worker held by the first job: the capacity bounds the jobs in flight
+		rg::AsyncEngine engine(1, 4);
+		std::vector<rg::AsyncTicket> held(4);
+		for (size_t k = 0; k < 4; k++) {
+			if (!engine.submit(async[k], &adata[k * spaceSize * length], spaceSize, length, &arefs[k * spaceSize], held[k],
+							   k == 0 ? &hold_completion : nullptr)) {
+				errors++;
+			}
+		}
+		rg::AsyncTicket extra;
+		bool full = !engine.submit(async[4], &adata[4 * spaceSize * length], spaceSize, length, &arefs[4 * spaceSize], extra);
+		bool timedOut = engine.wait(held[0], std::chrono::steady_clock::now() + std::chrono::milliseconds(20)) == rg::ASYNC_PENDING;
+		bool pending = engine.poll(held[3]) == rg::ASYNC_PENDING;
+		release.store(true);
+
+		if (!full || !timedOut || !pending || engine.wait(held[3]) != rg::ASYNC_DONE) {
+			errors++;
+		}
+
+		// a failure is reported on its ticket and the engine keeps working
+		rg::AsyncTicket failing, next;
+		engine.submit(async[5], &adata[5 * spaceSize * length], spaceSize, length, &arefs[5 * spaceSize], failing, &failing_completion);
+		engine.submit(async[6], &adata[6 * spaceSize * length], spaceSize, length, &arefs[6 * spaceSize], next);
+		if (engine.wait(failing) != rg::ASYNC_FAILED || engine.wait(next) != rg::ASYNC_DONE) {
+			errors++;
+		}
+
+		// results older than capacity tickets are gone, the state is still known
+		double cost = -1;
+		if (engine.poll(held[0], &cost) != rg::ASYNC_DONE || cost != -1) {
+			errors++;
+		}
+	}
+
+	{
+		// concurrent submits on a full engine: every ticket is issued once and owns its slot until its job completes
+		const size_t n_submitters = 4, per_submitter = 200;
+		rg::AsyncEngine engine(2, 4);
+		std::vector<rg::AsyncTicket> issued(n_submitters * per_submitter);
+		std::atomic<int> failures(0), done(0);
+		std::vector<std::thread> submitters;
+		for (size_t s = 0; s < n_submitters; s++) {
+			submitters.emplace_back([&, s]() {
+				size_t k = 8 + s;
+				for (size_t j = 0; j < per_submitter; j++) {
+					rg::AsyncTicket &t = issued[s * per_submitter + j];
+					while (!engine.submit(async[k], &adata[k * spaceSize * length], spaceSize, length, &arefs[k * spaceSize], t,
+										  &count_completion, &done)) {
+						std::this_thread::yield();
+					}
+					if (engine.wait(t) != rg::ASYNC_DONE) {
+						failures++;
+					}
+				}
+			});
+		}
+		for (auto &th : submitters) {
+			th.join();
+		}
+		std::vector<bool> seen(issued.size() + 1, false);
+		for (rg::AsyncTicket t : issued) {
+			if (t == 0 || t > issued.size() || seen[t]) {
+				errors++;
+				continue;
+			}
+			seen[t] = true;
+		}
+		if (failures.load() != 0 || done.load() != (int)issued.size()) {
+			errors++;
+		}
+	}
+
+	// C API: submit, poll until done, wait
+	completed.store(0);
+	const unsigned int clength = 3;
+	double cdata[2 * clength] = { 0, 6, 3,
+								  0, 0, 2 };
+	double cref[2], sref[2];
+	void *crefgen = new_refgen_double_ext(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3,
+										  120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 21);
+	void *srefgen = new_refgen_double_ext(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3,
+										  120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 21);
+
+	if (refgen_async_start(2, 16) != 0 || refgen_async_start(2, 16) != 1) {
+		errors++;
+	}
+
+	size_t polls = 0;
+	for (size_t t = 0; t < 20; t++) {
+		unsigned long long ticket = 0;
+		double cost = 0;
+		if (refgen_double_submit(crefgen, cdata, 2, clength, cref, &count_completion_c, nullptr, &ticket) != 0) {
+			errors++;
+		}
+		double scost = refgen_double_computeref(srefgen, cdata, 2, clength, sref);
+		while (refgen_poll(ticket, nullptr) == RG_ASYNC_PENDING) {
+			polls++;
+			std::this_thread::yield();
+		}
+		if (refgen_wait(ticket, 0, &cost) != RG_ASYNC_DONE || cost != scost || cref[0] != sref[0] || cref[1] != sref[1]) {
+			errors++;
+		}
+		cdata[1] = cref[0];
+		cdata[clength + 1] = cref[1];
+	}
+
+	// stop while other threads poll: they see the engine until it is gone, then RG_ASYNC_UNKNOWN
+	std::atomic<bool> stopped(false);
+	std::vector<std::thread> pollers;
+	for (size_t p = 0; p < 3; p++) {
+		pollers.emplace_back([&]() {
+			while (!stopped.load()) {
+				refgen_poll(1, nullptr);
+			}
+		});
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	refgen_async_stop();
+	stopped.store(true);
+	for (auto &th : pollers) {
+		th.join();
+	}
+
+	if (completed.load() != 20 || refgen_poll(1, nullptr) != RG_ASYNC_UNKNOWN) {
+		errors++;
+	}
+
+	delete_refgen_double(crefgen);
+	delete_refgen_double(srefgen);
+
+	std::cout << "asynchronous computations: polls " << polls << " errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
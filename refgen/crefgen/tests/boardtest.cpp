@@ -0,0 +1,282 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/board.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+
+// data block of the agent k: [target position others...], the others in slot order
+std::vector<double> gather(const std::vector<double> &positions, const std::vector<double> &targets, size_t spaceSize, size_t n, size_t k) {
+	size_t length = n + 1;
+	std::vector<double> block(spaceSize * length);
+	for (size_t i = 0; i < spaceSize; i++) {
+		block[i * length] = targets[i * n + k];
+		block[i * length + 1] = positions[i * n + k];
+		size_t col = 2;
+		for (size_t j = 0; j < n; j++) {
+			if (j != k) {
+				block[i * length + col++] = positions[i * n + j];
+			}
+		}
+	}
+	return block;
+}
+
+
+int main(void) {
+
+	const size_t n = 40;
+	const size_t spaceSize = 2;
+	int errors = 0;
+
+	srand(11);
+
+	std::vector<double> positions(spaceSize * n), targets(spaceSize * n);
+	for (size_t k = 0; k < spaceSize * n; k++) {
+		positions[k] = rgtest::random_value(8);
+		targets[k] = positions[k] + rgtest::random_value(3);
+	}
+
+	// neighbors read in place with a skipped column: the same references of the gathered blocks
+	double max_diff = 0;
+	int bitwise_errors = 0;
+	for (size_t k = 0; k < n; k++) {
+		rg::Refgen<double> copied(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, k);
+		rg::Refgen<double> inPlace(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, k);
+		rg::Refgen<double, 2> fixed(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, k);
+
+		std::vector<double> block = gather(positions, targets, spaceSize, n, k);
+		double self[2 * spaceSize] = { targets[k], positions[k], targets[n + k], positions[n + k] };
+		double ref[spaceSize], vref[spaceSize], bref[spaceSize];
+
+		copied.computeRef(block.data(), spaceSize, n + 1, ref);
+		inPlace.computeRefView(self, positions.data(), n, n, k, spaceSize, vref);
+		for (size_t i = 0; i < spaceSize; i++) {
+			max_diff = std::max(max_diff, std::abs(ref[i] - vref[i]));
+		}
+
+		// a single unsplit block is summed in the same order
+		fixed.computeRefView(self, block.data() + 2, n + 1, n - 1, n - 1, spaceSize, bref);
+		for (size_t i = 0; i < spaceSize; i++) {
+			bitwise_errors += ref[i] != bref[i] ? 1 : 0;
+		}
+
+		// the next calls use their data block again
+		copied.computeRef(block.data(), spaceSize, n + 1, ref);
+		inPlace.computeRef(block.data(), spaceSize, n + 1, vref);
+		for (size_t i = 0; i < spaceSize; i++) {
+			bitwise_errors += ref[i] != vref[i] ? 1 : 0;
+		}
+	}
+	// split sums round differently, the solver iterations amplify it a little
+	if (max_diff > 1e-5) {
+		errors++;
+	}
+	errors += bitwise_errors;
+	std::cout << "view max ref diff: " << max_diff << " bitwise errors: " << bitwise_errors << std::endl;
+
+	// publish, read and stamps
+#ifdef _WIN32
+	std::string name = "rgboardtest_" + std::to_string((long long)GetCurrentProcessId());
+#else
+	std::string name = "rgboardtest_" + std::to_string((long long)getpid());
+#endif
+	rg::PositionBoard<double> board;
+	if (!board.create(name.c_str(), n, spaceSize)) {
+		std::cout << "cannot create the board " << name << std::endl;
+		return 1;
+	}
+
+	double position[spaceSize];
+	if (board.count() != 0 || board.stamp(3) != 0 || board.read(3, position) || board.stride() != n) {
+		errors++;
+	}
+	double p3[spaceSize] = { 1.5, -2 };
+	board.publish(3, p3);
+	board.publish(3, p3);
+	if (board.count() != 4 || board.stamp(3) != 4 || !board.read(3, position) || position[0] != 1.5 || position[1] != -2 ||
+		board.positions()[board.stride() + 3] != -2) {
+		errors++;
+	}
+	board.retire(3);
+	if (board.read(3, position) || board.stamp(3) != 6) {
+		errors++;
+	}
+	try {
+		board.publish(n, p3);
+		errors++;
+	}
+	catch (...) {
+	}
+
+	// a second mapping of the same board, of the wrong precision: refused
+	rg::PositionBoard<double> mapped;
+	rg::PositionBoard<float> wrong;
+	if (!mapped.open(name.c_str()) || mapped.capacity() != n || mapped.spaceSize() != spaceSize || wrong.open(name.c_str())) {
+		errors++;
+	}
+
+	// all the agents on the board: same references of computeRefView on the positions
+	for (size_t k = 0; k < n; k++) {
+		double pk[spaceSize] = { positions[k], positions[n + k] };
+		board.publish(k, pk);
+	}
+	rg::BoardReader<double> reader;
+	int board_errors = 0;
+	for (size_t k = 0; k < n; k++) {
+		rg::Refgen<double> direct(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, k);
+		rg::Refgen<double> shared(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, k);
+		double self[2 * spaceSize] = { targets[k], positions[k], targets[n + k], positions[n + k] };
+		double target[spaceSize] = { targets[k], targets[n + k] };
+		double pk[spaceSize] = { positions[k], positions[n + k] };
+		double ref[spaceSize], sref[spaceSize];
+		size_t changed = 1;
+
+		direct.computeRefView(self, positions.data(), n, n, k, spaceSize, ref);
+		reader.computeRef(shared, mapped, k, target, pk, sref, &changed);
+		if (changed != 0 || ref[0] != sref[0] || ref[1] != sref[1]) {
+			board_errors++;
+		}
+	}
+	errors += board_errors;
+
+#ifndef _WIN32
+	// writers in other processes: every read is consistent (y == 2 x + slot), the updates are reported
+	const size_t writers = 4;
+	const size_t rounds = 20000;
+	std::vector<pid_t> children;
+	for (size_t w = 0; w < writers; w++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			rg::PositionBoard<double> child;
+			if (!child.open(name.c_str())) {
+				_exit(2);
+			}
+			size_t slot = 1 + w;
+			for (size_t r = 0; r < rounds; r++) {
+				double x = (double)r * 1e-4;
+				double p[spaceSize] = { x, 2 * x + (double)slot };
+				child.publish(slot, p);
+			}
+			_exit(0);
+		}
+		children.push_back(pid);
+	}
+
+	size_t torn = 0, changed_total = 0, computed = 0;
+	rg::Refgen<double> agent(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 1);
+	double target[spaceSize] = { targets[0], targets[n] };
+	double p0[spaceSize] = { positions[0], positions[n] };
+	for (size_t r = 0; r < 2000; r++) {
+		for (size_t slot = 1; slot <= writers; slot++) {
+			if (board.read(slot, position) && position[1] != 2 * position[0] + (double)slot && position[1] != positions[n + slot]) {
+				torn++;
+			}
+		}
+		double ref[spaceSize];
+		size_t changed = 0;
+		reader.computeRef(agent, board, 0, target, p0, ref, &changed, 2);
+		changed_total += changed;
+		computed++;
+		if (!std::isfinite(ref[0]) || !std::isfinite(ref[1])) {
+			torn++;
+		}
+	}
+
+	for (pid_t pid : children) {
+		int status = 0;
+		if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errors++;
+		}
+	}
+
+	// the writers are done: nothing changes any more, the last positions are there
+	size_t changed = 1;
+	double ref[spaceSize];
+	reader.computeRef(agent, board, 0, target, p0, ref, &changed);
+	double last = (double)(rounds - 1) * 1e-4;
+	for (size_t slot = 1; slot <= writers; slot++) {
+		if (!board.read(slot, position) || position[0] != last || position[1] != 2 * last + (double)slot ||
+			board.stamp(slot) < 2 * rounds || (board.stamp(slot) & 1)) {
+			errors++;
+		}
+	}
+	if (changed != 0 || torn != 0) {
+		errors++;
+	}
+	std::cout << "writers: " << writers << " computations: " << computed << " neighbors changed meanwhile: " << changed_total
+		<< " torn reads: " << torn << std::endl;
+#endif
+
+	mapped.close();
+	board.close();
+	if (!rg::PositionBoard<double>::remove(name.c_str()) || mapped.open(name.c_str())) {
+		errors++;
+	}
+
+	// C API: same references of a generator reading the positions in place
+	std::string cname = name + "_c";
+	void *cboard = refgen_double_board_open(cname.c_str(), 3, spaceSize, 1);
+	void *copened = refgen_double_board_open(cname.c_str(), 0, 0, 0);
+	void *crefgen = new_refgen_double(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	if (cboard == nullptr || copened == nullptr || refgen_double_board_open("rgboardtest_missing", 0, 0, 0) != nullptr) {
+		std::cout << "cannot open the board " << cname << std::endl;
+		return 1;
+	}
+	double cpositions[2 * 3] = { 0, 0.4, -0.3,
+								 0, 0.2, 0.5 };
+	for (unsigned int k = 0; k < 3; k++) {
+		double p[spaceSize] = { cpositions[k], cpositions[3 + k] };
+		if (refgen_double_board_publish(cboard, k, p) != 1) {
+			errors++;
+		}
+	}
+	// slots out of range are refused instead of throwing
+	double outside[spaceSize] = { 7, 7 };
+	if (refgen_double_board_publish(cboard, 3, outside) != 0 || refgen_double_board_read(copened, 3, outside) != 0 || outside[0] != 7) {
+		errors++;
+	}
+	double ctarget[spaceSize] = { 3, 1 };
+	double cself[2 * spaceSize] = { 3, 0, 1, 0 };
+	double cref[spaceSize], eref[spaceSize];
+	unsigned int cchanged = 1;
+	double cposition[spaceSize] = { 0, 0 };
+	refgen_double_board_computeref(crefgen, copened, 0, ctarget, cposition, cref, &cchanged);
+	rg::Refgen<double> expected(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	expected.computeRefView(cself, cpositions, 3, 3, 0, spaceSize, eref);
+	if (cchanged != 0 || cref[0] != eref[0] || cref[1] != eref[1] || refgen_double_board_read(copened, 2, position) != 1 ||
+		position[1] != 0.5) {
+		errors++;
+	}
+	delete_refgen_double(crefgen);
+	refgen_double_board_close(copened, 0);
+	refgen_double_board_close(cboard, 1);
+	if (refgen_double_board_open(cname.c_str(), 0, 0, 0) != nullptr) {
+		errors++;
+	}
+
+	std::cout << "board errors: " << board_errors << " errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -9,7 +9,6 @@
 #include "crefgen/c_api.h"
 
 #include <cmath>
-#include <chrono>
 #include <iostream>
 
 
@@ -35,25 +34,11 @@ int main(void) {
 
 		float *outRef = new float[2];
 
-		double tavg;
-
-
 		for (int k = 0; k < episode_size; k++) {
-			auto t1 = std::chrono::high_resolution_clock::now();
 			refgen_float_computeref(refgen, data, 2, 4, outRef);
-			auto t2 = std::chrono::high_resolution_clock::now();
-			auto time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-
-			if (k == 0) {
-				tavg = time_span.count();
-			}
-			else
-			{
-				tavg += 1 / k * (time_span.count() - tavg);
-			}
 
 			if (k == episode_size - 1)
-				std::cout << "new ref: " << outRef[0] << ", " << outRef[1] << " avg time: " << tavg << std::endl;
+				std::cout << "new ref: " << outRef[0] << ", " << outRef[1] << std::endl;
 			data[1] = outRef[0];
 			data[5] = outRef[1];
 		}
@@ -63,6 +48,4 @@ int main(void) {
 
 		delete_refgen_float(refgen);
 	}
-	int a;
-	std::cin >> a;
 }
\ No newline at end of file
@@ -0,0 +1,264 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/replay.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+
+
+// batched costs of count candidates against costfncV2 on each of them: equal bit for bit
+template<typename R, size_t Dim>
+int batch_errors(size_t neighbors, size_t count) {
+
+	const size_t spaceSize = Dim;
+	size_t length = 2 + neighbors;
+	std::vector<R> data(spaceSize * length);
+	for (size_t i = 0; i < spaceSize; i++) {
+		data[i * length] = (R)rgtest::random_value(6);
+		data[i * length + 1] = (R)rgtest::random_value(1);
+		for (size_t j = 2; j < length; j++) {
+			data[i * length + j] = (R)rgtest::random_value(5);
+		}
+	}
+
+	rg::costParamV2<R> params;
+	params.ni1 = (R)0.5;
+	params.ni2 = (R)100;
+	params.r1 = (R)1.414;
+	params.r2 = (R)0.0001;
+	params.alpha_slow = (R)6;
+	params.D_gauss = (R)1.5;
+	params.min_alpha_gauss = (R)30;
+	size_t shape[2] = { spaceSize, length };
+	params.data_raw.data = (char *)data.data();
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2;
+
+	size_t stride = count + 3;
+	std::vector<R> candidates(spaceSize * stride, R(-99)), costs(count);
+	for (size_t i = 0; i < spaceSize; i++) {
+		for (size_t p = 0; p < count; p++) {
+			candidates[i * stride + p] = (R)rgtest::random_value(4);
+		}
+	}
+	rg::costfncV2_batch(candidates.data(), stride, count, (void *)&params, costs.data());
+
+	int errors = 0;
+	typename rg::SPSAWorkspace<R, Dim>::vector_type theta;
+	for (size_t p = 0; p < count; p++) {
+		for (size_t i = 0; i < spaceSize; i++) {
+			theta(i, 0) = candidates[i * stride + p];
+		}
+		errors += rg::costfncV2<R>(theta, (void *)&params) != costs[p] ? 1 : 0;
+	}
+	return errors;
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	srand(23);
+
+	// every neighbor and candidate remainder of the SIMD lanes and of the candidate blocks
+	int batch_mismatches = 0;
+	for (size_t neighbors : { 0, 1, 7, 37 }) {
+		for (size_t count : { 1, 5, 8, 19 }) {
+			batch_mismatches += batch_errors<double, 2>(neighbors, count);
+			batch_mismatches += batch_errors<float, 3>(neighbors, count);
+		}
+	}
+	errors += batch_mismatches;
+	std::cout << "batch mismatches: " << batch_mismatches << std::endl;
+
+	// a multimodal function (Rastrigin, minimum in (1, -0.5)): CEM leaves the local minimum it starts in
+	{
+		const double pi = 3.14159265358979;
+		auto rastrigin = [pi](const rg::SPSAWorkspace<double, 2>::vector_type &theta) {
+			double x = theta(0, 0) - 1, y = theta(1, 0) + 0.5;
+			return 6 + x * x - 3 * std::cos(2 * pi * x) + y * y - 3 * std::cos(2 * pi * y);
+		};
+
+		rg::CEMWorkspace<double, 2> ws;
+		ws.theta(0, 0) = 3;
+		ws.theta(1, 0) = 1.5;
+		rg::RademacherGen gen(4);
+		rg::SPSAInfo info;
+		double minimum = rg::CEM(rastrigin, ws, 80, 128, 16, 3.0, 1e-4, 0.5, gen, rg::SPSAStop<double>(), &info);
+		if (minimum > 1e-3 || std::abs(ws.best(0, 0) - 1) > 0.01 || std::abs(ws.best(1, 0) + 0.5) > 0.01 ||
+			info.iterations != 80 || info.evaluations != 80 * 128) {
+			errors++;
+		}
+
+		// the step rule ends the run once the distribution has settled
+		ws.theta(0, 0) = 3;
+		ws.theta(1, 0) = 1.5;
+		rg::SPSAInfo stopped;
+		rg::CEM(rastrigin, ws, 500, 64, 8, 2.0, 1e-6, 0.7, gen, rg::SPSAStop<double>(1e-5), &stopped);
+		if (stopped.iterations >= 500 || stopped.evaluations != stopped.iterations * 64) {
+			errors++;
+		}
+		std::cout << "rastrigin minimum: " << minimum << " in " << ws.best(0, 0) << " " << ws.best(1, 0) << " rounds to settle: "
+			<< stopped.iterations << std::endl;
+
+		// resumed calls go on with the distribution and the best candidate: the same rounds of a single call
+		rg::CEMWorkspace<double, 2> single, chunked;
+		single.theta(0, 0) = chunked.theta(0, 0) = 3;
+		single.theta(1, 0) = chunked.theta(1, 0) = 1.5;
+		rg::RademacherGen genSingle(9), genChunked(9);
+		double costSingle = rg::CEM(rastrigin, single, 40, 32, 6, 2.0, 1e-4, 0.5, genSingle);
+		double costChunked = 0;
+		for (size_t s = 0; s < 4; s++) {
+			chunked.resume = s > 0;
+			costChunked = rg::CEM(rastrigin, chunked, 10, 32, 6, 2.0, 1e-4, 0.5, genChunked);
+		}
+		if (costChunked != costSingle || chunked.best(0, 0) != single.best(0, 0) || chunked.best(1, 0) != single.best(1, 0) ||
+			chunked.theta(0, 0) != single.theta(0, 0) || chunked.theta(1, 0) != single.theta(1, 0)) {
+			errors++;
+		}
+
+		// no candidate with a cost: the starting mean is the result
+		rg::CEMWorkspace<double, 2> undefined;
+		undefined.theta(0, 0) = 0.25;
+		undefined.theta(1, 0) = -0.75;
+		auto nan_loss = [](const rg::SPSAWorkspace<double, 2>::vector_type &) {
+			return std::numeric_limits<double>::quiet_NaN();
+		};
+		if (!std::isnan(rg::CEM(nan_loss, undefined, 5, 8, 2, 1.0, 1e-4, 0.5, gen)) || undefined.best(0, 0) != 0.25 || undefined.best(1, 0) != -0.75) {
+			errors++;
+		}
+	}
+
+	// batched policy, function pointers and a policy evaluated one candidate at a time: the same run
+	{
+		const size_t length = 6;
+		double data[2 * length] = { 4, 0, 0.6, -0.4, 1.2, 0.1,
+									3, 0, 0.3,  0.5, -1, -0.2 };
+		rg::costParamV2<double> params;
+		params.ni1 = 0.5;
+		params.ni2 = 100;
+		params.r1 = 1.414;
+		params.r2 = 0.0001;
+		params.alpha_slow = 6;
+		params.D_gauss = 1.5;
+		params.min_alpha_gauss = 30;
+		size_t shape[2] = { 2, length };
+		params.data_raw.data = (char *)data;
+		params.data_raw.shape = shape;
+		params.data_raw.rank = 2;
+
+		rg::CEMWorkspace<double, 2> wsFun, wsPtr, wsOne;
+		rg::RademacherGen genFun(7), genPtr(7), genOne(7);
+		auto one = [&params](const rg::SPSAWorkspace<double, 2>::vector_type &theta) {
+			return rg::CostV2<double>()(theta, params);
+		};
+		double costFun = rg::CEM(rg::bind_cost(rg::CostV2<double>(), params), wsFun, 30, 20, 5, 0.2, 1e-3, 0.7, genFun);
+		double costPtr = rg::CEM(rg::costfncV2, rg::costfncV2_batch, wsPtr, 30, 20, 5, 0.2, 1e-3, 0.7, (void *)&params, genPtr);
+		double costOne = rg::CEM(one, wsOne, 30, 20, 5, 0.2, 1e-3, 0.7, genOne);
+		if (costFun != costPtr || costFun != costOne || wsFun.best(0, 0) != wsPtr.best(0, 0) || wsFun.best(1, 0) != wsOne.best(1, 0)) {
+			errors++;
+		}
+		std::cout << "cem cost: " << costFun << " " << costPtr << " " << costOne << std::endl;
+	}
+
+	// reference generators: finite references within max_var, same seed same references, recorded calls replay
+	const char *path = "cemtest.bin";
+	{
+		rg::RefgenRecorder recorder(path);
+		for (size_t spaceSize : { 2, 3, 4 }) {
+			size_t length = 2 + 9;
+			std::vector<double> data(spaceSize * length);
+			for (size_t i = 0; i < spaceSize; i++) {
+				data[i * length] = rgtest::random_value(6);
+				data[i * length + 1] = rgtest::random_value(1);
+				for (size_t j = 2; j < length; j++) {
+					data[i * length + j] = rgtest::random_value(5);
+				}
+			}
+
+			rg::Refgen<double> a(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 40, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 5, rg::SOLVER_CEM);
+			rg::Refgen<double> b(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 40, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 5, rg::SOLVER_CEM);
+			a.setPopulation(24, 6, 0.2, 1e-3, 0.8);
+			b.setPopulation(24, 6, 0.2, 1e-3, 0.8);
+			a.setRecorder(&recorder, (uint32_t)spaceSize);
+
+			for (size_t t = 0; t < 3; t++) {
+				std::vector<double> ref(spaceSize), bref(spaceSize);
+				rg::SPSAInfo info;
+				double cost = a.computeRef(data.data(), spaceSize, length, ref.data(), &info);
+				double bcost = b.computeRef(data.data(), spaceSize, length, bref.data());
+
+				double var_sq = 0;
+				for (size_t i = 0; i < spaceSize; i++) {
+					double var = ref[i] - data[i * length + 1];
+					var_sq += var * var;
+					errors += (!std::isfinite(ref[i]) || ref[i] != bref[i]) ? 1 : 0;
+				}
+				if (std::sqrt(var_sq) > 0.3 + 1e-9 || cost != bcost || info.iterations != 40 || info.evaluations < 40 * 24) {
+					errors++;
+				}
+				for (size_t i = 0; i < spaceSize; i++) {
+					data[i * length + 1] = ref[i];
+				}
+			}
+		}
+		int refused = 0;
+		try {
+			rg::Refgen<double> c(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+			c.setPopulation(8, 9, 0.1, 1e-3, 0.5);
+		}
+		catch (...) {
+			refused++;
+		}
+		if (!recorder.close() || refused != 1) {
+			errors++;
+		}
+
+		rg::RecordLog log(path);
+		rg::ReplayReport report = rg::replayLog(log);
+		if (report.calls != 9 || report.mismatches != 0) {
+			errors++;
+		}
+		std::cout << "replayed: " << report.calls << " mismatches: " << report.mismatches << std::endl;
+	}
+	std::remove(path);
+
+	// C API
+	{
+		double data[2 * 5] = { 3, 0, 0.4, -0.3, 1,
+							   1, 0, 0.2, 0.5, -1 };
+		void *crefgen = new_refgen_double_ext(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 40, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 5);
+		refgen_double_set_solver(crefgen, RG_SOLVER_CEM);
+		rg::Refgen<double> expected(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 40, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 5, rg::SOLVER_CEM);
+		expected.setPopulation(16, 4, 0.2, 1e-3, 0.8);
+		double ref[2], eref[2];
+		if (refgen_double_set_population(crefgen, 16, 4, 0.2, 1e-3, 0.8) != 1 || refgen_double_set_population(crefgen, 1, 1, 0.2, 1e-3, 0.8) != 0) {
+			errors++;
+		}
+		refgen_double_computeref(crefgen, data, 2, 5, ref);
+		expected.computeRef(data, 2, 5, eref);
+		if (ref[0] != eref[0] || ref[1] != eref[1]) {
+			errors++;
+		}
+		delete_refgen_double(crefgen);
+	}
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/spsa.h"
+#include "crefgen/costfnc.h"
+#include "c_api_comm.h"
+#include "testutil.h"
+
+#include <xtensor/xarray.hpp>
+#include <xtensor/xrandom.hpp>
+#include <chrono>
+#include <iostream>
+
+
+// compares the runtime sized SPSA solver with the fixed size one on the same problem (same engine state)
+template<class R, size_t Dim>
+int compare(size_t length) {
+
+	std::vector<R> data(Dim * length);
+	for (size_t k = 0; k < data.size(); k++) {
+		data[k] = rgtest::random_value<R>(10);
+	}
+
+	size_t shape[2] = { Dim, length };
+
+	rg::costParamV2<R> params;
+	params.alpha_slow = 6;
+	params.ni1 = 10;
+	params.ni2 = 0;
+	params.r1 = (R)1.414;
+	params.r2 = (R)0.0001;
+	params.min_alpha_gauss = 30;
+	params.D_gauss = (R)1.5;
+	params.data_raw.data = (char *)data.data();
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2;
+
+	auto data_map = xtc::xarray_map_raw<R>(&(params.data_raw));
+	auto actualPos = xt::view(data_map, xt::all(), xt::range(1, 2));
+
+	xt::random::default_engine_type engine_dyn(42);
+	xt::random::default_engine_type engine_fix(42);
+
+	xt::xarray<R> theta_dyn = actualPos;
+	xt::xarray<R> theta_fix = actualPos;
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	R loss_dyn = rg::SPSA<R, xt::xarray<R>>(rg::costfncV2, theta_dyn, 120, (R)0.3, (R)0.4, (R)1, (R)0.602, (R)0.1, (R)0.1, &params, engine_dyn);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	R loss_fix = rg::SPSA<R, Dim>(rg::costfncV2, theta_fix, 120, (R)0.3, (R)0.4, (R)1, (R)0.602, (R)0.1, (R)0.1, &params, engine_fix);
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	int errors = 0;
+	if (loss_dyn != loss_fix) {
+		errors++;
+	}
+	for (size_t k = 0; k < Dim; k++) {
+		if (theta_dyn(k, 0) != theta_fix(k, 0)) {
+			errors++;
+		}
+	}
+
+	std::cout << "dim " << Dim << " sizeof(R) " << sizeof(R) << " dynamic: " << std::chrono::duration<double>(t2 - t1).count()
+		<< " s fixed: " << std::chrono::duration<double>(t3 - t2).count() << " s mismatches: " << errors << std::endl;
+
+	return errors;
+}
+
+int main(void) {
+
+	int errors = 0;
+
+	errors += compare<float, 2>(4);
+	errors += compare<float, 3>(10);
+	errors += compare<double, 2>(4);
+	errors += compare<double, 3>(50);
+
+	// Refgen with a compile time dimension must reject other dimensions
+	rg::Refgen<float, 3> gen(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f);
+	float data[8] = { 0, 1, 1,  1,
+					  0, 1, 1, -1 };
+	float ref[2];
+	try {
+		gen.computeRef(data, 2, 4, ref);
+		errors++;
+	}
+	catch (std::exception &) {
+	}
+
+	return errors == 0 ? 0 : 1;
+}
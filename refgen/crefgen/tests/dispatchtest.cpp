@@ -0,0 +1,237 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/dispatch.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+
+// selected kernels against the plain sums, in every layout and for blocks of points with and without a template
+template<typename R>
+int kernel_errors(const rg::SimdKernels<R> &kernels, size_t spaceSize, size_t neighbors, double tol) {
+
+	size_t length = 2 + neighbors;
+	std::vector<R> rows(spaceSize * length), records(spaceSize * length);
+	std::vector<const R *> axes(spaceSize);
+	for (size_t i = 0; i < spaceSize; i++) {
+		for (size_t j = 0; j < length; j++) {
+			rows[i * length + j] = records[j * spaceSize + i] = (R)rgtest::random_value(4);
+		}
+		axes[i] = &rows[i * length];
+	}
+	rg::DataLayout<R> layouts[3] = { rg::DataLayout<R>::rowMajor(rows.data(), length), rg::DataLayout<R>::interleaved(records.data(), spaceSize),
+									 rg::DataLayout<R>::perAxis(axes.data()) };
+	const R rate = (R)-0.7;
+
+	int errors = 0;
+	for (size_t count : { 1, 2, 5, 8 }) {
+		std::vector<R> points(count * spaceSize);
+		for (R &p : points) {
+			p = (R)rgtest::random_value(4);
+		}
+
+		// plain sums over the neighbors (columns 2..length)
+		std::vector<double> expected(count, 0.0);
+		for (size_t k = 0; k < count; k++) {
+			for (size_t j = 2; j < length; j++) {
+				double dist_sq = 0;
+				for (size_t i = 0; i < spaceSize; i++) {
+					double d = (double)points[k * spaceSize + i] - (double)rows[i * length + j];
+					dist_sq += d * d;
+				}
+				expected[k] += std::exp((double)rate * dist_sq);
+			}
+		}
+
+		for (const rg::DataLayout<R> &layout : layouts) {
+			std::vector<R> sums(count, R(0));
+			kernels.sums(layout, 2, length, spaceSize, rate, points.data(), count, sums.data());
+			for (size_t k = 0; k < count; k++) {
+				errors += rgtest::close(sums[k], expected[k], tol) ? 0 : 1;
+			}
+
+			// moments of the first point
+			std::vector<R> rel(spaceSize, R(0));
+			R weights = kernels.moments(layout, 2, length, spaceSize, rate, points.data(), rel.data());
+			errors += rgtest::close(weights, expected[0], tol) ? 0 : 1;
+			for (size_t i = 0; i < spaceSize; i++) {
+				double moment = 0;
+				for (size_t j = 2; j < length; j++) {
+					double dist_sq = 0;
+					for (size_t l = 0; l < spaceSize; l++) {
+						double d = (double)points[l] - (double)rows[l * length + j];
+						dist_sq += d * d;
+					}
+					moment += std::exp((double)rate * dist_sq) * ((double)points[i] - (double)rows[i * length + j]);
+				}
+				errors += rgtest::close(rel[i], moment, tol * (1 + neighbors)) ? 0 : 1;
+			}
+		}
+	}
+	return errors;
+}
+
+// costs of a fixed set of problems, the same in every run of the test
+template<typename R>
+void costs(std::vector<double> &out) {
+	srand(11);
+	for (size_t spaceSize : { 2, 3 }) {
+		for (size_t neighbors : { 0, 3, 17, 40 }) {
+			size_t length = 2 + neighbors;
+			std::vector<R> data(spaceSize * length);
+			for (R &v : data) {
+				v = (R)rgtest::random_value(5);
+			}
+			rg::costParamV2<R> params;
+			params.ni1 = (R)0.5;
+			params.ni2 = (R)100;
+			params.r1 = (R)1.414;
+			params.r2 = (R)0.0001;
+			params.alpha_slow = (R)6;
+			params.D_gauss = (R)1.5;
+			params.min_alpha_gauss = (R)30;
+			size_t shape[2] = { spaceSize, length };
+			params.data_raw.data = (char *)data.data();
+			params.data_raw.shape = shape;
+			params.data_raw.rank = 2;
+
+			typename rg::SPSAWorkspace<R, 0>::vector_type theta = rg::spsa_vector<R, 0>::make(spaceSize);
+			for (size_t t = 0; t < 4; t++) {
+				for (size_t i = 0; i < spaceSize; i++) {
+					theta(i, 0) = (R)rgtest::random_value(3);
+				}
+				out.push_back(rg::costfncV2<R>(theta, (void *)&params));
+			}
+		}
+	}
+}
+
+// child run: name of the selected kernels and the costs, one value per line
+int child(const char *path) {
+	FILE *file = std::fopen(path, "w");
+	if (file == nullptr) {
+		return 1;
+	}
+	std::vector<double> values;
+	costs<double>(values);
+	costs<float>(values);
+	std::fprintf(file, "%s\n", rg::simdArch<double>());
+	for (double v : values) {
+		std::fprintf(file, "%.17g\n", v);
+	}
+	std::fclose(file);
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+	if (argc == 3 && std::strcmp(argv[1], "--child") == 0) {
+		return child(argv[2]);
+	}
+
+	int errors = 0;
+	srand(24);
+
+	// the reported kernels: a known name, the same from the C API
+	size_t flanes = 0, dlanes = 0;
+	std::string fname = rg::simdArch<float>(&flanes);
+	std::string dname = rg::simdArch<double>(&dlanes);
+	unsigned int cflanes = 0, cdlanes = 0;
+	std::string cname = refgen_simd_arch(&cflanes, &cdlanes);
+	bool known = false;
+	for (const char *name : { "scalar", "baseline", "avx2", "avx512", "builtin" }) {
+		known = known || dname == name;
+	}
+	if (!known || fname != dname || cname != dname || flanes < 1 || dlanes < 1 || cflanes != flanes || cdlanes != dlanes) {
+		errors++;
+	}
+	std::cout << "simd arch: " << dname << " float lanes: " << flanes << " double lanes: " << dlanes << std::endl;
+
+	// the selected kernels compute the plain sums
+	const rg::SimdKernels<double> *dkernels = rg::detail::dispatched_kernels(double());
+	const rg::SimdKernels<float> *fkernels = rg::detail::dispatched_kernels(float());
+	if ((dkernels == nullptr) != (dname == "builtin") || (fkernels == nullptr) != (fname == "builtin")) {
+		errors++;
+	}
+	if (dkernels != nullptr && fkernels != nullptr) {
+		int kernel_mismatches = 0;
+		for (size_t neighbors : { 0, 1, 7, 16, 37 }) {
+			kernel_mismatches += kernel_errors(*dkernels, 2, neighbors, 1e-12);
+			kernel_mismatches += kernel_errors(*dkernels, 3, neighbors, 1e-12);
+			kernel_mismatches += kernel_errors(*fkernels, 2, neighbors, 1e-4);
+			kernel_mismatches += kernel_errors(*fkernels, 3, neighbors, 1e-4);
+		}
+		errors += kernel_mismatches;
+		std::cout << "kernel mismatches: " << kernel_mismatches << std::endl;
+	}
+
+#ifndef _WIN32
+	// RG_SIMD_ARCH forces the kernels of a run: the costs differ from the ones of the widest kernels only by the
+	// order of the sums
+	if (dkernels != nullptr) {
+		std::vector<double> expected;
+		costs<double>(expected);
+		size_t doubles = expected.size();
+		costs<float>(expected);
+
+		for (const char *forced : { "scalar", "baseline", "avx2", "avx512", "none" }) {
+			std::string path = std::string("dispatchtest_") + forced + ".txt";
+			std::string command = std::string("RG_SIMD_ARCH=") + forced + " \"" + argv[0] + "\" --child " + path;
+			if (std::system(command.c_str()) != 0) {
+				errors++;
+				continue;
+			}
+
+			FILE *file = std::fopen(path.c_str(), "r");
+			char name[32] = { 0 };
+			if (file == nullptr || std::fscanf(file, "%31s", name) != 1) {
+				errors++;
+				continue;
+			}
+			// the override is ignored when the kernels are not available
+			bool always = std::strcmp(forced, "scalar") == 0 || std::strcmp(forced, "baseline") == 0;
+			if ((always && std::strcmp(name, forced) != 0) || (std::strcmp(forced, "none") == 0 && dname != name) ||
+				(std::strcmp(name, forced) != 0 && dname != name)) {
+				errors++;
+			}
+
+			size_t count = 0, mismatches = 0;
+			double value;
+			while (std::fscanf(file, "%lf", &value) == 1) {
+				if (count < expected.size() && !rgtest::close(value, expected[count], count < doubles ? 1e-12 : 1e-4)) {
+					mismatches++;
+				}
+				count++;
+			}
+			std::fclose(file);
+			std::remove(path.c_str());
+			if (count != expected.size() || mismatches != 0) {
+				errors++;
+			}
+			std::cout << "RG_SIMD_ARCH=" << forced << ": " << name << " cost mismatches: " << mismatches << std::endl;
+		}
+	}
+#endif
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
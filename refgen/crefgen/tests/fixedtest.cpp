@@ -0,0 +1,193 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/fixedrefgen.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+
+
+using Q16 = rg::Fixed<16>;
+
+rg::FixedRefgen<16> make_fixed(uint64_t seed) {
+	return rg::FixedRefgen<16>(Q16::fromDouble(0.01), Q16::fromDouble(1.414), Q16::fromDouble(1000), Q16::fromDouble(0.0001), Q16::fromDouble(500),
+							   Q16::fromDouble(6), Q16::fromDouble(1.5), Q16::fromDouble(30), Q16::fromDouble(0.3), 120, Q16::fromDouble(0.3),
+							   Q16::fromDouble(0.4), Q16::fromDouble(1), Q16::fromDouble(0.602), Q16::fromDouble(0.1), Q16::fromDouble(0.1), seed);
+}
+
+// fixed point generator against the float one on the trajectory of the float references, with the neighbors drifting
+int reference_errors(size_t spaceSize, unsigned int seed, double &transient_dev, double &max_dev) {
+
+	size_t neighbors = 5, length = 2 + neighbors;
+	std::vector<float> data(spaceSize * length);
+	std::vector<int32_t> qdata(data.size());
+	for (size_t i = 0; i < spaceSize; i++) {
+		data[i * length] = (float)rgtest::random_value(12);
+		data[i * length + 1] = (float)rgtest::random_value(2);
+		for (size_t j = 2; j < length; j++) {
+			data[i * length + j] = (float)rgtest::random_value(10);
+		}
+	}
+
+	rg::Refgen<float> expected(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, seed);
+	rg::FixedRefgen<16> fixed = make_fixed(seed);
+
+	int errors = 0;
+	for (int t = 0; t < 60; t++) {
+		for (size_t k = 0; k < data.size(); k++) {
+			qdata[k] = Q16::fromDouble(data[k]).raw;
+		}
+		std::vector<float> ref(spaceSize);
+		std::vector<int32_t> qref(spaceSize);
+		double cost = expected.computeRef(data.data(), spaceSize, length, ref.data());
+		double qcost = fixed.computeRef(qdata.data(), spaceSize, length, qref.data()).toDouble();
+
+		double dev_sq = 0, var_sq = 0;
+		for (size_t i = 0; i < spaceSize; i++) {
+			double qr = Q16::fromRaw(qref[i]).toDouble();
+			dev_sq += (qr - ref[i]) * (qr - ref[i]);
+			var_sq += (qr - data[i * length + 1]) * (qr - data[i * length + 1]);
+		}
+		double dev = std::sqrt(dev_sq);
+		max_dev = std::max(max_dev, dev);
+		// while far from the target the references match closely (the costs differ mainly by the rounding of alpha_rate1),
+		// near the ring the stochastic steps drift apart
+		if (cost > 1) {
+			transient_dev = std::max(transient_dev, dev);
+			errors += (dev > 5e-3 || std::abs(qcost - cost) > 5e-3 * cost) ? 1 : 0;
+		}
+		errors += (dev > 0.15 || std::sqrt(var_sq) > 0.3 + 1e-3) ? 1 : 0;
+
+		for (size_t i = 0; i < spaceSize; i++) {
+			data[i * length + 1] = ref[i];
+			for (size_t j = 2; j < length; j++) {
+				data[i * length + j] += (float)rgtest::random_value(0.2);
+			}
+		}
+	}
+	return errors;
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	srand(25);
+
+	// arithmetic: exp2, log2 and sqrt against the double ones, symmetric saturation instead of wrap around
+	{
+		double exp_err = 0, log_err = 0, sqrt_err = 0;
+		for (int k = 0; k < 2000; k++) {
+			double x = rgtest::random_value(40);
+			double e = rg::fixed::exp2(Q16::fromDouble(x)).toDouble();
+			exp_err = std::max(exp_err, std::abs(e - std::exp2(Q16::fromDouble(x).toDouble())) / std::max(1.0, std::exp2(x)));
+
+			double y = std::abs(rgtest::random_value(2000)) + 1e-3;
+			double l = rg::fixed::log2(Q16::fromDouble(y)).toDouble();
+			log_err = std::max(log_err, std::abs(l - std::log2(Q16::fromDouble(y).toDouble())));
+
+			double s = rg::fixed::sqrt(rg::FixedAcc<16>(Q16::fromDouble(y))).toDouble();
+			sqrt_err = std::max(sqrt_err, std::abs(s - std::sqrt(Q16::fromDouble(y).toDouble())));
+		}
+		if (exp_err > 1e-4 || log_err > 1e-4 || sqrt_err > 1e-4) {
+			errors++;
+		}
+		std::cout << "exp2 error: " << exp_err << " log2 error: " << log_err << " sqrt error: " << sqrt_err << std::endl;
+
+		Q16 big = Q16::fromDouble(30000);
+		if ((big + big).raw != INT32_MAX || (big * big).raw != INT32_MAX || (-big * big).raw != -INT32_MAX ||
+			rg::fixed::exp2(Q16::fromDouble(-40)).raw != 0 || rg::fixed::exp2(rg::FixedAcc<16>::max()).raw != rg::FixedAcc<16>::max().raw ||
+			(Q16::fromDouble(1.5) * Q16::fromDouble(-2.25)).toDouble() != -3.375 || Q16::fromDouble(3).raw != 3 * RG_Q16_ONE) {
+			errors++;
+		}
+
+		// raw values outside the symmetric range negate to the largest value instead of overflowing
+		if ((-Q16::fromRaw(INT32_MIN)).raw != INT32_MAX || (-rg::FixedAcc<16>::fromRaw(INT64_MIN)).raw != INT64_MAX ||
+			(rg::FixedAcc<16>() - rg::FixedAcc<16>::fromRaw(INT64_MIN)).raw != INT64_MAX || (-Q16::fromRaw(-5)).raw != 5) {
+			errors++;
+		}
+	}
+
+	// references of the float generator reproduced in fixed point
+	{
+		int reference_mismatches = 0;
+		double transient_dev = 0, max_dev = 0;
+		for (size_t spaceSize : { 2, 3 }) {
+			for (unsigned int seed : { 1, 7, 19 }) {
+				reference_mismatches += reference_errors(spaceSize, seed, transient_dev, max_dev);
+			}
+		}
+		errors += reference_mismatches;
+		std::cout << "reference mismatches: " << reference_mismatches << " transient deviation: " << transient_dev
+			<< " max deviation: " << max_dev << std::endl;
+	}
+
+	// closed loop: the agent reaches the ring of radius r1 around the target
+	{
+		int32_t data[2 * 4] = { RG_Q16(2.0), RG_Q16(-0.3), RG_Q16(3.0), RG_Q16(3.0),
+								RG_Q16(1.0), RG_Q16(0.2),  RG_Q16(3.0), RG_Q16(-3.0) };
+		rg::RefgenQ16 fixed(Q16::fromDouble(0.01), Q16::fromDouble(1.414), Q16::fromDouble(1000), Q16::fromDouble(0.0001),
+							Q16::fromDouble(500), Q16::fromDouble(6), Q16::fromDouble(1.5), Q16::fromDouble(30), Q16::fromDouble(0.3));
+		int32_t ref[2];
+		for (int k = 0; k < 200; k++) {
+			fixed.computeRef(data, 2, 4, ref);
+			data[1] = ref[0];
+			data[5] = ref[1];
+		}
+		double dx = Q16::fromRaw(data[0] - data[1]).toDouble(), dy = Q16::fromRaw(data[4] - data[5]).toDouble();
+		double dist = std::sqrt(dx * dx + dy * dy);
+		if (std::abs(dist - 1.414) > 0.05) {
+			errors++;
+		}
+		std::cout << "closed loop distance: " << dist << std::endl;
+	}
+
+	// C API: the same references of the class, invalid parameters refused
+	{
+		int32_t data[2 * 5] = { RG_Q16(3.0), 0, RG_Q16(0.4), RG_Q16(-0.3), RG_Q16(1.0),
+								RG_Q16(1.0), 0, RG_Q16(0.2), RG_Q16(0.5),  RG_Q16(-1.0) };
+		void *crefgen = new_refgen_q16_ext(RG_Q16(0.01), RG_Q16(1.414), RG_Q16(1000.0), RG_Q16(0.0001), RG_Q16(500.0), RG_Q16(6.0), RG_Q16(1.5),
+										   RG_Q16(30.0), RG_Q16(0.3), 120, RG_Q16(0.3), RG_Q16(0.4), RG_Q16(1.0), RG_Q16(0.602), RG_Q16(0.1),
+										   RG_Q16(0.1), 7);
+		rg::FixedRefgen<16> expected = make_fixed(7);
+		for (int k = 0; crefgen != nullptr && k < 5; k++) {
+			int32_t ref[2], eref[2];
+			int64_t cost = refgen_q16_computeref(crefgen, data, 2, 5, ref);
+			rg::FixedAcc<16> ecost = expected.computeRef(data, 2, 5, eref);
+			if (cost != ecost.raw || ref[0] != eref[0] || ref[1] != eref[1]) {
+				errors++;
+			}
+			data[1] = ref[0];
+			data[6] = ref[1];
+		}
+		if (crefgen == nullptr) {
+			errors++;
+		}
+		delete_refgen_q16(crefgen);
+
+		void *refused = new_refgen_q16(RG_Q16(0.01), RG_Q16(1.414), RG_Q16(1000.0), RG_Q16(0.0001), RG_Q16(500.0), RG_Q16(6.0), 0, RG_Q16(30.0),
+									   RG_Q16(0.3));
+		if (refused != nullptr) {
+			errors++;
+			delete_refgen_q16(refused);
+		}
+	}
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/fleet.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+
+
+int main(void) {
+
+	const size_t n_agents = 64;
+	const size_t episode_size = 20;
+	const size_t spaceSize = 2;
+
+	const unsigned long long seed = 1234;
+
+	rg::Fleet<float> fleet(n_agents, 0, 0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+						   120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, seed);
+
+	// same agents computed one by one: each one gets the perturbation stream it has in the fleet
+	std::vector<rg::Refgen<float>> single;
+	for (size_t k = 0; k < n_agents; k++) {
+		single.emplace_back(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, rg::Fleet<float>::agentSeed(seed, k));
+	}
+
+	// different number of threads: same results
+	void *cfleet = new_refgen_float_fleet_ext((unsigned int)n_agents, 3, 0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+											  120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, seed);
+
+	// each agent sees a different number of neighbors (at fixed positions)
+	std::vector<unsigned int> offsets(n_agents + 1);
+	offsets[0] = 0;
+	for (size_t k = 0; k < n_agents; k++) {
+		size_t length = 2 + k % 5;
+		offsets[k + 1] = offsets[k] + (unsigned int)(spaceSize * length);
+	}
+
+	std::vector<float> data(offsets[n_agents]);
+	srand(7);
+	for (size_t k = 0; k < n_agents; k++) {
+		size_t length = (offsets[k + 1] - offsets[k]) / spaceSize;
+		float *block = &data[offsets[k]];
+		for (size_t i = 0; i < spaceSize; i++) {
+			for (size_t j = 0; j < length; j++) {
+				block[i * length + j] = rgtest::random_value<float>(20);
+			}
+		}
+		block[0] = 0;
+		block[length] = 0;
+	}
+	std::vector<float> cdata(data);
+	std::vector<float> sdata(data);
+
+	std::vector<float> refs(spaceSize * n_agents);
+	std::vector<float> crefs(spaceSize * n_agents);
+	std::vector<float> srefs(spaceSize * n_agents);
+
+	double tbatch = 0;
+	double tsingle = 0;
+	int errors = 0;
+
+	// unknown solvers are refused
+	if (refgen_float_fleet_set_solver(cfleet, RG_SOLVER_CEM + 1) != 0 || refgen_float_fleet_set_solver(cfleet, RG_SOLVER_SPSA) != 1) {
+		errors++;
+	}
+
+	for (size_t t = 0; t < episode_size; t++) {
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		fleet.computeRefBatch(data.data(), offsets.data(), spaceSize, n_agents, refs.data());
+		auto t2 = std::chrono::high_resolution_clock::now();
+		tbatch += std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+
+		refgen_float_computeref_batch(cfleet, cdata.data(), offsets.data(), (unsigned int)spaceSize, (unsigned int)n_agents, crefs.data());
+
+		t1 = std::chrono::high_resolution_clock::now();
+		for (size_t k = 0; k < n_agents; k++) {
+			size_t length = (offsets[k + 1] - offsets[k]) / spaceSize;
+			single[k].computeRef(&sdata[offsets[k]], spaceSize, length, &srefs[k * spaceSize]);
+		}
+		t2 = std::chrono::high_resolution_clock::now();
+		tsingle += std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+
+		for (size_t k = 0; k < spaceSize * n_agents; k++) {
+			if (refs[k] != srefs[k] || crefs[k] != srefs[k]) {
+				errors++;
+			}
+		}
+
+		// closed loop: the new reference becomes the actual position
+		for (size_t k = 0; k < n_agents; k++) {
+			size_t length = (offsets[k + 1] - offsets[k]) / spaceSize;
+			for (size_t i = 0; i < spaceSize; i++) {
+				data[offsets[k] + i * length + 1] = refs[k * spaceSize + i];
+				cdata[offsets[k] + i * length + 1] = crefs[k * spaceSize + i];
+				sdata[offsets[k] + i * length + 1] = srefs[k * spaceSize + i];
+			}
+		}
+	}
+
+	// more agents than the fleet ones: reported by a NaN cost
+	if (!std::isnan(refgen_float_computeref_batch(cfleet, cdata.data(), offsets.data(), (unsigned int)spaceSize, (unsigned int)n_agents + 1,
+												  crefs.data()))) {
+		errors++;
+	}
+
+	delete_refgen_float_fleet(cfleet);
+
+	std::cout << "batch time: " << tbatch << " single time: " << tsingle << " mismatches: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/costfnc.h"
+#include "crefgen/gradient.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+
+
+
+// analytic gradient against central differences of the cost returned with it
+template<class P, class G>
+double check_gradient(P &params, G costGrad, size_t spaceSize, size_t length) {
+
+	using V = xt::xarray<double>;
+
+	std::vector<double> data(spaceSize * length);
+	params.data_raw.data = (char *)data.data();
+	size_t shape[2] = { spaceSize, length };
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2;
+
+	double maxErr = 0;
+	for (size_t trial = 0; trial < 20; trial++) {
+
+		for (auto &x : data) {
+			x = rgtest::random_value(8.0);
+		}
+
+		V theta = V(std::vector<size_t>{ spaceSize, 1 });
+		V grad = V(std::vector<size_t>{ spaceSize, 1 });
+		V dummy = V(std::vector<size_t>{ spaceSize, 1 });
+		for (size_t i = 0; i < spaceSize; i++) {
+			theta(i, 0) = data[i * length + 1] + rgtest::random_value(1.0);
+		}
+
+		costGrad(theta, (void *)&params, grad);
+
+		const double h = 1e-6;
+		for (size_t i = 0; i < spaceSize; i++) {
+			V thetaPlus = theta, thetaMinus = theta;
+			thetaPlus(i, 0) += h;
+			thetaMinus(i, 0) -= h;
+			double numeric = (costGrad(thetaPlus, (void *)&params, dummy) - costGrad(thetaMinus, (void *)&params, dummy)) / (2 * h);
+			maxErr = std::max(maxErr, std::abs(numeric - grad(i, 0)) / std::max(1.0, std::abs(numeric)));
+		}
+	}
+
+	return maxErr;
+}
+
+// the cost returned with the gradient is the one of costfncV2
+template<class R>
+int check_cost(R tol) {
+
+	rg::costParamV2<R> params;
+	params.alpha_slow = R(6);
+	params.ni1 = R(0.2);
+	params.ni2 = R(0.05);
+	params.r1 = R(1.414);
+	params.r2 = R(0.3);
+	params.D_gauss = R(1.5);
+	params.min_alpha_gauss = R(30);
+
+	const size_t spaceSize = 2, length = 13;
+	std::vector<R> data(spaceSize * length);
+	for (auto &x : data) {
+		x = rgtest::random_value(R(6));
+	}
+	size_t shape[2] = { spaceSize, length };
+	params.data_raw.data = (char *)data.data();
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2;
+
+	typename rg::spsa_vector<R, 2>::type theta, grad;
+	theta(0, 0) = data[1];
+	theta(1, 0) = data[length + 1];
+
+	R withGrad = rg::costfncV2_grad<R>(theta, (void *)&params, grad);
+	R plain = rg::costfncV2<R>(theta, (void *)&params);
+
+	return std::abs(withGrad - plain) <= tol * std::max<R>(1, std::abs(plain)) ? 0 : 1;
+}
+
+// closed loop toward the target ring through the C API, returns the final distance from the target
+float closed_loop(unsigned int solver, size_t iterations, unsigned int &evaluations) {
+
+	const unsigned int length = 3;
+	float data[2 * length] = { 0, 6, 3,
+							   0, 0, 2 };
+	float ref[2];
+	void *refgen = new_refgen_float_ext(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+										(unsigned int)iterations, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 21);
+	refgen_float_set_solver(refgen, solver);
+	unsigned int used;
+	for (size_t t = 0; t < 60; t++) {
+		refgen_float_computeref_ext(refgen, data, 2, length, ref, &used, &evaluations);
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+	delete_refgen_float(refgen);
+
+	return std::sqrt(data[1] * data[1] + data[length + 1] * data[length + 1]);
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	srand(5);
+
+	rg::costParamV2<double> params2;
+	params2.alpha_slow = 6;
+	params2.ni1 = 0.3;
+	params2.ni2 = 0.02;
+	params2.r1 = 1.414;
+	params2.r2 = 0.3;
+	params2.D_gauss = 1.5;
+	params2.min_alpha_gauss = 30;
+
+	rg::costParam<double> params1;
+	params1.alpha_slow = 6;
+	params1.ni1 = 0.3;
+	params1.ni2 = 0.02;
+	params1.r1 = 1.414;
+	params1.r2 = 0.3;
+
+	using V = xt::xarray<double>;
+	for (size_t spaceSize = 2; spaceSize <= 3; spaceSize++) {
+		for (size_t length : { 2, 3, 9, 14 }) {
+			double err2 = check_gradient(params2, rg::costfncV2_grad<double, V, V>, spaceSize, length);
+			double err1 = length > 2 ? check_gradient(params1, rg::costfnc_grad<double, V, V>, spaceSize, length) : 0;
+			std::cout << "space " << spaceSize << " length " << length << " costfncV2 gradient error: " << err2
+				<< " costfnc gradient error: " << err1 << std::endl;
+			if (err2 > 1e-5 || err1 > 1e-5) {
+				errors++;
+			}
+		}
+	}
+
+	errors += check_cost<float>(1e-5f);
+	errors += check_cost<double>(1e-12);
+
+	// one exact gradient per iteration: a quarter of the SPSA evaluations reach the ring as well
+	unsigned int evalSPSA, evalGrad;
+	float distSPSA = closed_loop(RG_SOLVER_SPSA, 120, evalSPSA);
+	float distGrad = closed_loop(RG_SOLVER_GRADIENT, 30, evalGrad);
+
+	std::cout << "SPSA distance " << distSPSA << " (" << evalSPSA << " evaluations) gradient distance " << distGrad
+		<< " (" << evalGrad << " evaluations)" << std::endl;
+	if (std::abs(distGrad - 1.414f) > 0.3f || evalGrad < 31 || evalGrad > 32) {
+		errors++;
+	}
+
+	return errors == 0 ? 0 : 1;
+}
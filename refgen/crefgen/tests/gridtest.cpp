@@ -0,0 +1,207 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/fleet.h"
+#include "crefgen/spatialgrid.h"
+#include "crefgen/costfnc.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+
+// cost of the agent k at point theta given its data block
+double block_cost(std::vector<double> &block, size_t spaceSize, size_t length, const double *theta, double ni1, double ni2) {
+
+	rg::costParamV2<double> params;
+	params.alpha_slow = 6;
+	params.ni1 = ni1;
+	params.ni2 = ni2;
+	params.r1 = 1.414;
+	params.r2 = 0.0001;
+	params.min_alpha_gauss = 30;
+	params.D_gauss = 1.5;
+
+	size_t shape[2] = { spaceSize, length };
+	params.data_raw.data = (char *)block.data();
+	params.data_raw.shape = shape;
+	params.data_raw.rank = 2;
+
+	typename rg::SPSAWorkspace<double, 0>::vector_type th = rg::spsa_vector<double, 0>::make(spaceSize);
+	for (size_t i = 0; i < spaceSize; i++) {
+		th(i, 0) = theta[i];
+	}
+
+	return rg::costfncV2<double>(th, &params);
+}
+
+
+int main(void) {
+
+	const size_t n_agents = 600;
+	const size_t spaceSize = 2;
+	const double side = 120;
+	const double eps = 1e-9;
+	const double max_var = 0.3;
+	const unsigned long long seed = 99;
+
+	int errors = 0;
+
+	srand(3);
+
+	std::vector<double> positions(spaceSize * n_agents);
+	std::vector<double> targets(spaceSize * n_agents);
+	for (size_t k = 0; k < spaceSize * n_agents; k++) {
+		positions[k] = rgtest::random_value(side);
+		targets[k] = positions[k] + rgtest::random_value(4);
+	}
+
+	// the grid finds exactly the points of the ball
+	double radius = rg::gaussCutoff(1.5, 30.0, eps) + max_var;
+	rg::SpatialGrid<double> grid;
+	grid.build(positions.data(), spaceSize, n_agents, radius);
+
+	std::vector<std::vector<size_t>> culled(n_agents);
+	for (size_t k = 0; k < n_agents; k++) {
+		grid.forEachNeighborOf(k, radius, [&](size_t j) {
+			culled[k].push_back(j);
+		});
+		std::sort(culled[k].begin(), culled[k].end());
+
+		std::vector<size_t> brute;
+		for (size_t j = 0; j < n_agents; j++) {
+			double dist_sq = 0;
+			for (size_t i = 0; i < spaceSize; i++) {
+				double rel = positions[i * n_agents + k] - positions[i * n_agents + j];
+				dist_sq += rel * rel;
+			}
+			if (j != k && dist_sq <= radius * radius) {
+				brute.push_back(j);
+			}
+		}
+		if (brute != culled[k]) {
+			errors++;
+		}
+	}
+	std::cout << "radius: " << radius << " neighbor set mismatches: " << errors << std::endl;
+
+	// same fleets, all neighbors against the culled ones
+	rg::Fleet<double> full(n_agents, 0, 0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, max_var,
+						   120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, seed);
+	rg::Fleet<double> culling(n_agents, 0, 0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, max_var,
+							  120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, seed);
+
+	size_t length = n_agents + 1;
+	std::vector<unsigned int> offsets(n_agents + 1);
+	std::vector<double> data(spaceSize * length * n_agents);
+	for (size_t k = 0; k < n_agents; k++) {
+		offsets[k] = (unsigned int)(k * spaceSize * length);
+		double *block = &data[offsets[k]];
+		for (size_t i = 0; i < spaceSize; i++) {
+			block[i * length] = targets[i * n_agents + k];
+			block[i * length + 1] = positions[i * n_agents + k];
+			size_t col = 2;
+			for (size_t j = 0; j < n_agents; j++) {
+				if (j != k) {
+					block[i * length + col++] = positions[i * n_agents + j];
+				}
+			}
+		}
+	}
+	offsets[n_agents] = (unsigned int)(n_agents * spaceSize * length);
+
+	std::vector<double> refs(spaceSize * n_agents), grefs(spaceSize * n_agents), truncation(n_agents);
+
+	auto t1 = std::chrono::high_resolution_clock::now();
+	full.computeRefBatch(data.data(), offsets.data(), spaceSize, n_agents, refs.data());
+	auto t2 = std::chrono::high_resolution_clock::now();
+	culling.computeRefGrid(positions.data(), targets.data(), spaceSize, n_agents, eps, grefs.data(), nullptr, truncation.data());
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	double max_ref_diff = 0;
+	double max_cost_diff = 0;
+	int bound_errors = 0;
+	for (size_t k = 0; k < n_agents; k++) {
+
+		for (size_t i = 0; i < spaceSize; i++) {
+			max_ref_diff = std::max(max_ref_diff, std::abs(refs[k * spaceSize + i] - grefs[k * spaceSize + i]));
+		}
+
+		if (truncation[k] != (double)(n_agents - 1 - culled[k].size()) * eps) {
+			bound_errors++;
+		}
+
+		// cost error at the new reference (within max_var from the actual position) against the reported bound
+		std::vector<double> fullBlock(data.begin() + offsets[k], data.begin() + offsets[k + 1]);
+		size_t cLength = 2 + culled[k].size();
+		std::vector<double> culledBlock(spaceSize * cLength);
+		for (size_t i = 0; i < spaceSize; i++) {
+			culledBlock[i * cLength] = targets[i * n_agents + k];
+			culledBlock[i * cLength + 1] = positions[i * n_agents + k];
+			for (size_t j = 0; j < culled[k].size(); j++) {
+				culledBlock[i * cLength + 2 + j] = positions[i * n_agents + culled[k][j]];
+			}
+		}
+		double ni1 = 0.01, ni2 = 1000.0;
+		double diff = std::abs(block_cost(fullBlock, spaceSize, length, &grefs[k * spaceSize], ni1, ni2) -
+							   block_cost(culledBlock, spaceSize, cLength, &grefs[k * spaceSize], ni1, ni2));
+		max_cost_diff = std::max(max_cost_diff, diff);
+		if (diff > truncation[k] * (1 + 1e-9) + 1e-12) {
+			bound_errors++;
+		}
+	}
+
+	// an explicit radius equal to the one derived from eps gives the same neighbors and references
+	rg::Fleet<double> within(n_agents, 0, 0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, max_var,
+							 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, seed);
+	std::vector<double> rrefs(spaceSize * n_agents);
+	within.computeRefRadius(positions.data(), targets.data(), spaceSize, n_agents, radius, rrefs.data());
+	for (size_t k = 0; k < n_agents; k++) {
+		if (within.neighborCount(k) != culled[k].size() || culling.neighborCount(k) != culled[k].size()) {
+			bound_errors++;
+		}
+	}
+	if (rrefs != grefs) {
+		errors++;
+	}
+
+	// C API: an eps out of (0, 1) is reported by a NaN cost, the references are left untouched
+	void *cfleet = new_refgen_double_fleet((unsigned int)n_agents, 1, 0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, max_var);
+	std::vector<double> crefs(spaceSize * n_agents, 7.0);
+	for (double eps : { 0.0, 1.0, -1e-6 }) {
+		if (!std::isnan(refgen_double_computeref_grid(cfleet, positions.data(), targets.data(), (unsigned int)spaceSize, (unsigned int)n_agents,
+													  eps, crefs.data(), nullptr)) || crefs[0] != 7.0) {
+			errors++;
+		}
+	}
+	if (std::isnan(refgen_double_computeref_grid(cfleet, positions.data(), targets.data(), (unsigned int)spaceSize, (unsigned int)n_agents, 1e-6,
+												 crefs.data(), nullptr)) || crefs[0] == 7.0) {
+		errors++;
+	}
+	delete_refgen_double_fleet(cfleet);
+
+	if (max_ref_diff > 1e-6) {
+		errors++;
+	}
+	errors += bound_errors;
+
+	std::cout << "full: " << std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << " s"
+		<< " grid: " << std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << " s"
+		<< " max ref diff: " << max_ref_diff << " max cost diff: " << max_cost_diff
+		<< " bound errors: " << bound_errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,199 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/replay.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+
+
+// the same data block in every layout: row major (padded rows), interleaved (padded records) and one array for each axis
+template<typename R>
+struct Blocks {
+	size_t spaceSize, length, rowStride, recordStride;
+	std::vector<R> rows, padded, records;
+	std::vector<std::vector<R>> axis;
+	std::vector<const R *> axes;
+
+	Blocks(size_t spaceSize, size_t length) : spaceSize(spaceSize), length(length), rowStride(length + 3), recordStride(spaceSize + 1),
+		rows(spaceSize * length), padded(spaceSize * (length + 3), R(-99)), records((spaceSize + 1) * length, R(-99)),
+		axis(spaceSize, std::vector<R>(length)), axes(spaceSize) {
+		for (size_t i = 0; i < spaceSize; i++) {
+			axes[i] = axis[i].data();
+		}
+	}
+
+	void set(size_t i, size_t j, R value) {
+		rows[i * length + j] = value;
+		padded[i * rowStride + j] = value;
+		records[j * recordStride + i] = value;
+		axis[i][j] = value;
+	}
+
+	R get(size_t i, size_t j) const {
+		return rows[i * length + j];
+	}
+};
+
+// closed loop episode of generators with the same settings, one for each layout: the references must be equal bit for bit
+template<typename R, size_t Dim>
+int episode(size_t spaceSize, size_t neighbors, rg::SolverType solver, size_t calls, rg::RefgenRecorder *recorder = nullptr) {
+
+	size_t length = 2 + neighbors;
+	Blocks<R> b(spaceSize, length);
+	for (size_t i = 0; i < spaceSize; i++) {
+		b.set(i, 0, (R)rgtest::random_value(6));
+		b.set(i, 1, 0);
+		for (size_t j = 2; j < length; j++) {
+			b.set(i, j, (R)rgtest::random_value(5));
+		}
+	}
+
+	std::vector<std::unique_ptr<rg::Refgen<R, Dim>>> gens;
+	for (size_t g = 0; g < 4; g++) {
+		gens.emplace_back(new rg::Refgen<R, Dim>((R)0.01, (R)1.414, (R)1000.0, (R)0.0001, (R)500.0, (R)6.0, (R)1.5, (R)30.0, (R)0.3,
+			120, (R)0.3, (R)0.4, (R)1.0, (R)0.602, (R)0.1, (R)0.1, 17, solver));
+		gens.back()->setWarmStart(true, 40, 120, 1);
+	}
+	if (recorder != nullptr) {
+		gens[2]->setRecorder(recorder, 0);
+	}
+
+	int errors = 0;
+	std::vector<R> ref(4 * spaceSize);
+	for (size_t t = 0; t < calls; t++) {
+		R cost[4];
+		cost[0] = gens[0]->computeRef(b.rows.data(), spaceSize, length, &ref[0]);
+		cost[1] = gens[1]->computeRef(rg::DataLayout<R>::rowMajor(b.padded.data(), b.rowStride), spaceSize, length, &ref[spaceSize]);
+		cost[2] = gens[2]->computeRef(rg::DataLayout<R>::interleaved(b.records.data(), b.recordStride), spaceSize, length, &ref[2 * spaceSize]);
+		cost[3] = gens[3]->computeRef(rg::DataLayout<R>::perAxis(b.axes.data()), spaceSize, length, &ref[3 * spaceSize]);
+
+		for (size_t g = 1; g < 4; g++) {
+			for (size_t i = 0; i < spaceSize; i++) {
+				errors += ref[g * spaceSize + i] != ref[i] ? 1 : 0;
+			}
+			errors += cost[g] != cost[0] ? 1 : 0;
+		}
+
+		// the agent reaches its reference, the neighbors drift
+		for (size_t i = 0; i < spaceSize; i++) {
+			b.set(i, 1, ref[i]);
+			for (size_t j = 2; j < length; j++) {
+				b.set(i, j, b.get(i, j) + (R)rgtest::random_value(0.2));
+			}
+		}
+	}
+
+	return errors;
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	srand(5);
+
+	// neighbor counts with and without a SIMD remainder, every solver, fixed and runtime dimension
+	int layout_errors = 0;
+	for (size_t neighbors : { 0, 1, 7, 37, 64 }) {
+		layout_errors += episode<double, 0>(2, neighbors, rg::SOLVER_SPSA, 6);
+		layout_errors += episode<float, 0>(3, neighbors, rg::SOLVER_SPSA, 6);
+		layout_errors += episode<double, 3>(3, neighbors, rg::SOLVER_2SPSA, 4);
+		layout_errors += episode<float, 2>(2, neighbors, rg::SOLVER_GRADIENT, 4);
+	}
+	errors += layout_errors;
+	std::cout << "layout mismatches: " << layout_errors << std::endl;
+
+	// neighbors of a view in interleaved records with a skipped column: the same of the row major view
+	{
+		const size_t n = 23, spaceSize = 3;
+		std::vector<double> rows(spaceSize * n), records(spaceSize * n);
+		for (size_t j = 0; j < n; j++) {
+			for (size_t i = 0; i < spaceSize; i++) {
+				rows[i * n + j] = records[j * spaceSize + i] = rgtest::random_value(6);
+			}
+		}
+		double self[2 * spaceSize] = { 2, rows[4], -1, rows[n + 4], 0.5, rows[2 * n + 4] };
+		double ref[spaceSize], iref[spaceSize];
+		rg::Refgen<double> rowGen(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3);
+		rg::Refgen<double> recGen(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3);
+		rowGen.computeRefView(self, rows.data(), n, n, 4, spaceSize, ref);
+		recGen.computeRefView(self, rg::DataLayout<double>::interleaved(records.data(), spaceSize), n, 4, spaceSize, iref);
+		if (ref[0] != iref[0] || ref[1] != iref[1] || ref[2] != iref[2]) {
+			errors++;
+		}
+	}
+
+	// recorded calls on interleaved records are stored row major and replay bit for bit
+	const char *path = "layouttest.bin";
+	{
+		rg::RefgenRecorder recorder(path);
+		errors += episode<double, 0>(2, 9, rg::SOLVER_SPSA, 5, &recorder);
+		if (!recorder.close() || recorder.records() != 6) {
+			errors++;
+		}
+		rg::RecordLog log(path);
+		rg::ReplayReport report = rg::replayLog(log);
+		if (report.calls != 5 || report.mismatches != 0) {
+			errors++;
+		}
+	}
+	std::remove(path);
+
+	// C API: every layout gives the reference of refgen_double_computeref
+	{
+		const unsigned int clength = 5;
+		double rows[2 * clength] = { 3, 0, 0.4, -0.3, 1,
+									 1, 0, 0.2, 0.5, -1 };
+		double records[2 * clength];
+		for (unsigned int j = 0; j < clength; j++) {
+			records[2 * j] = rows[j];
+			records[2 * j + 1] = rows[clength + j];
+		}
+		const double *axes[2] = { rows, rows + clength };
+
+		double ref[2], lref[3][2];
+		void *crefgen[4];
+		for (size_t g = 0; g < 4; g++) {
+			crefgen[g] = new_refgen_double(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+		}
+		refgen_double_computeref(crefgen[0], rows, 2, clength, ref);
+		refgen_double_computeref_layout(crefgen[1], rows, nullptr, RG_LAYOUT_ROW_MAJOR, 0, 2, clength, lref[0]);
+		refgen_double_computeref_layout(crefgen[2], records, nullptr, RG_LAYOUT_INTERLEAVED, 0, 2, clength, lref[1]);
+		refgen_double_computeref_layout(crefgen[3], nullptr, axes, RG_LAYOUT_AXES, 0, 2, clength, lref[2]);
+		for (size_t g = 0; g < 3; g++) {
+			if (lref[g][0] != ref[0] || lref[g][1] != ref[1]) {
+				errors++;
+			}
+		}
+
+		// a block without the actual position, or without the data of its layout, gives NaN instead of throwing
+		double untouched[2] = { 7, 7 };
+		if (!std::isnan(refgen_double_computeref_layout(crefgen[1], rows, nullptr, RG_LAYOUT_ROW_MAJOR, 0, 2, 1, untouched)) ||
+			!std::isnan(refgen_double_computeref_layout(crefgen[2], records, nullptr, RG_LAYOUT_INTERLEAVED, 0, 2, 1, untouched)) ||
+			!std::isnan(refgen_double_computeref_layout(crefgen[3], rows, nullptr, RG_LAYOUT_AXES, 0, 2, clength, untouched)) ||
+			untouched[0] != 7 || untouched[1] != 7) {
+			errors++;
+		}
+		for (size_t g = 0; g < 4; g++) {
+			delete_refgen_double(crefgen[g]);
+		}
+	}
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
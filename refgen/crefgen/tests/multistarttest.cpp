@@ -0,0 +1,93 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+
+
+int main(void) {
+
+	const size_t spaceSize = 2;
+	const size_t length = 5;
+	const size_t episode_size = 40;
+	const size_t chains = 4;
+	const size_t chain_iter = 30;
+
+	int errors = 0;
+
+	// agent behind two close neighbors standing between it and the target
+	float data[spaceSize * length] = { 0, 6, 3, 3, 2,
+									   0, 0, 0.6f, -0.6f, 3 };
+	float sdata[spaceSize * length], cdata[spaceSize * length], pdata[spaceSize * length];
+	std::copy(data, data + spaceSize * length, sdata);
+	std::copy(data, data + spaceSize * length, cdata);
+	std::copy(data, data + spaceSize * length, pdata);
+
+	// same seed: the result does not depend on the number of threads
+	rg::Refgen<float> serial(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 8);
+	serial.setMultiStart(chains, chain_iter, 1.0f, 1);
+
+	void *parallel = new_refgen_float_ext(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+										  120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 8);
+	refgen_float_set_multi_start(parallel, (unsigned int)chains, (unsigned int)chain_iter, 1.0f, 4);
+
+	// a single chain is the plain solver
+	rg::Refgen<float> single(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 8);
+	single.setMultiStart(1, chain_iter, 1.0f, 4);
+	rg::Refgen<float> plain(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 8);
+
+	float ref[spaceSize], pref[spaceSize], sref[spaceSize], plref[spaceSize];
+	double tserial = 0, tparallel = 0;
+
+	for (size_t t = 0; t < episode_size; t++) {
+		rg::SPSAInfo info;
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		float cost = serial.computeRef(data, spaceSize, length, ref, &info);
+		auto t2 = std::chrono::high_resolution_clock::now();
+		unsigned int iterations;
+		float pcost = refgen_float_computeref_ext(parallel, pdata, (unsigned int)spaceSize, (unsigned int)length, pref, &iterations, nullptr);
+		auto t3 = std::chrono::high_resolution_clock::now();
+		tserial += std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+		tparallel += std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count();
+
+		single.computeRef(sdata, spaceSize, length, sref);
+		plain.computeRef(cdata, spaceSize, length, plref);
+
+		if (cost != pcost || info.iterations != chains * chain_iter || iterations != chains * chain_iter) {
+			errors++;
+		}
+		for (size_t i = 0; i < spaceSize; i++) {
+			if (ref[i] != pref[i] || sref[i] != plref[i]) {
+				errors++;
+			}
+			data[i * length + 1] = ref[i];
+			pdata[i * length + 1] = pref[i];
+			sdata[i * length + 1] = sref[i];
+			cdata[i * length + 1] = plref[i];
+		}
+	}
+
+	delete_refgen_float(parallel);
+
+	std::cout << "serial chains: " << tserial << " s parallel chains: " << tparallel << " s"
+		<< " final position: " << data[1] << " " << data[length + 1] << " errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
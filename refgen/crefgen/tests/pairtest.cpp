@@ -0,0 +1,122 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/costfnc.h"
+#include "crefgen/spsa.h"
+#include "testutil.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+
+
+
+// plain version of costfncV2, one neighbor at a time
+template<class R>
+R reference_cost(const std::vector<R> &theta, const rg::costParamV2<R> &params, const R *data, size_t spaceSize, size_t length) {
+
+	R targetOldDiff_sq = 0, targetSqDist = 0, mySqVar = 0;
+	for (size_t i = 0; i < spaceSize; i++) {
+		const R *row = data + i * length;
+		targetOldDiff_sq += (row[0] - row[1]) * (row[0] - row[1]);
+		targetSqDist += (row[0] - theta[i]) * (row[0] - theta[i]);
+		mySqVar += (theta[i] - row[1]) * (theta[i] - row[1]);
+	}
+
+	R alpha_gauss = std::max<R>(std::pow<R>(params.ni1 * targetOldDiff_sq, 4), params.min_alpha_gauss);
+	R coeff_gauss = params.D_gauss / std::log(alpha_gauss);
+
+	R gauss_sum = 0;
+	for (size_t j = 2; j < length; j++) {
+		R diff_sq = 0;
+		for (size_t i = 0; i < spaceSize; i++) {
+			R relPos = theta[i] - data[i * length + j];
+			diff_sq += relPos * relPos;
+		}
+		gauss_sum += std::exp(-diff_sq / (2 * coeff_gauss));
+	}
+
+	R cstr1 = targetSqDist - params.r1 * params.r1;
+	R cstr2 = targetSqDist - params.r2 * params.r2;
+
+	return alpha_gauss * gauss_sum + params.ni1 * cstr1 * cstr1 + params.ni2 * cstr2 * cstr2 + params.alpha_slow * mySqVar;
+}
+
+template<class R>
+int check(R tol) {
+
+	int errors = 0;
+
+	rg::costParamV2<R> params;
+	params.alpha_slow = R(6);
+	params.ni1 = R(0.01);
+	params.ni2 = R(0.001);
+	params.r1 = R(1.414);
+	params.r2 = R(0.0001);
+	params.min_alpha_gauss = R(30);
+	params.D_gauss = R(1.5);
+
+	// different number of neighbors, so that both the SIMD blocks and the scalar tail are used
+	for (size_t spaceSize = 1; spaceSize <= 3; spaceSize++) {
+		for (size_t length = 2; length <= 40; length += 3) {
+
+			std::vector<R> data(spaceSize * length);
+			for (auto &v : data) {
+				v = rgtest::random_value<R>(10);
+			}
+			size_t shape[2] = { spaceSize, length };
+			params.data_raw.data = (char *)data.data();
+			params.data_raw.shape = shape;
+			params.data_raw.rank = 2;
+
+			typename rg::SPSAWorkspace<R, 0>::vector_type thetaPlus = rg::spsa_vector<R, 0>::make(spaceSize);
+			typename rg::SPSAWorkspace<R, 0>::vector_type thetaMinus = rg::spsa_vector<R, 0>::make(spaceSize);
+			std::vector<R> tp(spaceSize), tm(spaceSize);
+			for (size_t i = 0; i < spaceSize; i++) {
+				tp[i] = thetaPlus(i, 0) = data[i * length + 1] + rgtest::random_value<R>(1);
+				tm[i] = thetaMinus(i, 0) = data[i * length + 1] + rgtest::random_value<R>(1);
+			}
+
+			R yplus, yminus;
+			rg::costfncV2_pair(thetaPlus, thetaMinus, (void *)&params, yplus, yminus);
+
+			R yplus_single = rg::costfncV2<R>(thetaPlus, &params);
+			R yminus_single = rg::costfncV2<R>(thetaMinus, &params);
+
+			R yplus_ref = reference_cost(tp, params, data.data(), spaceSize, length);
+			R yminus_ref = reference_cost(tm, params, data.data(), spaceSize, length);
+
+			if (!rgtest::close(yplus, yplus_ref, tol) || !rgtest::close(yminus, yminus_ref, tol) ||
+				!rgtest::close(yplus_single, yplus_ref, tol) || !rgtest::close(yminus_single, yminus_ref, tol)) {
+				std::cout << "mismatch: spaceSize " << spaceSize << " length " << length
+					<< " pair " << yplus << " " << yminus
+					<< " single " << yplus_single << " " << yminus_single
+					<< " reference " << yplus_ref << " " << yminus_ref << std::endl;
+				errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+
+int main(void) {
+
+	srand(11);
+
+	int errors = check<float>(1e-4f) + check<double>(1e-10);
+
+	std::cout << "mismatches: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
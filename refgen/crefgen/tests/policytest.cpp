@@ -0,0 +1,182 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+
+
+
+// cost of the reference generator plus a lane keeping term (weight * y^2), without the pair evaluation
+template<typename R>
+struct LaneCost {
+	R weight = 0;
+
+	template<class E>
+	R operator()(const E &theta, const rg::costParamV2<R> &params) const {
+		return rg::CostV2<R>()(theta, params) + weight * (R)theta(1, 0) * (R)theta(1, 0);
+	}
+
+	template<class E, class G>
+	R grad(const E &theta, const rg::costParamV2<R> &params, G &grad) const {
+		R cost = rg::CostV2<R>().grad(theta, params, grad);
+		grad(1, 0) += 2 * weight * (R)theta(1, 0);
+		return cost + weight * (R)theta(1, 0) * (R)theta(1, 0);
+	}
+};
+
+// custom cost only: squared distance from a point
+template<typename R>
+struct PinCost {
+	R pin[2] = { 0, 0 };
+
+	template<class E>
+	R operator()(const E &theta, const rg::costParamV2<R> &) const {
+		R dx = (R)theta(0, 0) - pin[0], dy = (R)theta(1, 0) - pin[1];
+		return dx * dx + dy * dy;
+	}
+
+	template<class E, class G>
+	R grad(const E &theta, const rg::costParamV2<R> &params, G &grad) const {
+		grad(0, 0) = 2 * ((R)theta(0, 0) - pin[0]);
+		grad(1, 0) = 2 * ((R)theta(1, 0) - pin[1]);
+		return (*this)(theta, params);
+	}
+};
+
+// plain cost without pair and gradient, counting its evaluations
+template<typename R>
+struct CountingCost {
+	mutable size_t evaluations = 0;
+
+	template<class E>
+	R operator()(const E &theta, const rg::costParamV2<R> &params) const {
+		evaluations++;
+		return rg::CostV2<R>()(theta, params);
+	}
+};
+
+
+int main(void) {
+
+	int errors = 0;
+
+	const size_t length = 5;
+	double data[2 * length] = { 4, 0, 0.6, -0.4, 1.2,
+								3, 0, 0.3,  0.5, -1 };
+
+	// functor and function pointer SPSA: same iterations, same results
+	{
+		rg::costParamV2<double> params;
+		params.ni1 = 0.5;
+		params.ni2 = 100;
+		params.r1 = 1.414;
+		params.r2 = 0.0001;
+		params.alpha_slow = 6;
+		params.D_gauss = 1.5;
+		params.min_alpha_gauss = 30;
+		size_t shape[2] = { 2, length };
+		params.data_raw.data = (char *)data;
+		params.data_raw.shape = shape;
+		params.data_raw.rank = 2;
+
+		rg::SPSAWorkspace<double, 2> wsPtr, wsFun;
+		rg::RademacherGen genPtr(9), genFun(9);
+		rg::SPSAInfo infoPtr, infoFun;
+		double costPtr = rg::SPSA(rg::costfncV2, rg::costfncV2_pair, wsPtr, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, (void *)&params, genPtr,
+								  rg::SPSAStop<double>(), &infoPtr);
+		double costFun = rg::SPSA(rg::bind_cost(rg::CostV2<double>(), params), wsFun, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, genFun,
+								  rg::SPSAStop<double>(), &infoFun);
+		if (costPtr != costFun || wsPtr.theta(0, 0) != wsFun.theta(0, 0) || wsPtr.theta(1, 0) != wsFun.theta(1, 0) ||
+			infoPtr.iterations != infoFun.iterations) {
+			errors++;
+		}
+
+		// any callable: a lambda minimizing a quadratic
+		rg::SPSAWorkspace<double, 0> ws(3);
+		rg::RademacherGen gen(1);
+		auto quadratic = [](const rg::SPSAWorkspace<double, 0>::vector_type &theta) {
+			return (theta(0, 0) - 1) * (theta(0, 0) - 1) + (theta(1, 0) + 2) * (theta(1, 0) + 2) + theta(2, 0) * theta(2, 0);
+		};
+		for (size_t i = 0; i < 3; i++) {
+			ws.theta(i, 0) = 0;
+		}
+		double minimum = rg::SPSA(quadratic, ws, 2000, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, gen);
+		if (minimum > 1e-3 || std::abs(ws.theta(0, 0) - 1) > 0.05 || std::abs(ws.theta(1, 0) + 2) > 0.05) {
+			errors++;
+		}
+		std::cout << "functor and pointer cost: " << costFun << " " << costPtr << " lambda minimum: " << minimum << std::endl;
+	}
+
+	// the default policy is the cost of costfncV2: the same references of the generators before the policy parameter
+	for (int solver = 0; solver < 3; solver++) {
+		rg::Refgen<double> plain(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3,
+								 (rg::SolverType)solver);
+		rg::Refgen<double, 0, LaneCost<double>> lane(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3,
+													 (rg::SolverType)solver);
+		double ref[2], lref[2];
+		double cost = plain.computeRef(data, 2, length, ref);
+		double lcost = lane.computeRef(data, 2, length, lref);
+		if (cost != lcost || ref[0] != lref[0] || ref[1] != lref[1]) {
+			errors++;
+		}
+
+		// the policy is what the solvers minimize
+		rg::Refgen<double, 0, PinCost<double>> pinned(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3,
+													  (rg::SolverType)solver);
+		pinned.cost().pin[0] = 0.1;
+		pinned.cost().pin[1] = -0.15;
+		double pref[2];
+		double pcost = pinned.computeRef(data, 2, length, pref);
+		if (std::abs(pref[0] - 0.1) > 0.02 || std::abs(pref[1] + 0.15) > 0.02 || pcost > 1e-3) {
+			errors++;
+		}
+		std::cout << "solver " << solver << " reference of the pinned cost: " << pref[0] << " " << pref[1] << std::endl;
+	}
+
+	// a policy with only the cost: SPSA evaluates the perturbed points one by one, the gradient solver is refused
+	{
+		rg::Refgen<double, 2, CountingCost<double>> counting(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3);
+		rg::Refgen<double, 2> paired(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 3);
+		double ref[2], pref[2];
+		rg::SPSAInfo info;
+		counting.computeRef(data, 2, length, ref, &info);
+		paired.computeRef(data, 2, length, pref);
+		if (counting.cost().evaluations != info.evaluations || std::abs(ref[0] - pref[0]) > 1e-9 || std::abs(ref[1] - pref[1]) > 1e-9) {
+			errors++;
+		}
+
+		int refused = 0;
+		try {
+			counting.setSolver(rg::SOLVER_GRADIENT);
+		}
+		catch (...) {
+			refused++;
+		}
+		try {
+			rg::Refgen<double, 2, CountingCost<double>> gradient(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 120, 0.3, 0.4, 1.0, 0.602,
+																 0.1, 0.1, 3, rg::SOLVER_GRADIENT);
+		}
+		catch (...) {
+			refused++;
+		}
+		counting.setSolver(rg::SOLVER_2SPSA);
+		counting.computeRef(data, 2, length, ref);
+		if (refused != 2 || counting.getSolver() != rg::SOLVER_2SPSA || !std::isfinite(ref[0])) {
+			errors++;
+		}
+	}
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/threadpool.h"
+#include "crefgen/jobs.h"
+#include "crefgen/c_api.h"
+#include "testutil.h"
+
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <chrono>
+#include <stdexcept>
+#include <iostream>
+
+
+
+// every item runs exactly once, whatever the cost of the items
+int check_loops(rg::ThreadPool &pool) {
+
+	int errors = 0;
+	const size_t count = 20000;
+
+	for (size_t grain : { 1, 7, 64 }) {
+		std::vector<std::atomic<int>> visits(count);
+		for (auto &v : visits) {
+			v.store(0);
+		}
+
+		pool.parallelFor(count, grain, [&](size_t k) {
+			// the last items are much more expensive: the first threads have to steal them
+			volatile double x = 0;
+			for (size_t i = 0; i < (k > count - count / 8 ? 2000 : 10); i++) {
+				x = x + std::sqrt((double)i);
+			}
+			visits[k]++;
+		});
+
+		for (auto &v : visits) {
+			if (v.load() != 1) {
+				errors++;
+			}
+		}
+	}
+
+	// exceptions reach the caller and the pool keeps working
+	bool thrown = false;
+	try {
+		pool.parallelFor(1000, 1, [](size_t k) {
+			if (k == 500) {
+				throw std::runtime_error("item 500");
+			}
+		});
+	}
+	catch (const std::runtime_error &) {
+		thrown = true;
+	}
+
+	// a loop inside a loop of the same pool runs on the calling thread
+	std::atomic<size_t> nested(0);
+	pool.parallelFor(16, 1, [&](size_t) {
+		pool.parallelFor(16, 1, [&](size_t) {
+			nested++;
+		});
+	});
+
+	if (!thrown || nested.load() != 256) {
+		errors++;
+	}
+
+	return errors;
+}
+
+
+int main(void) {
+
+	const size_t n_agents = 128;
+	const size_t spaceSize = 2;
+	const size_t episode_size = 10;
+	const size_t threads = std::max<size_t>(rg::hardwareThreads(), 4);
+
+	int errors = 0;
+
+	rg::ThreadPool pool(threads, true);
+	errors += check_loops(pool);
+
+	// agents with very different numbers of neighbors: jobs on the pool match the serial computation
+	std::vector<rg::Refgen<float>> serial, pooled, capi;
+	for (size_t k = 0; k < n_agents; k++) {
+		serial.emplace_back(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, k);
+		pooled.emplace_back(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, k);
+		capi.emplace_back(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, k);
+	}
+
+	std::vector<unsigned int> lengths(n_agents);
+	std::vector<std::vector<float>> sdata(n_agents), pdata(n_agents), cdata(n_agents);
+	srand(3);
+	for (size_t k = 0; k < n_agents; k++) {
+		lengths[k] = (unsigned int)(2 + (k % 4 == 0 ? 200 : k % 5));
+		sdata[k].resize(spaceSize * lengths[k]);
+		for (auto &x : sdata[k]) {
+			x = rgtest::random_value<float>(20);
+		}
+		pdata[k] = sdata[k];
+		cdata[k] = sdata[k];
+	}
+
+	std::vector<float> srefs(spaceSize * n_agents), prefs(spaceSize * n_agents), crefs(spaceSize * n_agents);
+	std::vector<rg::RefgenJob<float, 0>> jobs(n_agents);
+	std::vector<void *> crefgens(n_agents);
+	std::vector<float *> cdataPtr(n_agents), crefsPtr(n_agents);
+
+	void *cpool = new_refgen_pool((unsigned int)threads, 0);
+
+	double tserial = 0, tpool = 0;
+	for (size_t t = 0; t < episode_size; t++) {
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		for (size_t k = 0; k < n_agents; k++) {
+			serial[k].computeRef(sdata[k].data(), spaceSize, lengths[k], &srefs[k * spaceSize]);
+		}
+		auto t2 = std::chrono::high_resolution_clock::now();
+		tserial += std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+
+		for (size_t k = 0; k < n_agents; k++) {
+			jobs[k].refgen = &pooled[k];
+			jobs[k].data = pdata[k].data();
+			jobs[k].spaceSize = spaceSize;
+			jobs[k].length = lengths[k];
+			jobs[k].ref = &prefs[k * spaceSize];
+
+			crefgens[k] = &capi[k];
+			cdataPtr[k] = cdata[k].data();
+			crefsPtr[k] = &crefs[k * spaceSize];
+		}
+
+		t1 = std::chrono::high_resolution_clock::now();
+		rg::computeRefJobs(pool, jobs.data(), n_agents);
+		t2 = std::chrono::high_resolution_clock::now();
+		tpool += std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count();
+
+		refgen_float_computeref_jobs(cpool, crefgens.data(), cdataPtr.data(), (unsigned int)spaceSize, lengths.data(), crefsPtr.data(),
+									 (unsigned int)n_agents, nullptr);
+
+		for (size_t k = 0; k < spaceSize * n_agents; k++) {
+			if (prefs[k] != srefs[k] || crefs[k] != srefs[k]) {
+				errors++;
+			}
+		}
+
+		// closed loop
+		for (size_t k = 0; k < n_agents; k++) {
+			for (size_t i = 0; i < spaceSize; i++) {
+				sdata[k][i * lengths[k] + 1] = srefs[k * spaceSize + i];
+				pdata[k][i * lengths[k] + 1] = prefs[k * spaceSize + i];
+				cdata[k][i * lengths[k] + 1] = crefs[k * spaceSize + i];
+			}
+		}
+	}
+
+	delete_refgen_pool(cpool);
+
+	std::cout << "threads: " << threads << " serial time: " << tserial << " s pool time: " << tpool << " s errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
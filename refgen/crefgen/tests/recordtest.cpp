@@ -0,0 +1,229 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/replay.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+
+
+// closed loop episode of a generator: the target jumps halfway, the actual position reaches each reference
+template<typename R, class G>
+void episode(G &gen, size_t calls, std::vector<R> &refs) {
+
+	const size_t length = 4;
+	R data[2 * length] = { 0, 4, 1,  1,
+						   0, 2, 1, -1 };
+	R ref[2];
+	for (size_t t = 0; t < calls; t++) {
+		if (t == calls / 2) {
+			data[0] = -3;
+			data[length] = 5;
+		}
+		gen.computeRef(data, 2, length, ref);
+		refs.push_back(ref[0]);
+		refs.push_back(ref[1]);
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+}
+
+bool copy_file(const char *from, const char *to, size_t drop, long long flip) {
+	std::ifstream in(from, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (bytes.size() < drop) {
+		return false;
+	}
+	bytes.resize(bytes.size() - drop);
+	if (flip >= 0) {
+		bytes[(size_t)flip] ^= 1;
+	}
+	std::ofstream out(to, std::ios::binary);
+	out.write(bytes.data(), bytes.size());
+	return (bool)out;
+}
+
+// copy of a log with one 64 bits word overwritten
+bool patch_file(const char *from, const char *to, size_t offset, uint64_t value) {
+	std::ifstream in(from, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (bytes.size() < offset + sizeof(value)) {
+		return false;
+	}
+	std::memcpy(&bytes[offset], &value, sizeof(value));
+	std::ofstream out(to, std::ios::binary);
+	out.write(bytes.data(), bytes.size());
+	return (bool)out;
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	const char *path = "recordtest.bin";
+	const char *altered = "recordtest_altered.bin";
+	const size_t calls = 30;
+
+	rg::RefgenRecorder recorder(path);
+	if (!recorder.good()) {
+		std::cout << "cannot write " << path << std::endl;
+		return 1;
+	}
+
+	// warm started SPSA switching to 2SPSA halfway, multi-start gradient solver, fixed dimension generator
+	rg::Refgen<float> warm(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 3);
+	warm.setWarmStart(true, 30, 120, 1.0f);
+	rg::Refgen<double> chains(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3, 80, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 4, rg::SOLVER_GRADIENT);
+	chains.setMultiStart(3, 0, 0.5, 2);
+	chains.setStop(rg::SPSAStop<double>(1e-6, 0, 0, 10));
+	rg::Refgen<float, 2> planar(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 5);
+
+	warm.setRecorder(&recorder, 0);
+	chains.setRecorder(&recorder, 1);
+	planar.setRecorder(&recorder, 2);
+
+	std::vector<float> warmRefs, planarRefs;
+	std::vector<double> chainRefs;
+	episode<float>(warm, calls / 2, warmRefs);
+	warm.setSolver(rg::SOLVER_2SPSA, 1e-3f);
+	episode<float>(warm, calls / 2, warmRefs);
+	episode<double>(chains, calls, chainRefs);
+	episode<float>(planar, calls, planarRefs);
+
+	// not recorded
+	warm.setRecorder(nullptr);
+	episode<float>(warm, 2, warmRefs);
+
+	uint64_t records = recorder.records();
+	if (!recorder.close() || records != 4 + 3 * calls) {
+		errors++;
+	}
+
+	// the log holds the settings and, in place, the results of every call
+	rg::RecordLog log(path);
+	rg::RecordEntry entry;
+	size_t params = 0, read = 0, warmValid = 0;
+	std::vector<size_t> perSource(3, 0);
+	while (log.isOpen() && log.next(entry)) {
+		if (entry.params != nullptr) {
+			params++;
+			continue;
+		}
+		uint32_t source = entry.header->source;
+		size_t k = perSource[source]++;
+		bool same = false;
+		if (source == 1) {
+			same = entry.header->real_size == 8 && std::memcmp(entry.ref.data, &chainRefs[2 * k], 2 * sizeof(double)) == 0;
+		}
+		else {
+			const std::vector<float> &refs = source == 0 ? warmRefs : planarRefs;
+			same = entry.header->real_size == 4 && std::memcmp(entry.ref.data, &refs[2 * k], 2 * sizeof(float)) == 0;
+		}
+		if (!same || entry.header->dim != 2 || entry.header->length != 4 || entry.data.shape[1] != 4 || entry.header->seq != read + params) {
+			errors++;
+		}
+		warmValid += entry.last_ref != nullptr ? 1 : 0;
+		read++;
+	}
+	if (!log.isOpen() || params != 4 || read != 3 * calls || log.truncated() || warmValid == 0) {
+		errors++;
+	}
+
+	// every call replays bit for bit, also a single source on its own
+	rg::ReplayReport report = rg::replayLog(log);
+	rg::ReplayReport single = rg::replayLog(log, 1, 2);
+	if (report.calls != 3 * calls || report.mismatches != 0 || report.skipped != 0 || report.truncated || report.ns.size() != report.calls ||
+		single.calls != 2 * calls || single.mismatches != 0 || single.params != 1) {
+		errors++;
+	}
+	log.close();
+
+	// an altered reference (first byte of the last one) is found, an incomplete last record is reported
+	size_t bytes = 0;
+	{
+		std::ifstream in(path, std::ios::binary | std::ios::ate);
+		bytes = (size_t)in.tellg();
+	}
+	if (copy_file(path, altered, 0, (long long)bytes - 8)) {
+		rg::RecordLog flipped(altered);
+		rg::ReplayReport r = rg::replayLog(flipped);
+		if (r.mismatches != 1 || r.first_mismatch != records - 1) {
+			errors++;
+		}
+	}
+	else {
+		errors++;
+	}
+	if (copy_file(path, altered, 10, -1)) {
+		rg::RecordLog cut(altered);
+		rg::ReplayReport r = rg::replayLog(cut);
+		if (!r.truncated || r.calls != 3 * calls - 1 || r.mismatches != 0) {
+			errors++;
+		}
+	}
+	else {
+		errors++;
+	}
+	std::remove(altered);
+
+	// C API
+	void *crecorder = new_refgen_recorder(path);
+	void *crefgen = new_refgen_double(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	refgen_double_set_recorder(crefgen, crecorder, 7);
+	const unsigned int clength = 3;
+	double cdata[2 * clength] = { 0, 6, 3,
+								  0, 0, 2 };
+	double cref[2];
+	for (size_t t = 0; t < 5; t++) {
+		refgen_double_computeref(crefgen, cdata, 2, clength, cref);
+		cdata[1] = cref[0];
+		cdata[clength + 1] = cref[1];
+	}
+	if (refgen_recorder_flush(crecorder) != 0) {
+		errors++;
+	}
+	delete_refgen_double(crefgen);
+	delete_refgen_recorder(crecorder);
+
+	unsigned long long ccalls = 0, cmismatches = 1;
+	if (refgen_replay(path, &ccalls, &cmismatches) != 0 || ccalls != 5 || cmismatches != 0 ||
+		refgen_replay("recordtest_missing.bin", nullptr, nullptr) != -1) {
+		errors++;
+	}
+
+	// settings a generator refuses (here a population of 1 in the first record) are counted, the calls they rule skipped
+	size_t population = sizeof(rg::RecordFileHeader) + sizeof(rg::RecordHeader) + offsetof(rg::RecordParams, population);
+	if (patch_file(path, altered, population, 1)) {
+		rg::RecordLog corrupt(altered);
+		rg::ReplayReport r = rg::replayLog(corrupt);
+		ccalls = 1;
+		if (r.params != 1 || r.invalid != 1 || r.skipped != 5 || r.calls != 0 || refgen_replay(altered, &ccalls, nullptr) != 0 || ccalls != 0) {
+			errors++;
+		}
+	}
+	else {
+		errors++;
+	}
+	std::remove(altered);
+	std::remove(path);
+
+	std::cout << "recorded records: " << records << " replayed calls: " << report.calls << " mismatches: " << report.mismatches
+		<< " errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
@@ -15,7 +15,6 @@
 #include <xtensor/xnoalias.hpp>
 #include <xtensor/xnorm.hpp>
 #include <cmath>
-#include <chrono>
 #include <iostream>
 
 
@@ -41,25 +40,11 @@ int main(void) {
 
 		float *outRef = new float[2];
 
-		double tavg;
-
-		
 		for (int k = 0; k < episode_size; k++) {
-			auto t1 = std::chrono::high_resolution_clock::now();
 			gen.computeRef(data, 2, 4, outRef);
-			auto t2 = std::chrono::high_resolution_clock::now();
-			auto time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
-
-			if (k == 0) {
-				tavg = time_span.count();
-			}
-			else
-			{
-				tavg +=  1 / k * (time_span.count() - tavg);
-			}
 
 			if (k == episode_size - 1)
-				std::cout << "new ref: " << outRef[0] << ", " << outRef[1] << " avg time: " << tavg << std::endl;
+				std::cout << "new ref: " << outRef[0] << ", " << outRef[1] << std::endl;
 			data[1] = outRef[0];
 			data[5] = outRef[1];
 		}
@@ -67,6 +52,4 @@ int main(void) {
 		delete[] data;
 		delete[] outRef;
 	}
-	int a;
-	std::cin >> a;
 }
\ No newline at end of file
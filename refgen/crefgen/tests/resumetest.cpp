@@ -0,0 +1,122 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+
+
+// one long step and many short ones give the same run: the short ones see all its solutions and more
+int check_steps(rg::SolverType solver) {
+
+	const size_t length = 5;
+	float data[2 * length] = { 0, 4, 3.5f, 5, 2,
+							   0, 1, 1.2f, -1, 3 };
+
+	rg::Refgen<float> single(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							 120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 11, solver);
+	rg::Refgen<float> chunked(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							  120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 11, solver);
+
+	int errors = 0;
+
+	for (size_t t = 0; t < 5; t++) {
+
+		float refSingle[2], refChunked[2];
+		rg::SPSAInfo infoSingle, infoChunked;
+
+		float start = single.begin(data, 2, length);
+		single.step(120);
+		float costSingle = single.finish(refSingle, &infoSingle);
+
+		chunked.begin(data, 2, length);
+		for (size_t s = 0; s < 4; s++) {
+			chunked.step(30);
+		}
+		float costChunked = chunked.finish(refChunked, &infoChunked);
+
+		float var = std::sqrt((refChunked[0] - data[1]) * (refChunked[0] - data[1]) + (refChunked[1] - data[length + 1]) * (refChunked[1] - data[length + 1]));
+
+		if (costChunked > costSingle * (1 + 1e-6f) || infoSingle.iterations != 120 || infoChunked.iterations != 120 || var > 0.3f + 1e-5f) {
+			errors++;
+		}
+
+		std::cout << "solver " << solver << " start " << start << " single " << costSingle << " (" << infoSingle.evaluations << " evaluations)"
+			<< " chunked " << costChunked << " (" << infoChunked.evaluations << " evaluations)" << std::endl;
+
+		// closed loop
+		data[1] = refSingle[0];
+		data[length + 1] = refSingle[1];
+	}
+
+	return errors;
+}
+
+
+int main(void) {
+
+	int errors = check_steps(rg::SOLVER_SPSA);
+	errors += check_steps(rg::SOLVER_2SPSA);
+	errors += check_steps(rg::SOLVER_GRADIENT);
+	errors += check_steps(rg::SOLVER_CEM);
+
+	// control frames through the C API: whatever the time left, a valid reference comes out
+	const unsigned int length = 3;
+	double data[2 * length] = { 0, 6, 3,
+								0, 0, 2 };
+	double ref[2];
+	void *refgen = new_refgen_double_ext(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3,
+										 120, 0.3, 0.4, 1.0, 0.602, 0.1, 0.1, 21);
+
+	unsigned int iterations = 0, evaluations = 0;
+	double maxFrame = 0;
+	for (size_t t = 0; t < 60; t++) {
+		auto t1 = std::chrono::steady_clock::now();
+		refgen_double_begin(refgen, data, 2, length);
+		// spare time of the frame
+		refgen_double_step(refgen, 0, 200000ull);
+		refgen_double_finish(refgen, ref, &iterations, &evaluations);
+		auto t2 = std::chrono::steady_clock::now();
+		maxFrame = std::max(maxFrame, std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count());
+
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+
+	// no time left: the starting point is the reference
+	refgen_double_begin(refgen, data, 2, length);
+	refgen_double_step(refgen, 100, 1ull);
+	unsigned int late;
+	refgen_double_finish(refgen, ref, &late, nullptr);
+
+	// step and finish without begin are reported by a NaN cost
+	double untouched[2] = { 7, 7 };
+	if (!std::isnan(refgen_double_step(refgen, 10, 0)) || !std::isnan(refgen_double_finish(refgen, untouched, nullptr, nullptr)) ||
+		untouched[0] != 7) {
+		errors++;
+	}
+
+	delete_refgen_double(refgen);
+
+	double dist = std::sqrt(data[1] * data[1] + data[length + 1] * data[length + 1]);
+	std::cout << "framed reference generator: distance " << dist << " iterations " << iterations << " evaluations " << evaluations
+		<< " longest frame " << maxFrame << " s, late iterations " << late << std::endl;
+
+	if (std::abs(dist - 1.414) > 0.3 || iterations == 0 || late > 1) {
+		errors++;
+	}
+
+	return errors == 0 ? 0 : 1;
+}
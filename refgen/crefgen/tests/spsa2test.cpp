@@ -0,0 +1,173 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/spsa2.h"
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <cmath>
+#include <iostream>
+
+
+
+// quadratic with curvatures 2 * scale[i] and minimum in (1, -2, 0.5)
+template<class R>
+struct Quadratic {
+	static R scale[3];
+
+	template<class E>
+	static R loss(E &&theta, void *) {
+		const R center[3] = { 1, -2, 0.5 };
+		R toRet = 0;
+		for (size_t i = 0; i < theta.size(); i++) {
+			R d = theta(i, 0) - center[i];
+			toRet += scale[i] * d * d;
+		}
+		return toRet;
+	}
+};
+
+template<class R>
+R Quadratic<R>::scale[3] = { 1, 1, 1 };
+
+template<class R, size_t Dim>
+R error(rg::SPSAWorkspace<R, Dim> &ws) {
+	const R center[3] = { 1, -2, 0.5 };
+	R toRet = 0;
+	for (size_t i = 0; i < ws.theta.size(); i++) {
+		toRet += (ws.theta(i, 0) - center[i]) * (ws.theta(i, 0) - center[i]);
+	}
+	return std::sqrt(toRet);
+}
+
+template<class R, size_t Dim>
+int check_quadratic(size_t size = Dim) {
+
+	using V = typename rg::SPSAWorkspace<R, Dim>::vector_type;
+
+	const R center[3] = { 1, -2, 0.5 };
+	const size_t evaluations = 240;
+	int errors = 0;
+
+	// badly scaled cost: the SPSA gains tuned for unit curvatures are too small, the preconditioned steps are not
+	for (size_t i = 0; i < 3; i++) {
+		Quadratic<R>::scale[i] = 1000;
+	}
+
+	// start near the minimum: the distance covered is not limited by max_delta
+	rg::SPSA2Workspace<R, Dim> ws1(size), ws2(size);
+	for (size_t i = 0; i < size; i++) {
+		ws1.theta(i, 0) = ws2.theta(i, 0) = center[i] + (R)0.5;
+	}
+
+	rg::RademacherGen gen1(3), gen2(3);
+	rg::SPSAInfo info1, info2;
+
+	// same number of loss evaluations
+	rg::SPSA(Quadratic<R>::template loss<V>, ws1, evaluations / 2, (R)0.3, (R)0.4, (R)1, (R)0.602, (R)0.1, (R)0.1, nullptr, gen1,
+			 rg::SPSAStop<R>(), &info1);
+	rg::SPSA2(Quadratic<R>::template loss<V>, ws2, evaluations / 4, (R)0.3, (R)1, (R)1, (R)0.602, (R)0.1, (R)0.1, (R)1e-3, nullptr, gen2,
+			  rg::SPSAStop<R>(), &info2);
+
+	R err1 = error(ws1), err2 = error(ws2);
+
+	std::cout << "dim " << size << " sizeof(R) " << sizeof(R) << " SPSA error: " << err1 << " (" << info1.evaluations << " evaluations)"
+		<< " 2SPSA error: " << err2 << " (" << info2.evaluations << " evaluations)" << std::endl;
+
+	if (info2.iterations != evaluations / 4 || info2.evaluations != evaluations + 1 || !(err2 < err1)) {
+		errors++;
+	}
+
+	// the averaged Hessian estimate approaches the true one (diag(2 * scale)) within 10% of the largest curvature
+	Quadratic<R>::scale[0] = 10;
+	Quadratic<R>::scale[1] = 1;
+	Quadratic<R>::scale[2] = 5;
+	rg::SPSA2(Quadratic<R>::template loss<V>, ws2, 400, (R)0.3, (R)1, (R)1, (R)0.602, (R)0.1, (R)0.1, (R)1e-3, nullptr, gen2);
+
+	R hessErr = 0;
+	for (size_t i = 0; i < size; i++) {
+		for (size_t j = 0; j < size; j++) {
+			R expected = (i == j) ? 2 * Quadratic<R>::scale[i] : 0;
+			hessErr = std::max(hessErr, std::abs(ws2.hessian(i, j) - expected));
+		}
+	}
+	std::cout << "  Hessian estimate error: " << hessErr << std::endl;
+	if (hessErr > (R)0.1 * 2 * Quadratic<R>::scale[0]) {
+		errors++;
+	}
+
+	return errors;
+}
+
+int check_jacobi() {
+
+	xt::xtensor_fixed<double, xt::xshape<3, 3>> m, v;
+	const double a[3][3] = { { 4, 1, -2 }, { 1, 2, 0 }, { -2, 0, 3 } };
+	for (size_t i = 0; i < 3; i++) {
+		for (size_t j = 0; j < 3; j++) {
+			m(i, j) = a[i][j];
+		}
+	}
+
+	rg::detail::jacobi_eigen(m, v, 3);
+
+	// a v_j = lambda_j v_j
+	double maxErr = 0;
+	for (size_t j = 0; j < 3; j++) {
+		for (size_t i = 0; i < 3; i++) {
+			double av = 0;
+			for (size_t k = 0; k < 3; k++) {
+				av += a[i][k] * v(k, j);
+			}
+			maxErr = std::max(maxErr, std::abs(av - m(j, j) * v(i, j)));
+		}
+	}
+
+	std::cout << "jacobi error: " << maxErr << std::endl;
+	return maxErr < 1e-10 ? 0 : 1;
+}
+
+
+int main(void) {
+
+	int errors = check_jacobi();
+
+	errors += check_quadratic<float, 2>();
+	errors += check_quadratic<double, 2>();
+	errors += check_quadratic<float, 3>();
+	errors += check_quadratic<double, 3>();
+	errors += check_quadratic<double, 0>(3);
+
+	// reference generator driven by 2SPSA through the C API: closed loop toward the target ring
+	const unsigned int length = 3;
+	float data[2 * length] = { 0, 6, 3,
+							   0, 0, 2 };
+	float ref[2];
+	void *refgen = new_refgen_float_ext(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+										30, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 21);
+	if (refgen_float_set_solver(refgen, RG_SOLVER_2SPSA) != 1 || refgen_float_set_solver(refgen, RG_SOLVER_CEM + 1) != 0) {
+		errors++;
+	}
+	unsigned int iterations, evaluations;
+	for (size_t t = 0; t < 60; t++) {
+		refgen_float_computeref_ext(refgen, data, 2, length, ref, &iterations, &evaluations);
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+	delete_refgen_float(refgen);
+
+	float dist = std::sqrt(data[1] * data[1] + data[length + 1] * data[length + 1]);
+	std::cout << "2SPSA reference generator: distance " << dist << " iterations " << iterations << " evaluations " << evaluations << std::endl;
+	if (std::abs(dist - 1.414f) > 0.3f || iterations != 30 || evaluations < 121) {
+		errors++;
+	}
+
+	return errors == 0 ? 0 : 1;
+}
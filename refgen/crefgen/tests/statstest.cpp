@@ -0,0 +1,126 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <iostream>
+
+
+
+int main(void) {
+
+	int errors = 0;
+	bool enabled = rg::statsEnabled();
+
+	const size_t length = 4;
+	float data[2 * length] = { 20, 0, 1,  1,
+							   20, 0, 1, -1 };
+	std::vector<float> ref(2);
+
+	// far target: saturated multiplier, clipped steps and clamped references
+	rg::Refgen<float, 2> gen(0.01f, 1.414f, 1000.0f, 0.0001f, 0.05f, 6.0f, 1.5f, 30.0f, 0.02f, 60, 0.01f);
+
+	rg::resetGlobalStats();
+
+	size_t iterations = 0, evaluations = 0;
+	for (size_t t = 0; t < 10; t++) {
+		rg::SPSAInfo info;
+		gen.computeRef(data, 2, length, ref.data(), &info);
+		iterations += info.iterations;
+		evaluations += info.evaluations;
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+
+	// a resumable computation counts as one call
+	gen.begin(data, 2, length);
+	gen.step(20);
+	gen.step(20);
+	rg::SPSAInfo runInfo;
+	gen.finish(ref.data(), &runInfo);
+	iterations += runInfo.iterations;
+	evaluations += runInfo.evaluations;
+
+	rg::RefgenStats stats = gen.getStats();
+	rg::RefgenStats global = rg::globalStats();
+
+	if (enabled) {
+		if (stats.calls != 11 || stats.iterations != iterations || stats.evaluations != evaluations || stats.delta_clips == 0 ||
+			stats.delta_clips > iterations || stats.var_clamps == 0 || stats.ni1_saturated != 11 || stats.ns_solve == 0) {
+			errors++;
+		}
+		if (global.calls != stats.calls || global.evaluations != stats.evaluations || global.var_clamps != stats.var_clamps) {
+			errors++;
+		}
+	}
+	else if (stats.calls != 0 || stats.evaluations != 0 || global.calls != 0) {
+		errors++;
+	}
+
+	// the multipliers are always reported
+	if ((float)stats.ni1 != 0.05f) {
+		errors++;
+	}
+
+	gen.resetStats();
+	if (gen.getStats().calls != 0) {
+		errors++;
+	}
+
+	// C API
+	void *refgen = new_refgen_double(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	double cdata[2 * length] = { 0, 3, 1,  1,
+								 0, 0, 1, -1 };
+	double cref[2];
+	for (size_t t = 0; t < 5; t++) {
+		refgen_double_computeref(refgen, cdata, 2, length, cref);
+	}
+
+	refgen_stats cstats;
+	int counted = refgen_double_get_stats(refgen, &cstats);
+	if (counted != (enabled ? 1 : 0) || cstats.calls != (enabled ? 5u : 0u) || cstats.ni1 <= 0) {
+		errors++;
+	}
+
+	refgen_stats cglobal;
+	refgen_get_global_stats(&cglobal);
+	if (cglobal.calls != global.calls + (enabled ? 5u : 0u)) {
+		errors++;
+	}
+
+	refgen_double_reset_stats(refgen);
+	refgen_reset_global_stats();
+	refgen_double_get_stats(refgen, &cstats);
+	refgen_get_global_stats(&cglobal);
+	if (cstats.calls != 0 || cglobal.calls != 0) {
+		errors++;
+	}
+
+	delete_refgen_double(refgen);
+
+	// agents of a fleet: an index out of range is refused
+	void *fleet = new_refgen_double_fleet(3, 1, 0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	refgen_stats fstats;
+	fstats.calls = 7;
+	if (refgen_double_fleet_get_stats(fleet, 3, &fstats) != 0 || fstats.calls != 7 ||
+		refgen_double_fleet_get_stats(fleet, 2, &fstats) != (enabled ? 1 : 0) || fstats.calls != 0) {
+		errors++;
+	}
+	delete_refgen_double_fleet(fleet);
+
+	std::cout << "counters " << (enabled ? "enabled" : "disabled") << ": calls " << stats.calls << " iterations " << stats.iterations
+		<< " evaluations " << stats.evaluations << " clipped steps " << stats.delta_clips << " clamped references " << stats.var_clamps
+		<< " saturated ni1 " << stats.ni1_saturated << " ns prepare/solve/finalize " << stats.ns_prepare << "/" << stats.ns_solve
+		<< "/" << stats.ns_finalize << " ni1 " << stats.ni1 << " ni2 " << stats.ni2 << " errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
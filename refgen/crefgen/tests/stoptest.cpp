@@ -0,0 +1,80 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <iostream>
+
+
+
+int main(void) {
+
+	const size_t spaceSize = 2;
+	const size_t length = 4;
+	const size_t max_iter = 120;
+	const size_t episode_size = 30;
+
+	int errors = 0;
+
+	// agent already on its target ring, two far neighbors: a steady state formation
+	float data[spaceSize * length] = { 0, 1, 30, -30,
+									   0, 1, 30, 30 };
+	float ref[spaceSize];
+
+	rg::Refgen<float> fixedBudget(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+								  max_iter, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 5);
+	rg::Refgen<float> early(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+							max_iter, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 5);
+	early.setStop(rg::SPSAStop<float>(1e-3f, 10, 1e-3f, 20));
+
+	size_t usedFixed = 0, usedEarly = 0;
+	for (size_t t = 0; t < episode_size; t++) {
+		rg::SPSAInfo info;
+
+		fixedBudget.computeRef(data, spaceSize, length, ref, &info);
+		if (info.iterations != max_iter || info.evaluations < 2 * max_iter + 1) {
+			errors++;
+		}
+		usedFixed += info.iterations;
+
+		early.computeRef(data, spaceSize, length, ref, &info);
+		if (info.iterations < 20 || info.iterations > max_iter) {
+			errors++;
+		}
+		usedEarly += info.iterations;
+	}
+
+	std::cout << "iterations: fixed budget " << usedFixed << " early termination " << usedEarly << std::endl;
+	if (usedEarly >= usedFixed / 2) {
+		errors++;
+	}
+
+	// C API
+	void *refgen = new_refgen_float(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f);
+	unsigned int iterations = 0, evaluations = 0;
+
+	refgen_float_computeref_ext(refgen, data, spaceSize, length, ref, &iterations, &evaluations);
+	if (iterations != 120 || evaluations < 241) {
+		errors++;
+	}
+
+	refgen_float_set_stop(refgen, 1e-3f, 0, 0, 5);
+	refgen_float_computeref_ext(refgen, data, spaceSize, length, ref, &iterations, &evaluations);
+	if (iterations < 5 || iterations >= 120 || evaluations < 2 * iterations + 1) {
+		errors++;
+	}
+	std::cout << "C API iterations: " << iterations << " evaluations: " << evaluations << std::endl;
+
+	delete_refgen_float(refgen);
+
+	return errors == 0 ? 0 : 1;
+}
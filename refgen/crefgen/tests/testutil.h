@@ -0,0 +1,33 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+// Helpers shared by the tests.
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <type_traits>
+
+
+namespace rgtest {
+
+	/** Uniform value in [-scale / 2, scale / 2] from rand, so that srand makes a test repeatable.
+	* R is never deduced from scale: random_value(6) is a double.
+	*/
+	template<class R = double>
+	R random_value(typename std::common_type<R>::type scale) {
+		return scale * (static_cast <R> (rand()) / static_cast <R> (RAND_MAX) - R(0.5));
+	}
+
+	/** Equality within a relative tolerance (absolute below 1).
+	*/
+	inline bool close(double a, double b, double tol) {
+		return std::abs(a - b) <= tol * std::max(1.0, std::max(std::abs(a), std::abs(b)));
+	}
+}
@@ -0,0 +1,172 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <iostream>
+
+
+
+// the records of each call are its iterations in order, and the last one is the solution
+int check_calls(const std::vector<rg::TraceRecord> &records, size_t calls, size_t iterations, const std::vector<float> &lastTheta) {
+
+	int errors = 0;
+	if (records.size() != calls * iterations) {
+		return 1;
+	}
+	for (size_t k = 0; k < records.size(); k++) {
+		const rg::TraceRecord &r = records[k];
+		if (r.seq != k || r.call != k / iterations || r.iteration != k % iterations + 1 || r.dim != 2 || r.chain != 0 ||
+			r.normalization > 1 || ((r.flags & rg::TRACE_CLIPPED) != 0) != (r.normalization < 1)) {
+			errors++;
+		}
+	}
+	const rg::TraceRecord &last = records.back();
+	if (last.theta[0] != lastTheta[0] || last.theta[1] != lastTheta[1] || last.theta[2] != 0) {
+		errors++;
+	}
+	return errors;
+}
+
+
+int main(void) {
+
+	int errors = 0;
+	bool enabled = rg::traceEnabled();
+
+	const size_t length = 4;
+	const size_t iterations = 60;
+	float data[2 * length] = { 0, 4, 1,  1,
+							   0, 2, 1, -1 };
+	std::vector<float> ref(2);
+
+	rg::TraceBuffer trace(1024);
+	rg::Refgen<float> gen(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 100.0f, iterations);
+	gen.setTrace(&trace, 7);
+
+	for (size_t t = 0; t < 3; t++) {
+		gen.computeRef(data, 2, length, ref.data());
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+
+	std::vector<rg::TraceRecord> records;
+	uint64_t lost = trace.snapshot(records);
+
+	if (enabled) {
+		// max_var is large: the reference is the last solution
+		errors += check_calls(records, 3, iterations, ref);
+		if (lost != 0 || records[0].source != 7 || records[0].solver != rg::SOLVER_SPSA) {
+			errors++;
+		}
+	}
+	else if (!records.empty() || trace.written() != 0) {
+		errors++;
+	}
+
+	// once full, the ring keeps the newest records
+	trace.clear();
+	for (size_t t = 0; t < 20; t++) {
+		gen.computeRef(data, 2, length, ref.data());
+	}
+	lost = trace.snapshot(records);
+	if (enabled && (records.size() != trace.capacity() || lost != 20 * iterations - trace.capacity() ||
+					records.back().seq != 20 * iterations - 1 || records.back().iteration != iterations)) {
+		errors++;
+	}
+
+	// several writers on one buffer: no record is lost or torn while the ring is large enough
+	rg::TraceBuffer shared(8192);
+	std::vector<rg::Refgen<float>> agents;
+	for (size_t k = 0; k < 4; k++) {
+		agents.emplace_back(0.01f, 1.414f, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f, iterations, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, k,
+							k % 2 == 0 ? rg::SOLVER_SPSA : rg::SOLVER_GRADIENT);
+		agents[k].setTrace(&shared, (uint32_t)k);
+	}
+	std::vector<std::thread> threads;
+	for (size_t k = 0; k < 4; k++) {
+		threads.emplace_back([&, k]() {
+			float adata[2 * length] = { 0, 4, 1,  1,
+										0, 2, 1, -1 };
+			float aref[2];
+			for (size_t t = 0; t < 10; t++) {
+				agents[k].computeRef(adata, 2, length, aref);
+			}
+		});
+	}
+	for (auto &th : threads) {
+		th.join();
+	}
+	lost = shared.snapshot(records);
+	if (enabled) {
+		std::vector<size_t> perSource(4, 0);
+		for (const auto &r : records) {
+			if (r.source >= 4 || r.solver != (r.source % 2 == 0 ? rg::SOLVER_SPSA : rg::SOLVER_GRADIENT)) {
+				errors++;
+				continue;
+			}
+			perSource[r.source]++;
+		}
+		for (size_t n : perSource) {
+			if (n != 10 * iterations) {
+				errors++;
+			}
+		}
+	}
+
+	// C API: dump and read back
+	const char *path = "tracetest.bin";
+	void *ctrace = new_refgen_trace(4096);
+	void *crefgen = new_refgen_double(0.01, 1.414, 1000.0, 0.0001, 500.0, 6.0, 1.5, 30.0, 0.3);
+	refgen_double_set_trace(crefgen, ctrace, 3);
+	double cdata[2 * length] = { 0, 3, 1,  1,
+								 0, 0, 1, -1 };
+	double cref[2];
+	for (size_t t = 0; t < 4; t++) {
+		refgen_double_computeref(crefgen, cdata, 2, length, cref);
+	}
+	long long dumped = refgen_trace_dump(ctrace, path);
+
+	rg::TraceFileHeader header;
+	std::vector<rg::TraceRecord> fromFile;
+	FILE *file = std::fopen(path, "rb");
+	if (file != nullptr && std::fread(&header, sizeof(header), 1, file) == 1) {
+		fromFile.resize((size_t)header.count);
+		if (!fromFile.empty() && std::fread(fromFile.data(), sizeof(rg::TraceRecord), fromFile.size(), file) != fromFile.size()) {
+			errors++;
+		}
+	}
+	else {
+		errors++;
+	}
+	if (file != nullptr) {
+		std::fclose(file);
+	}
+	std::remove(path);
+
+	size_t expected = enabled ? 4 * 120 : 0;
+	if (dumped != (long long)expected || header.count != expected || std::memcmp(header.magic, "RGTRACE", 8) != 0 ||
+		refgen_trace_enabled() != (enabled ? 1 : 0) || (enabled && (fromFile[0].source != 3 || fromFile.back().call != 3))) {
+		errors++;
+	}
+
+	delete_refgen_double(crefgen);
+	delete_refgen_trace(ctrace);
+
+	std::cout << "tracing " << (enabled ? "enabled" : "disabled") << ": " << shared.written() << " records from 4 threads, "
+		<< dumped << " dumped, errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
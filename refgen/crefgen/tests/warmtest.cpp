@@ -0,0 +1,110 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/refgen.h"
+#include "crefgen/c_api.h"
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+
+
+
+// closed loop run toward the target: returns the final distance from the target and the SPSA iterations used
+template<class F>
+float run(F &&computeRef, size_t ticks, float *data, size_t length, size_t &iterations, int &errors, size_t expected_first, size_t expected_next) {
+
+	const size_t spaceSize = 2;
+	float ref[spaceSize];
+
+	iterations = 0;
+	for (size_t t = 0; t < ticks; t++) {
+		size_t used = computeRef(data, spaceSize, length, ref);
+		if (used != (t == 0 ? expected_first : expected_next)) {
+			errors++;
+		}
+		iterations += used;
+		data[1] = ref[0];
+		data[length + 1] = ref[1];
+	}
+
+	return std::sqrt((data[0] - data[1]) * (data[0] - data[1]) + (data[length] - data[length + 1]) * (data[length] - data[length + 1]));
+}
+
+
+int main(void) {
+
+	const size_t length = 3;
+	const size_t ticks = 80;
+	const float r1 = 1.414f;
+
+	int errors = 0;
+
+	rg::Refgen<float> cold(0.01f, r1, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+						   120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 17);
+	rg::Refgen<float> warm(0.01f, r1, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f,
+						   120, 0.3f, 0.4f, 1.0f, 0.602f, 0.1f, 0.1f, 17);
+	warm.setWarmStart(true, 20, 20, 1.0f);
+
+	auto step = [](rg::Refgen<float> &refgen) {
+		return [&refgen](float *data, size_t spaceSize, size_t length, float *ref) {
+			rg::SPSAInfo info;
+			refgen.computeRef(data, spaceSize, length, ref, &info);
+			return info.iterations;
+		};
+	};
+
+	// target in the origin, a neighbor near the path
+	float coldData[2 * length] = { 0, 10, 5,
+								   0, 0, 1.5f };
+	float warmData[2 * length] = { 0, 10, 5,
+								   0, 0, 1.5f };
+
+	size_t coldIterations, warmIterations;
+	auto t1 = std::chrono::high_resolution_clock::now();
+	float coldDist = run(step(cold), ticks, coldData, length, coldIterations, errors, 120, 120);
+	auto t2 = std::chrono::high_resolution_clock::now();
+	float warmDist = run(step(warm), ticks, warmData, length, warmIterations, errors, 120, 20);
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	std::cout << "cold: distance " << coldDist << " iterations " << coldIterations << " time "
+		<< std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1).count() << " s" << std::endl;
+	std::cout << "warm: distance " << warmDist << " iterations " << warmIterations << " time "
+		<< std::chrono::duration_cast<std::chrono::duration<double>>(t3 - t2).count() << " s" << std::endl;
+
+	// both reach the target ring
+	if (std::abs(coldDist - r1) > 0.3f || std::abs(warmDist - r1) > 0.3f) {
+		errors++;
+	}
+
+	// target jump: full run, then warm again
+	warmData[0] = 20;
+	run(step(warm), 2, warmData, length, warmIterations, errors, 120, 20);
+
+	// C API: disabled warm start gives full runs
+	void *refgen = new_refgen_float(0.01f, r1, 1000.0f, 0.0001f, 500.0f, 6.0f, 1.5f, 30.0f, 0.3f);
+	refgen_float_set_warm_start(refgen, 1, 10, 60, 1.0f);
+	refgen_float_set_warm_start(refgen, 0, 10, 60, 1.0f);
+	auto cstep = [refgen](float *data, size_t spaceSize, size_t length, float *ref) {
+		unsigned int iterations;
+		refgen_float_computeref_ext(refgen, data, (unsigned int)spaceSize, (unsigned int)length, ref, &iterations, nullptr);
+		return (size_t)iterations;
+	};
+	size_t cIterations;
+	run(cstep, 3, coldData, length, cIterations, errors, 120, 120);
+	refgen_float_set_warm_start(refgen, 1, 10, 60, 1.0f);
+	run(cstep, 3, coldData, length, cIterations, errors, 120, 10);
+	delete_refgen_float(refgen);
+
+	std::cout << "errors: " << errors << std::endl;
+
+	return errors == 0 ? 0 : 1;
+}
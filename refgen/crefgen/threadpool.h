@@ -0,0 +1,319 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <atomic>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace rg {
+
+	/** Number of hardware threads available on the running machine (at least 1).
+	*/
+	inline size_t hardwareThreads() {
+		size_t n = (size_t)std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+	}
+
+	/** Persistent pool of worker threads running parallel loops with work stealing.
+	* The items of a loop are grouped in chunks and each thread starts with its own contiguous range of chunks: it
+	* takes them one at a time from the front, and once it runs out it steals the back half of the range of another
+	* thread. Items with very different costs (e.g. agents with many or few neighbors) are balanced this way without
+	* a shared counter hit by every thread. The ranges are single atomic words, so neither stealing nor running
+	* a loop allocates or locks. The calling thread works as thread 0: a pool of n threads starts n - 1 workers.
+	* Loops are run one at a time; a loop started from inside a loop of the same pool runs serially.
+	*/
+	class ThreadPool {
+
+	private:
+		// chunk range [lo, hi) of a thread packed in one word (lo: high 32 bits), alone on its cache line
+		struct alignas(64) Slot {
+			std::atomic<uint64_t> range;
+		};
+
+		// new Slot[n] ignores the over-alignment before C++17: the slots are placed by hand in a larger buffer
+		static Slot * placeSlots(std::unique_ptr<char[]> &buffer, size_t n) {
+			size_t space = (n + 1) * sizeof(Slot);
+			buffer.reset(new char[space]);
+			void *p = buffer.get();
+			Slot *slots = (Slot *)std::align(alignof(Slot), n * sizeof(Slot), p, space);
+			for (size_t t = 0; t < n; t++) {
+				new (slots + t) Slot();		// trivially destructible, the buffer alone is released
+			}
+			return slots;
+		}
+
+		static uint64_t pack(uint64_t lo, uint64_t hi) {
+			return (lo << 32) | hi;
+		}
+
+		size_t _size;
+		std::vector<std::thread> _workers;
+		std::unique_ptr<char[]> _slotBuffer;
+		Slot *_slots;
+
+		std::mutex _run;		// one loop at a time
+		std::mutex _mutex;
+		std::condition_variable _wake;
+		std::condition_variable _done;
+		uint64_t _generation;
+		size_t _active;
+		bool _stop;
+
+		// loop in progress
+		void (*_invoke)(void *, size_t, size_t);
+		void *_body;
+		size_t _count, _grain;
+		std::atomic<bool> _failed;
+		std::exception_ptr _error;
+
+		static ThreadPool *& current() {
+			static thread_local ThreadPool *pool = nullptr;
+			return pool;
+		}
+
+		/** Pins the calling thread to the cpu-th core it is allowed to run on (Linux only, elsewhere the scheduler decides).
+		*/
+		static void pinTo(size_t cpu) {
+#ifdef __linux__
+			cpu_set_t allowed;
+			CPU_ZERO(&allowed);
+			if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+				return;
+			}
+			cpu %= (size_t)CPU_COUNT(&allowed);
+			for (int c = 0; c < CPU_SETSIZE; c++) {
+				if (CPU_ISSET(c, &allowed) && cpu-- == 0) {
+					cpu_set_t set;
+					CPU_ZERO(&set);
+					CPU_SET(c, &set);
+					pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+					return;
+				}
+			}
+#else
+			(void)cpu;
+#endif
+		}
+
+		bool popOwn(size_t t, size_t &chunk) {
+			std::atomic<uint64_t> &range = _slots[t].range;
+			uint64_t r = range.load(std::memory_order_acquire);
+			for (;;) {
+				uint64_t lo = r >> 32, hi = r & 0xffffffffu;
+				if (lo >= hi) {
+					return false;
+				}
+				if (range.compare_exchange_weak(r, pack(lo + 1, hi), std::memory_order_acq_rel)) {
+					chunk = (size_t)lo;
+					return true;
+				}
+			}
+		}
+
+		/** Moves the back half of the range of another thread to the (empty) range of thread t.
+		*/
+		bool steal(size_t t) {
+			for (size_t v = 1; v < _size; v++) {
+				std::atomic<uint64_t> &range = _slots[(t + v) % _size].range;
+				uint64_t r = range.load(std::memory_order_acquire);
+				for (;;) {
+					uint64_t lo = r >> 32, hi = r & 0xffffffffu;
+					if (lo >= hi) {
+						break;
+					}
+					uint64_t mid = lo + (hi - lo) / 2;
+					if (range.compare_exchange_weak(r, pack(lo, mid), std::memory_order_acq_rel)) {
+						_slots[t].range.store(pack(mid, hi), std::memory_order_release);
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		void work(size_t t) {
+			ThreadPool *outer = current();
+			current() = this;
+
+			size_t chunk;
+			while (!_failed.load(std::memory_order_relaxed)) {
+				if (!popOwn(t, chunk)) {
+					if (!steal(t)) {
+						break;
+					}
+					continue;
+				}
+				size_t begin = chunk * _grain;
+				size_t end = std::min(begin + _grain, _count);
+				try {
+					_invoke(_body, begin, end);
+				}
+				catch (...) {
+					bool expected = false;
+					if (_failed.compare_exchange_strong(expected, true)) {
+						_error = std::current_exception();
+					}
+				}
+			}
+
+			current() = outer;
+		}
+
+		void workerLoop(size_t t, bool pin) {
+			if (pin) {
+				pinTo(t);
+			}
+
+			uint64_t seen = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_wake.wait(lock, [&]() { return _stop || _generation != seen; });
+					if (_stop) {
+						return;
+					}
+					seen = _generation;
+				}
+
+				work(t);
+
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (--_active == 0) {
+					_done.notify_one();
+				}
+			}
+		}
+
+		template<class F>
+		static void invoke(void *body, size_t begin, size_t end) {
+			F &f = *(F *)body;
+			for (size_t k = begin; k < end; k++) {
+				f(k);
+			}
+		}
+
+	public:
+
+		/** Starts the workers of a pool.
+		* @param numThreads number of threads running the loops, the calling one included (0: all hardware threads).
+		* @param pin true to pin the worker t to the t-th core the process may use (the calling thread is not pinned).
+		*/
+		explicit ThreadPool(size_t numThreads = 0, bool pin = false) :
+			_size(numThreads == 0 ? hardwareThreads() : numThreads), _slots(placeSlots(_slotBuffer, _size)),
+			_generation(0), _active(0), _stop(false), _invoke(nullptr), _body(nullptr), _count(0), _grain(1), _failed(false) {
+
+			for (size_t t = 0; t < _size; t++) {
+				_slots[t].range.store(0);
+			}
+
+			_workers.reserve(_size - 1);
+			for (size_t t = 1; t < _size; t++) {
+				_workers.emplace_back(&ThreadPool::workerLoop, this, t, pin);
+			}
+		}
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool & operator=(const ThreadPool &) = delete;
+
+		/** Stops and joins the workers.
+		*/
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			for (auto &th : _workers) {
+				th.join();
+			}
+		}
+
+		/** Number of threads running the loops (the calling one included).
+		*/
+		size_t size() const {
+			return _size;
+		}
+
+		/** Runs body(k) for each k in [0, count) on the pool threads and returns when all the items are done.
+		* The first exception thrown by body is rethrown on the calling thread (the items not started yet are skipped).
+		* @param count number of items to process.
+		* @param grain number of consecutive items forming a chunk (the unit of work taken or stolen).
+		* @param body callable object invoked as body(size_t k).
+		*/
+		template<class F>
+		void parallelFor(size_t count, size_t grain, F &&body) {
+
+			grain = std::max<size_t>(grain, 1);
+			size_t chunks = (count + grain - 1) / grain;
+
+			if (_size <= 1 || chunks <= 1 || current() == this) {
+				for (size_t k = 0; k < count; k++) {
+					body(k);
+				}
+				return;
+			}
+
+			if (chunks > 0xffffffffu) {
+				THROW_EXCPT("ThreadPool: too many chunks, use a bigger grain");
+			}
+
+			using Fd = typename std::remove_reference<F>::type;
+
+			std::lock_guard<std::mutex> run(_run);
+
+			_invoke = &ThreadPool::invoke<Fd>;
+			_body = (void *)&body;
+			_count = count;
+			_grain = grain;
+			_failed.store(false);
+			_error = nullptr;
+
+			// even initial split: stealing fixes the imbalance
+			for (size_t t = 0; t < _size; t++) {
+				_slots[t].range.store(pack(chunks * t / _size, chunks * (t + 1) / _size), std::memory_order_relaxed);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_active = _size - 1;
+				_generation++;
+			}
+			_wake.notify_all();
+
+			work(0);
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_done.wait(lock, [&]() { return _active == 0; });
+			}
+
+			if (_error) {
+				std::exception_ptr error = _error;
+				_error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+	};
+}
@@ -0,0 +1,93 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#define XTENSOR_USE_XSIMD
+
+
+#include "crefgen/replay.h"
+#include "../bench/benchutil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+// Replay driver of the record logs written by rg::RefgenRecorder (or new_refgen_recorder): it runs every recorded
+// call again at full speed, checks that the results match and prints the time per call, so that the calls of a flight
+// can be profiled offline (e.g. under perf, with --passes to lengthen short logs).
+//
+// usage: rgreplay log.bin [--source n] [--passes n]
+//
+// exit code: 0 if every call matches, 1 if some call differs, 2 if the log cannot be read.
+
+
+int main(int argc, char **argv) {
+
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s log.bin [--source n] [--passes n]\n", argv[0]);
+		return 2;
+	}
+
+	long long source = -1;
+	size_t passes = 1;
+	for (int k = 2; k < argc; k++) {
+		if (std::strcmp(argv[k], "--source") == 0 && k + 1 < argc) {
+			source = std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--passes") == 0 && k + 1 < argc) {
+			passes = (size_t)std::max(1LL, std::atoll(argv[++k]));
+		}
+		else {
+			std::fprintf(stderr, "unknown option %s\n", argv[k]);
+			return 2;
+		}
+	}
+
+	rg::RecordLog log;
+	if (!log.open(argv[1])) {
+		std::fprintf(stderr, "%s is not a record log of this version\n", argv[1]);
+		return 2;
+	}
+
+	rg::ReplayReport report = rg::replayLog(log, source, passes);
+
+	std::printf("%s: %zu bytes, %llu settings records, %llu calls replayed (%zu passes), %llu skipped\n", argv[1], log.bytes(),
+		(unsigned long long)report.params, (unsigned long long)report.calls, passes, (unsigned long long)report.skipped);
+	if (report.truncated) {
+		std::printf("the log ends with an incomplete record\n");
+	}
+	if (report.invalid > 0) {
+		std::printf("%llu settings records refused (invalid settings), the calls they rule are skipped\n", (unsigned long long)report.invalid);
+	}
+
+	if (!report.ns.empty()) {
+		double total = 0;
+		for (double t : report.ns) {
+			total += t;
+		}
+		double mean = total / report.ns.size();
+		double max = *std::max_element(report.ns.begin(), report.ns.end());
+		double p50 = rgbench::percentile(report.ns, 0.5);
+		double p90 = rgbench::percentile(report.ns, 0.9);
+		double p99 = rgbench::percentile(report.ns, 0.99);
+		std::printf("us per call: mean %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f\n", mean * 1e-3, p50 * 1e-3, p90 * 1e-3, p99 * 1e-3, max * 1e-3);
+	}
+
+	if (report.timing > 0) {
+		std::printf("%llu calls recorded with a stopping deadline differ (timing dependent)\n", (unsigned long long)report.timing);
+	}
+	if (report.mismatches > 0) {
+		std::printf("MISMATCH: %llu calls differ from the recorded results, first at record %llu\n",
+			(unsigned long long)report.mismatches, (unsigned long long)report.first_mismatch);
+		return 1;
+	}
+
+	std::printf("all the replayed calls match\n");
+	return 0;
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+
+#include "crefgen/trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+
+// Reader of the solver traces written by rg::TraceBuffer::dump (or refgen_trace_dump).
+// It prints the records as CSV, or one line for each traced call with --summary.
+//
+// usage: rgtrace trace.bin [--source n] [--call n] [--summary]
+
+
+struct CallSummary {
+	uint32_t source, call;
+	size_t records;
+	size_t clipped;
+	uint16_t lastIteration;
+	float firstLoss, lastLoss;
+	float theta[3];
+	uint8_t dim, solver;
+};
+
+
+int main(int argc, char **argv) {
+
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s trace.bin [--source n] [--call n] [--summary]\n", argv[0]);
+		return 2;
+	}
+
+	long long source = -1, call = -1;
+	bool summary = false;
+	for (int k = 2; k < argc; k++) {
+		if (std::strcmp(argv[k], "--source") == 0 && k + 1 < argc) {
+			source = std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--call") == 0 && k + 1 < argc) {
+			call = std::atoll(argv[++k]);
+		}
+		else if (std::strcmp(argv[k], "--summary") == 0) {
+			summary = true;
+		}
+		else {
+			std::fprintf(stderr, "unknown option %s\n", argv[k]);
+			return 2;
+		}
+	}
+
+	FILE *file = std::fopen(argv[1], "rb");
+	if (file == nullptr) {
+		std::fprintf(stderr, "cannot open %s\n", argv[1]);
+		return 1;
+	}
+
+	rg::TraceFileHeader header;
+	if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "RGTRACE", 8) != 0 || header.version != 1 ||
+		header.record_size != sizeof(rg::TraceRecord)) {
+		std::fprintf(stderr, "%s is not a trace of this version\n", argv[1]);
+		std::fclose(file);
+		return 1;
+	}
+
+	std::vector<rg::TraceRecord> records((size_t)header.count);
+	size_t read = records.empty() ? 0 : std::fread(records.data(), sizeof(rg::TraceRecord), records.size(), file);
+	std::fclose(file);
+	if (read != records.size()) {
+		std::fprintf(stderr, "%s is truncated: %zu of %llu records\n", argv[1], read, (unsigned long long)header.count);
+		records.resize(read);
+	}
+
+	std::fprintf(stderr, "%zu records, %llu dropped\n", records.size(), (unsigned long long)header.dropped);
+
+	std::map<std::pair<uint32_t, uint32_t>, CallSummary> calls;
+
+	if (!summary) {
+		std::printf("seq,source,call,chain,iteration,solver,dim,clipped,ak,ck,yplus,yminus,grad,normalization,theta0,theta1,theta2\n");
+	}
+
+	for (const rg::TraceRecord &r : records) {
+		if ((source >= 0 && r.source != (uint32_t)source) || (call >= 0 && r.call != (uint32_t)call)) {
+			continue;
+		}
+
+		if (!summary) {
+			std::printf("%llu,%u,%u,%u,%u,%u,%u,%u,%g,%g,%g,%g,%g,%g,%g,%g,%g\n", (unsigned long long)r.seq, r.source, r.call,
+				(unsigned)r.chain, (unsigned)r.iteration, (unsigned)r.solver, (unsigned)r.dim, (r.flags & rg::TRACE_CLIPPED) ? 1u : 0u,
+				r.ak, r.ck, r.yplus, r.yminus, r.grad, r.normalization, r.theta[0], r.theta[1], r.theta[2]);
+			continue;
+		}
+
+		// the loss estimate of an iteration: mean of the two perturbed losses (SPSA), the loss (gradient solver) or the best loss of the round (CEM)
+		float loss = r.solver >= 2 ? r.yplus : (r.yplus + r.yminus) / 2;
+
+		auto key = std::make_pair(r.source, r.call);
+		auto it = calls.find(key);
+		if (it == calls.end()) {
+			CallSummary s;
+			s.source = r.source;
+			s.call = r.call;
+			s.records = 0;
+			s.clipped = 0;
+			s.firstLoss = loss;
+			s.dim = r.dim;
+			s.solver = r.solver;
+			it = calls.insert(std::make_pair(key, s)).first;
+		}
+
+		CallSummary &s = it->second;
+		s.records++;
+		s.clipped += (r.flags & rg::TRACE_CLIPPED) ? 1 : 0;
+		s.lastIteration = r.iteration;
+		s.lastLoss = loss;
+		std::memcpy(s.theta, r.theta, sizeof(s.theta));
+	}
+
+	if (summary) {
+		std::printf("source,call,solver,dim,records,clipped,last_iteration,first_loss,last_loss,theta0,theta1,theta2\n");
+		for (const auto &c : calls) {
+			const CallSummary &s = c.second;
+			std::printf("%u,%u,%u,%u,%zu,%zu,%u,%g,%g,%g,%g,%g\n", s.source, s.call, (unsigned)s.solver, (unsigned)s.dim, s.records, s.clipped,
+				(unsigned)s.lastIteration, s.firstLoss, s.lastLoss, s.theta[0], s.theta[1], s.theta[2]);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+/****************************************************************************
+* Author:	Luca Calacci													*
+* Company:	Universita' degli studi di Roma - Tor Vergata					*
+* Email:	luca.calacci@gmail.com											*
+*																			*
+****************************************************************************/
+
+#include "rgcommon.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+
+/** Solver tracing: compiled in only when RG_ENABLE_TRACE is defined (the CMake option RG_ENABLE_TRACE defines it for
+* the library and its users). RG_TRACE(code) expands to code only when tracing is enabled; even then nothing is
+* recorded until a TraceBuffer is given to the reference generator.
+*/
+#ifdef RG_ENABLE_TRACE
+#define RG_TRACE(...) __VA_ARGS__
+#else
+#define RG_TRACE(...)
+#endif
+
+
+namespace rg {
+
+	/** Trace record of one solver iteration (fixed layout, native byte order).
+	*/
+	struct TraceRecord {
+		uint64_t seq;			/**< position of the record in the trace stream. */
+		uint32_t source;		/**< generator that wrote the record (@see Refgen::setTrace). */
+		uint32_t call;			/**< reference computation the iteration belongs to (counted by each generator). */
+		uint16_t iteration;		/**< iteration k, from 1 (saturated at 65535). */
+		uint8_t solver;			/**< SolverType of the iteration. */
+		uint8_t dim;			/**< space dimension (saturated at 255, only the first 3 components of theta are recorded). */
+		uint16_t chain;			/**< multi-start chain. */
+		uint16_t flags;			/**< TRACE_CLIPPED if the step was scaled down to max_delta. */
+		float ak;				/**< step gain (CEM: mean standard deviation of the sampling). */
+		float ck;				/**< perturbation gain (0 for the gradient solver). */
+		float yplus;			/**< loss in theta + ck * delta (gradient solver: loss in theta, CEM: best loss of the round). */
+		float yminus;			/**< loss in theta - ck * delta (gradient solver: 0, CEM: loss in the centre of the round). */
+		float grad;				/**< SPSA: gradient estimate magnitude ghat, other solvers: norm of the step direction. */
+		float normalization;	/**< max_delta scaling of the step (1: not clipped). */
+		float theta[3];			/**< solution after the step. */
+		uint32_t reserved;		/**< 0, pads the record to 64 bytes. */
+	};
+
+	static_assert(sizeof(TraceRecord) == 64, "TraceRecord: the dump format needs a 64 bytes record");
+
+	enum {
+		TRACE_CLIPPED = 1
+	};
+
+	/** Header of a trace dump, followed by count records.
+	*/
+	struct TraceFileHeader {
+		char magic[8];			/**< "RGTRACE" and a terminating 0. */
+		uint32_t version;		/**< format version (1). */
+		uint32_t record_size;	/**< sizeof(TraceRecord). */
+		uint64_t count;			/**< records in the file. */
+		uint64_t dropped;		/**< older records overwritten before the dump. */
+	};
+
+	/** Fixed size ring of trace records written without locks by any number of threads: once full, the oldest records
+	* are overwritten. A record costs an atomic increment and a 64 bytes store, and the buffer never allocates after
+	* construction, so tracing can stay on in flight tests.
+	*/
+	class TraceBuffer {
+
+	private:
+		std::unique_ptr<TraceRecord[]> _records;
+		std::unique_ptr<std::atomic<uint64_t>[]> _written;	// seq + 1 of the record in each slot, stored once it is complete
+		uint64_t _mask;
+		std::atomic<uint64_t> _head;
+
+	public:
+
+		/** Allocates the ring.
+		* @param capacity number of records kept (rounded up to a power of two).
+		*/
+		explicit TraceBuffer(size_t capacity = 65536) : _head(0) {
+			uint64_t size = 1;
+			while (size < capacity) {
+				size *= 2;
+			}
+			_records.reset(new TraceRecord[size]);
+			_written.reset(new std::atomic<uint64_t>[size]);
+			for (uint64_t i = 0; i < size; i++) {
+				_written[i].store(0, std::memory_order_relaxed);
+			}
+			_mask = size - 1;
+		}
+
+		TraceBuffer(const TraceBuffer &) = delete;
+		TraceBuffer & operator=(const TraceBuffer &) = delete;
+
+		/** Number of records kept.
+		*/
+		size_t capacity() const {
+			return (size_t)(_mask + 1);
+		}
+
+		/** Number of records written since the construction or the last clear.
+		*/
+		uint64_t written() const {
+			return _head.load(std::memory_order_acquire);
+		}
+
+		/** Forgets all the records (no writer may be running).
+		*/
+		void clear() {
+			_head.store(0);
+			for (uint64_t i = 0; i <= _mask; i++) {
+				_written[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		/** Appends a record (its seq field is set by the buffer).
+		*/
+		void push(const TraceRecord &record) {
+			uint64_t seq = _head.fetch_add(1, std::memory_order_relaxed);
+			uint64_t slot = seq & _mask;
+			_written[slot].store(0, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			_records[slot] = record;
+			_records[slot].seq = seq;
+			_written[slot].store(seq + 1, std::memory_order_release);
+		}
+
+		/** Copies the records still in the ring, oldest first. Records being overwritten while copying are skipped.
+		* @param out vector receiving the records.
+		* @return number of records lost: overwritten before the copy or skipped.
+		*/
+		uint64_t snapshot(std::vector<TraceRecord> &out) const {
+			uint64_t head = _head.load(std::memory_order_acquire);
+			uint64_t first = head > _mask + 1 ? head - (_mask + 1) : 0;
+
+			out.clear();
+			out.reserve((size_t)(head - first));
+			for (uint64_t seq = first; seq < head; seq++) {
+				uint64_t slot = seq & _mask;
+				if (_written[slot].load(std::memory_order_acquire) != seq + 1) {
+					continue;
+				}
+				TraceRecord record = _records[slot];
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (_written[slot].load(std::memory_order_relaxed) == seq + 1) {
+					out.push_back(record);
+				}
+			}
+
+			return head - out.size();
+		}
+
+		/** Writes the records still in the ring to a binary file: a TraceFileHeader followed by the records, oldest first.
+		* @param path file to (over)write.
+		* @return the number of records written, -1 if the file cannot be written.
+		*/
+		long long dump(const char *path) const {
+			std::vector<TraceRecord> records;
+			TraceFileHeader header;
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, "RGTRACE", 8);
+			header.version = 1;
+			header.record_size = (uint32_t)sizeof(TraceRecord);
+			header.dropped = snapshot(records);
+			header.count = records.size();
+
+			FILE *file = std::fopen(path, "wb");
+			if (file == nullptr) {
+				return -1;
+			}
+			bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+				(records.empty() || std::fwrite(records.data(), sizeof(TraceRecord), records.size(), file) == records.size());
+			ok = std::fclose(file) == 0 && ok;
+
+			return ok ? (long long)records.size() : -1;
+		}
+	};
+
+	/** True if the library has been built with solver tracing.
+	*/
+	inline bool traceEnabled() {
+#ifdef RG_ENABLE_TRACE
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	/** Where a solver run writes its iterations: set by the reference generator in the solver workspace.
+	*/
+	struct TraceTarget {
+		TraceBuffer *buffer;	/**< nullptr: no tracing. */
+		uint32_t source;
+		uint32_t call;
+		uint16_t chain;
+
+		TraceTarget() : buffer(nullptr), source(0), call(0), chain(0) {
+		}
+	};
+
+	namespace detail {
+
+		/** Records a solver iteration.
+		*/
+		template<class R, class V>
+		void trace_iteration(const TraceTarget &target, uint8_t solver, size_t k, R ak, R ck, R yplus, R yminus, R grad, R normalization,
+			const V &theta, size_t size) {
+
+			TraceRecord record;
+			record.seq = 0;
+			record.source = target.source;
+			record.call = target.call;
+			record.iteration = (uint16_t)(k < 65535 ? k : 65535);
+			record.solver = solver;
+			record.dim = (uint8_t)(size < 255 ? size : 255);
+			record.chain = target.chain;
+			record.flags = normalization < 1 ? TRACE_CLIPPED : 0;
+			record.ak = (float)ak;
+			record.ck = (float)ck;
+			record.yplus = (float)yplus;
+			record.yminus = (float)yminus;
+			record.grad = (float)grad;
+			record.normalization = (float)normalization;
+			for (size_t i = 0; i < 3; i++) {
+				record.theta[i] = i < size ? (float)theta(i, 0) : 0.0f;
+			}
+			record.reserved = 0;
+
+			target.buffer->push(record);
+		}
+	}
+}